@@ -23,4 +23,7 @@ public:
     void free() {_packetdb.freePacket(this);}
     virtual ~CbrPacket(){};
 };
+
+PACKET_SIZE_BUDGET(CbrPacket, 80);
+
 #endif
@@ -2,11 +2,13 @@
 #include <iostream>
 #include "clock.h"
 #include "eventlist.h"
+#include "memstats.h"
 
 Clock::Clock(simtime_picosec period, EventList& eventlist)
   : EventSource(eventlist,"clock"), 
-    _period(period), _smallticks(0)
+    _period(period), _smallticks(0), _memreport_ticks(0), _ticks(0)
 {
+    setPeriodic(period);
     eventlist.sourceIsPendingRel(*this, period);
 }
 
@@ -21,4 +23,9 @@ Clock::doNextEvent() {
         cout << '|' << flush;
         _smallticks=0;
     }
+    _ticks++;
+    if (_memreport_ticks && _ticks % _memreport_ticks == 0) {
+        cout << endl;
+        MemoryStats::report(cout);
+    }
 }
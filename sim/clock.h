@@ -13,9 +13,13 @@ class Clock : public EventSource {
 public:
         Clock(simtime_picosec period, EventList& eventlist); 
         void doNextEvent();
+        // print a MemoryStats report every n ticks (0 to disable)
+        void setMemoryReport(uint32_t ticks) {_memreport_ticks = ticks;}
 private:
         simtime_picosec _period;
         int _smallticks;
+        uint32_t _memreport_ticks;
+        uint32_t _ticks;
         };
 
 #endif
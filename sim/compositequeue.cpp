@@ -24,6 +24,7 @@ CompositeQueue::CompositeQueue(linkspeed_bps bitrate, mem_b maxsize, EventList&
     _ecn_maxthresh = maxsize*2; // don't set ECN by default
 
     _return_to_sender = false;
+    _rng.setId(get_id());
 
     _queuesize_high = _queuesize_low = 0;
     _serv = QUEUE_INVALID;
@@ -69,7 +70,7 @@ bool CompositeQueue::decide_ECN() {
         return true;
     } else if (_queuesize_low > _ecn_minthresh) {
         uint64_t p = (0x7FFFFFFF * (_queuesize_low - _ecn_minthresh))/(_ecn_maxthresh - _ecn_minthresh);
-        if ((uint64_t)random() < p) {
+        if ((uint64_t)_rng.rand() < p) {
             return true;
         }
     }
@@ -115,6 +116,7 @@ CompositeQueue::completeService(){
     }
     
     pkt->flow().logTraffic(*pkt,*this,TrafficLogger::PKT_DEPART);
+    levelChanged();
     pkt->sendOn();
 
     //_virtual_time += drainTime(pkt);
@@ -139,7 +141,7 @@ CompositeQueue::receivePacket(Packet& pkt)
     if (_logger) _logger->logQueue(*this, QueueLogger::PKT_ARRIVE, pkt);
 
     if (!pkt.header_only()){
-        if (_queuesize_low+pkt.size() <= _maxsize  || drand()<0.5) {
+        if (_queuesize_low+pkt.size() <= _maxsize  || _rng.drand()<0.5) {
             //regular packet; don't drop the arriving packet
 
             // we are here because either the queue isn't full or,
@@ -203,6 +205,7 @@ CompositeQueue::receivePacket(Packet& pkt)
             _enqueued_low.push(pkt_p);
             _queuesize_low += pkt.size();
             if (_logger) _logger->logQueue(*this, QueueLogger::PKT_ENQUEUE, pkt);
+            levelChanged();
             
             if (_serv==QUEUE_INVALID) {
                 beginService();
@@ -263,6 +266,7 @@ CompositeQueue::receivePacket(Packet& pkt)
     _enqueued_high.push(pkt_p);
     _queuesize_high += pkt.size();
     if (_logger) _logger->logQueue(*this, QueueLogger::PKT_ENQUEUE, pkt);
+    levelChanged();
     
     //cout << "BH[ " << _enqueued_low.size() << " " << _enqueued_high.size() << " ]" << endl;
     
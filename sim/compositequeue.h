@@ -17,6 +17,7 @@
 #include "eventlist.h"
 #include "network.h"
 #include "loggertypes.h"
+#include "rng.h"
 
 class CompositeQueue : public Queue {
  public:
@@ -75,6 +76,8 @@ class CompositeQueue : public Queue {
 
     bool _return_to_sender;
 
+    RngStream _rng; // for ECN marking and trimming decisions
+
     CircularBuffer<Packet*> _enqueued_low;
     CircularBuffer<Packet*> _enqueued_high;
 };
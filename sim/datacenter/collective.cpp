@@ -0,0 +1,187 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#include "collective.h"
+#include <iostream>
+#include <string.h>
+#include <limits.h>
+
+void CollectiveFlow::activate() {
+    _owner.flowDone(this);
+}
+
+Collective::Collective(EventList& eventlist, algorithm algo, const vector<uint32_t>& hosts,
+                       uint64_t bytes, WorkloadTarget& target, uint32_t parallel)
+    : _eventlist(eventlist), _algo(algo), _hosts(hosts), _bytes(bytes), _target(target),
+      _parallel(parallel)
+{
+    uint64_t n = hosts.size();
+    assert(n > 1);
+    assert(parallel > 0);
+    switch (algo) {
+    case RING:
+        _flows_total = n * 2 * (n - 1);
+        // each step moves one chunk of the buffer
+        _bytes = (bytes + n - 1) / n;
+        break;
+    case TREE:
+        _flows_total = 2 * (n - 1);
+        _rank_state.resize(n);
+        for (uint32_t r = 0; r < n; r++)
+            _rank_state[r] = children(r);
+        break;
+    case BUTTERFLY:
+        if (n & (n - 1)) {
+            cerr << "Butterfly collective needs a power of two ranks, found " << n << endl;
+            exit(1);
+        }
+        _flows_total = 0;
+        for (uint64_t i = 1; i < n; i <<= 1)
+            _flows_total += n;
+        break;
+    case ALLTOALL:
+        _flows_total = n * (n - 1);
+        _rank_state.resize(n, 1);
+        break;
+    }
+    if (_bytes > (uint64_t)INT_MAX) {
+        // connection::size is an int
+        cerr << "Collective flows of " << _bytes << " bytes are too large, the limit is "
+             << INT_MAX << " bytes per flow" << endl;
+        exit(1);
+    }
+    _flows_done = 0;
+    _start_time = 0;
+    _finish_time = 0;
+
+    _flow.flowid = 0;
+    _flow.send_done_trigger = 0;
+    _flow.recv_done_trigger = 0;
+    _flow.trigger = 0;
+    _flow.priority = 2000000;
+    _flow.size = _bytes;
+}
+
+bool Collective::parse(const char* name, algorithm& algo) {
+    if (!strcmp(name, "ring"))
+        algo = RING;
+    else if (!strcmp(name, "tree"))
+        algo = TREE;
+    else if (!strcmp(name, "butterfly"))
+        algo = BUTTERFLY;
+    else if (!strcmp(name, "alltoall"))
+        algo = ALLTOALL;
+    else
+        return false;
+    return true;
+}
+
+const char* Collective::name(algorithm algo) {
+    switch (algo) {
+    case RING: return "ring";
+    case TREE: return "tree";
+    case BUTTERFLY: return "butterfly";
+    case ALLTOALL: return "alltoall";
+    }
+    return "unknown";
+}
+
+// ranks form a binary heap: parent (r-1)/2, children 2r+1 and 2r+2
+uint32_t Collective::children(uint32_t rank) const {
+    uint32_t n = _hosts.size();
+    return (2 * rank + 1 < n) + (2 * rank + 2 < n);
+}
+
+void Collective::start(simtime_picosec when) {
+    uint32_t n = _hosts.size();
+    _start_time = when;
+    switch (_algo) {
+    case RING:
+        for (uint32_t r = 0; r < n; r++)
+            send(r, (r + 1) % n, 0, when);
+        break;
+    case TREE:
+        // leaves start the reduce
+        for (uint32_t r = 1; r < n; r++)
+            if (_rank_state[r] == 0)
+                send(r, (r - 1) / 2, 0, when);
+        break;
+    case BUTTERFLY:
+        for (uint32_t r = 0; r < n; r++)
+            send(r, r ^ 1, 0, when);
+        break;
+    case ALLTOALL:
+        for (uint32_t r = 0; r < n; r++) {
+            while (_rank_state[r] < n && _rank_state[r] <= _parallel) {
+                send(r, (r + _rank_state[r]) % n, _rank_state[r], when);
+                _rank_state[r]++;
+            }
+        }
+        break;
+    }
+}
+
+void Collective::send(uint32_t src, uint32_t dst, uint32_t step, simtime_picosec when) {
+    CollectiveFlow* f;
+    if (_free_flows.empty()) {
+        f = new CollectiveFlow(_eventlist, *this);
+    } else {
+        f = _free_flows.back();
+        _free_flows.pop_back();
+    }
+    f->_src = src;
+    f->_dst = dst;
+    f->_step = step;
+
+    _flow.src = _hosts[src];
+    _flow.dst = _hosts[dst];
+    _flow.start = when;
+    _target.newFlow(_flow, f);
+}
+
+void Collective::flowDone(CollectiveFlow* f) {
+    uint32_t n = _hosts.size();
+    uint32_t src = f->_src, dst = f->_dst, step = f->_step;
+    simtime_picosec now = _eventlist.now();
+    // the source doesn't activate it again
+    _free_flows.push_back(f);
+    _flows_done++;
+
+    switch (_algo) {
+    case RING:
+        // dst now has chunk step, and passes it on
+        if (step + 1 < 2 * (n - 1))
+            send(dst, (dst + 1) % n, step + 1, now);
+        break;
+    case TREE:
+        if (step == 0) {
+            assert(_rank_state[dst] > 0);
+            if (--_rank_state[dst] > 0)
+                break;
+            if (dst != 0) {
+                send(dst, (dst - 1) / 2, 0, now);
+                break;
+            }
+            // the root has the result; broadcast it
+            step = 1;
+        }
+        for (uint32_t c = 2 * dst + 1; c <= 2 * dst + 2 && c < n; c++)
+            send(dst, c, 1, now);
+        break;
+    case BUTTERFLY:
+        if ((2u << step) < n)
+            send(dst, dst ^ (2u << step), step + 1, now);
+        break;
+    case ALLTOALL:
+        if (_rank_state[src] < n) {
+            send(src, (src + _rank_state[src]) % n, _rank_state[src], now);
+            _rank_state[src]++;
+        }
+        break;
+    }
+
+    if (finished()) {
+        _finish_time = now;
+        cout << "Collective " << name(_algo) << " of " << n << " ranks finished at "
+             << timeAsUs(now) << " after " << timeAsUs(now - _start_time) << "us, "
+             << _flows_total << " flows" << endl;
+    }
+}
@@ -0,0 +1,91 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef COLLECTIVE_H
+#define COLLECTIVE_H
+
+#include <vector>
+#include "config.h"
+#include "eventlist.h"
+#include "trigger.h"
+#include "workload.h"
+
+/*
+ * A collective operation among a group of hosts, run natively rather
+ * than expanded into a connection matrix of flows and triggers by the
+ * gen_allreduce*.py and gen_serial*_alltoall.py scripts.
+ *
+ * Flows are only created when the data they depend on has arrived, so
+ * the collective holds state for the flows in flight and a counter per
+ * rank, not for every flow of the operation.
+ *
+ *   RING       ring allreduce: 2(n-1) steps, each rank sending a 1/n
+ *              chunk to its successor once it has the previous chunk
+ *   TREE       binary tree reduce to rank 0, then broadcast back down
+ *   BUTTERFLY  recursive doubling: log2(n) steps, each rank exchanging
+ *              the whole buffer with rank ^ 2^step.  n a power of two.
+ *   ALLTOALL   each rank sends to rank+1, rank+2, ... in turn, with at
+ *              most parallel flows outstanding
+ *
+ * A flow's data has arrived when its source sees it all acked, which is
+ * when the transport activates its end trigger.
+ */
+
+class Collective;
+
+// A flow of the collective, activated by its source when it finishes.
+// Recycled once it has been activated.
+class CollectiveFlow : public Trigger {
+public:
+    CollectiveFlow(EventList& eventlist, Collective& owner)
+        : Trigger(eventlist, 0), _owner(owner) {}
+    virtual void activate();
+
+    uint32_t _src;   // ranks
+    uint32_t _dst;
+    uint32_t _step;
+private:
+    Collective& _owner;
+};
+
+class Collective {
+public:
+    enum algorithm {RING, TREE, BUTTERFLY, ALLTOALL};
+
+    // hosts are the ranks' host ids, in rank order
+    Collective(EventList& eventlist, algorithm algo, const vector<uint32_t>& hosts,
+               uint64_t bytes, WorkloadTarget& target, uint32_t parallel = 1);
+
+    void start(simtime_picosec when);
+    bool finished() const {return _flows_done == _flows_total;}
+    simtime_picosec finishTime() const {return _finish_time;}
+    uint64_t flowsDone() const {return _flows_done;}
+    uint64_t flowsTotal() const {return _flows_total;}
+
+    static bool parse(const char* name, algorithm& algo);
+    static const char* name(algorithm algo);
+
+    void flowDone(CollectiveFlow* f);
+private:
+    void send(uint32_t src, uint32_t dst, uint32_t step, simtime_picosec when);
+    uint32_t children(uint32_t rank) const;
+
+    EventList& _eventlist;
+    algorithm _algo;
+    vector<uint32_t> _hosts;
+    uint64_t _bytes;
+    WorkloadTarget& _target;
+    uint32_t _parallel;
+
+    // TREE: children still to be heard from in the reduce phase.
+    // ALLTOALL: offset of the next destination.
+    vector<uint32_t> _rank_state;
+
+    vector<CollectiveFlow*> _free_flows;
+    connection _flow;
+
+    uint64_t _flows_total;
+    uint64_t _flows_done;
+    simtime_picosec _start_time;
+    simtime_picosec _finish_time;
+};
+
+#endif
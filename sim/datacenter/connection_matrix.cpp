@@ -751,7 +751,7 @@ bool ConnectionMatrix::load(istream& file){
             for (size_t i = 1; i < tokens.size(); i++) {
                 if (tokens[i] == "start") {
                     i++;
-                    double start = stof(tokens[i]);
+                    double start = stod(tokens[i]);
                     c->start = start; // start is in picoseconds already
                 } else if (tokens[i] == "size") {
                     i++;
@@ -867,6 +867,8 @@ bool ConnectionMatrix::load(istream& file){
                 assert (failures.size()<failures_size);
 
             failure *f = new failure;
+            f->start = NO_START;
+            f->end = NO_START;
 
             for (size_t i = 1; i < tokens.size(); i++) {
                         if (tokens[i] == "switch_type") {
@@ -887,6 +889,12 @@ bool ConnectionMatrix::load(istream& file){
                         } else if (tokens[i] == "link_id") {
                                 i++;
                                 f->link_id = stoi(tokens[i]);
+                        } else if (tokens[i] == "start") {
+                                i++;
+                                f->start = stod(tokens[i]);
+                        } else if (tokens[i] == "end") {
+                                i++;
+                                f->end = stod(tokens[i]);
                         } else {
                                 cerr << "Error: unknown failure attribute " << tokens[i] << " at line " << linecount << endl;
                                 exit(1);
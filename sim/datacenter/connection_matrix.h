@@ -39,6 +39,11 @@ struct failure {
     FatTreeSwitch::switch_type switch_type;
     uint32_t switch_id;
     uint32_t link_id;
+    // when the link fails and recovers during the run, in picoseconds
+    // like connection start times.  Without a start time the link is
+    // failed from the outset; without an end time it never recovers.
+    simtime_picosec start;
+    simtime_picosec end;
 };
 
 
@@ -40,12 +40,13 @@ private:
 
 DragonFlyPlusTopology::DragonFlyPlusTopology(uint32_t p, uint32_t h, uint32_t a, uint32_t h_plus,
                                            mem_b queuesize, Logfile* lg, EventList* ev,
-                                           queue_type q, simtime_picosec rtt) {
+                                           queue_type q, simtime_picosec rtt, bool hop_by_hop) {
     _queuesize = queuesize;
     logfile = lg;
     _eventlist = ev;
     qt = q;
     _rtt = rtt;
+    _hop_by_hop = hop_by_hop;
     
     _p = p;
     _a = a;
@@ -72,6 +73,7 @@ DragonFlyPlusTopology::DragonFlyPlusTopology(uint32_t no_of_nodes, mem_b queuesi
     _eventlist = ev;
     qt = q;
     _rtt = rtt;
+    _hop_by_hop = false;
     
     set_params(no_of_nodes);
     init_network();
@@ -114,11 +116,14 @@ void DragonFlyPlusTopology::set_params() {
     // Initialize vectors
     switches.resize(_no_of_switches, NULL);
     
-    pipes_host_switch.resize(_no_of_nodes, vector<Pipe*>(_no_of_switches));
-    queues_host_switch.resize(_no_of_nodes, vector<Queue*>(_no_of_switches));
+    pipes_host_switch.resize(_no_of_nodes, NULL);
+    queues_host_switch.resize(_no_of_nodes, NULL);
     
-    pipes_switch_host.resize(_no_of_switches, vector<Pipe*>(_no_of_nodes));
-    queues_switch_host.resize(_no_of_switches, vector<Queue*>(_no_of_nodes));
+    pipes_switch_host.resize(_no_of_nodes, NULL);
+    queues_switch_host.resize(_no_of_nodes, NULL);
+    
+    if (_hop_by_hop)
+        return;
     
     pipes_switch_switch.resize(_no_of_switches, vector<Pipe*>(_no_of_switches));
     queues_switch_switch.resize(_no_of_switches, vector<Queue*>(_no_of_switches));
@@ -191,25 +196,17 @@ void DragonFlyPlusTopology::count_queue(Queue* queue) {
 void DragonFlyPlusTopology::init_network() {
     QueueLoggerSampling* queueLogger;
     
-    // Initialize all arrays to NULL
-    for (uint32_t j = 0; j < _no_of_switches; j++) {
-        for (uint32_t k = 0; k < _no_of_switches; k++) {
-            queues_switch_switch[j][k] = NULL;
-            pipes_switch_switch[j][k] = NULL;
-            queues_global_plus[j][k] = NULL;
-            pipes_global_plus[j][k] = NULL;
+    // Create switches if we have lossless operation, or if they route packets
+    if (_hop_by_hop) {
+        if (qt == LOSSLESS || qt == LOSSLESS_INPUT || qt == LOSSLESS_INPUT_ECN) {
+            cerr << "Hop-by-hop DragonFly routing does not support lossless queues" << endl;
+            exit(1);
         }
-        
-        for (uint32_t k = 0; k < _no_of_nodes; k++) {
-            queues_switch_host[j][k] = NULL;
-            pipes_switch_host[j][k] = NULL;
-            queues_host_switch[k][j] = NULL;
-            pipes_host_switch[k][j] = NULL;
+        for (uint32_t j = 0; j < _no_of_switches; j++) {
+            switches[j] = new DragonFlySwitch(*_eventlist, "Switch_" + ntoa(j), j, 0,
+                                              _p, _a, _no_of_groups);
         }
-    }
-    
-    // Create switches if we have lossless operation
-    if (qt == LOSSLESS || qt == LOSSLESS_INPUT || qt == LOSSLESS_INPUT_ECN) {
+    } else if (qt == LOSSLESS || qt == LOSSLESS_INPUT || qt == LOSSLESS_INPUT_ECN) {
         for (uint32_t j = 0; j < _no_of_switches; j++) {
             switches[j] = new Switch(*_eventlist, "Switch_" + ntoa(j));
         }
@@ -224,32 +221,37 @@ void DragonFlyPlusTopology::init_network() {
             queueLogger = new QueueLoggerSampling(timeFromUs((uint32_t)10), *_eventlist);
             logfile->addLogger(*queueLogger);
             
-            queues_switch_host[j][k] = alloc_queue(queueLogger, _queuesize, true);
-            queues_switch_host[j][k]->setName("SW" + ntoa(j) + "->DST" + ntoa(k));
-            logfile->writeName(*(queues_switch_host[j][k]));
+            queues_switch_host[k] = alloc_queue(queueLogger, _queuesize, true);
+            queues_switch_host[k]->setName("SW" + ntoa(j) + "->DST" + ntoa(k));
+            logfile->writeName(*(queues_switch_host[k]));
             
-            pipes_switch_host[j][k] = new Pipe(_rtt, *_eventlist);
-            pipes_switch_host[j][k]->setName("Pipe-SW" + ntoa(j) + "->DST" + ntoa(k));
-            logfile->writeName(*(pipes_switch_host[j][k]));
+            pipes_switch_host[k] = new Pipe(_rtt, *_eventlist);
+            pipes_switch_host[k]->setName("Pipe-SW" + ntoa(j) + "->DST" + ntoa(k));
+            logfile->writeName(*(pipes_switch_host[k]));
             
             // Uplink (Host -> Switch)
             queueLogger = new QueueLoggerSampling(timeFromMs(1000), *_eventlist);
             logfile->addLogger(*queueLogger);
             
-            queues_host_switch[k][j] = alloc_src_queue(queueLogger);
-            queues_host_switch[k][j]->setName("SRC" + ntoa(k) + "->SW" + ntoa(j));
-            logfile->writeName(*(queues_host_switch[k][j]));
+            queues_host_switch[k] = alloc_src_queue(queueLogger);
+            queues_host_switch[k]->setName("SRC" + ntoa(k) + "->SW" + ntoa(j));
+            logfile->writeName(*(queues_host_switch[k]));
             
             if (qt == LOSSLESS) {
-                switches[j]->addPort(queues_switch_host[j][k]);
-                ((LosslessQueue*)queues_switch_host[j][k])->setRemoteEndpoint(queues_host_switch[k][j]);
+                switches[j]->addPort(queues_switch_host[k]);
+                ((LosslessQueue*)queues_switch_host[k])->setRemoteEndpoint(queues_host_switch[k]);
             } else if (qt == LOSSLESS_INPUT || qt == LOSSLESS_INPUT_ECN) {
-                new LosslessInputQueue(*_eventlist, queues_host_switch[k][j]);
+                new LosslessInputQueue(*_eventlist, queues_host_switch[k]);
             }
             
-            pipes_host_switch[k][j] = new Pipe(_rtt, *_eventlist);
-            pipes_host_switch[k][j]->setName("Pipe-SRC" + ntoa(k) + "->SW" + ntoa(j));
-            logfile->writeName(*(pipes_host_switch[k][j]));
+            pipes_host_switch[k] = new Pipe(_rtt, *_eventlist);
+            pipes_host_switch[k]->setName("Pipe-SRC" + ntoa(k) + "->SW" + ntoa(j));
+            logfile->writeName(*(pipes_host_switch[k]));
+
+            if (_hop_by_hop) {
+                queues_host_switch[k]->setRemoteEndpoint(switches[j]);
+                ((DragonFlySwitch*)switches[j])->addHostLink(k, queues_switch_host[k], pipes_switch_host[k]);
+            }
         }
     }
     
@@ -258,38 +260,7 @@ void DragonFlyPlusTopology::init_network() {
         uint32_t groupid = j / _a;
         
         for (uint32_t k = j + 1; k < (groupid + 1) * _a; k++) {
-            // Bidirectional links within group
-            queueLogger = new QueueLoggerSampling(timeFromMs(1000), *_eventlist);
-            logfile->addLogger(*queueLogger);
-            
-            queues_switch_switch[j][k] = alloc_queue(queueLogger, _queuesize, false);
-            queues_switch_switch[j][k]->setName("SW" + ntoa(j) + "->SW" + ntoa(k));
-            logfile->writeName(*(queues_switch_switch[j][k]));
-            
-            queueLogger = new QueueLoggerSampling(timeFromMs(1000), *_eventlist);
-            logfile->addLogger(*queueLogger);
-            
-            queues_switch_switch[k][j] = alloc_queue(queueLogger, _queuesize, false);
-            queues_switch_switch[k][j]->setName("SW" + ntoa(k) + "->SW" + ntoa(j));
-            logfile->writeName(*(queues_switch_switch[k][j]));
-            
-            if (qt == LOSSLESS) {
-                switches[j]->addPort(queues_switch_switch[j][k]);
-                switches[k]->addPort(queues_switch_switch[k][j]);
-                ((LosslessQueue*)queues_switch_switch[j][k])->setRemoteEndpoint(queues_switch_switch[k][j]);
-                ((LosslessQueue*)queues_switch_switch[k][j])->setRemoteEndpoint(queues_switch_switch[j][k]);
-            } else if (qt == LOSSLESS_INPUT || qt == LOSSLESS_INPUT_ECN) {
-                new LosslessInputQueue(*_eventlist, queues_switch_switch[j][k]);
-                new LosslessInputQueue(*_eventlist, queues_switch_switch[k][j]);
-            }
-            
-            pipes_switch_switch[j][k] = new Pipe(_rtt, *_eventlist);
-            pipes_switch_switch[j][k]->setName("Pipe-SW" + ntoa(j) + "->SW" + ntoa(k));
-            logfile->writeName(*(pipes_switch_switch[j][k]));
-            
-            pipes_switch_switch[k][j] = new Pipe(_rtt, *_eventlist);
-            pipes_switch_switch[k][j]->setName("Pipe-SW" + ntoa(k) + "->SW" + ntoa(j));
-            logfile->writeName(*(pipes_switch_switch[k][j]));
+            connect_switches(j, k, false, false);
         }
     }
     
@@ -297,41 +268,7 @@ void DragonFlyPlusTopology::init_network() {
     for (uint32_t g1 = 0; g1 < _no_of_groups; g1++) {
         for (uint32_t g2 = g1 + 1; g2 < _no_of_groups; g2++) {
             for (uint32_t i = 0; i < _h; i++) {
-                uint32_t src = g1 * _a + i;
-                uint32_t dst = g2 * _a + i;
-                
-                // Bidirectional global links
-                queueLogger = new QueueLoggerSampling(timeFromMs(1000), *_eventlist);
-                logfile->addLogger(*queueLogger);
-                
-                queues_switch_switch[src][dst] = alloc_queue(queueLogger, _queuesize, false);
-                queues_switch_switch[src][dst]->setName("SW" + ntoa(src) + "->SW" + ntoa(dst) + "(Global)");
-                logfile->writeName(*(queues_switch_switch[src][dst]));
-                
-                queueLogger = new QueueLoggerSampling(timeFromMs(1000), *_eventlist);
-                logfile->addLogger(*queueLogger);
-                
-                queues_switch_switch[dst][src] = alloc_queue(queueLogger, _queuesize, false);
-                queues_switch_switch[dst][src]->setName("SW" + ntoa(dst) + "->SW" + ntoa(src) + "(Global)");
-                logfile->writeName(*(queues_switch_switch[dst][src]));
-                
-                if (qt == LOSSLESS) {
-                    switches[src]->addPort(queues_switch_switch[src][dst]);
-                    switches[dst]->addPort(queues_switch_switch[dst][src]);
-                    ((LosslessQueue*)queues_switch_switch[src][dst])->setRemoteEndpoint(queues_switch_switch[dst][src]);
-                    ((LosslessQueue*)queues_switch_switch[dst][src])->setRemoteEndpoint(queues_switch_switch[src][dst]);
-                } else if (qt == LOSSLESS_INPUT || qt == LOSSLESS_INPUT_ECN) {
-                    new LosslessInputQueue(*_eventlist, queues_switch_switch[src][dst]);
-                    new LosslessInputQueue(*_eventlist, queues_switch_switch[dst][src]);
-                }
-                
-                pipes_switch_switch[src][dst] = new Pipe(_rtt, *_eventlist);
-                pipes_switch_switch[src][dst]->setName("Pipe-SW" + ntoa(src) + "->SW" + ntoa(dst) + "(Global)");
-                logfile->writeName(*(pipes_switch_switch[src][dst]));
-                
-                pipes_switch_switch[dst][src] = new Pipe(_rtt, *_eventlist);
-                pipes_switch_switch[dst][src]->setName("Pipe-SW" + ntoa(dst) + "->SW" + ntoa(src) + "(Global)");
-                logfile->writeName(*(pipes_switch_switch[dst][src]));
+                connect_switches(g1 * _a + i, g2 * _a + i, true, false);
             }
         }
     }
@@ -340,46 +277,105 @@ void DragonFlyPlusTopology::init_network() {
     for (uint32_t g1 = 0; g1 < _no_of_groups; g1++) {
         for (uint32_t g2 = g1 + 1; g2 < _no_of_groups; g2++) {
             for (uint32_t i = 0; i < _h_plus; i++) {
-                uint32_t src = g1 * _a + i;
-                uint32_t dst = g2 * _a + (_a - i - 1);  // Connect to complementary switch
-                
-                // Bidirectional additional global links
-                queueLogger = new QueueLoggerSampling(timeFromMs(1000), *_eventlist);
-                logfile->addLogger(*queueLogger);
-                
-                queues_global_plus[src][dst] = alloc_queue(queueLogger, _queuesize, false);
-                queues_global_plus[src][dst]->setName("SW" + ntoa(src) + "->SW" + ntoa(dst) + "(Plus)");
-                logfile->writeName(*(queues_global_plus[src][dst]));
-                
-                queueLogger = new QueueLoggerSampling(timeFromMs(1000), *_eventlist);
-                logfile->addLogger(*queueLogger);
-                
-                queues_global_plus[dst][src] = alloc_queue(queueLogger, _queuesize, false);
-                queues_global_plus[dst][src]->setName("SW" + ntoa(dst) + "->SW" + ntoa(src) + "(Plus)");
-                logfile->writeName(*(queues_global_plus[dst][src]));
-                
-                if (qt == LOSSLESS) {
-                    switches[src]->addPort(queues_global_plus[src][dst]);
-                    switches[dst]->addPort(queues_global_plus[dst][src]);
-                    ((LosslessQueue*)queues_global_plus[src][dst])->setRemoteEndpoint(queues_global_plus[dst][src]);
-                    ((LosslessQueue*)queues_global_plus[dst][src])->setRemoteEndpoint(queues_global_plus[src][dst]);
-                } else if (qt == LOSSLESS_INPUT || qt == LOSSLESS_INPUT_ECN) {
-                    new LosslessInputQueue(*_eventlist, queues_global_plus[src][dst]);
-                    new LosslessInputQueue(*_eventlist, queues_global_plus[dst][src]);
-                }
-                
-                pipes_global_plus[src][dst] = new Pipe(_rtt, *_eventlist);
-                pipes_global_plus[src][dst]->setName("Pipe-SW" + ntoa(src) + "->SW" + ntoa(dst) + "(Plus)");
-                logfile->writeName(*(pipes_global_plus[src][dst]));
-                
-                pipes_global_plus[dst][src] = new Pipe(_rtt, *_eventlist);
-                pipes_global_plus[dst][src]->setName("Pipe-SW" + ntoa(dst) + "->SW" + ntoa(src) + "(Plus)");
-                logfile->writeName(*(pipes_global_plus[dst][src]));
+                // Connect to complementary switch
+                connect_switches(g1 * _a + i, g2 * _a + (_a - i - 1), true, true);
+            }
+        }
+    }
+
+    if (!_hop_by_hop)
+        return;
+
+    // Routers without a global link to a group reach it through the
+    // routers in their group that have one.
+    vector<uint32_t> gateways;
+    for (uint32_t group = 0; group < _no_of_groups; group++) {
+        for (uint32_t g = 0; g < _no_of_groups; g++) {
+            if (g == group)
+                continue;
+            gateways.clear();
+            for (uint32_t j = group * _a; j < (group + 1) * _a; j++) {
+                if (((DragonFlySwitch*)switches[j])->hasGlobalLink(g))
+                    gateways.push_back(j % _a);
+            }
+            if (gateways.empty()) {
+                cerr << "No global link from group " << group << " to group " << g << endl;
+                exit(1);
+            }
+            for (uint32_t j = group * _a; j < (group + 1) * _a; j++) {
+                DragonFlySwitch* sw = (DragonFlySwitch*)switches[j];
+                if (sw->hasGlobalLink(g))
+                    continue;
+                for (uint32_t r = 0; r < gateways.size(); r++)
+                    sw->addGateway(g, gateways[r]);
             }
         }
     }
 }
 
+// Bidirectional link between two switches, either within a group or
+// (global) between groups.
+void DragonFlyPlusTopology::connect_switches(uint32_t src, uint32_t dst, bool global, bool plus) {
+    string kind = plus ? "(Plus)" : (global ? "(Global)" : "");
+    QueueLoggerSampling* queueLogger;
+
+    queueLogger = new QueueLoggerSampling(timeFromMs(1000), *_eventlist);
+    logfile->addLogger(*queueLogger);
+    
+    Queue* q_sd = alloc_queue(queueLogger, _queuesize, false);
+    q_sd->setName("SW" + ntoa(src) + "->SW" + ntoa(dst) + kind);
+    logfile->writeName(*q_sd);
+    
+    queueLogger = new QueueLoggerSampling(timeFromMs(1000), *_eventlist);
+    logfile->addLogger(*queueLogger);
+    
+    Queue* q_ds = alloc_queue(queueLogger, _queuesize, false);
+    q_ds->setName("SW" + ntoa(dst) + "->SW" + ntoa(src) + kind);
+    logfile->writeName(*q_ds);
+    
+    if (qt == LOSSLESS) {
+        switches[src]->addPort(q_sd);
+        switches[dst]->addPort(q_ds);
+        ((LosslessQueue*)q_sd)->setRemoteEndpoint(q_ds);
+        ((LosslessQueue*)q_ds)->setRemoteEndpoint(q_sd);
+    } else if (qt == LOSSLESS_INPUT || qt == LOSSLESS_INPUT_ECN) {
+        new LosslessInputQueue(*_eventlist, q_sd);
+        new LosslessInputQueue(*_eventlist, q_ds);
+    }
+    
+    Pipe* p_sd = new Pipe(_rtt, *_eventlist);
+    p_sd->setName("Pipe-SW" + ntoa(src) + "->SW" + ntoa(dst) + kind);
+    logfile->writeName(*p_sd);
+    
+    Pipe* p_ds = new Pipe(_rtt, *_eventlist);
+    p_ds->setName("Pipe-SW" + ntoa(dst) + "->SW" + ntoa(src) + kind);
+    logfile->writeName(*p_ds);
+
+    if (_hop_by_hop) {
+        DragonFlySwitch* sw_s = (DragonFlySwitch*)switches[src];
+        DragonFlySwitch* sw_d = (DragonFlySwitch*)switches[dst];
+        q_sd->setRemoteEndpoint(sw_d);
+        q_ds->setRemoteEndpoint(sw_s);
+        if (global) {
+            sw_s->addGlobalLink(sw_d, q_sd, p_sd);
+            sw_d->addGlobalLink(sw_s, q_ds, p_ds);
+        } else {
+            sw_s->addLocalLink(sw_d, q_sd, p_sd);
+            sw_d->addLocalLink(sw_s, q_ds, p_ds);
+        }
+    } else if (plus) {
+        queues_global_plus[src][dst] = q_sd;
+        queues_global_plus[dst][src] = q_ds;
+        pipes_global_plus[src][dst] = p_sd;
+        pipes_global_plus[dst][src] = p_ds;
+    } else {
+        queues_switch_switch[src][dst] = q_sd;
+        queues_switch_switch[dst][src] = q_ds;
+        pipes_switch_switch[src][dst] = p_sd;
+        pipes_switch_switch[dst][src] = p_ds;
+    }
+}
+
 bool DragonFlyPlusTopology::is_valid_route(Route* route) {
     if (!route || route->size() == 0) {
         return false;
@@ -451,6 +447,27 @@ vector<const Route*>* DragonFlyPlusTopology::get_bidir_paths(uint32_t src, uint3
     uint32_t src_sw = src / _p;
     uint32_t dst_sw = dest / _p;
     
+    if (_hop_by_hop) {
+        // the switches take it from the first router on
+        Route* routeout = new Route();
+        routeout->push_back(queues_host_switch[src]);
+        routeout->push_back(pipes_host_switch[src]);
+        routeout->push_back(switches[src_sw]);
+        
+        Route* routeback = new Route();
+        routeback->push_back(queues_host_switch[dest]);
+        routeback->push_back(pipes_host_switch[dest]);
+        routeback->push_back(switches[dst_sw]);
+        
+        routeout->set_path_id(0, 1);
+        routeback->set_path_id(0, 1);
+        routeout->set_reverse(routeback);
+        routeback->set_reverse(routeout);
+        
+        paths->push_back(routeout);
+        return paths;
+    }
+    
     // Count total possible paths first
     uint32_t total_paths = 0;
     
@@ -487,12 +504,12 @@ vector<const Route*>* DragonFlyPlusTopology::get_bidir_paths(uint32_t src, uint3
         bool valid_path = true;
         
         // Forward path
-        if (queues_host_switch[src][src_sw] && pipes_host_switch[src][src_sw]) {
-            routeout->push_back(queues_host_switch[src][src_sw]);
-            routeout->push_back(pipes_host_switch[src][src_sw]);
+        if (queues_host_switch[src] && pipes_host_switch[src]) {
+            routeout->push_back(queues_host_switch[src]);
+            routeout->push_back(pipes_host_switch[src]);
             
             if (qt == LOSSLESS_INPUT || qt == LOSSLESS_INPUT_ECN) {
-                PacketSink* remote = queues_host_switch[src][src_sw]->getRemoteEndpoint();
+                PacketSink* remote = queues_host_switch[src]->getRemoteEndpoint();
                 if (remote) routeout->push_back(remote);
             }
         } else {
@@ -530,20 +547,20 @@ vector<const Route*>* DragonFlyPlusTopology::get_bidir_paths(uint32_t src, uint3
             }
         }
         
-        if (queues_switch_host[dst_sw][dest] && pipes_switch_host[dst_sw][dest]) {
-            routeout->push_back(queues_switch_host[dst_sw][dest]);
-            routeout->push_back(pipes_switch_host[dst_sw][dest]);
+        if (queues_switch_host[dest] && pipes_switch_host[dest]) {
+            routeout->push_back(queues_switch_host[dest]);
+            routeout->push_back(pipes_switch_host[dest]);
         } else {
             valid_path = false;
         }
         
         // Reverse path
-        if (queues_host_switch[dest][dst_sw] && pipes_host_switch[dest][dst_sw]) {
-            routeback->push_back(queues_host_switch[dest][dst_sw]);
-            routeback->push_back(pipes_host_switch[dest][dst_sw]);
+        if (queues_host_switch[dest] && pipes_host_switch[dest]) {
+            routeback->push_back(queues_host_switch[dest]);
+            routeback->push_back(pipes_host_switch[dest]);
             
             if (qt == LOSSLESS_INPUT || qt == LOSSLESS_INPUT_ECN) {
-                PacketSink* remote = queues_host_switch[dest][dst_sw]->getRemoteEndpoint();
+                PacketSink* remote = queues_host_switch[dest]->getRemoteEndpoint();
                 if (remote) routeback->push_back(remote);
             }
         } else {
@@ -581,9 +598,9 @@ vector<const Route*>* DragonFlyPlusTopology::get_bidir_paths(uint32_t src, uint3
             }
         }
         
-        if (queues_switch_host[src_sw][src] && pipes_switch_host[src_sw][src]) {
-            routeback->push_back(queues_switch_host[src_sw][src]);
-            routeback->push_back(pipes_switch_host[src_sw][src]);
+        if (queues_switch_host[src] && pipes_switch_host[src]) {
+            routeback->push_back(queues_switch_host[src]);
+            routeback->push_back(pipes_switch_host[src]);
         } else {
             valid_path = false;
         }
@@ -624,12 +641,12 @@ vector<const Route*>* DragonFlyPlusTopology::get_bidir_paths(uint32_t src, uint3
             bool valid_path = true;
             
             // Forward path
-            if (queues_host_switch[src][src_sw] && pipes_host_switch[src][src_sw]) {
-                routeout->push_back(queues_host_switch[src][src_sw]);
-                routeout->push_back(pipes_host_switch[src][src_sw]);
+            if (queues_host_switch[src] && pipes_host_switch[src]) {
+                routeout->push_back(queues_host_switch[src]);
+                routeout->push_back(pipes_host_switch[src]);
                 
                 if (qt == LOSSLESS_INPUT || qt == LOSSLESS_INPUT_ECN) {
-                    PacketSink* remote = queues_host_switch[src][src_sw]->getRemoteEndpoint();
+                    PacketSink* remote = queues_host_switch[src]->getRemoteEndpoint();
                     if (remote) routeout->push_back(remote);
                 }
             } else {
@@ -692,20 +709,20 @@ vector<const Route*>* DragonFlyPlusTopology::get_bidir_paths(uint32_t src, uint3
                 valid_path = false;
             }
             
-            if (queues_switch_host[dst_sw][dest] && pipes_switch_host[dst_sw][dest]) {
-                routeout->push_back(queues_switch_host[dst_sw][dest]);
-                routeout->push_back(pipes_switch_host[dst_sw][dest]);
+            if (queues_switch_host[dest] && pipes_switch_host[dest]) {
+                routeout->push_back(queues_switch_host[dest]);
+                routeout->push_back(pipes_switch_host[dest]);
             } else {
                 valid_path = false;
             }
             
             // Reverse path
-            if (queues_host_switch[dest][dst_sw] && pipes_host_switch[dest][dst_sw]) {
-                routeback->push_back(queues_host_switch[dest][dst_sw]);
-                routeback->push_back(pipes_host_switch[dest][dst_sw]);
+            if (queues_host_switch[dest] && pipes_host_switch[dest]) {
+                routeback->push_back(queues_host_switch[dest]);
+                routeback->push_back(pipes_host_switch[dest]);
                 
                 if (qt == LOSSLESS_INPUT || qt == LOSSLESS_INPUT_ECN) {
-                    PacketSink* remote = queues_host_switch[dest][dst_sw]->getRemoteEndpoint();
+                    PacketSink* remote = queues_host_switch[dest]->getRemoteEndpoint();
                     if (remote) routeback->push_back(remote);
                 }
             } else {
@@ -768,9 +785,9 @@ vector<const Route*>* DragonFlyPlusTopology::get_bidir_paths(uint32_t src, uint3
                 valid_path = false;
             }
             
-            if (queues_switch_host[src_sw][src] && pipes_switch_host[src_sw][src]) {
-                routeback->push_back(queues_switch_host[src_sw][src]);
-                routeback->push_back(pipes_switch_host[src_sw][src]);
+            if (queues_switch_host[src] && pipes_switch_host[src]) {
+                routeback->push_back(queues_switch_host[src]);
+                routeback->push_back(pipes_switch_host[src]);
             } else {
                 valid_path = false;
             }
@@ -839,7 +856,7 @@ int64_t DragonFlyPlusTopology::find_switch(Queue* queue) {
 int64_t DragonFlyPlusTopology::find_destination(Queue* queue) {
     // Find the destination of this queue
     for (uint32_t i = 0; i < _no_of_nodes; i++) {
-        if (queues_host_switch[i][0] == queue)
+        if (queues_host_switch[i] == queue)
             return i;
     }
     return -1;
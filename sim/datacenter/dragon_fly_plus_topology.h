@@ -15,6 +15,7 @@
 #include "logfile.h"
 #include "eventlist.h"
 #include "switch.h"
+#include "dragon_fly_switch.h"
 #include <ostream>
 #include <vector>
 #include <map>
@@ -44,13 +45,19 @@ class DragonFlyPlusTopology : public Topology {
 public:
     vector<Switch*> switches;
     
-    // Network components
-    vector<vector<Pipe*>> pipes_host_switch;      // Connections from hosts to switches
+    // Network components.  Each host has a single router, so host links
+    // are indexed by host only.
+    vector<Pipe*> pipes_host_switch;              // Connections from hosts to switches
+    vector<Pipe*> pipes_switch_host;              // Connections from switches back to hosts
+    vector<Queue*> queues_host_switch;            // Queues from hosts to switches
+    vector<Queue*> queues_switch_host;            // Queues from switches back to hosts
+
+    // Links between switches, indexed [from][to].  These are only built
+    // for source routing; with hop-by-hop routing the links are held
+    // by the DragonFlySwitches, which keeps memory linear in the number
+    // of routers.
     vector<vector<Pipe*>> pipes_switch_switch;    // Local and global connections between switches
-    vector<vector<Queue*>> queues_host_switch;    // Queues from hosts to switches
     vector<vector<Queue*>> queues_switch_switch;  // Queues between switches
-    vector<vector<Pipe*>> pipes_switch_host;      // Connections from switches back to hosts
-    vector<vector<Queue*>> queues_switch_host;    // Queues from switches back to hosts
     
     // Additional global links for Plus enhancement
     vector<vector<Pipe*>> pipes_global_plus;      // Additional global connections
@@ -61,10 +68,12 @@ public:
     uint32_t failed_links;
     queue_type qt;
 
-    // Constructors
+    // Constructors.  With hop_by_hop, packets are routed by
+    // DragonFlySwitches (see DragonFlySwitch::_routing) and
+    // get_bidir_paths only returns the route to the first router.
     DragonFlyPlusTopology(uint32_t p, uint32_t h, uint32_t a, uint32_t h_plus,
                          mem_b queuesize, Logfile* log, EventList* ev,
-                         queue_type q, simtime_picosec rtt);
+                         queue_type q, simtime_picosec rtt, bool hop_by_hop = false);
     
     DragonFlyPlusTopology(uint32_t no_of_nodes, mem_b queuesize, Logfile* log,
                          EventList* ev, queue_type q, simtime_picosec rtt);
@@ -85,6 +94,7 @@ public:
     uint32_t no_of_nodes() const { return _no_of_nodes; }
     uint32_t get_mtu() const { return 1500; }  // Standard MTU size
     uint32_t get_group(uint32_t sw) const { return sw / _a; }  // Get group number for a switch
+    uint32_t host_router(uint32_t host) const { return host / _p; }  // Get switch a host is attached to
 
 private:
     // Helper functions
@@ -94,6 +104,7 @@ private:
     void set_params(uint32_t no_of_nodes);
     void set_params();
     bool is_global_plus_link(uint32_t src_switch, uint32_t dst_switch);
+    void connect_switches(uint32_t src, uint32_t dst, bool global, bool plus);
     
     // Topology parameters
     uint32_t _p;           // Hosts per router
@@ -105,6 +116,7 @@ private:
     uint32_t _no_of_switches; // Total number of switches
     simtime_picosec _rtt;  // Round trip time
     mem_b _queuesize;      // Queue size
+    bool _hop_by_hop;      // Switches route packets, rather than the source
 };
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,213 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#include "dragon_fly_switch.h"
+#include "routetable.h"
+#include "callback_pipe.h"
+
+DragonFlySwitch::routing_strategy DragonFlySwitch::_routing = DragonFlySwitch::MINIMAL;
+mem_b DragonFlySwitch::_ugal_threshold = 0;
+uint32_t DragonFlySwitch::_valiant_salt = 0;
+uint64_t DragonFlySwitch::_minimal_decisions = 0;
+uint64_t DragonFlySwitch::_valiant_decisions = 0;
+uint64_t DragonFlySwitch::_deferred_decisions = 0;
+
+static inline uint32_t dfhash(uint32_t x) {
+    x = ((x >> 16) ^ x) * 0x45d9f3b;
+    x = ((x >> 16) ^ x) * 0x45d9f3b;
+    x = (x >> 16) ^ x;
+    return x;
+}
+
+DragonFlySwitch::DragonFlySwitch(EventList& eventlist, string s, uint32_t id, simtime_picosec delay,
+                                 uint32_t hosts_per_router, uint32_t routers_per_group, uint32_t groups)
+    : Switch(eventlist, s) {
+    _id = id;
+    _hosts = hosts_per_router;
+    _routers = routers_per_group;
+    _groups = groups;
+    _group = id / routers_per_group;
+    _pipe = new CallbackPipe(delay, eventlist, this);
+    _fib = new RouteTable();
+
+    _host_queues.resize(_hosts, NULL);
+    _host_pipes.resize(_hosts, NULL);
+    _local.resize(_routers, NULL);
+    _to_group.resize(_groups);
+    _direct.resize(_groups, false);
+
+    // all routers must agree on the intermediate group
+    if (_valiant_salt == 0)
+        _valiant_salt = random() | 1;
+}
+
+void DragonFlySwitch::receivePacket(Packet& pkt) {
+    if (_packets.find(&pkt) == _packets.end()) {
+        //ingress pipeline processing.
+        _packets[&pkt] = true;
+
+        const Route* nh = getNextHop(pkt, NULL);
+        pkt.set_route(*nh);
+
+        //emulate the switching latency between ingress and packet arriving at the egress queue.
+        _pipe->receivePacket(pkt);
+    } else {
+        _packets.erase(&pkt);
+
+        //egress queue processing.
+        pkt.sendOn();
+    }
+}
+
+void DragonFlySwitch::addHostLink(uint32_t addr, BaseQueue* q, Pipe* p) {
+    assert(addr / _hosts == _id);
+    _host_queues[addr % _hosts] = q;
+    _host_pipes[addr % _hosts] = p;
+    addPort(q);
+}
+
+void DragonFlySwitch::addHostPort(int addr, int flowid, PacketSink* transport) {
+    // all flows to a host share one route; only the final transport differs.
+    uint32_t port = addr % _hosts;
+    HostFibEntry* fe = _fib->getHostRoute(port);
+    if (!fe) {
+        assert(_host_queues[port]);
+        Route* rt = new Route();
+        rt->push_back(_host_queues[port]);
+        rt->push_back(_host_pipes[port]);
+        fe = _fib->addHostRoute(port, rt, addr);
+    }
+    fe->getDemux()->addFlow(flowid, transport);
+}
+
+void DragonFlySwitch::addLocalLink(DragonFlySwitch* peer, BaseQueue* q, Pipe* p) {
+    assert(peer->group() == _group);
+    Route* rt = new Route();
+    rt->push_back(q);
+    rt->push_back(p);
+    rt->push_back(peer);
+    _local[peer->getID() % _routers] = rt;
+    addPort(q);
+}
+
+void DragonFlySwitch::addGlobalLink(DragonFlySwitch* peer, BaseQueue* q, Pipe* p) {
+    uint32_t g = peer->group();
+    assert(g != _group);
+    Route* rt = new Route();
+    rt->push_back(q);
+    rt->push_back(p);
+    rt->push_back(peer);
+    _to_group[g].push_back(rt);
+    _direct[g] = true;
+    addPort(q);
+}
+
+void DragonFlySwitch::addGateway(uint32_t group, uint32_t router) {
+    assert(!_direct[group]);
+    assert(_local[router]);
+    _to_group[group].push_back(_local[router]);
+}
+
+// Intermediate group for a packet's Valiant path; never the destination
+// group, but it may be the source group, in which case the packet goes
+// minimal.
+uint32_t DragonFlySwitch::valiantGroup(Packet& pkt, uint32_t dst_group) {
+    uint32_t mid = dfhash(pkt.flow_id() ^ dfhash(pkt.pathid() ^ _valiant_salt)) % (_groups - 1);
+    if (mid >= dst_group)
+        mid++;
+    return mid;
+}
+
+// The least loaded first hop towards group.  Ties are broken by flow,
+// so idle links are spread across flows rather than all using the first.
+Route* DragonFlySwitch::toGroup(uint32_t group, Packet& pkt, mem_b& backlog) {
+    vector<Route*>& hops = _to_group[group];
+    assert(!hops.empty());
+    uint32_t n = hops.size();
+    uint32_t start = n > 1 ? dfhash(pkt.flow_id()) % n : 0;
+    Route* best = NULL;
+    backlog = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        Route* rt = hops[(start + i) % n];
+        mem_b q = ((BaseQueue*)rt->at(0))->queuesize();
+        if (!best || q < backlog) {
+            best = rt;
+            backlog = q;
+        }
+    }
+    return best;
+}
+
+Route* DragonFlySwitch::chooseGroup(Packet& pkt, uint32_t dst_group) {
+    mem_b min_backlog, val_backlog;
+    Route* minimal = toGroup(dst_group, pkt, min_backlog);
+    uint32_t mid = valiantGroup(pkt, dst_group);
+
+    bool valiant = false;
+    Route* detour = NULL;
+    if (mid != _group && _routing != MINIMAL) {
+        detour = toGroup(mid, pkt, val_backlog);
+        if (_routing == VALIANT) {
+            valiant = true;
+        } else {
+            // remaining router-to-router hops: to the group, then at
+            // most one local hop; Valiant adds a global and a local hop.
+            mem_b min_hops = (_direct[dst_group] ? 1 : 2) + 1;
+            mem_b val_hops = (_direct[mid] ? 1 : 2) + 3;
+            valiant = min_backlog * min_hops > val_backlog * val_hops + _ugal_threshold;
+        }
+    }
+
+    if (valiant) {
+        _valiant_decisions++;
+        pkt.set_direction(UP);
+        return detour;
+    }
+    if (_routing == PAR && !_direct[dst_group]) {
+        // still in the source group: the gateway decides again
+        _deferred_decisions++;
+        return minimal;
+    }
+    _minimal_decisions++;
+    pkt.set_direction(DOWN);
+    return minimal;
+}
+
+Route* DragonFlySwitch::getNextHop(Packet& pkt, BaseQueue* ingress_port) {
+    uint32_t dst_router = pkt.dst() / _hosts;
+    if (dst_router == _id) {
+        HostFibEntry* fe = _fib->getHostRoute(pkt.dst() % _hosts);
+        if (!fe) {
+            cerr << "No host port for " << pkt.dst() << " at " << _name << endl;
+            abort();
+        }
+        return fe->getEgressPort();
+    }
+
+    uint32_t dst_group = dst_router / _routers;
+    if (dst_group == _group)
+        return _local[dst_router % _routers];
+
+    mem_b backlog;
+    switch (pkt.get_direction()) {
+    case NONE:
+        return chooseGroup(pkt, dst_group);
+    case UP:
+    {
+        uint32_t mid = valiantGroup(pkt, dst_group);
+        if (mid != _group)
+            return toGroup(mid, pkt, backlog);
+        // reached the intermediate group
+        pkt.set_direction(DOWN);
+        return toGroup(dst_group, pkt, backlog);
+    }
+    case DOWN:
+        return toGroup(dst_group, pkt, backlog);
+    }
+    abort();
+    return NULL;
+}
+
+void DragonFlySwitch::report(ostream& out) {
+    out << "# dragonfly routing decisions minimal " << _minimal_decisions
+        << " valiant " << _valiant_decisions
+        << " deferred " << _deferred_decisions << endl;
+}
@@ -0,0 +1,93 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef _DRAGONFLYSWITCH_H
+#define _DRAGONFLYSWITCH_H
+
+#include "switch.h"
+#include "callback_pipe.h"
+#include <unordered_map>
+
+/*
+ * A DragonFly router that forwards packets hop by hop, as FatTreeSwitch
+ * does for fat trees, so packets only carry a route to their first
+ * router.
+ *
+ * The forwarding tables are sized by the topology, not by the number
+ * of host pairs: one route per router in our group, and for every
+ * group the first hops towards it - our global links that go straight
+ * there, or if we have none, the local links to the routers in our
+ * group that do.
+ *
+ * A packet for another group takes either the minimal path or a
+ * Valiant path through an intermediate group:
+ *   MINIMAL  always minimal
+ *   VALIANT  always through the intermediate group
+ *   UGAL     chosen at the source router by comparing the local output
+ *            queues, weighted by path length (UGAL-L)
+ *   PAR      as UGAL, but a packet that took a local hop towards a
+ *            minimal gateway is re-evaluated there (progressive
+ *            adaptive routing)
+ *
+ * The packet's direction records how far it has got: NONE while the
+ * choice is open, UP on the way to the intermediate group and DOWN
+ * once it is on the minimal path to its destination group.  The
+ * intermediate group is a hash of the flow and path id, so every
+ * router computes the same one without it being carried in the packet.
+ */
+
+class DragonFlySwitch : public Switch {
+public:
+    enum routing_strategy {
+        MINIMAL = 0, VALIANT = 1, UGAL = 2, PAR = 3
+    };
+
+    DragonFlySwitch(EventList& eventlist, string s, uint32_t id, simtime_picosec switch_delay,
+                    uint32_t hosts_per_router, uint32_t routers_per_group, uint32_t groups);
+
+    virtual void receivePacket(Packet& pkt);
+    virtual Route* getNextHop(Packet& pkt, BaseQueue* ingress_port);
+    virtual void addHostPort(int addr, int flowid, PacketSink* transport);
+
+    // called by the topology as it builds the links
+    void addHostLink(uint32_t addr, BaseQueue* q, Pipe* p);
+    void addLocalLink(DragonFlySwitch* peer, BaseQueue* q, Pipe* p);
+    void addGlobalLink(DragonFlySwitch* peer, BaseQueue* q, Pipe* p);
+    // once all global links exist: reach group through router, a
+    // router in our group that has a global link there.
+    void addGateway(uint32_t group, uint32_t router);
+
+    uint32_t group() const {return _group;}
+    bool hasGlobalLink(uint32_t group) const {return _direct[group];}
+
+    static routing_strategy _routing;
+    // UGAL prefers the Valiant path only when the weighted minimal
+    // backlog exceeds the Valiant one by more than this.
+    static mem_b _ugal_threshold;
+
+    // inter-group routing decisions taken by all routers
+    static void report(ostream& out);
+private:
+    Route* toGroup(uint32_t group, Packet& pkt, mem_b& backlog);
+    Route* chooseGroup(Packet& pkt, uint32_t dst_group);
+    uint32_t valiantGroup(Packet& pkt, uint32_t dst_group);
+
+    CallbackPipe* _pipe;
+    uint32_t _hosts;     // hosts per router
+    uint32_t _routers;   // routers per group
+    uint32_t _groups;
+    uint32_t _group;
+
+    unordered_map<Packet*,bool> _packets;
+
+    vector<BaseQueue*> _host_queues;     // by host index at this router
+    vector<Pipe*> _host_pipes;
+    vector<Route*> _local;               // by router index in the group
+    vector<vector<Route*> > _to_group;   // first hops towards each group
+    vector<bool> _direct;                // _to_group[g] are global links
+
+    static uint32_t _valiant_salt;
+    static uint64_t _minimal_decisions;
+    static uint64_t _valiant_decisions;
+    static uint64_t _deferred_decisions;
+};
+
+#endif
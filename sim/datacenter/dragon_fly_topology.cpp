@@ -14,17 +14,19 @@
 #include "queue_lossless_input.h"
 #include "queue_lossless_output.h"
 #include "ecnqueue.h"
+#include "dragon_fly_switch.h"
 #include "main.h"
 
 string ntoa(double n);
 string itoa(uint64_t n);
 
-DragonFlyTopology::DragonFlyTopology(uint32_t p, uint32_t a, uint32_t h, mem_b queuesize, Logfile* lg, EventList* ev, queue_type q, simtime_picosec rtt) {
+DragonFlyTopology::DragonFlyTopology(uint32_t p, uint32_t a, uint32_t h, mem_b queuesize, Logfile* lg, EventList* ev, queue_type q, simtime_picosec rtt, bool hop_by_hop) {
     _queuesize = queuesize;
     logfile = lg;
     _eventlist = ev;
     qt = q;
     _rtt = rtt;
+    _hop_by_hop = hop_by_hop;
  
     _p = p;
     _a = a;
@@ -53,6 +55,7 @@ DragonFlyTopology::DragonFlyTopology(uint32_t no_of_nodes, mem_b queuesize, Logf
     _eventlist = ev;
     qt = q;
     _rtt = rtt;
+    _hop_by_hop = false;
   
     set_params(no_of_nodes);
 
@@ -92,11 +95,14 @@ void DragonFlyTopology::set_params() {
 
     switches.resize(_no_of_switches,NULL);
 
-    pipes_host_switch.resize(_no_of_nodes, vector<Pipe*>(_no_of_switches));
-    queues_host_switch.resize(_no_of_nodes, vector<Queue*>(_no_of_switches));
+    pipes_host_switch.resize(_no_of_nodes, NULL);
+    queues_host_switch.resize(_no_of_nodes, NULL);
 
-    pipes_switch_host.resize(_no_of_switches, vector<Pipe*>(_no_of_nodes));
-    queues_switch_host.resize(_no_of_switches, vector<Queue*>(_no_of_nodes));
+    pipes_switch_host.resize(_no_of_nodes, NULL);
+    queues_switch_host.resize(_no_of_nodes, NULL);
+
+    if (_hop_by_hop)
+        return;
 
     pipes_switch_switch.resize(_no_of_switches, vector<Pipe*>(_no_of_switches));
     queues_switch_switch.resize(_no_of_switches, vector<Queue*>(_no_of_switches));
@@ -140,22 +146,24 @@ Queue* DragonFlyTopology::alloc_queue(QueueLogger* queueLogger, uint64_t speed,
 void DragonFlyTopology::init_network(){
     QueueLoggerSampling* queueLogger;
 
-    for (uint32_t j=0;j<_no_of_switches;j++){
+    for (uint32_t j=0;j<queues_switch_switch.size();j++){
         for (uint32_t k=0;k<_no_of_switches;k++){
             queues_switch_switch[j][k] = NULL;
             pipes_switch_switch[j][k] = NULL;
         }
-      
-        for (uint32_t k=0;k<_no_of_nodes;k++){
-            queues_switch_host[j][k] = NULL;
-            pipes_switch_host[j][k] = NULL;
-            queues_host_switch[k][j] = NULL;
-            pipes_host_switch[k][j] = NULL;
-        }
     }
   
-    //create switches if we have lossless operation
-    if (qt==LOSSLESS)
+    //create switches if we have lossless operation, or if they route packets
+    if (_hop_by_hop) {
+        if (qt==LOSSLESS || qt==LOSSLESS_INPUT || qt==LOSSLESS_INPUT_ECN) {
+            cerr << "Hop-by-hop DragonFly routing does not support lossless queues" << endl;
+            exit(1);
+        }
+        for (uint32_t j=0;j<_no_of_switches;j++){
+            switches[j] = new DragonFlySwitch(*_eventlist, "Switch_"+ntoa(j), j, 0,
+                                              _p, _a, _no_of_groups);
+        }
+    } else if (qt==LOSSLESS)
         for (uint32_t j=0;j<_no_of_switches;j++){
             switches[j] = new Switch(*_eventlist, "Switch_"+ntoa(j));
         }
@@ -169,32 +177,37 @@ void DragonFlyTopology::init_network(){
             //queueLogger = NULL;
             logfile->addLogger(*queueLogger);
           
-            queues_switch_host[j][k] = alloc_queue(queueLogger, _queuesize,true);
-            queues_switch_host[j][k]->setName("SW" + ntoa(j) + "->DST" +ntoa(k));
-            logfile->writeName(*(queues_switch_host[j][k]));
+            queues_switch_host[k] = alloc_queue(queueLogger, _queuesize,true);
+            queues_switch_host[k]->setName("SW" + ntoa(j) + "->DST" +ntoa(k));
+            logfile->writeName(*(queues_switch_host[k]));
           
-            pipes_switch_host[j][k] = new Pipe(_rtt, *_eventlist);
-            pipes_switch_host[j][k]->setName("Pipe-SW" + ntoa(j)  + "->DST" + ntoa(k));
-            logfile->writeName(*(pipes_switch_host[j][k]));
+            pipes_switch_host[k] = new Pipe(_rtt, *_eventlist);
+            pipes_switch_host[k]->setName("Pipe-SW" + ntoa(j)  + "->DST" + ntoa(k));
+            logfile->writeName(*(pipes_switch_host[k]));
           
             // Uplink
             queueLogger = new QueueLoggerSampling(timeFromMs(1000), *_eventlist);
             logfile->addLogger(*queueLogger);
-            queues_host_switch[k][j] = alloc_src_queue(queueLogger);
-            queues_host_switch[k][j]->setName("SRC" + ntoa(k) + "->SW" +ntoa(j));
-            logfile->writeName(*(queues_host_switch[k][j]));
+            queues_host_switch[k] = alloc_src_queue(queueLogger);
+            queues_host_switch[k]->setName("SRC" + ntoa(k) + "->SW" +ntoa(j));
+            logfile->writeName(*(queues_host_switch[k]));
 
             if (qt==LOSSLESS){
-                switches[j]->addPort(queues_switch_host[j][k]);
-                ((LosslessQueue*)queues_switch_host[j][k])->setRemoteEndpoint(queues_host_switch[k][j]);
+                switches[j]->addPort(queues_switch_host[k]);
+                ((LosslessQueue*)queues_switch_host[k])->setRemoteEndpoint(queues_host_switch[k]);
             }else if (qt==LOSSLESS_INPUT || qt == LOSSLESS_INPUT_ECN){
                 //no virtual queue needed at server
-                new LosslessInputQueue(*_eventlist,queues_host_switch[k][j]);
+                new LosslessInputQueue(*_eventlist,queues_host_switch[k]);
             }
           
-            pipes_host_switch[k][j] = new Pipe(_rtt, *_eventlist);
-            pipes_host_switch[k][j]->setName("Pipe-SRC" + ntoa(k) + "->SW" + ntoa(j));
-            logfile->writeName(*(pipes_host_switch[k][j]));
+            pipes_host_switch[k] = new Pipe(_rtt, *_eventlist);
+            pipes_host_switch[k]->setName("Pipe-SRC" + ntoa(k) + "->SW" + ntoa(j));
+            logfile->writeName(*(pipes_host_switch[k]));
+
+            if (_hop_by_hop) {
+                queues_host_switch[k]->setRemoteEndpoint(switches[j]);
+                ((DragonFlySwitch*)switches[j])->addHostLink(k, queues_switch_host[k], pipes_switch_host[k]);
+            }
         }
     }
 
@@ -205,37 +218,7 @@ void DragonFlyTopology::init_network(){
 
         //Connect the switch to other switches in the same group, with higher IDs (full mesh within group).
         for (uint32_t k=j+1; k<(groupid+1)*_a;k++){
-            //Downlink
-            queueLogger = new QueueLoggerSampling(timeFromMs(1000), *_eventlist);
-            logfile->addLogger(*queueLogger);
-            queues_switch_switch[k][j] = alloc_queue(queueLogger, _queuesize);
-            queues_switch_switch[k][j]->setName("SW" + ntoa(k) + "-I->SW" + ntoa(j));
-            logfile->writeName(*(queues_switch_switch[k][j]));
-        
-            pipes_switch_switch[k][j] = new Pipe(_rtt, *_eventlist);
-            pipes_switch_switch[k][j]->setName("Pipe-SW" + ntoa(k) + "-I->SW" + ntoa(j));
-            logfile->writeName(*(pipes_switch_switch[k][j]));
-        
-            // Uplink
-            queueLogger = new QueueLoggerSampling(timeFromMs(1000), *_eventlist);
-            logfile->addLogger(*queueLogger);
-            queues_switch_switch[j][k] = alloc_queue(queueLogger, _queuesize,true);
-            queues_switch_switch[j][k]->setName("SW" + ntoa(j) + "-I->SW" + ntoa(k));
-            logfile->writeName(*(queues_switch_switch[j][k]));
-
-            if (qt==LOSSLESS){
-                switches[j]->addPort(queues_switch_switch[j][k]);
-                ((LosslessQueue*)queues_switch_switch[j][k])->setRemoteEndpoint(queues_switch_switch[k][j]);
-                switches[k]->addPort(queues_switch_switch[k][j]);
-                ((LosslessQueue*)queues_switch_switch[k][j])->setRemoteEndpoint(queues_switch_switch[j][k]);
-            }else if (qt==LOSSLESS_INPUT || qt == LOSSLESS_INPUT_ECN){            
-                new LosslessInputQueue(*_eventlist, queues_switch_switch[j][k]);
-                new LosslessInputQueue(*_eventlist, queues_switch_switch[k][j]);
-            }
-        
-            pipes_switch_switch[j][k] = new Pipe(_rtt, *_eventlist);
-            pipes_switch_switch[j][k]->setName("Pipe-SW" + ntoa(j) + "-I->SW" + ntoa(k));
-            logfile->writeName(*(pipes_switch_switch[j][k]));
+            connect_switches(j, k, false);
         }
 
         //Connect the switch to switches from other groups. Global links.
@@ -251,39 +234,36 @@ void DragonFlyTopology::init_network(){
                 continue;
             
             uint32_t k  = targetgroupid * _a + groupid/_h;
+            connect_switches(j, k, true);
+        }        
+    }
 
-            //Downlink
-            queueLogger = new QueueLoggerSampling(timeFromMs(1000), *_eventlist);
-            logfile->addLogger(*queueLogger);
-            queues_switch_switch[k][j] = alloc_queue(queueLogger, _queuesize);
-            queues_switch_switch[k][j]->setName("SW" + ntoa(k) + "-G->SW" + ntoa(j));
-            logfile->writeName(*(queues_switch_switch[k][j]));
-        
-            pipes_switch_switch[k][j] = new Pipe(_rtt, *_eventlist);
-            pipes_switch_switch[k][j]->setName("Pipe-SW" + ntoa(k) + "-G->SW" + ntoa(j));
-            logfile->writeName(*(pipes_switch_switch[k][j]));
-        
-            // Uplink
-            queueLogger = new QueueLoggerSampling(timeFromMs(1000), *_eventlist);
-            logfile->addLogger(*queueLogger);
-            queues_switch_switch[j][k] = alloc_queue(queueLogger, _queuesize,true);
-            queues_switch_switch[j][k]->setName("SW" + ntoa(j) + "-G->SW" + ntoa(k));
-            logfile->writeName(*(queues_switch_switch[j][k]));
-
-            if (qt==LOSSLESS){
-                switches[j]->addPort(queues_switch_switch[j][k]);
-                ((LosslessQueue*)queues_switch_switch[j][k])->setRemoteEndpoint(queues_switch_switch[k][j]);
-                switches[k]->addPort(queues_switch_switch[k][j]);
-                ((LosslessQueue*)queues_switch_switch[k][j])->setRemoteEndpoint(queues_switch_switch[j][k]);
-            }else if (qt==LOSSLESS_INPUT || qt == LOSSLESS_INPUT_ECN){            
-                new LosslessInputQueue(*_eventlist, queues_switch_switch[j][k]);
-                new LosslessInputQueue(*_eventlist, queues_switch_switch[k][j]);
+    if (_hop_by_hop) {
+        // Routers without a global link to a group reach it through the
+        // routers in their group that have one.
+        vector<uint32_t> gateways;
+        for (uint32_t group = 0; group < _no_of_groups; group++) {
+            for (uint32_t g = 0; g < _no_of_groups; g++) {
+                if (g == group)
+                    continue;
+                gateways.clear();
+                for (uint32_t j = group * _a; j < (group + 1) * _a; j++) {
+                    if (((DragonFlySwitch*)switches[j])->hasGlobalLink(g))
+                        gateways.push_back(j % _a);
+                }
+                if (gateways.empty()) {
+                    cerr << "No global link from group " << group << " to group " << g << endl;
+                    exit(1);
+                }
+                for (uint32_t j = group * _a; j < (group + 1) * _a; j++) {
+                    DragonFlySwitch* sw = (DragonFlySwitch*)switches[j];
+                    if (sw->hasGlobalLink(g))
+                        continue;
+                    for (uint32_t r = 0; r < gateways.size(); r++)
+                        sw->addGateway(g, gateways[r]);
+                }
             }
-        
-            pipes_switch_switch[j][k] = new Pipe(_rtt, *_eventlist);
-            pipes_switch_switch[j][k]->setName("Pipe-SW" + ntoa(j) + "-G->SW" + ntoa(k));
-            logfile->writeName(*(pipes_switch_switch[j][k]));
-        }        
+        }
     }
 
     //init thresholds for lossless operation
@@ -293,6 +273,66 @@ void DragonFlyTopology::init_network(){
         }
 }
 
+// Bidirectional link between switches j and k, either within a group or
+// (global) between groups.
+void DragonFlyTopology::connect_switches(uint32_t j, uint32_t k, bool global){
+    QueueLoggerSampling* queueLogger;
+    string kind = global ? "-G->" : "-I->";
+    Queue *q_kj, *q_jk;
+    Pipe *p_kj, *p_jk;
+
+    //Downlink
+    queueLogger = new QueueLoggerSampling(timeFromMs(1000), *_eventlist);
+    logfile->addLogger(*queueLogger);
+    q_kj = alloc_queue(queueLogger, _queuesize);
+    q_kj->setName("SW" + ntoa(k) + kind + "SW" + ntoa(j));
+    logfile->writeName(*q_kj);
+
+    p_kj = new Pipe(_rtt, *_eventlist);
+    p_kj->setName("Pipe-SW" + ntoa(k) + kind + "SW" + ntoa(j));
+    logfile->writeName(*p_kj);
+
+    // Uplink
+    queueLogger = new QueueLoggerSampling(timeFromMs(1000), *_eventlist);
+    logfile->addLogger(*queueLogger);
+    q_jk = alloc_queue(queueLogger, _queuesize,true);
+    q_jk->setName("SW" + ntoa(j) + kind + "SW" + ntoa(k));
+    logfile->writeName(*q_jk);
+
+    if (qt==LOSSLESS){
+        switches[j]->addPort(q_jk);
+        ((LosslessQueue*)q_jk)->setRemoteEndpoint(q_kj);
+        switches[k]->addPort(q_kj);
+        ((LosslessQueue*)q_kj)->setRemoteEndpoint(q_jk);
+    }else if (qt==LOSSLESS_INPUT || qt == LOSSLESS_INPUT_ECN){            
+        new LosslessInputQueue(*_eventlist, q_jk);
+        new LosslessInputQueue(*_eventlist, q_kj);
+    }
+
+    p_jk = new Pipe(_rtt, *_eventlist);
+    p_jk->setName("Pipe-SW" + ntoa(j) + kind + "SW" + ntoa(k));
+    logfile->writeName(*p_jk);
+
+    if (_hop_by_hop) {
+        DragonFlySwitch* sw_j = (DragonFlySwitch*)switches[j];
+        DragonFlySwitch* sw_k = (DragonFlySwitch*)switches[k];
+        q_jk->setRemoteEndpoint(sw_k);
+        q_kj->setRemoteEndpoint(sw_j);
+        if (global) {
+            sw_j->addGlobalLink(sw_k, q_jk, p_jk);
+            sw_k->addGlobalLink(sw_j, q_kj, p_kj);
+        } else {
+            sw_j->addLocalLink(sw_k, q_jk, p_jk);
+            sw_k->addLocalLink(sw_j, q_kj, p_kj);
+        }
+    } else {
+        queues_switch_switch[k][j] = q_kj;
+        pipes_switch_switch[k][j] = p_kj;
+        queues_switch_switch[j][k] = q_jk;
+        pipes_switch_switch[j][k] = p_jk;
+    }
+}
+
 void DragonFlyTopology::update_link_congestion(uint32_t src, uint32_t dst, uint32_t queue_length) {
     auto link = make_pair(src, dst);
     auto now = _eventlist->now();
@@ -319,6 +359,10 @@ double DragonFlyTopology::get_path_congestion(const vector<pair<uint32_t, uint32
 }
 
 vector<const Route*>* DragonFlyTopology::get_adaptive_paths(uint32_t src, uint32_t dest) {
+    // the switches choose between minimal and Valiant paths per packet
+    if (_hop_by_hop)
+        return get_bidir_paths(src, dest, false);
+
     vector<const Route*>* paths = new vector<const Route*>();
     
     uint32_t srcgroup = HOST_GROUP(src);
@@ -343,8 +387,8 @@ vector<const Route*>* DragonFlyTopology::get_adaptive_paths(uint32_t src, uint32
         
         // Source to intermediate group
         uint32_t src_switch = srcgroup * _a + (inter_group % _h);
-        route->push_back(queues_host_switch[src][HOST_TOR(src)]);
-        route->push_back(pipes_host_switch[src][HOST_TOR(src)]);
+        route->push_back(queues_host_switch[src]);
+        route->push_back(pipes_host_switch[src]);
         
         if (HOST_TOR(src) != src_switch) {
             route->push_back(queues_switch_switch[HOST_TOR(src)][src_switch]);
@@ -365,8 +409,8 @@ vector<const Route*>* DragonFlyTopology::get_adaptive_paths(uint32_t src, uint32
             route->push_back(pipes_switch_switch[dst_switch][HOST_TOR(dest)]);
         }
         
-        route->push_back(queues_switch_host[HOST_TOR(dest)][dest]);
-        route->push_back(pipes_switch_host[HOST_TOR(dest)][dest]);
+        route->push_back(queues_switch_host[dest]);
+        route->push_back(pipes_switch_host[dest]);
         
         paths->push_back(route);
     }
@@ -375,6 +419,28 @@ vector<const Route*>* DragonFlyTopology::get_adaptive_paths(uint32_t src, uint32
 }
 
 vector<const Route*>* DragonFlyTopology::get_bidir_paths(uint32_t src, uint32_t dest, bool reverse) {
+    if (_hop_by_hop) {
+        // the switches take it from the first router on
+        vector<const Route*>* paths = new vector<const Route*>();
+        Route* routeout = new Route();
+        routeout->push_back(queues_host_switch[src]);
+        routeout->push_back(pipes_host_switch[src]);
+        routeout->push_back(switches[HOST_TOR(src)]);
+
+        Route* routeback = new Route();
+        routeback->push_back(queues_host_switch[dest]);
+        routeback->push_back(pipes_host_switch[dest]);
+        routeback->push_back(switches[HOST_TOR(dest)]);
+
+        routeout->set_path_id(0, 1);
+        routeback->set_path_id(0, 1);
+        routeout->set_reverse(routeback);
+        routeback->set_reverse(routeout);
+
+        paths->push_back(routeout);
+        return paths;
+    }
+
     // First try adaptive routing
     vector<const Route*>* adaptive_paths = get_adaptive_paths(src, dest);
     
@@ -412,25 +478,25 @@ vector<const Route*>* DragonFlyTopology::get_bidir_paths(uint32_t src, uint32_t
     if (HOST_TOR(src)==HOST_TOR(dest)){
         // forward path
         routeout = new Route();
-        routeout->push_back(queues_host_switch[src][HOST_TOR(src)]);
-        routeout->push_back(pipes_host_switch[src][HOST_TOR(src)]);
+        routeout->push_back(queues_host_switch[src]);
+        routeout->push_back(pipes_host_switch[src]);
 
         if (qt==LOSSLESS_INPUT || qt==LOSSLESS_INPUT_ECN)
-            routeout->push_back(queues_host_switch[src][HOST_TOR(src)]->getRemoteEndpoint());
+            routeout->push_back(queues_host_switch[src]->getRemoteEndpoint());
 
-        routeout->push_back(queues_switch_host[HOST_TOR(dest)][dest]);
-        routeout->push_back(pipes_switch_host[HOST_TOR(dest)][dest]);
+        routeout->push_back(queues_switch_host[dest]);
+        routeout->push_back(pipes_switch_host[dest]);
 
         // reverse path for RTS packets
         routeback = new Route();
-        routeback->push_back(queues_host_switch[dest][HOST_TOR(dest)]);
-        routeback->push_back(pipes_host_switch[dest][HOST_TOR(dest)]);
+        routeback->push_back(queues_host_switch[dest]);
+        routeback->push_back(pipes_host_switch[dest]);
 
         if (qt==LOSSLESS_INPUT || qt==LOSSLESS_INPUT_ECN)
-            routeback->push_back(queues_host_switch[dest][HOST_TOR(dest)]->getRemoteEndpoint());
+            routeback->push_back(queues_host_switch[dest]->getRemoteEndpoint());
 
-        routeback->push_back(queues_switch_host[HOST_TOR(src)][src]);
-        routeback->push_back(pipes_switch_host[HOST_TOR(src)][src]);
+        routeback->push_back(queues_switch_host[src]);
+        routeback->push_back(pipes_switch_host[src]);
 
         routeout->set_reverse(routeback);
         routeback->set_reverse(routeout);
@@ -449,11 +515,11 @@ vector<const Route*>* DragonFlyTopology::get_bidir_paths(uint32_t src, uint32_t
 
         routeout = new Route();
     
-        routeout->push_back(queues_host_switch[src][HOST_TOR(src)]);
-        routeout->push_back(pipes_host_switch[src][HOST_TOR(src)]);
+        routeout->push_back(queues_host_switch[src]);
+        routeout->push_back(pipes_host_switch[src]);
     
         if (qt==LOSSLESS_INPUT || qt==LOSSLESS_INPUT_ECN)
-            routeout->push_back(queues_host_switch[src][HOST_TOR(src)]->getRemoteEndpoint());
+            routeout->push_back(queues_host_switch[src]->getRemoteEndpoint());
     
         routeout->push_back(queues_switch_switch[HOST_TOR(src)][HOST_TOR(dest)]);
         routeout->push_back(pipes_switch_switch[HOST_TOR(src)][HOST_TOR(dest)]);
@@ -461,17 +527,17 @@ vector<const Route*>* DragonFlyTopology::get_bidir_paths(uint32_t src, uint32_t
         if (qt==LOSSLESS_INPUT || qt==LOSSLESS_INPUT_ECN)
             routeout->push_back(queues_switch_switch[HOST_TOR(src)][HOST_TOR(dest)]->getRemoteEndpoint());
     
-        routeout->push_back(queues_switch_host[HOST_TOR(dest)][dest]);
-        routeout->push_back(pipes_switch_host[HOST_TOR(dest)][dest]);
+        routeout->push_back(queues_switch_host[dest]);
+        routeout->push_back(pipes_switch_host[dest]);
     
         // reverse path for RTS packets
         routeback = new Route();
     
-        routeback->push_back(queues_host_switch[dest][HOST_TOR(dest)]);
-        routeback->push_back(pipes_host_switch[dest][HOST_TOR(dest)]);
+        routeback->push_back(queues_host_switch[dest]);
+        routeback->push_back(pipes_host_switch[dest]);
     
         if (qt==LOSSLESS_INPUT || qt==LOSSLESS_INPUT_ECN)
-            routeback->push_back(queues_host_switch[dest][HOST_TOR(dest)]->getRemoteEndpoint());
+            routeback->push_back(queues_host_switch[dest]->getRemoteEndpoint());
     
         routeback->push_back(queues_switch_switch[HOST_TOR(dest)][HOST_TOR(src)]);
         routeback->push_back(pipes_switch_switch[HOST_TOR(dest)][HOST_TOR(src)]);
@@ -479,8 +545,8 @@ vector<const Route*>* DragonFlyTopology::get_bidir_paths(uint32_t src, uint32_t
         if (qt==LOSSLESS_INPUT || qt==LOSSLESS_INPUT_ECN)
             routeback->push_back(queues_switch_switch[HOST_TOR(dest)][HOST_TOR(src)]->getRemoteEndpoint());
     
-        routeback->push_back(queues_switch_host[HOST_TOR(src)][src]);
-        routeback->push_back(pipes_switch_host[HOST_TOR(src)][src]);
+        routeback->push_back(queues_switch_host[src]);
+        routeback->push_back(pipes_switch_host[src]);
     
         routeout->set_reverse(routeback);
         routeback->set_reverse(routeout);
@@ -498,15 +564,15 @@ vector<const Route*>* DragonFlyTopology::get_bidir_paths(uint32_t src, uint32_t
         //add lowest cost path first. add others if needed later. 
         routeout = new Route();
 
-        assert(queues_host_switch[src][HOST_TOR(src)]);
+        assert(queues_host_switch[src]);
     
-        routeout->push_back(queues_host_switch[src][HOST_TOR(src)]);
-        routeout->push_back(pipes_host_switch[src][HOST_TOR(src)]);
+        routeout->push_back(queues_host_switch[src]);
+        routeout->push_back(pipes_host_switch[src]);
 
         //cout << "SRC " << src << " SW " << HOST_TOR(src) << " ";
     
         if (qt==LOSSLESS_INPUT || qt==LOSSLESS_INPUT_ECN)
-            routeout->push_back(queues_host_switch[src][HOST_TOR(src)]->getRemoteEndpoint());
+            routeout->push_back(queues_host_switch[src]->getRemoteEndpoint());
 
         uint32_t srcswitch,dstswitch;
         //find srcswitch from srcgroup which has a path to dstgroup and  dstswitch from dstgroup which has an incoming path from srcgroup.
@@ -541,7 +607,7 @@ vector<const Route*>* DragonFlyTopology::get_bidir_paths(uint32_t src, uint32_t
         //cout << "SW " << dstswitch <<        " ";    
 
         if (qt==LOSSLESS_INPUT || qt==LOSSLESS_INPUT_ECN)
-            routeout->push_back(queues_host_switch[srcswitch][dstswitch]->getRemoteEndpoint());
+            routeout->push_back(queues_switch_switch[srcswitch][dstswitch]->getRemoteEndpoint());
 
         if (dstswitch!=HOST_TOR(dest)){
             /*When dstswitch does not have a direct path to dest, take local path to the appropriate TOR switch*/
@@ -555,19 +621,19 @@ vector<const Route*>* DragonFlyTopology::get_bidir_paths(uint32_t src, uint32_t
                 routeout->push_back(queues_switch_switch[dstswitch][HOST_TOR(dest)]->getRemoteEndpoint());
         }
         //cout << "DEST " << dest <<        " " << endl;
-        assert(queues_switch_host[HOST_TOR(dest)][dest]);
+        assert(queues_switch_host[dest]);
 
-        routeout->push_back(queues_switch_host[HOST_TOR(dest)][dest]);
-        routeout->push_back(pipes_switch_host[HOST_TOR(dest)][dest]);
+        routeout->push_back(queues_switch_host[dest]);
+        routeout->push_back(pipes_switch_host[dest]);
 
         // reverse path for RTS packets                                                                                        /*
         //routeback = new Route();
 
-        /*routeback->push_back(queues_host_switch[dest][HOST_TOR(dest)]);
-          routeback->push_back(pipes_host_switch[dest][HOST_TOR(dest)]);
+        /*routeback->push_back(queues_host_switch[dest]);
+          routeback->push_back(pipes_host_switch[dest]);
 
           if (qt==LOSSLESS_INPUT || qt==LOSSLESS_INPUT_ECN)
-          routeback->push_back(queues_host_switch[dest][HOST_TOR(dest)]->getRemoteEndpoint());
+          routeback->push_back(queues_host_switch[dest]->getRemoteEndpoint());
 
 
           if (dstswitch!=HOST_TOR(dest)){
@@ -594,8 +660,8 @@ vector<const Route*>* DragonFlyTopology::get_bidir_paths(uint32_t src, uint32_t
           routeback->push_back(queues_host_switch[srcswitch][HOST_TOR(src)]->getRemoteEndpoint());
           }
     
-          routeback->push_back(queues_switch_host[HOST_TOR(src)][src]);
-          routeback->push_back(pipes_switch_host[HOST_TOR(src)][src]);
+          routeback->push_back(queues_switch_host[src]);
+          routeback->push_back(pipes_switch_host[src]);
 
           routeout->set_reverse(routeback);
           routeback->set_reverse(routeout);
@@ -612,15 +678,15 @@ vector<const Route*>* DragonFlyTopology::get_bidir_paths(uint32_t src, uint32_t
             //add indirect paths via random group;
             routeout = new Route();
 
-            assert(queues_host_switch[src][HOST_TOR(src)]);
+            assert(queues_host_switch[src]);
         
-            routeout->push_back(queues_host_switch[src][HOST_TOR(src)]);
-            routeout->push_back(pipes_host_switch[src][HOST_TOR(src)]);
+            routeout->push_back(queues_host_switch[src]);
+            routeout->push_back(pipes_host_switch[src]);
         
-            //cout << "DPSRC " << src << " SW " << HOST_TOR(src) << " " << queues_host_switch[src][HOST_TOR(src)]  << " ";
+            //cout << "DPSRC " << src << " SW " << HOST_TOR(src) << " " << queues_host_switch[src]  << " ";
         
             if (qt==LOSSLESS_INPUT || qt==LOSSLESS_INPUT_ECN)
-                routeout->push_back(queues_host_switch[src][HOST_TOR(src)]->getRemoteEndpoint());
+                routeout->push_back(queues_host_switch[src]->getRemoteEndpoint());
         
             uint32_t intergroup = p;
         
@@ -662,7 +728,7 @@ vector<const Route*>* DragonFlyTopology::get_bidir_paths(uint32_t src, uint32_t
             //cout << "SW " << interswitch1 <<        " ";    
         
             if (qt==LOSSLESS_INPUT || qt==LOSSLESS_INPUT_ECN)
-                routeout->push_back(queues_host_switch[srcswitch][interswitch1]->getRemoteEndpoint());
+                routeout->push_back(queues_switch_switch[srcswitch][interswitch1]->getRemoteEndpoint());
         
             //route from inter group to destination group.
             if (intergroup<dstgroup){
@@ -694,7 +760,7 @@ vector<const Route*>* DragonFlyTopology::get_bidir_paths(uint32_t src, uint32_t
             //cout << "SW " << dstswitch <<        " ";
         
             if (qt==LOSSLESS_INPUT || qt==LOSSLESS_INPUT_ECN)
-                routeout->push_back(queues_host_switch[interswitch2][dstswitch]->getRemoteEndpoint());
+                routeout->push_back(queues_switch_switch[interswitch2][dstswitch]->getRemoteEndpoint());
         
             if (dstswitch!=HOST_TOR(dest)){
                 /*When dstswitch does not have a direct path to dest, take local path to the appropriate TOR switch*/
@@ -709,10 +775,10 @@ vector<const Route*>* DragonFlyTopology::get_bidir_paths(uint32_t src, uint32_t
             }
     
             //cout << "DEST " << dest <<        " " << endl;
-            assert(queues_switch_host[HOST_TOR(dest)][dest]);
+            assert(queues_switch_host[dest]);
         
-            routeout->push_back(queues_switch_host[HOST_TOR(dest)][dest]);
-            routeout->push_back(pipes_switch_host[HOST_TOR(dest)][dest]);
+            routeout->push_back(queues_switch_host[dest]);
+            routeout->push_back(pipes_switch_host[dest]);
 
             // reverse path for RTS packets                                                                                      
             //routeback = new Route();
@@ -732,11 +798,10 @@ vector<const Route*>* DragonFlyTopology::get_bidir_paths(uint32_t src, uint32_t
 int64_t DragonFlyTopology::find_switch(Queue* queue){
     //first check host to switch
     for (uint32_t i=0;i<_no_of_nodes;i++)
-        for (uint32_t j = 0;j<_no_of_switches;j++)
-            if (queues_host_switch[i][j]==queue)
-                return j;
+        if (queues_host_switch[i]==queue)
+            return HOST_TOR(i);
 
-    for (uint32_t i=0;i<_no_of_switches;i++)
+    for (uint32_t i=0;i<queues_switch_switch.size();i++)
         for (uint32_t j = 0;j<_no_of_switches;j++)
             if (queues_switch_switch[i][j]==queue)
                 return j;
@@ -745,10 +810,9 @@ int64_t DragonFlyTopology::find_switch(Queue* queue){
 }
 
 int64_t DragonFlyTopology::find_destination(Queue* queue){
-    for (uint32_t i=0;i<_no_of_switches;i++)
-        for (uint32_t j = 0;j<_no_of_nodes;j++)
-            if (queues_switch_host[i][j]==queue)
-                return j;
+    for (uint32_t i=0;i<_no_of_nodes;i++)
+        if (queues_switch_host[i]==queue)
+            return i;
 
     return -1;
 }
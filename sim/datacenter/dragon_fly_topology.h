@@ -11,6 +11,7 @@
 #include "logfile.h"
 #include "eventlist.h"
 #include "switch.h"
+#include "dragon_fly_switch.h"
 #include <ostream>
 #include <map>
 
@@ -51,12 +52,15 @@ class DragonFlyTopology: public Topology{
 public:
     vector <Switch*> switches;
 
-    vector< vector<Pipe*> > pipes_host_switch;
+    // each host has a single router, so host links are indexed by host.
+    vector<Pipe*> pipes_host_switch;
+    vector<Queue*> queues_host_switch;
+    vector<Pipe*> pipes_switch_host;
+    vector<Queue*> queues_switch_host;
+    // [from][to]; only built for source routing.  With hop-by-hop
+    // routing the DragonFlySwitches hold the links.
     vector< vector<Pipe*> > pipes_switch_switch;
-    vector< vector<Queue*> > queues_host_switch;
     vector< vector<Queue*> > queues_switch_switch;
-    vector< vector<Pipe*> > pipes_switch_host;
-    vector< vector<Queue*> > queues_switch_host;
   
     // DragonFly Plus specific members
     map<pair<uint32_t, uint32_t>, LinkCongestion> link_congestion;
@@ -69,7 +73,10 @@ public:
     uint32_t failed_links;
     queue_type qt;
 
-    DragonFlyTopology(uint32_t p, uint32_t h, uint32_t a, mem_b queuesize, Logfile* log,EventList* ev,queue_type q,simtime_picosec rtt);
+    // With hop_by_hop, packets are routed by DragonFlySwitches (see
+    // DragonFlySwitch::_routing) and get_bidir_paths only returns the
+    // route to the first router.
+    DragonFlyTopology(uint32_t p, uint32_t h, uint32_t a, mem_b queuesize, Logfile* log,EventList* ev,queue_type q,simtime_picosec rtt, bool hop_by_hop = false);
     DragonFlyTopology(uint32_t no_of_nodes, mem_b queuesize, Logfile* log,EventList* ev,queue_type q, simtime_picosec rtt);
 
     void init_network();
@@ -88,7 +95,9 @@ public:
     void print_path(std::ofstream& paths, uint32_t src, const Route* route);
     vector<uint32_t>* get_neighbours(uint32_t src) { return NULL;};
     uint32_t no_of_nodes() const {return _no_of_nodes;}
+    uint32_t host_router(uint32_t host) const {return HOST_TOR(host);}
 private:
+    void connect_switches(uint32_t j, uint32_t k, bool global);
     int64_t find_switch(Queue* queue);
     int64_t find_destination(Queue* queue);
 
@@ -100,6 +109,7 @@ private:
     uint32_t _no_of_groups,_no_of_switches;
     simtime_picosec _rtt;
     mem_b _queuesize;
+    bool _hop_by_hop;
 };
 
 #endif
@@ -7,15 +7,20 @@
 #include "queue_lossless_output.h"
 
 unordered_map<BaseQueue*,uint32_t> FatTreeSwitch::_port_flow_counts;
+uint64_t FatTreeSwitch::_no_route_drops = 0;
 
 FatTreeSwitch::FatTreeSwitch(EventList& eventlist, string s, switch_type t, uint32_t id,simtime_picosec delay, FatTreeTopology* ft): Switch(eventlist, s) {
     _id = id;
     _type = t;
     _pipe = new CallbackPipe(delay,eventlist, this);
     _uproutes = NULL;
+    _flowlets = NULL;
+    _upranking = NULL;
+    _pod_uproute_count = 0;
     _ft = ft;
     _crt_route = 0;
-    _hash_salt = random();
+    _rng.setId(get_id());
+    _hash_salt = _rng.rand();
     _last_choice = eventlist.now();
     _fib = new RouteTable();
 }
@@ -39,9 +44,15 @@ void FatTreeSwitch::receivePacket(Packet& pkt){
     if (_packets.find(&pkt)==_packets.end()){
         //ingress pipeline processing.
 
+        const Route * nh = getNextHop(pkt,NULL);
+        if (!nh) {
+            _no_route_drops++;
+            pkt.flow().logTraffic(pkt, *this, TrafficLogger::PKT_DROP);
+            pkt.free();
+            return;
+        }
         _packets[&pkt] = true;
 
-        const Route * nh = getNextHop(pkt,NULL);
         //set next hop which is peer switch.
         pkt.set_route(*nh);
 
@@ -58,11 +69,16 @@ void FatTreeSwitch::receivePacket(Packet& pkt){
 };
 
 void FatTreeSwitch::addHostPort(int addr, int flowid, PacketSink* transport){
-    Route* rt = new Route();
-    rt->push_back(_ft->queues_nlp_ns[_ft->HOST_POD_SWITCH(addr)][addr][0]);
-    rt->push_back(_ft->pipes_nlp_ns[_ft->HOST_POD_SWITCH(addr)][addr][0]);
-    rt->push_back(transport);
-    _fib->addHostRoute(addr,rt,flowid);
+    // all flows to a host share one route; only the final transport differs.
+    uint32_t port = addr % _ft->radix_down(TOR_TIER);
+    HostFibEntry* fe = _fib->getHostRoute(port);
+    if (!fe) {
+        Route* rt = new Route();
+        rt->push_back(_ft->queues_nlp_ns[_ft->HOST_POD_SWITCH(addr)][addr][0]);
+        rt->push_back(_ft->pipes_nlp_ns[_ft->HOST_POD_SWITCH(addr)][addr][0]);
+        fe = _fib->addHostRoute(port,rt,addr);
+    }
+    fe->getDemux()->addFlow(flowid,transport);
 }
 
 uint32_t mhash(uint32_t x) {
@@ -78,7 +94,7 @@ uint32_t FatTreeSwitch::adaptive_route_p2c(vector<FibEntry*>* ecmp_set, int8_t (
     static const uint16_t nr_choices = 2;
     
     do {
-        start = random()%ecmp_set->size();
+        start = _rng.rand()%ecmp_set->size();
 
         Route * r= (*ecmp_set)[start]->getEgressPort();
         assert(r && r->size()>1);
@@ -95,6 +111,12 @@ uint32_t FatTreeSwitch::adaptive_route_p2c(vector<FibEntry*>* ecmp_set, int8_t (
 
 uint32_t FatTreeSwitch::adaptive_route(vector<FibEntry*>* ecmp_set, int8_t (*cmp)(FibEntry*,FibEntry*)){
     //cout << "adaptive_route" << endl;
+    if (_ar_ranked && cmp == fn) {
+        PortRanking* r = ranking(ecmp_set);
+        if (r)
+            return r->best(_rng);
+    }
+
     uint32_t choice = 0;
 
     uint32_t best_choices[256];
@@ -119,7 +141,7 @@ uint32_t FatTreeSwitch::adaptive_route(vector<FibEntry*>* ecmp_set, int8_t (*cmp
     }
 
     assert (best_choices_count>=1);
-    uint32_t choiceindex = random()%best_choices_count;
+    uint32_t choiceindex = _rng.rand()%best_choices_count;
     choice = best_choices[choiceindex];
     //cout << "ECMP set choices " << ecmp_set->size() << " Choice count " << best_choices_count << " chosen entry " << choiceindex << " chosen path " << choice << " ";
 
@@ -134,6 +156,15 @@ uint32_t FatTreeSwitch::adaptive_route(vector<FibEntry*>* ecmp_set, int8_t (*cmp
 }
 
 uint32_t FatTreeSwitch::replace_worst_choice(vector<FibEntry*>* ecmp_set, int8_t (*cmp)(FibEntry*,FibEntry*),uint32_t my_choice){
+    if (_ar_ranked && cmp == fn) {
+        PortRanking* r = ranking(ecmp_set);
+        if (r) {
+            if (r->level(my_choice) == r->worst_level())
+                return r->best(_rng);
+            return my_choice;
+        }
+    }
+
     uint32_t best_choice = 0;
     uint32_t worst_choice = 0;
 
@@ -170,7 +201,7 @@ uint32_t FatTreeSwitch::replace_worst_choice(vector<FibEntry*>* ecmp_set, int8_t
 
     if (r==0){
         assert (best_choices_count>=1);
-        return best_choices[random()%best_choices_count];
+        return best_choices[_rng.rand()%best_choices_count];
     }
     else return my_choice;
 }
@@ -303,7 +334,7 @@ int8_t FatTreeSwitch::compare_pb(FibEntry* left, FibEntry* right){
 void FatTreeSwitch::permute_paths(vector<FibEntry *>* uproutes) {
     int len = uproutes->size();
     for (int i = 0; i < len; i++) {
-        int ix = random() % (len - i);
+        int ix = _rng.rand() % (len - i);
         FibEntry* tmppath = (*uproutes)[ix];
         (*uproutes)[ix] = (*uproutes)[len-1-i];
         (*uproutes)[len-1-i] = tmppath;
@@ -316,14 +347,45 @@ uint16_t FatTreeSwitch::_ar_sticky = FatTreeSwitch::PER_PACKET;
 simtime_picosec FatTreeSwitch::_sticky_delta = timeFromUs((uint32_t)10);
 double FatTreeSwitch::_ecn_threshold_fraction = 1.0;
 double FatTreeSwitch::_speculative_threshold_fraction = 0.2;
+uint32_t FatTreeSwitch::_flowlet_table_size = 4096;
+simtime_picosec FatTreeSwitch::_flowlet_age = 0;
+bool FatTreeSwitch::_ar_ranked = false;
 int8_t (*FatTreeSwitch::fn)(FibEntry*,FibEntry*)= &FatTreeSwitch::compare_queuesize;
 
+// Destinations resolve hierarchically rather than per host: everything
+// that goes up shares the switch's one uplink group, and on the way
+// down the choice only depends on the destination's ToR (at an
+// aggregation switch) or pod (at a core switch), so all destinations
+// behind the same ToR or pod share one group, except at an AGG for pods
+// some of its cores can't reach.  Returns NULL if the group hasn't been
+// built yet, or for hosts attached to this ToR.
+vector<FibEntry*>* FatTreeSwitch::lookup_group(uint32_t dst) {
+    switch (_type) {
+    case TOR:
+        if (_ft->HOST_POD_SWITCH(dst) == _id)
+            return NULL;
+        return _uproutes;
+    case AGG:
+        if (_ft->get_tiers()==2 || _ft->HOST_POD(dst) == _ft->AGG_SWITCH_POD_ID(_id))
+            return _fib->getGroup(_ft->HOST_POD_SWITCH(dst));
+        if (!_pod_uproutes.empty() && _pod_uproutes[_ft->HOST_POD(dst)])
+            return _pod_uproutes[_ft->HOST_POD(dst)];
+        return _uproutes;
+    case CORE:
+        return _fib->getGroup(_ft->HOST_POD(dst));
+    default:
+        return NULL;
+    }
+}
+
 Route* FatTreeSwitch::getNextHop(Packet& pkt, BaseQueue* ingress_port){
-    vector<FibEntry*> * available_hops = _fib->getRoutes(pkt.dst());
+    vector<FibEntry*> * available_hops = lookup_group(pkt.dst());
 
     if (available_hops){
         //implement a form of ECMP hashing; might need to revisit based on measured performance.
         uint32_t ecmp_choice = 0;
+        if (available_hops->empty())
+            return NULL; // every port has failed
         if (available_hops->size()>1)
             switch(_strategy){
             case NIX:
@@ -336,14 +398,16 @@ Route* FatTreeSwitch::getNextHop(Packet& pkt, BaseQueue* ingress_port){
                     ecmp_choice = adaptive_route(available_hops,fn); 
                 } 
                 else if (_ar_sticky==FatTreeSwitch::PER_FLOWLET){     
-                    if (_flowlet_maps.find(pkt.flow_id())!=_flowlet_maps.end()){
-                        FlowletInfo* f = _flowlet_maps[pkt.flow_id()];
+                    if (!_flowlets)
+                        _flowlets = new FlowletTable(_flowlet_table_size, _flowlet_age, _hash_salt);
+                    FlowletTable::Entry* f = _flowlets->lookup(pkt.flow_id(), available_hops, eventlist().now());
+                    if (f){
                         
                         // only reroute an existing flow if its inter packet time is larger than _sticky_delta and
                         // and
                         // 50% chance happens. 
                         // and (commented out) if the switch has not taken any other placement decision that we've not seen the effects of.
-                        if (eventlist().now() - f->_last > _sticky_delta && /*eventlist().now() - _last_choice > _pipe->delay() + BaseQueue::_update_period  &&*/ random()%2==0){ 
+                        if (eventlist().now() - f->_last > _sticky_delta && /*eventlist().now() - _last_choice > _pipe->delay() + BaseQueue::_update_period  &&*/ _rng.rand()%2==0){ 
                             //cout << "AR 1 " << timeAsUs(eventlist().now()) << endl;
                             uint32_t new_route = adaptive_route(available_hops,fn); 
                             if (fn(available_hops->at(f->_egress),available_hops->at(new_route)) < 0){
@@ -361,14 +425,14 @@ Route* FatTreeSwitch::getNextHop(Packet& pkt, BaseQueue* ingress_port){
                         ecmp_choice = adaptive_route(available_hops,fn); 
                         _last_choice = eventlist().now();
 
-                        _flowlet_maps[pkt.flow_id()] = new FlowletInfo(ecmp_choice,eventlist().now());
+                        _flowlets->insert(pkt.flow_id(),available_hops,ecmp_choice,eventlist().now());
                     }
                 }
 
                 break;
             case ECMP_ADAPTIVE:
                 ecmp_choice = freeBSDHash(pkt.flow_id(),pkt.pathid(),_hash_salt) % available_hops->size();
-                if (random()%100 < 50)
+                if (_rng.rand()%100 < 50)
                     ecmp_choice = replace_worst_choice(available_hops,fn, ecmp_choice);
                 break;
             case RR:
@@ -403,46 +467,14 @@ Route* FatTreeSwitch::getNextHop(Packet& pkt, BaseQueue* ingress_port){
     if (_type == TOR){
         if ( _ft->HOST_POD_SWITCH(pkt.dst()) == _id) { 
             //this host is directly connected!
-            HostFibEntry* fe = _fib->getHostRoute(pkt.dst(),pkt.flow_id());
+            HostFibEntry* fe = _fib->getHostRoute(pkt.dst() % _ft->radix_down(TOR_TIER));
             assert(fe);
             pkt.set_direction(DOWN);
             return fe->getEgressPort();
         } else {
             //route packet up!
-            if (_uproutes)
-                _fib->setRoutes(pkt.dst(),_uproutes);
-            else {
-                uint32_t podid,agg_min,agg_max;
-
-                if (_ft->get_tiers()==3) {
-                    podid = _id / _ft->tor_switches_per_pod();
-                    agg_min = _ft->MIN_POD_AGG_SWITCH(podid);
-                    agg_max = _ft->MAX_POD_AGG_SWITCH(podid);
-                }
-                else {
-                    agg_min = 0;
-                    agg_max = _ft->getNAGG()-1;
-                }
-
-                for (uint32_t k=agg_min; k<=agg_max;k++){
-                    for (uint32_t b = 0; b < _ft->bundlesize(AGG_TIER); b++) {
-                        Route * r = new Route();
-                        r->push_back(_ft->queues_nlp_nup[_id][k][b]);
-                        assert(((BaseQueue*)r->at(0))->getSwitch() == this);
-
-                        r->push_back(_ft->pipes_nlp_nup[_id][k][b]);
-                        r->push_back(_ft->queues_nlp_nup[_id][k][b]->getRemoteEndpoint());
-                        _fib->addRoute(pkt.dst(),r,1,UP);
-                    }
-
-                    /*
-                      FatTreeSwitch* next = (FatTreeSwitch*)_ft->queues_nlp_nup[_id][k]->getRemoteEndpoint();
-                      assert (next->getType()==AGG && next->getID() == k);
-                    */
-                }
-                _uproutes = _fib->getRoutes(pkt.dst());
-                permute_paths(_uproutes);
-            }
+            if (!_uproutes)
+                build_uproutes();
         }
     } else if (_type == AGG) {
         if ( _ft->get_tiers()==2 || _ft->HOST_POD(pkt.dst()) == _ft->AGG_SWITCH_POD_ID(_id)) {
@@ -457,62 +489,444 @@ Route* FatTreeSwitch::getNextHop(Packet& pkt, BaseQueue* ingress_port){
                 r->push_back(_ft->pipes_nup_nlp[_id][target_tor][b]);          
                 r->push_back(_ft->queues_nup_nlp[_id][target_tor][b]->getRemoteEndpoint());
 
-                _fib->addRoute(pkt.dst(),r,1, DOWN);
+                _fib->addGroupRoute(target_tor,r,1, DOWN);
             }
         } else {
             //go up!
-            if (_uproutes)
-                _fib->setRoutes(pkt.dst(),_uproutes);
-            else {
-                uint32_t podpos = _id % _ft->agg_switches_per_pod();
-                uint32_t uplink_bundles = _ft->radix_up(AGG_TIER) / _ft->bundlesize(CORE_TIER);
-                for (uint32_t l = 0; l <  uplink_bundles ; l++) {
-                    uint32_t core = l * _ft->agg_switches_per_pod() + podpos;
-                    for (uint32_t b = 0; b < _ft->bundlesize(CORE_TIER); b++) {
-                        Route *r = new Route();
-                        r->push_back(_ft->queues_nup_nc[_id][core][b]);
-                        assert(((BaseQueue*)r->at(0))->getSwitch() == this);
-
-                        r->push_back(_ft->pipes_nup_nc[_id][core][b]);
-                        r->push_back(_ft->queues_nup_nc[_id][core][b]->getRemoteEndpoint());
-
-                        /*
-                          FatTreeSwitch* next = (FatTreeSwitch*)_ft->queues_nup_nc[_id][k]->getRemoteEndpoint();
-                          assert (next->getType()==CORE && next->getID() == k);
-                        */
-                    
-                        _fib->addRoute(pkt.dst(),r,1,UP);
-
-                        //cout << "AGG switch " << _id << " adding route to " << pkt.dst() << " via CORE " << k << " bundle_id " << b << endl;
-                    }
-                }
-                //_uproutes = _fib->getRoutes(pkt.dst());
-                permute_paths(_fib->getRoutes(pkt.dst()));
-            }
+            if (!_uproutes)
+                build_uproutes();
         }
     } else if (_type == CORE) {
-        uint32_t nup = _ft->MIN_POD_AGG_SWITCH(_ft->HOST_POD(pkt.dst())) + (_id % _ft->agg_switches_per_pod());
-        for (uint32_t b = 0; b < _ft->bundlesize(CORE_TIER); b++) {
-            Route *r = new Route();
-            //cout << "CORE switch " << _id << " adding route to " << pkt.dst() << " via AGG " << nup << endl;
-
-            assert (_ft->queues_nc_nup[_id][nup][b]);
-            r->push_back(_ft->queues_nc_nup[_id][nup][b]);
-            assert(((BaseQueue*)r->at(0))->getSwitch() == this);
-
-            assert (_ft->pipes_nc_nup[_id][nup][b]);
-            r->push_back(_ft->pipes_nc_nup[_id][nup][b]);
-
-            r->push_back(_ft->queues_nc_nup[_id][nup][b]->getRemoteEndpoint());
-            _fib->addRoute(pkt.dst(),r,1,DOWN);
-        }
+        build_core_routes(_ft->HOST_POD(pkt.dst()));
     }
     else {
         cerr << "Route lookup on switch with no proper type: " << _type << endl;
         abort();
     }
-    assert(_fib->getRoutes(pkt.dst()));
+    assert(lookup_group(pkt.dst()));
 
     //FIB has been filled in; return choice. 
     return getNextHop(pkt, ingress_port);
 };
+
+void FatTreeSwitch::build_uproutes() {
+    assert(!_uproutes);
+    _uproutes = new vector<FibEntry*>();
+    if (_type == TOR) {
+        uint32_t podid,agg_min,agg_max;
+
+        if (_ft->get_tiers()==3) {
+            podid = _id / _ft->tor_switches_per_pod();
+            agg_min = _ft->MIN_POD_AGG_SWITCH(podid);
+            agg_max = _ft->MAX_POD_AGG_SWITCH(podid);
+        }
+        else {
+            agg_min = 0;
+            agg_max = _ft->getNAGG()-1;
+        }
+
+        for (uint32_t k=agg_min; k<=agg_max;k++){
+            for (uint32_t b = 0; b < _ft->bundlesize(AGG_TIER); b++) {
+                Route * r = new Route();
+                r->push_back(_ft->queues_nlp_nup[_id][k][b]);
+                assert(((BaseQueue*)r->at(0))->getSwitch() == this);
+
+                r->push_back(_ft->pipes_nlp_nup[_id][k][b]);
+                r->push_back(_ft->queues_nlp_nup[_id][k][b]->getRemoteEndpoint());
+                _uproutes->push_back(new FibEntry(r,1,UP));
+            }
+
+            /*
+              FatTreeSwitch* next = (FatTreeSwitch*)_ft->queues_nlp_nup[_id][k]->getRemoteEndpoint();
+              assert (next->getType()==AGG && next->getID() == k);
+            */
+        }
+    } else {
+        assert(_type == AGG);
+        uint32_t podpos = _id % _ft->agg_switches_per_pod();
+        uint32_t uplink_bundles = _ft->radix_up(AGG_TIER) / _ft->bundlesize(CORE_TIER);
+        for (uint32_t l = 0; l <  uplink_bundles ; l++) {
+            uint32_t core = l * _ft->agg_switches_per_pod() + podpos;
+            for (uint32_t b = 0; b < _ft->bundlesize(CORE_TIER); b++) {
+                Route *r = new Route();
+                r->push_back(_ft->queues_nup_nc[_id][core][b]);
+                assert(((BaseQueue*)r->at(0))->getSwitch() == this);
+
+                r->push_back(_ft->pipes_nup_nc[_id][core][b]);
+                r->push_back(_ft->queues_nup_nc[_id][core][b]->getRemoteEndpoint());
+
+                /*
+                  FatTreeSwitch* next = (FatTreeSwitch*)_ft->queues_nup_nc[_id][k]->getRemoteEndpoint();
+                  assert (next->getType()==CORE && next->getID() == k);
+                */
+                    
+                FibEntry* e = new FibEntry(r,1,UP);
+                if (_ft->pipes_nup_nc[_id][core][b]->failed())
+                    _withdrawn[_ft->queues_nup_nc[_id][core][b]] = e;
+                else
+                    _uproutes->push_back(e);
+
+                //cout << "AGG switch " << _id << " adding route via CORE " << core << " bundle_id " << b << endl;
+            }
+        }
+    }
+    permute_paths(_uproutes);
+}
+
+void FatTreeSwitch::build_core_routes(uint32_t pod) {
+    assert(_type == CORE);
+    uint32_t nup = _ft->MIN_POD_AGG_SWITCH(pod) + (_id % _ft->agg_switches_per_pod());
+    // the group exists even if all its links have failed
+    vector<FibEntry*>* group = _fib->addGroup(pod);
+    for (uint32_t b = 0; b < _ft->bundlesize(CORE_TIER); b++) {
+        Route *r = new Route();
+        //cout << "CORE switch " << _id << " adding route to pod " << pod << " via AGG " << nup << endl;
+
+        assert (_ft->queues_nc_nup[_id][nup][b]);
+        r->push_back(_ft->queues_nc_nup[_id][nup][b]);
+        assert(((BaseQueue*)r->at(0))->getSwitch() == this);
+
+        assert (_ft->pipes_nc_nup[_id][nup][b]);
+        r->push_back(_ft->pipes_nc_nup[_id][nup][b]);
+
+        r->push_back(_ft->queues_nc_nup[_id][nup][b]->getRemoteEndpoint());
+        FibEntry* e = new FibEntry(r,1,DOWN);
+        if (_ft->pipes_nc_nup[_id][nup][b]->failed())
+            _withdrawn[_ft->queues_nc_nup[_id][nup][b]] = e;
+        else
+            group->push_back(e);
+    }
+}
+
+// The group port belongs to, built now if no packet has needed it yet.
+vector<FibEntry*>* FatTreeSwitch::port_group(BaseQueue* port) {
+    if (_type == AGG) {
+        if (!_uproutes)
+            build_uproutes();
+        return _uproutes;
+    }
+    assert(_type == CORE);
+    uint32_t pod = _ft->AGG_SWITCH_POD_ID(((Switch*)port->getRemoteEndpoint())->getID());
+    if (!_fib->getGroup(pod))
+        build_core_routes(pod);
+    return _fib->getGroup(pod);
+}
+
+static bool remove_port(vector<FibEntry*>* group, BaseQueue* port) {
+    for (size_t i = 0; i < group->size(); i++) {
+        if ((*group)[i]->getEgressPort()->at(0) == port) {
+            group->erase(group->begin() + i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void FatTreeSwitch::withdraw_port(BaseQueue* port) {
+    vector<FibEntry*>* group = port_group(port);
+    for (size_t i = 0; i < group->size(); i++) {
+        FibEntry* e = (*group)[i];
+        if (e->getEgressPort()->at(0) == port) {
+            _withdrawn[port] = e;
+            group->erase(group->begin() + i);
+            group_changed(group);
+            break;
+        }
+    }
+    // the per pod uplink groups are subsets of _uproutes
+    for (uint32_t pod = 0; pod < _pod_uproutes.size(); pod++) {
+        if (_pod_uproutes[pod] && remove_port(_pod_uproutes[pod], port))
+            group_changed(_pod_uproutes[pod]);
+    }
+}
+
+void FatTreeSwitch::restore_port(BaseQueue* port) {
+    unordered_map<BaseQueue*,FibEntry*>::iterator i = _withdrawn.find(port);
+    assert(i != _withdrawn.end());
+    vector<FibEntry*>* group = port_group(port);
+    group->push_back(i->second);
+    _withdrawn.erase(i);
+    group_changed(group);
+    for (uint32_t pod = 0; pod < _pod_uproutes.size(); pod++) {
+        if (_pod_uproutes[pod])
+            update_pod_uproutes(pod);
+    }
+}
+
+void FatTreeSwitch::update_pod_uproutes(uint32_t pod) {
+    assert(_type == AGG && pod != _ft->AGG_SWITCH_POD_ID(_id));
+    if (!_uproutes)
+        build_uproutes();
+    vector<FibEntry*> reach;
+    for (size_t i = 0; i < _uproutes->size(); i++) {
+        Switch* core = (Switch*)(*_uproutes)[i]->getEgressPort()->at(2);
+        if (_ft->core_reaches_pod(core->getID(), pod))
+            reach.push_back((*_uproutes)[i]);
+    }
+
+    vector<FibEntry*>* group = pod < _pod_uproutes.size() ? _pod_uproutes[pod] : NULL;
+    if (reach.size() == _uproutes->size()) {
+        // every core reaches pod again; back to the shared group
+        if (group) {
+            group_changed(group);
+            delete group;
+            _pod_uproutes[pod] = NULL;
+            if (--_pod_uproute_count == 0)
+                _pod_uproutes.clear();
+        }
+        return;
+    }
+    if (!group) {
+        if (_pod_uproutes.empty())
+            _pod_uproutes.resize(_ft->no_of_pods(), NULL);
+        group = _pod_uproutes[pod] = new vector<FibEntry*>();
+        _pod_uproute_count++;
+    }
+    group->swap(reach);
+    group_changed(group);
+}
+
+// Rankings and flowlets refer to ports by their index in a group, so
+// they can't outlive a change to it.
+void FatTreeSwitch::group_changed(vector<FibEntry*>* group) {
+    if (group == _uproutes) {
+        delete _upranking;
+        _upranking = NULL;
+    } else {
+        unordered_map<vector<FibEntry*>*,PortRanking*>::iterator i = _rankings.find(group);
+        if (i != _rankings.end()) {
+            delete i->second;
+            _rankings.erase(i);
+        }
+    }
+    if (_flowlets)
+        _flowlets->clear();
+}
+
+uint32_t FlowletTable::_tables = 0;
+uint64_t FlowletTable::_slots = 0;
+uint64_t FlowletTable::_total_occupied = 0;
+uint64_t FlowletTable::_lookups = 0;
+uint64_t FlowletTable::_hits = 0;
+uint64_t FlowletTable::_collisions = 0;
+uint64_t FlowletTable::_inserts = 0;
+uint64_t FlowletTable::_aged = 0;
+
+FlowletTable::FlowletTable(uint32_t size, simtime_picosec age, uint32_t salt) {
+    // power of two so the slot is a mask of the hash
+    assert(size > 0 && (size & (size - 1)) == 0);
+    Entry empty = {0, 0, NULL, 0, false};
+    _entries.resize(size, empty);
+    _mask = size - 1;
+    _age = age;
+    _salt = salt;
+    _occupied = 0;
+    _tables++;
+    _slots += size;
+}
+
+uint32_t FlowletTable::slot(uint32_t flowid) const {
+    return mhash(flowid ^ _salt) & _mask;
+}
+
+FlowletTable::Entry* FlowletTable::lookup(uint32_t flowid, const vector<FibEntry*>* group, simtime_picosec now) {
+    _lookups++;
+    Entry* e = &_entries[slot(flowid)];
+    if (!e->_valid)
+        return NULL;
+    if (_age > 0 && now - e->_last > _age) {
+        e->_valid = false;
+        _occupied--;
+        _total_occupied--;
+        _aged++;
+        return NULL;
+    }
+    if (e->_flowid != flowid) {
+        _collisions++;
+        return NULL;
+    }
+    // the group may also have shrunk since, if a port was withdrawn
+    if (e->_group != group || e->_egress >= group->size())
+        return NULL;
+    _hits++;
+    return e;
+}
+
+void FlowletTable::insert(uint32_t flowid, const vector<FibEntry*>* group, uint32_t egress, simtime_picosec now) {
+    Entry* e = &_entries[slot(flowid)];
+    if (!e->_valid) {
+        e->_valid = true;
+        _occupied++;
+        _total_occupied++;
+    }
+    e->_flowid = flowid;
+    e->_group = group;
+    e->_egress = egress;
+    e->_last = now;
+    _inserts++;
+}
+
+void FlowletTable::clear() {
+    for (size_t i = 0; i < _entries.size(); i++)
+        _entries[i]._valid = false;
+    _total_occupied -= _occupied;
+    _occupied = 0;
+}
+
+void FlowletTable::report(ostream& out) {
+    out << "# flowlet tables " << _tables
+        << " slots " << _slots
+        << " occupied " << _total_occupied
+        << " lookups " << _lookups
+        << " hits " << _hits
+        << " collisions " << _collisions
+        << " new " << _inserts
+        << " aged " << _aged << endl;
+}
+
+uint8_t FatTreeSwitch::ranking_metrics() {
+    if (fn == &compare_pause)
+        return PortRanking::PAUSE;
+    if (fn == &compare_queuesize)
+        return PortRanking::QUEUE;
+    if (fn == &compare_bandwidth)
+        return PortRanking::BANDWIDTH;
+    if (fn == &compare_pqb)
+        return PortRanking::PAUSE | PortRanking::QUEUE | PortRanking::BANDWIDTH;
+    if (fn == &compare_pq)
+        return PortRanking::PAUSE | PortRanking::QUEUE;
+    if (fn == &compare_pb)
+        return PortRanking::PAUSE | PortRanking::BANDWIDTH;
+    if (fn == &compare_qb)
+        return PortRanking::QUEUE | PortRanking::BANDWIDTH;
+    // flow counts change when we choose, not when queues do
+    return 0;
+}
+
+PortRanking* FatTreeSwitch::ranking(vector<FibEntry*>* ecmp_set) {
+    uint8_t metrics = ranking_metrics();
+    if (!metrics)
+        return NULL;
+    if (ecmp_set == _uproutes) {
+        if (!_upranking)
+            _upranking = new PortRanking(ecmp_set, metrics);
+        return _upranking;
+    }
+    PortRanking*& r = _rankings[ecmp_set];
+    if (!r) {
+        // the per pod uplink groups share their ports with _uproutes,
+        // and a queue only has one listener
+        if ((*ecmp_set)[0]->getDirection() == UP) {
+            _rankings.erase(ecmp_set);
+            return NULL;
+        }
+        r = new PortRanking(ecmp_set, metrics);
+    }
+    return r;
+}
+
+PortRanking::PortRanking(vector<FibEntry*>* ecmp_set, uint8_t metrics) {
+    assert(metrics);
+    _metrics = metrics;
+    _nonempty = 0;
+    _sweep = 0;
+    _last_select = EventList::now();
+    for (uint32_t i = 0; i < ecmp_set->size(); i++) {
+        Route* r = (*ecmp_set)[i]->getEgressPort();
+        assert(r && r->size()>1);
+        BaseQueue* q = dynamic_cast<BaseQueue*>(r->at(0));
+        assert(q);
+        _queues.push_back(q);
+        _lossless.push_back(dynamic_cast<LosslessOutputQueue*>(q));
+
+        uint8_t l = read_level(i);
+        _level.push_back(l);
+        _last_read.push_back(EventList::now());
+        _is_dirty.push_back(false);
+        _slot.push_back(_buckets[l].size());
+        _buckets[l].push_back(i);
+        _nonempty |= 1u << l;
+
+        q->setLevelListener(this, i);
+    }
+}
+
+PortRanking::~PortRanking() {
+    for (uint32_t i = 0; i < _queues.size(); i++)
+        _queues[i]->setLevelListener(NULL, 0);
+}
+
+uint8_t PortRanking::read_level(uint32_t port) {
+    uint8_t l = 0;
+    if ((_metrics & PAUSE) && _lossless[port] && _lossless[port]->is_paused())
+        l |= 16;
+    if (_metrics & QUEUE)
+        l |= _queues[port]->queuesize_level() << 2;
+    if (_metrics & BANDWIDTH)
+        l |= _queues[port]->utilization_level();
+    return l;
+}
+
+void PortRanking::refresh(uint32_t port) {
+    _last_read[port] = EventList::now();
+    uint8_t old = _level[port];
+    uint8_t l = read_level(port);
+    if (l == old)
+        return;
+
+    // swap the port out of its old bucket
+    vector<uint32_t>& from = _buckets[old];
+    uint32_t moved = from.back();
+    from[_slot[port]] = moved;
+    _slot[moved] = _slot[port];
+    from.pop_back();
+    if (from.empty())
+        _nonempty &= ~(1u << old);
+
+    _slot[port] = _buckets[l].size();
+    _buckets[l].push_back(port);
+    _nonempty |= 1u << l;
+    _level[port] = l;
+}
+
+void PortRanking::update(uint32_t port) {
+    if (_is_dirty[port])
+        return;
+    // an unchanged port would have been read again by the last
+    // selection if its period had run out by then
+    if (_last_select - _last_read[port] > BaseQueue::_update_period)
+        _last_read[port] = _last_select;
+    _is_dirty[port] = true;
+    _dirty.push(make_pair(_last_read[port], port));
+}
+
+void PortRanking::flush() {
+    while (!_dirty.empty() && EventList::now() - _dirty.top().first > BaseQueue::_update_period) {
+        uint32_t port = _dirty.top().second;
+        _dirty.pop();
+        _is_dirty[port] = false;
+        refresh(port);
+    }
+    _last_select = EventList::now();
+}
+
+void PortRanking::queueLevelChanged(uint32_t port) {
+    update(port);
+}
+
+uint32_t PortRanking::best(RngStream& rng) {
+    flush();
+    if (!_is_dirty[_sweep] && EventList::now() - _last_read[_sweep] > BaseQueue::_update_period)
+        refresh(_sweep);
+    _sweep = (_sweep + 1) % _level.size();
+
+    assert(_nonempty);
+    vector<uint32_t>& b = _buckets[__builtin_ctz(_nonempty)];
+    return b[rng.rand() % b.size()];
+}
+
+uint8_t PortRanking::worst_level() {
+    flush();
+    assert(_nonempty);
+    return 31 - __builtin_clz(_nonempty);
+}
@@ -3,10 +3,14 @@
 #define _FATTREESWITCH_H
 
 #include "switch.h"
+#include "queue.h"
 #include "callback_pipe.h"
+#include "rng.h"
 #include <unordered_map>
+#include <queue>
 
 class FatTreeTopology;
+class LosslessOutputQueue;
 
 /*
  * Copyright (C) 2013-2014 Universita` di Pisa. All rights reserved.
@@ -72,13 +76,102 @@ static inline uint32_t freeBSDHash(uint32_t target1, uint32_t target2 = 0, uint3
 
 #undef MIX
 
-class FlowletInfo {
+// A flowlet table as found in switch ASICs: a fixed number of slots
+// indexed by a hash of the flow id, so memory doesn't grow with the
+// number of flows seen.  Each slot is tagged with the flow that set it
+// and the next-hop group its egress indexes; a flow that finds another
+// flow's tag (a collision) or a different group (e.g. its ACKs on the
+// way back, or a per-pod subset after a link failure) takes the slot
+// over.  A slot that has been idle for longer than the aging time is
+// free to start a new flowlet; an aging time of zero means slots never
+// expire.
+class FlowletTable {
 public:
-    uint32_t _egress;
-    simtime_picosec _last;
+    struct Entry {
+        uint32_t _flowid;
+        uint32_t _egress;
+        const vector<FibEntry*>* _group;
+        simtime_picosec _last;
+        bool _valid;
+    };
+
+    FlowletTable(uint32_t size, simtime_picosec age, uint32_t salt);
+
+    // the live slot this flow set for this group, or NULL if there
+    // isn't one, in which case the caller picks an egress port and
+    // calls insert().
+    Entry* lookup(uint32_t flowid, const vector<FibEntry*>* group, simtime_picosec now);
+    void insert(uint32_t flowid, const vector<FibEntry*>* group, uint32_t egress, simtime_picosec now);
+    // forget every flowlet, eg when the ports of a group have moved
+    void clear();
+    uint32_t occupancy() const {return _occupied;}
+    uint32_t size() const {return _entries.size();}
+
+    // totals over all tables
+    static void report(ostream& out);
+private:
+    uint32_t slot(uint32_t flowid) const;
 
-    FlowletInfo(uint32_t egress,simtime_picosec lasttime) {_egress = egress; _last = lasttime;};
+    vector<Entry> _entries;
+    uint32_t _mask;
+    simtime_picosec _age;
+    uint32_t _salt;
+    uint32_t _occupied;
 
+    static uint32_t _tables;
+    static uint64_t _slots;
+    static uint64_t _total_occupied;
+    static uint64_t _lookups;
+    static uint64_t _hits;
+    static uint64_t _collisions;
+    static uint64_t _inserts;
+    static uint64_t _aged;
+};
+
+// Keeps the ports of one ECMP group bucketed by load level, so the
+// least loaded ones can be found without comparing every port.  A
+// port's level combines the pause state, queue size and utilization
+// levels of its first-hop queue, in that order of precedence, as the
+// compare_* functions do.  Queues tell us when their level may have
+// changed, and the port is re-read at the next selection at least
+// BaseQueue::_update_period after its last read, so levels are as
+// stale as the sampled quantized_* values the comparisons use.
+// Utilization also decays while a port is idle, so each selection
+// re-reads one more port, round robin.
+class PortRanking : public QueueLevelListener {
+public:
+    enum metric { BANDWIDTH = 1, QUEUE = 2, PAUSE = 4 };
+
+    PortRanking(vector<FibEntry*>* ecmp_set, uint8_t metrics);
+    ~PortRanking();
+
+    // a random choice among the least loaded ports
+    uint32_t best(RngStream& rng);
+    uint8_t level(uint32_t port) const {return _level[port];}
+    uint8_t worst_level();
+
+    virtual void queueLevelChanged(uint32_t port);
+private:
+    static const uint8_t LEVELS = 32;
+    uint8_t read_level(uint32_t port);
+    void refresh(uint32_t port);
+    void update(uint32_t port);
+    void flush();
+
+    uint8_t _metrics;
+    vector<BaseQueue*> _queues;
+    vector<LosslessOutputQueue*> _lossless; // NULL for queues that can't be paused
+    vector<uint8_t> _level;
+    vector<uint32_t> _slot;                 // position of each port in its bucket
+    vector<uint32_t> _buckets[LEVELS];
+    uint32_t _nonempty;                     // bit per level that has ports in it
+    vector<simtime_picosec> _last_read;
+    simtime_picosec _last_select;
+    // ports that have changed since they were last read, oldest read first
+    priority_queue<pair<simtime_picosec,uint32_t>, vector<pair<simtime_picosec,uint32_t> >,
+                   greater<pair<simtime_picosec,uint32_t> > > _dirty;
+    vector<bool> _is_dirty;
+    uint32_t _sweep;
 };
 
 class FatTreeSwitch : public Switch {
@@ -119,6 +212,24 @@ public:
     virtual void addHostPort(int addr, int flowid, PacketSink* transport);
 
     virtual void permute_paths(vector<FibEntry*>* uproutes);
+    vector<FibEntry*>* lookup_group(uint32_t dst);
+    PortRanking* ranking(vector<FibEntry*>* ecmp_set);
+
+    // the levels ranked on for the current comparison function, or 0
+    // if it can't be ranked incrementally
+    static uint8_t ranking_metrics();
+
+    // Link failures at runtime (see FatTreeTopology::fail_link).  Only
+    // the group the port belongs to changes: an AGG's uplinks or a
+    // core's routes down to one pod.  A withdrawn port's FIB entry is
+    // kept, so routes that packets in flight still point at stay valid.
+    void withdraw_port(BaseQueue* port);
+    void restore_port(BaseQueue* port);
+    // AGG only: recompute which uplinks reach pod, after a core's last
+    // link down to pod has failed or the first one has recovered.
+    void update_pod_uproutes(uint32_t pod);
+    // packets dropped because every port of their group had failed
+    static uint64_t _no_route_drops;
 
     static void set_strategy(routing_strategy s) { assert (_strategy==NIX); _strategy = s; }
     static void set_ar_fraction(uint16_t f) { assert(f>=1);_ar_fraction = f;} 
@@ -129,20 +240,46 @@ public:
     static simtime_picosec _sticky_delta;
     static double _ecn_threshold_fraction;
     static double _speculative_threshold_fraction;
+    // flowlet table geometry, used when _ar_sticky is PER_FLOWLET.
+    // The size must be a power of two.
+    static uint32_t _flowlet_table_size;
+    static simtime_picosec _flowlet_age;
+    // pick adaptive routing choices from incrementally maintained port
+    // rankings rather than by comparing all ports per packet.
+    static bool _ar_ranked;
 private:
+    void build_uproutes();
+    void build_core_routes(uint32_t pod);
+    vector<FibEntry*>* port_group(BaseQueue* port);
+    void group_changed(vector<FibEntry*>* group);
+
     switch_type _type;
     Pipe* _pipe;
     FatTreeTopology* _ft;
     
-    //CAREFUL: can't always have a single FIB for all up destinations when there are failures!
+    // All destinations reached via an uplink share this group; down
+    // groups live in _fib, keyed by destination ToR or pod.
     vector<FibEntry*>* _uproutes;
+    // That breaks when a core loses its last link to a pod: an AGG
+    // must then reach that pod through its other cores only.  Such
+    // pods get their own subset of _uproutes here, indexed by pod.
+    // Empty while there are none, so lookups don't pay for it.
+    vector<vector<FibEntry*>*> _pod_uproutes;
+    uint32_t _pod_uproute_count;
+    // entries of failed ports, taken out of their group until they recover
+    unordered_map<BaseQueue*,FibEntry*> _withdrawn;
+
+    FlowletTable* _flowlets; // allocated on first use
 
-    unordered_map<uint32_t,FlowletInfo*> _flowlet_maps;
+    // built on first use when _ar_ranked is set
+    PortRanking* _upranking;
+    unordered_map<vector<FibEntry*>*,PortRanking*> _rankings;
 
     static unordered_map<BaseQueue*,uint32_t> _port_flow_counts;
 
     uint32_t _crt_route;
     uint32_t _hash_salt;
+    RngStream _rng; // for ECMP and adaptive routing choices
     simtime_picosec _last_choice;
 
     unordered_map<Packet*,bool> _packets;
@@ -3,6 +3,7 @@
 #include <vector>
 #include "string.h"
 #include <sstream>
+#include <thread>
 
 #include <iostream>
 #include "main.h"
@@ -26,6 +27,7 @@ uint32_t FatTreeTopology::_tiers = 3;
 simtime_picosec FatTreeTopology::_link_latencies[] = {0,0,0};
 simtime_picosec FatTreeTopology::_switch_latencies[] = {0,0,0};
 uint32_t FatTreeTopology::_hosts_per_pod = 0;
+uint32_t FatTreeTopology::_build_threads = 0;
 uint32_t FatTreeTopology::_radix_up[] = {0,0};
 uint32_t FatTreeTopology::_radix_down[] = {0,0,0};
 mem_b FatTreeTopology::_queue_up[] = {0,0};
@@ -430,7 +432,6 @@ void FatTreeTopology::set_custom_params(uint32_t no_of_nodes) {
     }
 
     no_of_pods = no_of_nodes / _hosts_per_pod; // we don't allow multi-port hosts yet
-    assert(_bundlesize[TOR_TIER] == 1);
     if (_hosts_per_pod % _radix_down[TOR_TIER] != 0) {
         cerr << "Mismatch between TOR radix " << _radix_down[TOR_TIER] << " and podsize " << _hosts_per_pod << endl;
         exit(1);
@@ -519,6 +520,13 @@ void FatTreeTopology::set_custom_params(uint32_t no_of_nodes) {
 
 
 void FatTreeTopology::set_params(uint32_t no_of_nodes) {
+    // we don't allow multi-port hosts yet: HOST_POD_SWITCH and the host
+    // link tables assume one link between a host and its ToR.
+    if (_bundlesize[TOR_TIER] != 1) {
+        cerr << "Tier " << TOR_TIER << " bundle size is " << _bundlesize[TOR_TIER]
+             << ", but hosts can only have one link to their ToR\n";
+        exit(1);
+    }
     if (_hosts_per_pod > 0) {
         // if we've set all the detailed parameters, we'll use them, otherwise fall through to defaults
         set_custom_params(no_of_nodes);
@@ -610,8 +618,10 @@ void FatTreeTopology::alloc_vectors() {
     pipes_nup_nlp.resize(NAGG, vector< vector<Pipe*> >(NTOR, vector<Pipe*>(_bundlesize[AGG_TIER])));
     queues_nup_nlp.resize(NAGG, vector< vector<BaseQueue*> >(NTOR, vector<BaseQueue*>(_bundlesize[AGG_TIER])));
 
-    pipes_nlp_ns.resize(NTOR, vector< vector<Pipe*> >(NSRV, vector<Pipe*>(_bundlesize[TOR_TIER])));
-    queues_nlp_ns.resize(NTOR, vector< vector<BaseQueue*> >(NSRV, vector<BaseQueue*>(_bundlesize[TOR_TIER])));
+    // one bundle per host; see HostLinkTable
+    uint32_t hosts_per_tor = _radix_down[TOR_TIER]/_bundlesize[TOR_TIER];
+    pipes_nlp_ns.resize(NSRV, hosts_per_tor, _bundlesize[TOR_TIER], true);
+    queues_nlp_ns.resize(NSRV, hosts_per_tor, _bundlesize[TOR_TIER], true);
 
 
     if (_tiers == 3) {
@@ -620,9 +630,9 @@ void FatTreeTopology::alloc_vectors() {
     }
     
     pipes_nlp_nup.resize(NTOR, vector< vector<Pipe*> >(NAGG, vector<Pipe*>(_bundlesize[AGG_TIER])));
-    pipes_ns_nlp.resize(NSRV, vector< vector<Pipe*> >(NTOR, vector<Pipe*>(_bundlesize[TOR_TIER])));
+    pipes_ns_nlp.resize(NSRV, hosts_per_tor, _bundlesize[TOR_TIER], false);
     queues_nlp_nup.resize(NTOR, vector< vector<BaseQueue*> >(NAGG, vector<BaseQueue*>(_bundlesize[AGG_TIER])));
-    queues_ns_nlp.resize(NSRV, vector< vector<BaseQueue*> >(NTOR, vector<BaseQueue*>(_bundlesize[TOR_TIER])));
+    queues_ns_nlp.resize(NSRV, hosts_per_tor, _bundlesize[TOR_TIER], false);
 }
 
 BaseQueue* FatTreeTopology::alloc_src_queue(QueueLogger* queueLogger){
@@ -704,40 +714,11 @@ FatTreeTopology::alloc_queue(QueueLogger* queueLogger, linkspeed_bps speed, mem_
 
 void FatTreeTopology::init_network(){
     QueueLogger* queueLogger;
-    if (_tiers == 3) {
-        for (uint32_t j=0;j<NCORE;j++) {
-            for (uint32_t k=0;k<NAGG;k++) {
-                for (uint32_t b = 0; b < _bundlesize[CORE_TIER]; b++) {
-                    queues_nc_nup[j][k][b] = NULL;
-                    pipes_nc_nup[j][k][b] = NULL;
-                    queues_nup_nc[k][j][b] = NULL;
-                    pipes_nup_nc[k][j][b] = NULL;
-                }
-            }
-        }
-    }
-    
-    for (uint32_t j=0;j<NAGG;j++) {
-        for (uint32_t k=0;k<NTOR;k++) {
-            for (uint32_t b = 0; b < _bundlesize[AGG_TIER]; b++) {
-                queues_nup_nlp[j][k][b] = NULL;
-                pipes_nup_nlp[j][k][b] = NULL;
-                queues_nlp_nup[k][j][b] = NULL;
-                pipes_nlp_nup[k][j][b] = NULL;
-            }
-        }
-    }
-    
-    for (uint32_t j=0;j<NTOR;j++) {
-        for (uint32_t k=0;k<NSRV;k++) {
-            for (uint32_t b = 0; b < _bundlesize[TOR_TIER]; b++) { 
-                queues_nlp_ns[j][k][b] = NULL;
-                pipes_nlp_ns[j][k][b] = NULL;
-                queues_ns_nlp[k][j][b] = NULL;
-                pipes_ns_nlp[k][j][b] = NULL;
-            }
-        }
-    }
+
+    // alloc_vectors() has already NULLed all the link vectors.  Queues,
+    // pipes and switches are created here in a fixed order so log IDs
+    // are the same from run to run; naming them is deferred to
+    // name_links(), which can run in parallel.
 
     //create switches if we have lossless operation
     //if (_qt==LOSSLESS)
@@ -769,11 +750,9 @@ void FatTreeTopology::init_network(){
                 }
             
                 queues_nlp_ns[tor][srv][b] = alloc_queue(queueLogger, _queue_down[TOR_TIER], DOWNLINK, TOR_TIER, true);
-                queues_nlp_ns[tor][srv][b]->setName("LS" + ntoa(tor) + "->DST" +ntoa(srv) + "(" + ntoa(b) + ")");
                 //if (logfile) logfile->writeName(*(queues_nlp_ns[tor][srv]));
                 simtime_picosec hop_latency = (_hop_latency == 0) ? _link_latencies[TOR_TIER] : _hop_latency;
                 pipes_nlp_ns[tor][srv][b] = new Pipe(hop_latency, *_eventlist);
-                pipes_nlp_ns[tor][srv][b]->setName("Pipe-LS" + ntoa(tor)  + "->DST" + ntoa(srv) + "(" + ntoa(b) + ")");
                 //if (logfile) logfile->writeName(*(pipes_nlp_ns[tor][srv]));
             
                 // Uplink
@@ -783,7 +762,6 @@ void FatTreeTopology::init_network(){
                     queueLogger = NULL;
                 }
                 queues_ns_nlp[srv][tor][b] = alloc_src_queue(queueLogger);   
-                queues_ns_nlp[srv][tor][b]->setName("SRC" + ntoa(srv) + "->LS" +ntoa(tor) + "(" + ntoa(b) + ")");
                 //cout << queues_ns_nlp[srv][tor][b]->str() << endl;
                 //if (logfile) logfile->writeName(*(queues_ns_nlp[srv][tor]));
 
@@ -797,7 +775,6 @@ void FatTreeTopology::init_network(){
                 }
         
                 pipes_ns_nlp[srv][tor][b] = new Pipe(hop_latency, *_eventlist);
-                pipes_ns_nlp[srv][tor][b]->setName("Pipe-SRC" + ntoa(srv) + "->LS" + ntoa(tor) + "(" + ntoa(b) + ")");
                 //if (logfile) logfile->writeName(*(pipes_ns_nlp[srv][tor]));
             
                 if (ff){
@@ -831,12 +808,10 @@ void FatTreeTopology::init_network(){
                     queueLogger = NULL;
                 }
                 queues_nup_nlp[agg][tor][b] = alloc_queue(queueLogger, _queue_down[AGG_TIER], DOWNLINK, AGG_TIER);
-                queues_nup_nlp[agg][tor][b]->setName("US" + ntoa(agg) + "->LS_" + ntoa(tor) + "(" + ntoa(b) + ")");
                 //if (logfile) logfile->writeName(*(queues_nup_nlp[agg][tor]));
             
                 simtime_picosec hop_latency = (_hop_latency == 0) ? _link_latencies[AGG_TIER] : _hop_latency;
                 pipes_nup_nlp[agg][tor][b] = new Pipe(hop_latency, *_eventlist);
-                pipes_nup_nlp[agg][tor][b]->setName("Pipe-US" + ntoa(agg) + "->LS" + ntoa(tor) + "(" + ntoa(b) + ")");
                 //if (logfile) logfile->writeName(*(pipes_nup_nlp[agg][tor]));
             
                 // Uplink
@@ -846,7 +821,6 @@ void FatTreeTopology::init_network(){
                     queueLogger = NULL;
                 }
                 queues_nlp_nup[tor][agg][b] = alloc_queue(queueLogger, _queue_up[TOR_TIER], UPLINK, TOR_TIER, true);
-                queues_nlp_nup[tor][agg][b]->setName("LS" + ntoa(tor) + "->US" + ntoa(agg) + "(" + ntoa(b) + ")");
                 //cout << queues_nlp_nup[tor][agg][b]->str() << endl;
                 //if (logfile) logfile->writeName(*(queues_nlp_nup[tor][agg]));
 
@@ -865,7 +839,6 @@ void FatTreeTopology::init_network(){
                 }
         
                 pipes_nlp_nup[tor][agg][b] = new Pipe(hop_latency, *_eventlist);
-                pipes_nlp_nup[tor][agg][b]->setName("Pipe-LS" + ntoa(tor) + "->US" + ntoa(agg) + "(" + ntoa(b) + ")");
                 //if (logfile) logfile->writeName(*(pipes_nlp_nup[tor][agg]));
         
                 if (ff){
@@ -900,13 +873,11 @@ void FatTreeTopology::init_network(){
                     }
                     assert(queues_nup_nc[agg][core][b] == NULL);
                     queues_nup_nc[agg][core][b] = alloc_queue(queueLogger, _queue_up[AGG_TIER], UPLINK, AGG_TIER);
-                    queues_nup_nc[agg][core][b]->setName("US" + ntoa(agg) + "->CS" + ntoa(core) + "(" + ntoa(b) + ")");
                     //cout << queues_nup_nc[agg][core][b]->str() << endl;
                     //if (logfile) logfile->writeName(*(queues_nup_nc[agg][core]));
         
                     simtime_picosec hop_latency = (_hop_latency == 0) ? _link_latencies[CORE_TIER] : _hop_latency;
                     pipes_nup_nc[agg][core][b] = new Pipe(hop_latency, *_eventlist);
-                    pipes_nup_nc[agg][core][b]->setName("Pipe-US" + ntoa(agg) + "->CS" + ntoa(core) + "(" + ntoa(b) + ")");
                     //if (logfile) logfile->writeName(*(pipes_nup_nc[agg][core]));
         
                     // Uplink
@@ -924,8 +895,6 @@ void FatTreeTopology::init_network(){
                         queues_nc_nup[core][agg][b] = alloc_queue(queueLogger, _queue_down[CORE_TIER], DOWNLINK, CORE_TIER);
                     }
         
-                    queues_nc_nup[core][agg][b]->setName("CS" + ntoa(core) + "->US" + ntoa(agg) + "(" + ntoa(b) + ")");
-
                     assert(switches_up[agg]->addPort(queues_nup_nc[agg][core][b]) < 64);
                     assert(switches_c[core]->addPort(queues_nc_nup[core][agg][b]) < 64);
                     queues_nup_nc[agg][core][b]->setRemoteEndpoint(switches_c[core]);
@@ -943,7 +912,6 @@ void FatTreeTopology::init_network(){
                     //if (logfile) logfile->writeName(*(queues_nc_nup[core][agg]));
             
                     pipes_nc_nup[core][agg][b] = new Pipe(hop_latency, *_eventlist);
-                    pipes_nc_nup[core][agg][b]->setName("Pipe-CS" + ntoa(core) + "->US" + ntoa(agg) + "(" + ntoa(b) + ")");
                     //if (logfile) logfile->writeName(*(pipes_nc_nup[core][agg]));
             
                     if (ff){
@@ -961,6 +929,8 @@ void FatTreeTopology::init_network(){
           }
           printf("\n");
           }*/
+
+    name_links();
     
     //init thresholds for lossless operation
     if (_qt==LOSSLESS) {
@@ -976,23 +946,187 @@ void FatTreeTopology::init_network(){
     }
 }
 
+// Naming every queue and pipe is mostly string formatting, and at 16K
+// hosts there are a few hundred thousand of them.  Each link is named
+// by the switch that owns it (a ToR names its host links and its
+// uplinks, an agg switch names its core links), so ranges of switches
+// can be named by separate threads without sharing anything.
+void FatTreeTopology::name_links() {
+    uint32_t threads = _build_threads;
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    threads = max(1u, min(threads, NTOR));
+    if (threads == 1) {
+        name_links(0, NTOR, 0, NAGG);
+        return;
+    }
+    vector<std::thread> workers;
+    for (uint32_t t = 0; t < threads; t++) {
+        workers.push_back(std::thread([this, t, threads]() {
+                    name_links(t * NTOR / threads, (t + 1) * NTOR / threads,
+                               t * NAGG / threads, (t + 1) * NAGG / threads);
+                }));
+    }
+    for (uint32_t t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+}
+
+// name the links owned by ToRs [tor_min, tor_max) and agg switches [agg_min, agg_max)
+void FatTreeTopology::name_links(uint32_t tor_min, uint32_t tor_max, uint32_t agg_min, uint32_t agg_max) {
+    uint32_t link_bundles = _radix_down[TOR_TIER]/_bundlesize[TOR_TIER];
+    for (uint32_t tor = tor_min; tor < tor_max; tor++) {
+        for (uint32_t l = 0; l < link_bundles; l++) {
+            uint32_t srv = tor * link_bundles + l;
+            for (uint32_t b = 0; b < _bundlesize[TOR_TIER]; b++) {
+                queues_nlp_ns[tor][srv][b]->setName("LS" + ntoa(tor) + "->DST" +ntoa(srv) + "(" + ntoa(b) + ")");
+                pipes_nlp_ns[tor][srv][b]->setName("Pipe-LS" + ntoa(tor)  + "->DST" + ntoa(srv) + "(" + ntoa(b) + ")");
+                name_queue(queues_ns_nlp[srv][tor][b], "SRC" + ntoa(srv) + "->LS" +ntoa(tor) + "(" + ntoa(b) + ")");
+                pipes_ns_nlp[srv][tor][b]->setName("Pipe-SRC" + ntoa(srv) + "->LS" + ntoa(tor) + "(" + ntoa(b) + ")");
+            }
+        }
+        for (uint32_t agg = 0; agg < NAGG; agg++) {
+            for (uint32_t b = 0; b < _bundlesize[AGG_TIER]; b++) {
+                if (!queues_nlp_nup[tor][agg][b])
+                    continue;
+                name_queue(queues_nup_nlp[agg][tor][b], "US" + ntoa(agg) + "->LS_" + ntoa(tor) + "(" + ntoa(b) + ")");
+                pipes_nup_nlp[agg][tor][b]->setName("Pipe-US" + ntoa(agg) + "->LS" + ntoa(tor) + "(" + ntoa(b) + ")");
+                name_queue(queues_nlp_nup[tor][agg][b], "LS" + ntoa(tor) + "->US" + ntoa(agg) + "(" + ntoa(b) + ")");
+                pipes_nlp_nup[tor][agg][b]->setName("Pipe-LS" + ntoa(tor) + "->US" + ntoa(agg) + "(" + ntoa(b) + ")");
+            }
+        }
+    }
+    if (_tiers == 3) {
+        for (uint32_t agg = agg_min; agg < agg_max; agg++) {
+            for (uint32_t core = 0; core < NCORE; core++) {
+                for (uint32_t b = 0; b < _bundlesize[CORE_TIER]; b++) {
+                    if (!queues_nup_nc[agg][core][b])
+                        continue;
+                    name_queue(queues_nup_nc[agg][core][b], "US" + ntoa(agg) + "->CS" + ntoa(core) + "(" + ntoa(b) + ")");
+                    pipes_nup_nc[agg][core][b]->setName("Pipe-US" + ntoa(agg) + "->CS" + ntoa(core) + "(" + ntoa(b) + ")");
+                    name_queue(queues_nc_nup[core][agg][b], "CS" + ntoa(core) + "->US" + ntoa(agg) + "(" + ntoa(b) + ")");
+                    pipes_nc_nup[core][agg][b]->setName("Pipe-CS" + ntoa(core) + "->US" + ntoa(agg) + "(" + ntoa(b) + ")");
+                }
+            }
+        }
+    }
+}
+
+// A LOSSLESS_INPUT queue's virtual input queue is created with it, in
+// init_network, and takes its name from the queue.  That is before the
+// queue is named, so rename the virtual queue here too.
+void FatTreeTopology::name_queue(BaseQueue* queue, const string& name) {
+    queue->setName(name);
+    if (_qt == LOSSLESS_INPUT || _qt == LOSSLESS_INPUT_ECN) {
+        LosslessInputQueue* vq = dynamic_cast<LosslessInputQueue*>(queue->getRemoteEndpoint());
+        assert(vq);
+        vq->nodename() = "VirtualQueue(" + queue->_name + ")";
+    }
+}
+
 void FatTreeTopology::add_failed_link(uint32_t type, uint32_t switch_id, uint32_t link_id){
     assert(type == FatTreeSwitch::AGG);
     assert(link_id < _radix_up[AGG_TIER]);
     assert(switch_id < NAGG);
     
-    uint32_t podpos = switch_id%(_agg_switches_per_pod);
-    uint32_t k = podpos * _agg_switches_per_pod + link_id;
-
-    // note: if bundlesize > 1, we only fail the first link in a bundle.
+    uint32_t b;
+    uint32_t k = uplink_core(switch_id, link_id, b);
     
-    assert(queues_nup_nc[switch_id][k][0]!=NULL && queues_nc_nup[k][switch_id][0]!=NULL );
-    queues_nup_nc[switch_id][k][0] = NULL;
-    queues_nc_nup[k][switch_id][0] = NULL;
+    assert(queues_nup_nc[switch_id][k][b]!=NULL && queues_nc_nup[k][switch_id][b]!=NULL );
+    queues_nup_nc[switch_id][k][b] = NULL;
+    queues_nc_nup[k][switch_id][b] = NULL;
 
-    assert(pipes_nup_nc[switch_id][k][0]!=NULL && pipes_nc_nup[k][switch_id][0]);
-    pipes_nup_nc[switch_id][k][0] = NULL;
-    pipes_nc_nup[k][switch_id][0] = NULL;
+    assert(pipes_nup_nc[switch_id][k][b]!=NULL && pipes_nc_nup[k][switch_id][b]);
+    pipes_nup_nc[switch_id][k][b] = NULL;
+    pipes_nc_nup[k][switch_id][b] = NULL;
+}
+
+// The core switch at the far end of an AGG's link_id'th uplink, and the
+// link's number in its bundle.  Uplinks are numbered bundle by bundle.
+uint32_t FatTreeTopology::uplink_core(uint32_t agg, uint32_t link_id, uint32_t& bundle) {
+    assert(_tiers == 3);
+    assert(agg < NAGG && link_id < _radix_up[AGG_TIER]);
+    uint32_t podpos = agg % _agg_switches_per_pod;
+    bundle = link_id % _bundlesize[CORE_TIER];
+    return (link_id / _bundlesize[CORE_TIER]) * _agg_switches_per_pod + podpos;
+}
+
+bool FatTreeTopology::core_reaches_pod(uint32_t core, uint32_t pod) {
+    uint32_t agg = MIN_POD_AGG_SWITCH(pod) + core % _agg_switches_per_pod;
+    for (uint32_t b = 0; b < _bundlesize[CORE_TIER]; b++) {
+        if (!pipes_nc_nup[core][agg][b]->failed())
+            return true;
+    }
+    return false;
+}
+
+void FatTreeTopology::fail_link(uint32_t agg, uint32_t link_id) {
+    set_link_failed(agg, link_id, true);
+}
+
+void FatTreeTopology::recover_link(uint32_t agg, uint32_t link_id) {
+    set_link_failed(agg, link_id, false);
+}
+
+void FatTreeTopology::set_link_failed(uint32_t agg, uint32_t link_id, bool failed) {
+    uint32_t b;
+    uint32_t core = uplink_core(agg, link_id, b);
+    Pipe* up = pipes_nup_nc[agg][core][b];
+    Pipe* down = pipes_nc_nup[core][agg][b];
+    assert(up && down); // not failed with add_failed_link
+    if (up->failed() == failed)
+        return;
+
+    uint32_t pod = AGG_SWITCH_POD_ID(agg);
+    bool reached = core_reaches_pod(core, pod);
+    up->setFailed(failed);
+    down->setFailed(failed);
+
+    FatTreeSwitch* agg_switch = (FatTreeSwitch*)switches_up[agg];
+    FatTreeSwitch* core_switch = (FatTreeSwitch*)switches_c[core];
+    if (failed) {
+        agg_switch->withdraw_port(queues_nup_nc[agg][core][b]);
+        core_switch->withdraw_port(queues_nc_nup[core][agg][b]);
+    } else {
+        agg_switch->restore_port(queues_nup_nc[agg][core][b]);
+        core_switch->restore_port(queues_nc_nup[core][agg][b]);
+    }
+
+    if (core_reaches_pod(core, pod) != reached) {
+        // the same AGG in every other pod goes through this core
+        uint32_t podpos = agg % _agg_switches_per_pod;
+        for (uint32_t p = 0; p < NPOD; p++) {
+            if (p != pod)
+                ((FatTreeSwitch*)switches_up[MIN_POD_AGG_SWITCH(p) + podpos])->update_pod_uproutes(pod);
+        }
+    }
+
+    for (size_t i = 0; i < _link_listeners.size(); i++) {
+        _link_listeners[i](up, failed);
+        _link_listeners[i](down, failed);
+    }
+}
+
+LinkFailureEvent::LinkFailureEvent(EventList& eventlist, FatTreeTopology* top, uint32_t agg, uint32_t link_id,
+                                   simtime_picosec start, simtime_picosec end)
+    : EventSource(eventlist, "link_failure"), _top(top), _agg(agg), _link_id(link_id), _end(end), _failed(false)
+{
+    assert(end == 0 || end > start);
+    eventlist.sourceIsPending(*this, start);
+}
+
+void LinkFailureEvent::doNextEvent() {
+    _failed = !_failed;
+    cout << (_failed ? "Failing" : "Recovering") << " link " << _link_id << " of AGG switch " << _agg
+         << " at " << timeAsUs(eventlist().now()) << "us" << endl;
+    if (_failed) {
+        _top->fail_link(_agg, _link_id);
+        if (_end)
+            eventlist().sourceIsPending(*this, _end);
+    } else {
+        _top->recover_link(_agg, _link_id);
+    }
 }
 
 
@@ -1007,10 +1141,15 @@ vector<const Route*>* FatTreeTopology::get_bidir_paths(uint32_t src, uint32_t de
     //Queue* pqueue = new Queue(_linkspeed, memFromPkt(FEEDER_BUFFER), *_eventlist, simplequeuelogger);
     //pqueue->setName("PQueue_" + ntoa(src) + "_" + ntoa(dest));
     //logfile->writeName(*pqueue);
+    // allocate forward routes at their final size, a queue and a pipe
+    // per link, plus an input queue per switch with lossless queues.
+    // Route sets may be held for the whole run.
+    bool lossless = _qt==LOSSLESS_INPUT || _qt==LOSSLESS_INPUT_ECN;
+
     if (HOST_POD_SWITCH(src)==HOST_POD_SWITCH(dest)){
   
         // forward path
-        routeout = new Route();
+        routeout = new Route(lossless ? 5 : 4);
         //routeout->push_back(pqueue);
         routeout->push_back(queues_ns_nlp[src][HOST_POD_SWITCH(src)][0]);
         routeout->push_back(pipes_ns_nlp[src][HOST_POD_SWITCH(src)][0]);
@@ -1062,7 +1201,7 @@ vector<const Route*>* FatTreeTopology::get_bidir_paths(uint32_t src, uint32_t de
                 
                     //upper is nup
       
-                    routeout = new Route();
+                    routeout = new Route(lossless ? 11 : 8);
       
                     routeout->push_back(queues_ns_nlp[src][HOST_POD_SWITCH(src)][0]);
                     routeout->push_back(pipes_ns_nlp[src][HOST_POD_SWITCH(src)][0]);
@@ -1142,7 +1281,7 @@ vector<const Route*>* FatTreeTopology::get_bidir_paths(uint32_t src, uint32_t de
                                 // note: no bundling supported between host and tor - just use link number 0
                                 //upper is nup
         
-                                routeout = new Route();
+                                routeout = new Route(lossless ? 17 : 12);
                                 //routeout->push_back(pqueue);
         
                                 routeout->push_back(queues_ns_nlp[src][HOST_POD_SWITCH(src)][0]);
@@ -1252,9 +1391,8 @@ void FatTreeTopology::count_queue(Queue* queue){
 int64_t FatTreeTopology::find_lp_switch(Queue* queue){
     //first check ns_nlp
     for (uint32_t srv=0;srv<NSRV;srv++)
-        for (uint32_t tor = 0; tor < NTOR; tor++)
-            if (queues_ns_nlp[srv][tor][0] == queue)
-                return tor;
+        if (queues_ns_nlp[srv][HOST_POD_SWITCH(srv)][0] == queue)
+            return HOST_POD_SWITCH(srv);
 
     //only count nup to nlp
     count_queue(queue);
@@ -1305,10 +1443,9 @@ int64_t FatTreeTopology::find_core_switch(Queue* queue){
 
 int64_t FatTreeTopology::find_destination(Queue* queue){
     //first check nlp_ns
-    for (uint32_t tor=0; tor<NTOR; tor++)
-        for (uint32_t srv = 0; srv<NSRV; srv++)
-            if (queues_nlp_ns[tor][srv][0]==queue)
-                return srv;
+    for (uint32_t srv = 0; srv<NSRV; srv++)
+        if (queues_nlp_ns[HOST_POD_SWITCH(srv)][srv][0]==queue)
+            return srv;
 
     return -1;
 }
@@ -1350,3 +1487,18 @@ void FatTreeTopology::add_switch_loggers(Logfile& log, simtime_picosec sample_pe
         switches_c[i]->add_logger(log, sample_period);
     }
 }
+
+void FatTreeTopology::add_aggregate_switch_logger(Logfile& log, simtime_picosec sample_period, uint32_t levels) {
+    AggregateQueueLoggerSampling* logger = new AggregateQueueLoggerSampling(sample_period, *_eventlist, levels);
+    log.addLogger(*logger);
+    // in a leaf-spine all the ToRs form one pod and the spines aren't in a pod
+    for (uint32_t i = 0; i < NTOR; i++) {
+        logger->addSwitch(*switches_lp[i], TOR_TIER, _tiers == 3 ? i/_tor_switches_per_pod : 0);
+    }
+    for (uint32_t i = 0; i < NAGG; i++) {
+        logger->addSwitch(*switches_up[i], AGG_TIER, _tiers == 3 ? (int)(i/_agg_switches_per_pod) : -1);
+    }
+    for (uint32_t i = 0; i < NCORE; i++) {
+        logger->addSwitch(*switches_c[i], CORE_TIER, -1);
+    }
+}
@@ -13,6 +13,7 @@
 #include "eventlist.h"
 #include "switch.h"
 #include <ostream>
+#include <functional>
 
 //#define N K*K*K/4
 
@@ -29,6 +30,49 @@ typedef enum {UPLINK, DOWNLINK} link_direction;
 #define AGG_TIER 1
 #define CORE_TIER 2
 
+// Queues or pipes on the links between hosts and their ToR.  Each host
+// hangs off exactly one ToR by one link (set_params rejects a ToR bundle
+// size above one), so rather than a dense ToR x host matrix
+// (most of it NULL, and far too big at 16K hosts) we keep one bundle per
+// host.  Indexing looks the same as the other link vectors -
+// [tor][host][b] for downlinks, [host][tor][b] for uplinks - but the ToR
+// given must be the host's own ToR.
+template <class T>
+class HostLinkTable {
+public:
+    class Row {
+    public:
+        Row(HostLinkTable* table, uint32_t index) : _table(table), _index(index) {}
+        T* operator[](uint32_t index) const {
+            if (_table->_tor_first)
+                return _table->bundle(_index, index);
+            else
+                return _table->bundle(index, _index);
+        }
+    private:
+        HostLinkTable* _table;
+        uint32_t _index;
+    };
+
+    HostLinkTable() : _hosts_per_tor(1), _bundlesize(1), _tor_first(false) {}
+    void resize(uint32_t hosts, uint32_t hosts_per_tor, uint32_t bundlesize, bool tor_first) {
+        _hosts_per_tor = hosts_per_tor;
+        _bundlesize = bundlesize;
+        _tor_first = tor_first;
+        _links.assign((size_t)hosts * bundlesize, NULL);
+    }
+    Row operator[](uint32_t index) {return Row(this, index);}
+private:
+    T* bundle(uint32_t tor, uint32_t host) {
+        assert(host / _hosts_per_tor == tor);
+        return &_links[(size_t)host * _bundlesize];
+    }
+    vector<T> _links;
+    uint32_t _hosts_per_tor;
+    uint32_t _bundlesize;
+    bool _tor_first;
+};
+
 class FatTreeTopology: public Topology{
 public:
     vector <Switch*> switches_lp;
@@ -38,17 +82,17 @@ public:
     // 3rd index is link number in bundle
     vector< vector< vector<Pipe*> > > pipes_nc_nup;
     vector< vector< vector<Pipe*> > > pipes_nup_nlp;
-    vector< vector< vector<Pipe*> > > pipes_nlp_ns;
+    HostLinkTable<Pipe*> pipes_nlp_ns;
     vector< vector< vector<BaseQueue*> > > queues_nc_nup;
     vector< vector< vector<BaseQueue*> > > queues_nup_nlp;
-    vector< vector< vector<BaseQueue*> > > queues_nlp_ns;
+    HostLinkTable<BaseQueue*> queues_nlp_ns;
 
     vector< vector< vector<Pipe*> > > pipes_nup_nc;
     vector< vector< vector<Pipe*> > > pipes_nlp_nup;
-    vector< vector< vector<Pipe*> > > pipes_ns_nlp;
+    HostLinkTable<Pipe*> pipes_ns_nlp;
     vector< vector< vector<BaseQueue*> > > queues_nup_nc;
     vector< vector< vector<BaseQueue*> > > queues_nlp_nup;
-    vector< vector< vector<BaseQueue*> > > queues_ns_nlp;
+    HostLinkTable<BaseQueue*> queues_ns_nlp;
   
     FirstFit* ff;
     QueueLoggerFactory* _logger_factory;
@@ -93,6 +137,8 @@ public:
     static void set_podsize(int hosts_per_pod) {
         _hosts_per_pod = hosts_per_pod;
     }
+    // threads used to name the links once they are built; 0 means one per core.
+    static void set_build_threads(uint32_t threads) {_build_threads = threads;}
 
     void count_queue(Queue*);
     void print_path(std::ofstream& paths,uint32_t src,const Route* route);
@@ -111,8 +157,25 @@ public:
 
     void add_failed_link(uint32_t type, uint32_t switch_id, uint32_t link_id);
 
+    // Fail or recover, while the simulation runs, the link between AGG
+    // switch agg and its link_id'th uplink (numbered as for
+    // add_failed_link), in both directions.  Packets sent onto a failed
+    // link are lost.  Only the FIB groups that use the link change: the
+    // AGG's uplinks, the core's routes down to the AGG's pod and, if
+    // that was the core's last link to the pod, the uplinks AGGs in
+    // other pods use to reach it.
+    void fail_link(uint32_t agg, uint32_t link_id);
+    void recover_link(uint32_t agg, uint32_t link_id);
+    bool core_reaches_pod(uint32_t core, uint32_t pod);
+
+    // Told about each pipe of a link that fails or recovers, so
+    // transports can stop or resume using source routes that cross it.
+    typedef std::function<void(const Pipe*, bool)> LinkListener;
+    void add_link_listener(LinkListener listener) {_link_listeners.push_back(listener);}
+
     // add loggers to record total queue size at switches
     virtual void add_switch_loggers(Logfile& log, simtime_picosec sample_period); 
+    virtual void add_aggregate_switch_logger(Logfile& log, simtime_picosec sample_period, uint32_t levels);
 
     uint32_t HOST_POD_SWITCH(uint32_t src){
         return src/_radix_down[TOR_TIER];
@@ -180,6 +243,12 @@ private:
     void set_params(uint32_t no_of_nodes);
     void set_custom_params(uint32_t no_of_nodes);
     void alloc_vectors();
+    void name_links();
+    void name_links(uint32_t tor_min, uint32_t tor_max, uint32_t agg_min, uint32_t agg_max);
+    void name_queue(BaseQueue* queue, const string& name);
+    uint32_t uplink_core(uint32_t agg, uint32_t link_id, uint32_t& bundle);
+    void set_link_failed(uint32_t agg, uint32_t link_id, bool failed);
+    vector<LinkListener> _link_listeners;
     uint32_t NCORE, NAGG, NTOR, NSRV, NPOD;
     uint32_t _tor_switches_per_pod, _agg_switches_per_pod;
     static uint32_t _tiers;
@@ -216,9 +285,24 @@ private:
 
     // number of hosts in a pod.  
     static uint32_t _hosts_per_pod; 
+
+    static uint32_t _build_threads;
     
     uint32_t _no_of_nodes;
     simtime_picosec _hop_latency,_switch_latency;
 };
 
+// Fails an AGG uplink at start, and recovers it at end unless end is 0.
+class LinkFailureEvent : public EventSource {
+public:
+    LinkFailureEvent(EventList& eventlist, FatTreeTopology* top, uint32_t agg, uint32_t link_id,
+                     simtime_picosec start, simtime_picosec end);
+    virtual void doNextEvent();
+private:
+    FatTreeTopology* _top;
+    uint32_t _agg, _link_id;
+    simtime_picosec _end;
+    bool _failed;
+};
+
 #endif
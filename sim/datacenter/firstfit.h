@@ -6,6 +6,7 @@
 #include "tcp.h"
 #include "randomqueue.h"
 #include "eventlist.h"
+#include "path_service.h"
 #include <list>
 #include <map>
 
@@ -27,13 +28,13 @@ struct flow_entry {
 
 class FirstFit: public EventSource{
 public:
-    FirstFit(simtime_picosec scanPeriod, EventList& eventlist,vector<const Route*>*** np = NULL);
+    FirstFit(simtime_picosec scanPeriod, EventList& eventlist,PathService* np = NULL);
     void doNextEvent();
 
     void run();
     void add_flow(int src,int dest,TcpSrc* flow);
     void add_queue(BaseQueue* queue);
-    vector<const Route*>*** net_paths;
+    PathService* net_paths;
 
 private:
     map<TcpSrc*,flow_entry*> flow_counters;
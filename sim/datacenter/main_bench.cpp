@@ -0,0 +1,310 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+// Micro benchmarks for the parts of the simulator every run depends
+// on: the eventlist, queue and pipe forwarding, and FatTreeSwitch
+// forwarding, plus the EQDS receiver's SACK scoreboard and per packet
+// type forwarding cost.  Each benchmark is deterministic for a given seed and
+// count, and prints the same "Events: Packet hops:" and "Peak RSS:" lines
+// as the main simulators, so tests/benchmarks.py can time them all the
+// same way.
+#include <string.h>
+#include <chrono>
+#include "network.h"
+#include "eventlist.h"
+#include "memstats.h"
+#include "queue.h"
+#include "pipe.h"
+#include "eqdspacket.h"
+#include "ndppacket.h"
+#include "tcppacket.h"
+#include "rocepacket.h"
+#include "hpccpacket.h"
+#include "fat_tree_topology.h"
+#include "fat_tree_switch.h"
+#include "eqds.h"
+
+#include "main.h"
+
+EventList eventlist;
+
+void exit_error(char* progr) {
+    cout << "Usage " << progr << " -bench eventlist|pipe_queue|switch_ecmp|switch_ar|sack|entropy|forward\n\t[-count n] events or packets per source, default 1000\n\t[-seed random_seed]" << endl;
+    exit(1);
+}
+
+// Reschedules itself count times at a fixed period.
+class TickSource : public EventSource {
+public:
+    TickSource(EventList& eventlist, simtime_picosec period, uint32_t count)
+        : EventSource(eventlist, "tick"), _period(period), _remaining(count) {}
+    virtual void doNextEvent() {
+        if (--_remaining > 0)
+            _eventlist.sourceIsPendingRel(*this, _period);
+    }
+private:
+    simtime_picosec _period;
+    uint32_t _remaining;
+};
+
+// Data packet constructors for the packet types the forward benchmark
+// compares.
+typedef Packet* (*PacketMaker)(PacketFlow& flow, const Route& route, uint64_t seqno, uint32_t dst);
+
+Packet* make_eqds(PacketFlow& flow, const Route& route, uint64_t seqno, uint32_t dst) {
+    return EqdsDataPacket::newpkt(flow, route, seqno, Packet::data_packet_size(),
+                                  EqdsDataPacket::DATA_PULL, 0, false, dst);
+}
+
+Packet* make_ndp(PacketFlow& flow, const Route& route, uint64_t seqno, uint32_t dst) {
+    return NdpPacket::newpkt(flow, route, seqno, 0, Packet::data_packet_size(), false, 1, false, dst);
+}
+
+Packet* make_tcp(PacketFlow& flow, const Route& route, uint64_t seqno, uint32_t dst) {
+    return TcpPacket::newpkt(flow, route, seqno, Packet::data_packet_size());
+}
+
+Packet* make_roce(PacketFlow& flow, const Route& route, uint64_t seqno, uint32_t dst) {
+    return RocePacket::newpkt(flow, route, seqno, Packet::data_packet_size(), false, false, dst);
+}
+
+Packet* make_hpcc(PacketFlow& flow, const Route& route, uint64_t seqno, uint32_t dst) {
+    return HPCCPacket::newpkt(flow, route, seqno, Packet::data_packet_size(), false, false, dst);
+}
+
+// Sends count packets along a route, one every gap, to dst.  Each
+// packet gets a random pathid so switches spread them over all paths.
+class PacedSource : public EventSource {
+public:
+    PacedSource(EventList& eventlist, Route* route, uint32_t dst, simtime_picosec gap, uint32_t count,
+                PacketMaker maker = make_eqds)
+        : EventSource(eventlist, "paced"), _flow(NULL), _route(route), _dst(dst),
+          _gap(gap), _remaining(count), _seqno(0), _maker(maker) {}
+    virtual void doNextEvent() {
+        Packet* p = _maker(_flow, *_route, _seqno, _dst);
+        _seqno += Packet::data_packet_size();
+        p->set_pathid(random());
+        p->sendOn();
+        if (--_remaining > 0)
+            _eventlist.sourceIsPendingRel(*this, _gap);
+    }
+    PacketFlow _flow;
+private:
+    Route* _route;
+    uint32_t _dst;
+    simtime_picosec _gap;
+    uint32_t _remaining;
+    uint64_t _seqno;
+    PacketMaker _maker;
+};
+
+class BenchSink : public PacketSink {
+public:
+    BenchSink() : _received(0), _nodename("benchsink") {}
+    virtual void receivePacket(Packet& pkt) {
+        _received++;
+        pkt.free();
+    }
+    virtual const string& nodename() {return _nodename;}
+    uint64_t _received;
+private:
+    string _nodename;
+};
+
+// 10000 sources with periods between 1ns and 100ns, so the pending
+// set stays large and events from different sources interleave.
+void bench_eventlist(uint32_t count) {
+    for (uint32_t i = 0; i < 10000; i++) {
+        TickSource* t = new TickSource(eventlist, timeFromNs(1 + random() % 100), count);
+        eventlist.sourceIsPendingRel(*t, timeFromNs(random() % 100));
+    }
+}
+
+// 16 independent chains of 8 queue/pipe hops, each fed at line rate.
+void bench_pipe_queue(uint32_t count, PacketMaker maker = make_eqds) {
+    linkspeed_bps linkspeed = speedFromGbps(100);
+    simtime_picosec gap = (simtime_picosec)Packet::data_packet_size() * 8 * 1000000000000ULL / linkspeed;
+    for (uint32_t c = 0; c < 16; c++) {
+        Route* route = new Route();
+        for (uint32_t h = 0; h < 8; h++) {
+            route->push_back(new Queue(linkspeed, memFromPkt(100), eventlist, NULL));
+            route->push_back(new Pipe(timeFromUs(1.0), eventlist));
+        }
+        route->push_back(new BenchSink());
+        PacedSource* src = new PacedSource(eventlist, route, 0, gap, count, maker);
+        eventlist.sourceIsPendingRel(*src, timeFromNs(c));
+    }
+}
+
+// The pipe_queue benchmark run once for each data packet type, to
+// compare what their size and layout cost per hop.  Runs the eventlist
+// itself, so it can time each packet type separately.
+void bench_forward(uint32_t count) {
+    struct {const char* name; PacketMaker maker; size_t size;} types[] = {
+        {"eqds", make_eqds, sizeof(EqdsDataPacket)},
+        {"ndp", make_ndp, sizeof(NdpPacket)},
+        {"tcp", make_tcp, sizeof(TcpPacket)},
+        {"roce", make_roce, sizeof(RocePacket)},
+        {"hpcc", make_hpcc, sizeof(HPCCPacket)},
+    };
+    for (auto& t : types) {
+        uint64_t hops = Pipe::_packets_carried;
+        bench_pipe_queue(count, t.maker);
+        auto start = chrono::steady_clock::now();
+        while (eventlist.doNextEvent()) {
+        }
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        hops = Pipe::_packets_carried - hops;
+        cout << "Forward " << t.name << " (" << t.size << " bytes): " << ns / hops << " ns/hop" << endl;
+    }
+    cout << "Events: " << EventList::eventsRun() << " Packet hops: " << Pipe::_packets_carried << endl;
+}
+
+// Every host of a 128 host, 3-tier fat tree sends to a host in another
+// pod at 80% of line rate, so packets cross the core and ECMP
+// collisions build some queues.
+void bench_switch(uint32_t count) {
+    linkspeed_bps linkspeed = speedFromGbps(100);
+    FatTreeTopology::set_tiers(3);
+    FatTreeTopology* top = new FatTreeTopology(128, linkspeed, memFromPkt(100), NULL,
+                                               &eventlist, NULL, COMPOSITE, timeFromUs(1.0), 0);
+    uint32_t hosts = top->no_of_nodes();
+    simtime_picosec gap = (simtime_picosec)Packet::data_packet_size() * 8 * 1000000000000ULL / linkspeed * 5 / 4;
+    for (uint32_t src = 0; src < hosts; src++) {
+        uint32_t dst = (src + hosts / 2) % hosts;
+        uint32_t tor = top->HOST_POD_SWITCH(src);
+        Route* srctotor = new Route();
+        srctotor->push_back(top->queues_ns_nlp[src][tor][0]);
+        srctotor->push_back(top->pipes_ns_nlp[src][tor][0]);
+        srctotor->push_back(top->queues_ns_nlp[src][tor][0]->getRemoteEndpoint());
+
+        PacedSource* ps = new PacedSource(eventlist, srctotor, dst, gap, count);
+        top->switches_lp[top->HOST_POD_SWITCH(dst)]->addHostPort(dst, ps->_flow.flow_id(), new BenchSink());
+        eventlist.sourceIsPendingRel(*ps, timeFromNs(random() % 1000));
+    }
+}
+
+// count*1000 packets arrive at an EqdsSink scoreboard, shuffled within
+// windows of 64 as if sprayed over paths with different delays, and
+// each arrival is SACKed the way EqdsSink::processData does it.
+// Doesn't use the eventlist, so it reports the ACKs as events.
+void bench_sack(uint32_t count) {
+    EqdsScoreboard<eqdsMaxInFlightPkts>* scoreboard = new EqdsScoreboard<eqdsMaxInFlightPkts>();
+    uint64_t packets = (uint64_t)count * 1000;
+    vector<uint64_t> arrivals(packets);
+    for (uint64_t i = 0; i < packets; i++)
+        arrivals[i] = i;
+    for (uint64_t w = 0; w + 64 <= packets; w += 64)
+        for (uint64_t i = 63; i > 0; i--)
+            swap(arrivals[w + i], arrivals[w + random() % (i + 1)]);
+
+    auto start = chrono::steady_clock::now();
+    uint64_t expected = 0, acks = 0, checksum = 0;
+    for (uint64_t i = 0; i < packets; i++) {
+        uint64_t epsn = arrivals[i];
+        if (epsn == expected) {
+            while (scoreboard->received(++expected))
+                scoreboard->clear(expected);
+        } else {
+            scoreboard->setReceived(epsn);
+        }
+        uint64_t ref = max((int64_t)epsn - 63, (int64_t)(expected + 1));
+        uint64_t bitmap = scoreboard->bits(ref);
+        scoreboard->countSacks(ref, bitmap & ~(uint64_t)1);
+        checksum += bitmap;
+        acks++;
+    }
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    cout << "SACK: " << ns / acks << " ns/ack, checksum " << checksum << endl;
+    cout << "Events: " << acks << " Packet hops: 0" << endl;
+}
+
+// count*1000 EVs are chosen by an EqdsSrc entropy selector for each of
+// several path entropy sizes, with every few EVs reported back as
+// congested, as trimmed or ECN-marked packets would be.  Doesn't use
+// the eventlist, so it reports the EVs chosen as events.
+void bench_entropy(uint32_t count) {
+    uint64_t selections = (uint64_t)count * 1000;
+    vector<uint8_t> congested(selections);
+    for (uint64_t i = 0; i < selections; i++)
+        congested[i] = random() % 2 == 0;
+
+    uint64_t events = 0, checksum = 0;
+    for (uint16_t size : {8, 256, 4096}) {
+        EqdsEntropySelector evs;
+        RngStream rng(size);
+        evs.init(size, 1, &rng);
+        auto start = chrono::steady_clock::now();
+        for (uint64_t i = 0; i < selections; i++) {
+            uint16_t ev = evs.next();
+            if (congested[i])
+                evs.penalize(ev, 1);
+            checksum += ev;
+        }
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        cout << "Entropy size " << size << ": " << ns / selections << " ns/ev" << endl;
+        events += selections;
+    }
+    cout << "Checksum " << checksum << endl;
+    cout << "Events: " << events << " Packet hops: 0" << endl;
+}
+
+int main(int argc, char **argv) {
+    char* bench = NULL;
+    uint32_t count = 1000;
+    int seed = 13;
+    int i = 1;
+
+    while (i<argc) {
+        if (!strcmp(argv[i],"-bench")) {
+            bench = argv[i+1];
+            i++;
+        } else if (!strcmp(argv[i],"-count")) {
+            count = atoi(argv[i+1]);
+            i++;
+        } else if (!strcmp(argv[i],"-seed")) {
+            seed = atoi(argv[i+1]);
+            i++;
+        } else {
+            exit_error(argv[0]);
+        }
+        i++;
+    }
+    if (bench == NULL || count == 0) {
+        exit_error(argv[0]);
+    }
+    srand(seed);
+    srandom(seed);
+
+    // the sack, entropy and forward benchmarks don't use the eventlist,
+    // and print their own counts
+    bool simulate = true;
+    if (!strcmp(bench, "eventlist")) {
+        bench_eventlist(count);
+    } else if (!strcmp(bench, "pipe_queue")) {
+        bench_pipe_queue(count);
+    } else if (!strcmp(bench, "switch_ecmp")) {
+        FatTreeSwitch::set_strategy(FatTreeSwitch::ECMP);
+        bench_switch(count);
+    } else if (!strcmp(bench, "switch_ar")) {
+        FatTreeSwitch::set_strategy(FatTreeSwitch::ADAPTIVE_ROUTING);
+        bench_switch(count);
+    } else if (!strcmp(bench, "sack")) {
+        bench_sack(count);
+        simulate = false;
+    } else if (!strcmp(bench, "entropy")) {
+        bench_entropy(count);
+        simulate = false;
+    } else if (!strcmp(bench, "forward")) {
+        bench_forward(count);
+        simulate = false;
+    } else {
+        exit_error(argv[0]);
+    }
+
+    if (simulate) {
+        while (eventlist.doNextEvent()) {
+        }
+        cout << "Events: " << EventList::eventsRun() << " Packet hops: " << Pipe::_packets_carried << endl;
+    }
+    cout << "Peak RSS: " << MemoryStats::peakRss()/1024 << " KB" << endl;
+    return 0;
+}
@@ -15,8 +15,10 @@
 #include "tcp.h"
 #include "tcp_transfer.h"
 #include "dragon_fly_plus_topology.h"
+#include "dragon_fly_topology.h"
 #include "firstfit.h"
 #include <list>
+#include <functional>
 
 #define PRINT_PATHS 1
 
@@ -29,7 +31,7 @@ uint32_t subflow_count = 1;
 EventList eventlist;
 
 void exit_error(char* progr) {
-    cout << "Usage " << progr << " [UNCOUPLED(DEFAULT)|COUPLED_INC|FULLY_COUPLED|COUPLED_EPSILON] [epsilon][COUPLED_SCALABLE_TCP]" << endl;
+    cout << "Usage " << progr << " [-nodes n] [-conns n] [-end us] [-cwnd n] [-o logfile] [-topology dragonfly_plus|dragonfly] [-routing source|minimal|valiant|ugal|par] [-ugal_threshold bytes] [UNCOUPLED(DEFAULT)|COUPLED_INC|FULLY_COUPLED|COUPLED_EPSILON] [epsilon][COUPLED_SCALABLE_TCP]" << endl;
     exit(1);
 }
 
@@ -56,6 +58,8 @@ int main(int argc, char **argv) {
     
     string filename = "logout.dat";
     uint32_t cwnd = 15;
+    bool hop_by_hop = false;
+    bool plus = true;
     
     int i = 1;
     while (i < argc) {
@@ -74,6 +78,40 @@ int main(int argc, char **argv) {
             cwnd = atoi(argv[i+1]);
             cout << "cwnd " << cwnd << endl;
             i++;
+        } else if (!strcmp(argv[i], "-end")) {
+            eventlist.setEndtime(timeFromUs((uint32_t)atoi(argv[i+1])));
+            cout << "endtime(us) " << argv[i+1] << endl;
+            i++;
+        } else if (!strcmp(argv[i], "-topology")) {
+            if (!strcmp(argv[i+1], "dragonfly_plus"))
+                plus = true;
+            else if (!strcmp(argv[i+1], "dragonfly"))
+                plus = false;
+            else
+                exit_error(argv[0]);
+            cout << "topology " << argv[i+1] << endl;
+            i++;
+        } else if (!strcmp(argv[i], "-routing")) {
+            // anything but source routing is done hop by hop in the switches
+            hop_by_hop = true;
+            if (!strcmp(argv[i+1], "source"))
+                hop_by_hop = false;
+            else if (!strcmp(argv[i+1], "minimal"))
+                DragonFlySwitch::_routing = DragonFlySwitch::MINIMAL;
+            else if (!strcmp(argv[i+1], "valiant"))
+                DragonFlySwitch::_routing = DragonFlySwitch::VALIANT;
+            else if (!strcmp(argv[i+1], "ugal"))
+                DragonFlySwitch::_routing = DragonFlySwitch::UGAL;
+            else if (!strcmp(argv[i+1], "par"))
+                DragonFlySwitch::_routing = DragonFlySwitch::PAR;
+            else
+                exit_error(argv[0]);
+            cout << "routing " << argv[i+1] << endl;
+            i++;
+        } else if (!strcmp(argv[i], "-ugal_threshold")) {
+            DragonFlySwitch::_ugal_threshold = atoi(argv[i+1]);
+            cout << "ugal_threshold " << DragonFlySwitch::_ugal_threshold << endl;
+            i++;
         } else if (!strcmp(argv[i], "UNCOUPLED"))
             algo = UNCOUPLED;
         else if (!strcmp(argv[i], "COUPLED_INC"))
@@ -109,15 +147,35 @@ int main(int argc, char **argv) {
     TcpSinkLoggerSampling sinkLogger = TcpSinkLoggerSampling(timeFromMs(1000), eventlist);
     logfile.addLogger(sinkLogger);
     
-    // Create DragonFly Plus topology
-    // Using balanced configuration: p = h, a = 2h, h_plus = h/2
-    uint32_t p = (uint32_t)ceil(sqrt(no_of_nodes/4));  // Hosts per router
-    uint32_t h = p;                                     // Global links per router
-    uint32_t a = 2 * p;                                // Routers per group
-    uint32_t h_plus = h/2;                             // Additional global links
-    
-    // Create DragonFly Plus topology with large queue size (2000 packets)
-    DragonFlyPlusTopology* top = new DragonFlyPlusTopology(p, h, a, h_plus, memFromPkt(2000), &logfile, &eventlist, RANDOM, timeFromUs(RTT));
+    Topology* top;
+    // the router each host hangs off, for hop-by-hop routing
+    std::function<Switch*(uint32_t)> host_router;
+    if (plus) {
+        // Create DragonFly Plus topology
+        // Using balanced configuration: p = h, a = 2h, h_plus = h/2
+        uint32_t p = (uint32_t)ceil(sqrt(no_of_nodes/4));  // Hosts per router
+        uint32_t h = p;                                     // Global links per router
+        uint32_t a = 2 * p;                                // Routers per group
+        uint32_t h_plus = h/2;                             // Additional global links
+
+        // Create DragonFly Plus topology with large queue size (2000 packets)
+        DragonFlyPlusTopology* dfp = new DragonFlyPlusTopology(p, h, a, h_plus, memFromPkt(2000), &logfile, &eventlist, RANDOM, timeFromUs(RTT), hop_by_hop);
+        host_router = [dfp](uint32_t host) {return dfp->switches[dfp->host_router(host)];};
+        top = dfp;
+    } else {
+        if (!hop_by_hop) {
+            // DragonFlyTopology only builds the routers' tables, not source routes
+            cerr << "Error: -topology dragonfly needs a hop-by-hop -routing mode" << endl;
+            exit(1);
+        }
+        // the smallest balanced DragonFly (p = h, a = 2h) with enough hosts
+        uint32_t h = 1;
+        while (2*h*h*(2*h*h+1) < no_of_nodes)
+            h++;
+        DragonFlyTopology* df = new DragonFlyTopology(h, 2*h, h, memFromPkt(2000), &logfile, &eventlist, RANDOM, timeFromUs(RTT), hop_by_hop);
+        host_router = [df](uint32_t host) {return df->switches[df->host_router(host)];};
+        top = df;
+    }
     
     // Initialize TCP endpoints
     TcpRtxTimerScanner tcpRtxScanner(timeFromMs(10), eventlist);
@@ -242,6 +300,12 @@ int main(int argc, char **argv) {
         tcpSrc->set_dst(dst);
         tcpSnk->set_dst(src);
         
+        if (hop_by_hop) {
+            // register src and snk to receive packets from their routers
+            host_router(src)->addHostPort(src, tcpSrc->getFlowId(), tcpSrc);
+            host_router(dst)->addHostPort(dst, tcpSrc->getFlowId(), tcpSnk);
+        }
+        
 #ifdef PACKET_SCATTER
         tcpSrc->set_paths(routes);
 #endif
@@ -251,5 +315,8 @@ int main(int argc, char **argv) {
     while (eventlist.doNextEvent()) {
     }
     
+    if (hop_by_hop)
+        DragonFlySwitch::report(cout);
+    
     return 0;
 } 
\ No newline at end of file
@@ -8,13 +8,18 @@
 #include "network.h"
 #include "pipe.h"
 #include "eventlist.h"
+#include "memstats.h"
 #include "logfile.h"
 #include "eqds_logger.h"
 #include "clock.h"
+#include "metrics.h"
 #include "eqds.h"
+#include "fct_stats.h"
 #include "compositequeue.h"
 #include "topology.h"
 #include "connection_matrix.h"
+#include "workload.h"
+#include "collective.h"
 
 #include "fat_tree_topology.h"
 #include "fat_tree_switch.h"
@@ -34,10 +39,141 @@ int DEFAULT_NODES = 128;
 EventList eventlist;
 
 void exit_error(char* progr) {
-    cout << "Usage " << progr << " [-nodes N]\n\t[-conns C]\n\t[-cwnd cwnd_size]\n\t[-q queue_size]\n\t[-oversubscribed_cc] Use receiver-driven AIMD to reduce total window when trims are not last hop\n\t[-queue_type composite|random|lossless|lossless_input|]\n\t[-tm traffic_matrix_file]\n\t[-strat route_strategy (single,rand,perm,pull,ecmp,\n\tecmp_host path_count,ecmp_ar,ecmp_rr,\n\tecmp_host_ar ar_thresh)]\n\t[-log log_level]\n\t[-seed random_seed]\n\t[-end end_time_in_usec]\n\t[-mtu MTU]\n\t[-hop_latency x] per hop wire latency in us,default 1\n\t[-switch_latency x] switching latency in us, default 0\n\t[-host_queue_type  swift|prio|fair_prio]\n\t[-logtime dt] sample time for sinklogger, etc" << endl;
+    cout << "Usage " << progr << " [-nodes N]\n\t[-conns C]\n\t[-cwnd cwnd_size]\n\t[-q queue_size]\n\t[-oversubscribed_cc] Use receiver-driven AIMD to reduce total window when trims are not last hop\n\t[-queue_type composite|random|lossless|lossless_input|]\n\t[-tm traffic_matrix_file]\n\t[-strat route_strategy (single,rand,perm,pull,ecmp,\n\tecmp_host path_count,ecmp_ar,ecmp_rr,\n\tecmp_host_ar ar_thresh)]\n\t[-log log_level]\n\t[-seed random_seed]\n\t[-end end_time_in_usec] 0 to run until the flows finish, with -elide_idle\n\t[-elide_idle] skip clock, sampler and timer scanner events while the network is idle\n\t[-mtu MTU]\n\t[-hop_latency x] per hop wire latency in us,default 1\n\t[-switch_latency x] switching latency in us, default 0\n\t[-host_queue_type  swift|prio|fair_prio]\n\t[-logtime dt] sample time for sinklogger, etc\n\t[-fct_stats file] write FCT percentiles to file instead of logging flow events\n\t[-log_index dt] write a time index of the logfile with dt us buckets\n\t[-memstats n] report memory use by subsystem every n clock ticks and at exit\n\t[-metrics path|port] serve live metrics on a Unix socket or a TCP port on 127.0.0.1\n\t[-metrics_period dt] simulated time between metrics snapshots in us, default 10\n\t[-flowlet_table n] flowlet table slots per switch (power of two), default 4096\n\t[-flowlet_age dt] flowlet table aging time in us, default 0 (never)\n\t[-ar_ranked] pick adaptive routing choices from incrementally ranked ports\n\t[-workload cdf_file] generate flows with sizes from this CDF instead of reading a traffic matrix\n\t[-load f] offered load per host for -workload, fraction of linkspeed, default 0.5\n\t[-locality rack pod] fraction of generated flows within the rack and within the pod, default 0 0\n\t[-dump_cm file] write the generated flows as a connection matrix\n\t[-collective ring|tree|butterfly|alltoall] run a collective instead of reading a traffic matrix\n\t[-coll_size bytes] collective buffer size per rank, default 1000000\n\t[-coll_ranks n] ranks per collective group of consecutive hosts, default all hosts\n\t[-coll_parallel n] alltoall flows in progress per rank, default 1" << endl;
     exit(1);
 }
 
+// Sets up the EQDS source and sink for a connection: those in the
+// connection matrix before the run, and those from the workload
+// generator or a collective as they arrive.
+class EqdsFlowBuilder : public WorkloadTarget {
+public:
+    EqdsFlowBuilder(EventList& eventlist, FatTreeTopology* top, ConnectionMatrix* conns,
+                    RouteStrategy route_strategy, uint32_t cwnd,
+                    vector<EqdsPullPacer*>& pacers, vector<EqdsNIC*>& nics, Logfile& logfile,
+                    TrafficLogger* traffic_logger, FlowEventLogger* event_logger,
+                    EqdsSinkLoggerSampling* sink_logger)
+        : _eventlist(eventlist), _top(top), _conns(conns), _route_strategy(route_strategy),
+          _cwnd(cwnd), _pacers(pacers), _nics(nics), _logfile(logfile),
+          _traffic_logger(traffic_logger), _event_logger(event_logger), _sink_logger(sink_logger) {}
+
+    EqdsSrc* build(connection* crt);
+    virtual void newFlow(connection& c, Trigger* done) {
+        EqdsSrc* src = build(&c);
+        if (done)
+            src->setEndTrigger(*done);
+    }
+
+    const vector<EqdsSrc*>& srcs() const {return _srcs;}
+private:
+    EventList& _eventlist;
+    FatTreeTopology* _top;
+    ConnectionMatrix* _conns;
+    RouteStrategy _route_strategy;
+    uint32_t _cwnd;
+    vector<EqdsPullPacer*>& _pacers;
+    vector<EqdsNIC*>& _nics;
+    Logfile& _logfile;
+    TrafficLogger* _traffic_logger;
+    FlowEventLogger* _event_logger;
+    EqdsSinkLoggerSampling* _sink_logger;
+
+    vector<EqdsSrc*> _srcs;
+    map<flowid_t, TriggerTarget*> _flowmap;
+};
+
+EqdsSrc* EqdsFlowBuilder::build(connection* crt) {
+    int src = crt->src;
+    int dest = crt->dst;
+    //cout << "Connection " << crt->src << "->" <<crt->dst << " starting at " << crt->start << " size " << crt->size << endl;
+
+    EqdsSrc* eqds_src = new EqdsSrc(_traffic_logger, _eventlist, *_nics.at(src));
+    eqds_src->setCwnd(_cwnd*Packet::data_packet_size());
+    _srcs.push_back(eqds_src);
+    eqds_src->setDst(dest);
+
+    if (_event_logger) {
+        eqds_src->logFlowEvents(*_event_logger);
+    }
+    
+    EqdsSink* eqds_snk = new EqdsSink(NULL,_pacers[dest],*_nics.at(dest));
+    eqds_src->setName("Eqds_" + ntoa(src) + "_" + ntoa(dest));
+    _logfile.writeName(*eqds_src);
+    eqds_snk->setSrc(src);
+                    
+    eqds_snk->setName("Eqds_sink_" + ntoa(src) + "_" + ntoa(dest));
+    _logfile.writeName(*eqds_snk);
+
+    if (crt->flowid) {
+        eqds_src->setFlowId(crt->flowid);
+        eqds_snk->setFlowId(crt->flowid);
+        assert(_flowmap.find(crt->flowid) == _flowmap.end()); // don't have dups
+        _flowmap[crt->flowid] = eqds_src;
+    }
+                    
+    if (crt->size>0){
+        eqds_src->setFlowsize(crt->size);
+    }
+
+    if (crt->trigger) {
+        Trigger* trig = _conns->getTrigger(crt->trigger, _eventlist);
+        trig->add_target(*eqds_src);
+    }
+    if (crt->send_done_trigger) {
+        Trigger* trig = _conns->getTrigger(crt->send_done_trigger, _eventlist);
+        eqds_src->setEndTrigger(*trig);
+    }
+
+
+    if (crt->recv_done_trigger) {
+        Trigger* trig = _conns->getTrigger(crt->recv_done_trigger, _eventlist);
+        eqds_snk->setEndTrigger(*trig);
+    }
+
+    //eqds_snk->set_priority(crt->priority);
+                    
+    //EqdsRtxScanner.registerEqds(*EqdsSrc);
+
+    switch (_route_strategy) {
+    case ECMP_FIB:
+    case ECMP_FIB_ECN:
+    case REACTIVE_ECN:
+        {
+            Route* srctotor = new Route();
+            srctotor->push_back(_top->queues_ns_nlp[src][_top->HOST_POD_SWITCH(src)][0]);
+            srctotor->push_back(_top->pipes_ns_nlp[src][_top->HOST_POD_SWITCH(src)][0]);
+            srctotor->push_back(_top->queues_ns_nlp[src][_top->HOST_POD_SWITCH(src)][0]->getRemoteEndpoint());
+
+            Route* dsttotor = new Route();
+            dsttotor->push_back(_top->queues_ns_nlp[dest][_top->HOST_POD_SWITCH(dest)][0]);
+            dsttotor->push_back(_top->pipes_ns_nlp[dest][_top->HOST_POD_SWITCH(dest)][0]);
+            dsttotor->push_back(_top->queues_ns_nlp[dest][_top->HOST_POD_SWITCH(dest)][0]->getRemoteEndpoint());
+
+
+            eqds_src->connect(*srctotor, *dsttotor, *eqds_snk, crt->start);
+            //eqds_src->setPaths(path_entropy_size);
+            //eqds_snk->setPaths(path_entropy_size);
+
+            //register src and snk to receive packets from their respective TORs. 
+            assert(_top->switches_lp[_top->HOST_POD_SWITCH(src)]);
+            assert(_top->switches_lp[_top->HOST_POD_SWITCH(src)]);
+            _top->switches_lp[_top->HOST_POD_SWITCH(src)]->addHostPort(src,eqds_snk->flowId(),eqds_src);
+            _top->switches_lp[_top->HOST_POD_SWITCH(dest)]->addHostPort(dest,eqds_src->flowId(),eqds_snk);
+            break;
+        }
+    default:
+        abort();
+    }
+
+    // set up the triggers
+    // xxx
+
+    if (_sink_logger) {
+        _sink_logger->monitorSink(eqds_snk);
+    }
+    return eqds_src;
+}
+
 int main(int argc, char **argv) {
     Clock c(timeFromSec(5 / 100.), eventlist);
     mem_b queuesize = DEFAULT_QUEUE_SIZE;
@@ -59,6 +195,7 @@ int main(int argc, char **argv) {
     bool log_tor_upqueue = false;
     bool log_traffic = false;
     bool log_switches = false;
+    uint32_t log_switch_agg = 0;
     bool log_queue_usage = false;
     double ecn_thresh = 0.5; // default marking threshold for ECN load balancing
 
@@ -72,6 +209,7 @@ int main(int argc, char **argv) {
 
     filename << "logout.dat";
     int end_time = 1000;//in microseconds
+    bool elide_idle = false;
 
     //unsure how to set this. 
     queue_type snd_type = FAIR_PRIO;
@@ -81,6 +219,23 @@ int main(int argc, char **argv) {
 
     char* tm_file = NULL;
     char* topo_file = NULL;
+    char* fct_file = NULL;
+    simtime_picosec log_index_width = 0;
+    int memstats_ticks = -1;
+    char* metrics_address = NULL;
+    double metrics_period = 10;
+
+    char* workload_cdf = NULL;
+    FlowSizeCdf sizes;
+    double workload_load = 0.5;
+    double rack_locality = 0, pod_locality = 0;
+    char* dump_file = NULL;
+
+    bool collective = false;
+    Collective::algorithm collective_algo = Collective::RING;
+    uint64_t collective_bytes = 1000000;
+    uint32_t collective_ranks = 0;
+    uint32_t collective_parallel = 1;
 
     while (i<argc) {
         if (!strcmp(argv[i],"-o")) {
@@ -160,6 +315,13 @@ int main(int argc, char **argv) {
             } else if (!strcmp(argv[i+1], "switch")) {
                 cout << "logging total switch queues\n";
                 log_switches = true;
+            } else if (!strcmp(argv[i+1], "switch_agg")) {
+                cout << "logging aggregate switch, tier and pod queues\n";
+                log_switch_agg |= AggregateQueueLoggerSampling::SWITCH | AggregateQueueLoggerSampling::TIER
+                    | AggregateQueueLoggerSampling::POD;
+            } else if (!strcmp(argv[i+1], "port_agg")) {
+                cout << "logging aggregate port queues\n";
+                log_switch_agg |= AggregateQueueLoggerSampling::PORT;
             } else if (!strcmp(argv[i+1], "traffic")) {
                 cout << "logging traffic\n";
                 log_traffic = true;
@@ -182,6 +344,64 @@ int main(int argc, char **argv) {
             topo_file = argv[i+1];
             cout << "FatTree topology input file: "<< topo_file << endl;
             i++;
+        } else if (!strcmp(argv[i],"-fct_stats")){
+            fct_file = argv[i+1];
+            cout << "FCT summary file: "<< fct_file << endl;
+            i++;
+        } else if (!strcmp(argv[i],"-workload")){
+            workload_cdf = argv[i+1];
+            if (!sizes.load(workload_cdf))
+                exit(1);
+            cout << "Flow size CDF: "<< workload_cdf << endl;
+            i++;
+        } else if (!strcmp(argv[i],"-load")){
+            workload_load = atof(argv[i+1]);
+            if (workload_load <= 0) {
+                cout << "Workload load must be positive, found " << argv[i+1] << endl;
+                exit(1);
+            }
+            i++;
+        } else if (!strcmp(argv[i],"-locality")){
+            // fraction of flows within the rack, then within the pod
+            rack_locality = atof(argv[i+1]);
+            pod_locality = atof(argv[i+2]);
+            i += 2;
+        } else if (!strcmp(argv[i],"-dump_cm")){
+            dump_file = argv[i+1];
+            i++;
+        } else if (!strcmp(argv[i],"-collective")){
+            if (!Collective::parse(argv[i+1], collective_algo)) {
+                cout << "Unknown collective " << argv[i+1] << " expecting one of ring|tree|butterfly|alltoall" << endl;
+                exit(1);
+            }
+            collective = true;
+            cout << "Collective " << argv[i+1] << endl;
+            i++;
+        } else if (!strcmp(argv[i],"-coll_size")){
+            collective_bytes = atoll(argv[i+1]);
+            i++;
+        } else if (!strcmp(argv[i],"-coll_ranks")){
+            collective_ranks = atoi(argv[i+1]);
+            i++;
+        } else if (!strcmp(argv[i],"-coll_parallel")){
+            collective_parallel = atoi(argv[i+1]);
+            i++;
+        } else if (!strcmp(argv[i],"-elide_idle")){
+            elide_idle = true;
+        } else if (!strcmp(argv[i],"-memstats")){
+            memstats_ticks = atoi(argv[i+1]);
+            c.setMemoryReport(memstats_ticks);
+            i++;
+        } else if (!strcmp(argv[i],"-metrics")){
+            metrics_address = argv[i+1];
+            i++;
+        } else if (!strcmp(argv[i],"-metrics_period")){
+            metrics_period = atof(argv[i+1]);
+            i++;
+        } else if (!strcmp(argv[i],"-log_index")){
+            log_index_width = timeFromUs(atof(argv[i+1]));
+            cout << "Logfile index bucket width: "<< timeAsUs(log_index_width) << "us" << endl;
+            i++;
         } else if (!strcmp(argv[i],"-q")){
             queuesize = atoi(argv[i+1]);
             i++;
@@ -224,10 +444,26 @@ int main(int argc, char **argv) {
             switch_latency = timeFromUs(atof(argv[i+1]));
             cout << "Switch latency set to " << timeAsUs(switch_latency) << endl;
             i++;
+        } else if (!strcmp(argv[i],"-flowlet_table")){
+            FatTreeSwitch::_flowlet_table_size = atoi(argv[i+1]);
+            uint32_t n = FatTreeSwitch::_flowlet_table_size;
+            if (n == 0 || (n & (n - 1)) != 0) {
+                cout << "Flowlet table size must be a power of two, found " << argv[i+1] << endl;
+                exit(1);
+            }
+            cout << "Flowlet table size " << n << endl;
+            i++;
+        } else if (!strcmp(argv[i],"-flowlet_age")){
+            FatTreeSwitch::_flowlet_age = timeFromUs(atof(argv[i+1]));
+            cout << "Flowlet table aging time " << timeAsUs(FatTreeSwitch::_flowlet_age) << "us" << endl;
+            i++;
         } else if (!strcmp(argv[i],"-ar_sticky_delta")){
             ar_sticky_delta = atof(argv[i+1]);
             cout << "Adaptive routing sticky delta " << ar_sticky_delta << "us" << endl;
             i++;
+        } else if (!strcmp(argv[i],"-ar_ranked")){
+            FatTreeSwitch::_ar_ranked = true;
+            cout << "Adaptive routing using incremental port ranking" << endl;
         } else if (!strcmp(argv[i],"-ar_granularity")){
             if (!strcmp(argv[i+1],"packet"))
                 ar_sticky = FatTreeSwitch::PER_PACKET;
@@ -339,6 +575,15 @@ int main(int argc, char **argv) {
     FatTreeSwitch::_sticky_delta = timeFromUs(ar_sticky_delta);
     FatTreeSwitch::_ecn_threshold_fraction = ecn_thresh;
 
+    if (end_time == 0 && !elide_idle) {
+        cout << "-end 0 needs -elide_idle, or the simulation never ends" << endl;
+        exit(1);
+    }
+    if (end_time == 0 && workload_cdf) {
+        cout << "-workload needs an -end time to generate flows up to" << endl;
+        exit(1);
+    }
+    eventlist.setElideIdle(elide_idle);
     eventlist.setEndtime(timeFromUs((uint32_t)end_time));
     queuesize = memFromPkt(queuesize);
 
@@ -378,6 +623,8 @@ int main(int argc, char **argv) {
     cout << "Logging to " << filename.str() << endl;
     //Logfile 
     Logfile logfile(filename.str(), eventlist);
+    if (log_index_width > 0)
+        logfile.enableIndex(log_index_width);
 
     cout << "Linkspeed set to " << linkspeed/1000000000 << "Gbps" << endl;
     logfile.setStartTime(timeFromSec(0));
@@ -392,18 +639,23 @@ int main(int argc, char **argv) {
         traffic_logger = new TrafficLoggerSimple();
         logfile.addLogger(*traffic_logger);
     }
-    FlowEventLoggerSimple* event_logger = NULL;
-    if (log_flow_events) {
-        event_logger = new FlowEventLoggerSimple();
-        logfile.addLogger(*event_logger);
+    FlowEventLogger* event_logger = NULL;
+    FctStatsCollector* fct_stats = NULL;
+    if (fct_file) {
+        // summarize FCTs in the simulator rather than logging every flow
+        // event.  Base delay is the unloaded RTT of the longest path.
+        simtime_picosec base_delay = 2 * (tiers == 3 ? 6 : 4) * hop_latency + 2 * (tiers == 3 ? 5 : 3) * switch_latency;
+        fct_stats = new FctStatsCollector(linkspeed, base_delay);
+        event_logger = fct_stats;
+    } else if (log_flow_events) {
+        FlowEventLoggerSimple* simple_logger = new FlowEventLoggerSimple();
+        logfile.addLogger(*simple_logger);
+        event_logger = simple_logger;
     }
 
     //EqdsSrc::setMinRTO(50000); //increase RTO to avoid spurious retransmits
     EqdsSrc::_path_entropy_size = path_entropy_size;
     
-    EqdsSrc* eqds_src;
-    EqdsSink* eqds_snk;
-
     //Route* routeout, *routein;
 
     // scanner interval must be less than min RTO
@@ -420,7 +672,14 @@ int main(int argc, char **argv) {
 
     ConnectionMatrix* conns = new ConnectionMatrix(no_of_nodes);
 
-    if (tm_file){
+    if (workload_cdf || collective) {
+        // flows come from the workload generator or collective instead
+        if (no_of_nodes == 0) {
+            cout << "A generated workload or collective needs -nodes" << endl;
+            exit(1);
+        }
+    }
+    else if (tm_file){
         cout << "Loading connection matrix from  " << tm_file << endl;
 
         if (!conns->load(tm_file)){
@@ -457,14 +716,37 @@ int main(int argc, char **argv) {
                                   snd_type);
     }
 
+    if (log_switch_agg) {
+        assert(!log_switches); // both want to be the switch ports' queue logger
+        top->add_aggregate_switch_logger(logfile, timeFromUs(20.0), log_switch_agg);
+    }
     if (log_switches) {
         top->add_switch_loggers(logfile, timeFromUs(20.0));
     }
     
     //handle link failures specified in the connection matrix.
+    bool runtime_failures = false;
     for (size_t c = 0; c < conns->failures.size(); c++){
         failure* crt = conns->failures.at(c);
 
+        if (crt->start != NO_START) {
+            // fails (and maybe recovers) while the simulation runs
+            if (crt->switch_type != FatTreeSwitch::AGG) {
+                cerr << "Error: failure " << c << " has a start time, but only AGG switch links can fail during the run" << endl;
+                exit(1);
+            }
+            if (crt->end != NO_START && crt->end <= crt->start) {
+                cerr << "Error: failure " << c << " recovers at " << timeAsUs(crt->end)
+                     << "us, not after it fails at " << timeAsUs(crt->start) << "us" << endl;
+                exit(1);
+            }
+            cout << "Scheduling link failure Switch ID " << crt->switch_id << " link ID " << crt->link_id
+                 << " at " << timeAsUs(crt->start) << "us" << endl;
+            new LinkFailureEvent(eventlist, top, crt->switch_id, crt->link_id, crt->start,
+                                 crt->end == NO_START ? 0 : crt->end);
+            runtime_failures = true;
+            continue;
+        }
         cout << "Adding link failure switch type" << crt->switch_type << " Switch ID " << crt->switch_id << " link ID "  << crt->link_id << endl;
         top->add_failed_link(crt->switch_type,crt->switch_id,crt->link_id);
     }
@@ -481,100 +763,74 @@ int main(int argc, char **argv) {
     list <const Route*> routes;
 
     vector<connection*>* all_conns = conns->getAllConnections();
-    vector <EqdsSrc*> eqds_srcs;
-
-    map <flowid_t, TriggerTarget*> flowmap;
 
+    EqdsFlowBuilder flows(eventlist, top, conns, route_strategy, cwnd, pacers, nics, logfile,
+                          traffic_logger, event_logger, sink_logger);
     for (size_t c = 0; c < all_conns->size(); c++){
-        connection* crt = all_conns->at(c);
-        int src = crt->src;
-        int dest = crt->dst;
-        //cout << "Connection " << crt->src << "->" <<crt->dst << " starting at " << crt->start << " size " << crt->size << endl;
-
-        eqds_src = new EqdsSrc(traffic_logger, eventlist, *nics.at(src));
-        eqds_src->setCwnd(cwnd*Packet::data_packet_size());
-        eqds_srcs.push_back(eqds_src);
-        eqds_src->setDst(dest);
-
-        if (log_flow_events) {
-            eqds_src->logFlowEvents(*event_logger);
-        }
-        
-        eqds_snk = new EqdsSink(NULL,pacers[dest],*nics.at(dest));
-        eqds_src->setName("Eqds_" + ntoa(src) + "_" + ntoa(dest));
-        logfile.writeName(*eqds_src);
-        eqds_snk->setSrc(src);
-                        
-        eqds_snk->setName("Eqds_sink_" + ntoa(src) + "_" + ntoa(dest));
-        logfile.writeName(*eqds_snk);
-
-        if (crt->flowid) {
-            eqds_src->setFlowId(crt->flowid);
-            eqds_snk->setFlowId(crt->flowid);
-            assert(flowmap.find(crt->flowid) == flowmap.end()); // don't have dups
-            flowmap[crt->flowid] = eqds_src;
-        }
-                        
-        if (crt->size>0){
-            eqds_src->setFlowsize(crt->size);
-        }
+        flows.build(all_conns->at(c));
+    }
 
-        if (crt->trigger) {
-            Trigger* trig = conns->getTrigger(crt->trigger, eventlist);
-            trig->add_target(*eqds_src);
-        }
-        if (crt->send_done_trigger) {
-            Trigger* trig = conns->getTrigger(crt->send_done_trigger, eventlist);
-            eqds_src->setEndTrigger(*trig);
+    WorkloadGenerator* workload = NULL;
+    if (workload_cdf) {
+        workload = new WorkloadGenerator(eventlist, no_of_nodes, linkspeed, workload_load, sizes, seed);
+        workload->setLocality(top->radix_down(TOR_TIER), rack_locality,
+                              no_of_nodes / top->no_of_pods(), pod_locality);
+        cout << "Workload " << workload_cdf << " load " << workload_load << " mean flow size "
+             << sizes.mean() << " bytes, " << workload->arrivalRate() << " flows/s" << endl;
+        workload->start(flows, 0, timeFromUs((uint32_t)end_time));
+        if (dump_file) {
+            if (!workload->dump(dump_file, 0, timeFromUs((uint32_t)end_time))) {
+                cout << "Failed to write connection matrix " << dump_file << endl;
+                exit(1);
+            }
+            cout << "Workload connection matrix written to " << dump_file << endl;
         }
+    }
 
-
-        if (crt->recv_done_trigger) {
-            Trigger* trig = conns->getTrigger(crt->recv_done_trigger, eventlist);
-            eqds_snk->setEndTrigger(*trig);
+    vector<Collective*> collectives;
+    if (collective) {
+        if (collective_ranks == 0)
+            collective_ranks = no_of_nodes;
+        if (collective_ranks < 2 || no_of_nodes % collective_ranks) {
+            cout << "Collective groups of " << collective_ranks << " ranks do not fit "
+                 << no_of_nodes << " hosts" << endl;
+            exit(1);
         }
-
-        //eqds_snk->set_priority(crt->priority);
-                        
-        //EqdsRtxScanner.registerEqds(*EqdsSrc);
-
-        switch (route_strategy) {
-        case ECMP_FIB:
-        case ECMP_FIB_ECN:
-        case REACTIVE_ECN:
-            {
-                Route* srctotor = new Route();
-                srctotor->push_back(top->queues_ns_nlp[src][top->HOST_POD_SWITCH(src)][0]);
-                srctotor->push_back(top->pipes_ns_nlp[src][top->HOST_POD_SWITCH(src)][0]);
-                srctotor->push_back(top->queues_ns_nlp[src][top->HOST_POD_SWITCH(src)][0]->getRemoteEndpoint());
-
-                Route* dsttotor = new Route();
-                dsttotor->push_back(top->queues_ns_nlp[dest][top->HOST_POD_SWITCH(dest)][0]);
-                dsttotor->push_back(top->pipes_ns_nlp[dest][top->HOST_POD_SWITCH(dest)][0]);
-                dsttotor->push_back(top->queues_ns_nlp[dest][top->HOST_POD_SWITCH(dest)][0]->getRemoteEndpoint());
-
-
-                eqds_src->connect(*srctotor, *dsttotor, *eqds_snk, crt->start);
-                //eqds_src->setPaths(path_entropy_size);
-                //eqds_snk->setPaths(path_entropy_size);
-
-                //register src and snk to receive packets from their respective TORs. 
-                assert(top->switches_lp[top->HOST_POD_SWITCH(src)]);
-                assert(top->switches_lp[top->HOST_POD_SWITCH(src)]);
-                top->switches_lp[top->HOST_POD_SWITCH(src)]->addHostPort(src,eqds_snk->flowId(),eqds_src);
-                top->switches_lp[top->HOST_POD_SWITCH(dest)]->addHostPort(dest,eqds_src->flowId(),eqds_snk);
-                break;
-            }
-        default:
-            abort();
+        for (uint32_t g = 0; g < no_of_nodes / collective_ranks; g++) {
+            vector<uint32_t> hosts;
+            for (uint32_t r = 0; r < collective_ranks; r++)
+                hosts.push_back(g * collective_ranks + r);
+            Collective* coll = new Collective(eventlist, collective_algo, hosts, collective_bytes,
+                                              flows, collective_parallel);
+            coll->start(0);
+            collectives.push_back(coll);
         }
+    }
 
-        // set up the triggers
-        // xxx
-
-        if (log_sink) {
-            sink_logger->monitorSink(eqds_snk);
-        }
+    MetricsServer* metrics = NULL;
+    if (metrics_address) {
+        metrics = new MetricsServer(eventlist, timeFromUs(metrics_period), metrics_address);
+        for (size_t i = 0; i < top->switches_lp.size(); i++)
+            metrics->addSwitch(*top->switches_lp[i]);
+        for (size_t i = 0; i < top->switches_up.size(); i++)
+            metrics->addSwitch(*top->switches_up[i]);
+        for (size_t i = 0; i < top->switches_c.size(); i++)
+            metrics->addSwitch(*top->switches_c[i]);
+        metrics->addGauge("htsim_flows", "Flows created so far.",
+                          [&flows]() {return (double)flows.srcs().size();});
+        metrics->addGauge("htsim_flows_active", "Flows started and not yet finished.", [&flows]() {
+                uint32_t n = 0;
+                for (EqdsSrc* src : flows.srcs())
+                    n += src->flowActive();
+                return (double)n;
+            });
+        metrics->addGauge("htsim_flows_finished", "Flows finished.", [&flows]() {
+                uint32_t n = 0;
+                for (EqdsSrc* src : flows.srcs())
+                    n += src->flowFinished();
+                return (double)n;
+            });
+        cout << "Serving metrics on " << metrics_address << endl;
     }
 
     Logged::dump_idmap();
@@ -592,6 +848,7 @@ int main(int argc, char **argv) {
 
     cout << "Done" << endl;
     int new_pkts = 0, rtx_pkts = 0, bounce_pkts = 0, rts_pkts = 0;
+    const vector<EqdsSrc*>& eqds_srcs = flows.srcs();
     for (size_t ix = 0; ix < eqds_srcs.size(); ix++) {
         new_pkts += eqds_srcs[ix]->_new_packets_sent;
         rtx_pkts += eqds_srcs[ix]->_rtx_packets_sent;
@@ -599,6 +856,30 @@ int main(int argc, char **argv) {
         bounce_pkts += eqds_srcs[ix]->_bounces_received;
     }
     cout << "New: " << new_pkts << " Rtx: " << rtx_pkts << " RTS: " << rts_pkts << " Bounced: " << bounce_pkts << endl;
+    cout << "Events: " << EventList::eventsRun() << " Packet hops: " << Pipe::_packets_carried << endl;
+    cout << "Peak RSS: " << MemoryStats::peakRss()/1024 << " KB" << endl;
+    if (fct_stats) {
+        fct_stats->writeSummary(fct_file);
+    }
+    if (ar_sticky == FatTreeSwitch::PER_FLOWLET) {
+        FlowletTable::report(cout);
+    }
+    if (workload) {
+        workload->report(cout);
+    }
+    if (runtime_failures) {
+        cout << "Lost on failed links: " << Pipe::_failed_drops
+             << " No route: " << FatTreeSwitch::_no_route_drops << endl;
+    }
+    for (size_t ix = 0; ix < collectives.size(); ix++) {
+        if (!collectives[ix]->finished())
+            cout << "Collective " << ix << " unfinished, " << collectives[ix]->flowsDone()
+                 << " of " << collectives[ix]->flowsTotal() << " flows done" << endl;
+    }
+    if (memstats_ticks >= 0) {
+        MemoryStats::report(cout);
+    }
+    delete metrics;
     /*
     list <const Route*>::iterator rt_i;
     int counts[10]; int hop;
@@ -12,12 +12,14 @@
 #include "shortflows.h"
 #include "pipe.h"
 #include "eventlist.h"
+#include "memstats.h"
 #include "logfile.h"
 #include "loggers.h"
 #include "clock.h"
 #include "hpcc.h"
 #include "compositequeue.h"
 #include "firstfit.h"
+#include "path_service.h"
 #include "topology.h"
 #include "connection_matrix.h"
 #include "fat_tree_topology.h"
@@ -372,22 +374,12 @@ int main(int argc, char **argv) {
         top->add_switch_loggers(logfile, timeFromUs(20.0));
     }
 
-    vector<const Route*>*** net_paths;
-    net_paths = new vector<const Route*>**[no_of_nodes];
-
-    int **path_refcounts;
-    path_refcounts = new int*[no_of_nodes];
+    PathService* net_paths = new PathService(top, false);
 
     int* is_dest = new int[no_of_nodes];
     
     for (size_t s = 0; s < no_of_nodes; s++) {
         is_dest[s] = 0;
-        net_paths[s] = new vector<const Route*>*[no_of_nodes];
-        path_refcounts[s] = new int[no_of_nodes];
-        for (size_t d = 0; d < no_of_nodes; d++) {
-            net_paths[s][d] = NULL;
-            path_refcounts[s][d] = 0;
-        }
     }
     
     ConnectionMatrix* conns = new ConnectionMatrix(no_of_nodes);
@@ -420,22 +412,10 @@ int main(int argc, char **argv) {
         connection* crt = all_conns->at(c);
         int src = crt->src;
         int dest = crt->dst;
-        path_refcounts[src][dest]++;
-        path_refcounts[dest][src]++;
-                        
-        if (!net_paths[src][dest]&&route_strategy!=ECMP_FIB) {
-            vector<const Route*>* paths = top->get_bidir_paths(src,dest,false);
-            net_paths[src][dest] = paths;
-            /*
-              for (unsigned int i = 0; i < paths->size(); i++) {
-              routes.push_back((*paths)[i]);
-              }
-            */
-        }
-        if (!net_paths[dest][src]&&route_strategy!=ECMP_FIB) {
-            vector<const Route*>* paths = top->get_bidir_paths(dest,src,false);
-            net_paths[dest][src] = paths;
-        }
+        // paths are built as each connection is set up below, and
+        // freed once the last connection between the pair is done
+        net_paths->hold(src,dest);
+        net_paths->hold(dest,src);
     }
 
     map <flowid_t, TriggerTarget*> flowmap;
@@ -509,8 +489,8 @@ int main(int argc, char **argv) {
             top->switches_lp[top->HOST_POD_SWITCH(src)]->addHostPort(src,hpccSrc->flow_id(),hpccSrc);
             top->switches_lp[top->HOST_POD_SWITCH(dest)]->addHostPort(dest,hpccSrc->flow_id(),hpccSnk);
         } else {
-            int choice = rand()%net_paths[src][dest]->size();
-            routeout = new Route(*(net_paths[src][dest]->at(choice)));
+            int choice = rand()%net_paths->get_paths(src,dest)->size();
+            routeout = new Route(*(net_paths->get_paths(src,dest)->at(choice)));
             routeout->add_endpoints(hpccSrc, hpccSnk);
                                 
             routein = new Route(*top->get_bidir_paths(dest,src,false)->at(choice));
@@ -518,38 +498,15 @@ int main(int argc, char **argv) {
             hpccSrc->connect(routeout, routein, *hpccSnk, timeFromUs((uint32_t)rand()%20));
         }
 
-        path_refcounts[src][dest]--;
-        path_refcounts[dest][src]--;
-
         // free up the routes if no other connection needs them 
-        if (path_refcounts[src][dest] == 0 && net_paths[src][dest]) {
-            vector<const Route*>::iterator i;
-            for (i = net_paths[src][dest]->begin(); i != net_paths[src][dest]->end(); i++) {
-                if ((*i)->reverse())
-                    delete (*i)->reverse();
-                delete *i;
-            }
-            delete net_paths[src][dest];
-        }
-        if (path_refcounts[dest][src] == 0 && net_paths[dest][src]) {
-            vector<const Route*>::iterator i;
-            for (i = net_paths[dest][src]->begin(); i != net_paths[dest][src]->end(); i++) {
-                if ((*i)->reverse())
-                    delete (*i)->reverse();
-                delete *i;
-            }
-            delete net_paths[dest][src];
-        }
+        net_paths->release(src,dest);
+        net_paths->release(dest,src);
 
         if (log_sink) {
             sinkLogger.monitorSink(hpccSnk);
         }
     }
 
-    for (size_t ix = 0; ix < no_of_nodes; ix++) {
-        delete path_refcounts[ix];
-    }
-
     Logged::dump_idmap();
     // Record the setup
     int pktsize = Packet::data_packet_size();
@@ -572,6 +529,8 @@ int main(int argc, char **argv) {
         rtx_pkts += hpcc_srcs[ix]->_rtx_packets_sent;
     }
     cout << "New: " << new_pkts << " Rtx: " << rtx_pkts << endl;
+    cout << "Events: " << EventList::eventsRun() << " Packet hops: " << Pipe::_packets_carried << endl;
+    cout << "Peak RSS: " << MemoryStats::peakRss()/1024 << " KB" << endl;
 
     /*list <const Route*>::iterator rt_i;
       int counts[10]; int hop;
@@ -11,12 +11,15 @@
 #include "shortflows.h"
 #include "pipe.h"
 #include "eventlist.h"
+#include "memstats.h"
 #include "logfile.h"
 #include "loggers.h"
 #include "clock.h"
 #include "ndp.h"
+#include "fct_stats.h"
 #include "compositequeue.h"
 #include "firstfit.h"
+#include "path_service.h"
 #include "topology.h"
 #include "queue_lossless_input.h"
 #include "connection_matrix.h"
@@ -44,7 +47,7 @@ int DEFAULT_NODES = 432;
 EventList eventlist;
 
 void exit_error(char* progr) {
-    cout << "Usage " << progr << " [-nodes N]\n\t[-conns C]\n\t[-cwnd cwnd_size]\n\t[-q queue_size]\n\t[-oversubscribed_cc] Use receiver-driven AIMD to reduce total window when trims are not last hop\n\t[-queue_type composite|random|lossless|lossless_input|]\n\t[-tm traffic_matrix_file]\n\t[-strat route_strategy (single,rand,perm,pull,ecmp,\n\tecmp_host path_count,ecmp_ar,ecmp_rr,\n\tecmp_host_ar ar_thresh)]\n\t[-log log_level]\n\t[-seed random_seed]\n\t[-end end_time_in_usec]\n\t[-mtu MTU]\n\t[-hop_latency x] per hop wire latency in us,default 1\n\t[-switch_latency x] switching latency in us, default 0\n\t[-host_queue_type  swift|prio|fair_prio]" << endl;
+    cout << "Usage " << progr << " [-nodes N]\n\t[-conns C]\n\t[-cwnd cwnd_size]\n\t[-q queue_size]\n\t[-oversubscribed_cc] Use receiver-driven AIMD to reduce total window when trims are not last hop\n\t[-queue_type composite|random|lossless|lossless_input|]\n\t[-tm traffic_matrix_file]\n\t[-strat route_strategy (single,rand,perm,pull,ecmp,\n\tecmp_host path_count,ecmp_ar,ecmp_rr,\n\tecmp_host_ar ar_thresh)]\n\t[-log log_level]\n\t[-seed random_seed]\n\t[-end end_time_in_usec] 0 to run until the flows finish, with -elide_idle\n\t[-elide_idle] skip clock, sampler and timer scanner events while the network is idle\n\t[-mtu MTU]\n\t[-hop_latency x] per hop wire latency in us,default 1\n\t[-switch_latency x] switching latency in us, default 0\n\t[-host_queue_type  swift|prio|fair_prio]\n\t[-fct_stats file] write FCT percentiles to file\n\t[-log_index dt] write a time index of the logfile with dt us buckets\n\t[-memstats n] report memory use by subsystem every n clock ticks and at exit\n\t[-flowlet_table n] flowlet table slots per switch (power of two), default 4096\n\t[-flowlet_age dt] flowlet table aging time in us, default 0 (never)\n\t[-ar_ranked] pick adaptive routing choices from incrementally ranked ports" << endl;
     exit(1);
 }
 
@@ -92,6 +95,7 @@ int main(int argc, char **argv) {
     bool log_tor_upqueue = false;
     bool log_traffic = false;
     bool log_switches = false;
+    uint32_t log_switch_agg = 0;
     bool log_queue_usage = false;
     double ecn_thresh = 0.5; // default marking threshold for ECN load balancing
     RouteStrategy route_strategy = NOT_SET;
@@ -103,6 +107,7 @@ int main(int argc, char **argv) {
 
     filename << "logout.dat";
     int end_time = 1000;//in microseconds
+    bool elide_idle = false;
 
     queue_type snd_type = FAIR_PRIO;
 
@@ -112,6 +117,9 @@ int main(int argc, char **argv) {
 
     char* tm_file = NULL;
     char* topo_file = NULL;
+    char* fct_file = NULL;
+    simtime_picosec log_index_width = 0;
+    int memstats_ticks = -1;
 
     while (i<argc) {
         if (!strcmp(argv[i],"-o")) {
@@ -190,6 +198,13 @@ int main(int argc, char **argv) {
             } else if (!strcmp(argv[i+1], "switch")) {
                 cout << "logging total switch queues\n";
                 log_switches = true;
+            } else if (!strcmp(argv[i+1], "switch_agg")) {
+                cout << "logging aggregate switch, tier and pod queues\n";
+                log_switch_agg |= AggregateQueueLoggerSampling::SWITCH | AggregateQueueLoggerSampling::TIER
+                    | AggregateQueueLoggerSampling::POD;
+            } else if (!strcmp(argv[i+1], "port_agg")) {
+                cout << "logging aggregate port queues\n";
+                log_switch_agg |= AggregateQueueLoggerSampling::PORT;
             } else if (!strcmp(argv[i+1], "traffic")) {
                 cout << "logging traffic\n";
                 log_traffic = true;
@@ -212,6 +227,20 @@ int main(int argc, char **argv) {
             topo_file = argv[i+1];
             cout << "FatTree topology input file: "<< topo_file << endl;
             i++;
+        } else if (!strcmp(argv[i],"-fct_stats")){
+            fct_file = argv[i+1];
+            cout << "FCT summary file: "<< fct_file << endl;
+            i++;
+        } else if (!strcmp(argv[i],"-elide_idle")){
+            elide_idle = true;
+        } else if (!strcmp(argv[i],"-memstats")){
+            memstats_ticks = atoi(argv[i+1]);
+            c.setMemoryReport(memstats_ticks);
+            i++;
+        } else if (!strcmp(argv[i],"-log_index")){
+            log_index_width = timeFromUs(atof(argv[i+1]));
+            cout << "Logfile index bucket width: "<< timeAsUs(log_index_width) << "us" << endl;
+            i++;
         } else if (!strcmp(argv[i],"-q")){
             queuesize = atoi(argv[i+1]);
             i++;
@@ -250,6 +279,19 @@ int main(int argc, char **argv) {
             switch_latency = timeFromUs(atof(argv[i+1]));
             cout << "Switch latency set to " << timeAsUs(switch_latency) << endl;
             i++;
+        } else if (!strcmp(argv[i],"-flowlet_table")){
+            FatTreeSwitch::_flowlet_table_size = atoi(argv[i+1]);
+            uint32_t n = FatTreeSwitch::_flowlet_table_size;
+            if (n == 0 || (n & (n - 1)) != 0) {
+                cout << "Flowlet table size must be a power of two, found " << argv[i+1] << endl;
+                exit(1);
+            }
+            cout << "Flowlet table size " << n << endl;
+            i++;
+        } else if (!strcmp(argv[i],"-flowlet_age")){
+            FatTreeSwitch::_flowlet_age = timeFromUs(atof(argv[i+1]));
+            cout << "Flowlet table aging time " << timeAsUs(FatTreeSwitch::_flowlet_age) << "us" << endl;
+            i++;
         } else if (!strcmp(argv[i],"-ar_sticky_delta")){
             ar_sticky_delta = atof(argv[i+1]);
             cout << "Adaptive routing sticky delta " << ar_sticky_delta << "us" << endl;
@@ -259,6 +301,9 @@ int main(int argc, char **argv) {
             high_pfc = atoi(argv[i+2]);
             cout << "PFC thresholds high " << high_pfc << " low " << low_pfc << endl;
             i++;
+        } else if (!strcmp(argv[i],"-ar_ranked")){
+            FatTreeSwitch::_ar_ranked = true;
+            cout << "Adaptive routing using incremental port ranking" << endl;
         } else if (!strcmp(argv[i],"-ar_granularity")){
             if (!strcmp(argv[i+1],"packet"))
                 ar_sticky = FatTreeSwitch::PER_PACKET;
@@ -378,6 +423,11 @@ int main(int argc, char **argv) {
     LosslessInputQueue::_low_threshold = Packet::data_packet_size()*low_pfc;
 
 
+    if (end_time == 0 && !elide_idle) {
+        cout << "-end 0 needs -elide_idle, or the simulation never ends" << endl;
+        exit(1);
+    }
+    eventlist.setElideIdle(elide_idle);
     eventlist.setEndtime(timeFromUs((uint32_t)end_time));
     queuesize = memFromPkt(queuesize);
     
@@ -418,6 +468,8 @@ int main(int argc, char **argv) {
     cout << "Logging to " << filename.str() << endl;
     //Logfile 
     Logfile logfile(filename.str(), eventlist);
+    if (log_index_width > 0)
+        logfile.enableIndex(log_index_width);
 
     cout << "Linkspeed set to " << linkspeed/1000000000 << "Gbps" << endl;
     logfile.setStartTime(timeFromSec(0));
@@ -430,6 +482,12 @@ int main(int argc, char **argv) {
     if (log_traffic) {
         logfile.addLogger(traffic_logger);
     }
+    FctStatsCollector* fct_stats = NULL;
+    if (fct_file) {
+        // base delay is the unloaded RTT of the longest path
+        simtime_picosec base_delay = 2 * (tiers == 3 ? 6 : 4) * hop_latency + 2 * (tiers == 3 ? 5 : 3) * switch_latency;
+        fct_stats = new FctStatsCollector(linkspeed, base_delay);
+    }
 
 #if PRINT_PATHS
     filename << ".paths";
@@ -497,26 +555,20 @@ int main(int argc, char **argv) {
     VL2Topology* top = new VL2Topology(lf, &eventlist,ff);
 #endif
 
+    if (log_switch_agg) {
+        assert(!log_switches); // both want to be the switch ports' queue logger
+        top->add_aggregate_switch_logger(logfile, timeFromUs(20.0), log_switch_agg);
+    }
     if (log_switches) {
         top->add_switch_loggers(logfile, timeFromUs(20.0));
     }
 
-    vector<const Route*>*** net_paths;
-    net_paths = new vector<const Route*>**[no_of_nodes];
-
-    int **path_refcounts;
-    path_refcounts = new int*[no_of_nodes];
+    PathService* net_paths = new PathService(top, false);
 
     int* is_dest = new int[no_of_nodes];
     
     for (size_t s = 0; s < no_of_nodes; s++) {
         is_dest[s] = 0;
-        net_paths[s] = new vector<const Route*>*[no_of_nodes];
-        path_refcounts[s] = new int[no_of_nodes];
-        for (size_t d = 0; d < no_of_nodes; d++) {
-            net_paths[s][d] = NULL;
-            path_refcounts[s][d] = 0;
-        }
     }
     
     ConnectionMatrix* conns = new ConnectionMatrix(no_of_nodes);
@@ -540,9 +592,20 @@ int main(int argc, char **argv) {
     }
     
     //handle link failures specified in the connection matrix.
+    bool runtime_failures = false;
     for (size_t c = 0; c < conns->failures.size(); c++){
         failure* crt = conns->failures.at(c);
 
+        if (crt->start != NO_START) {
+            // fails (and maybe recovers) while the simulation runs
+            assert(crt->switch_type == FatTreeSwitch::AGG);
+            cout << "Scheduling link failure Switch ID " << crt->switch_id << " link ID " << crt->link_id
+                 << " at " << timeAsUs(crt->start) << "us" << endl;
+            new LinkFailureEvent(eventlist, top, crt->switch_id, crt->link_id, crt->start,
+                                 crt->end == NO_START ? 0 : crt->end);
+            runtime_failures = true;
+            continue;
+        }
         cout << "Adding link failure switch type" << crt->switch_type << " Switch ID " << crt->switch_id << " link ID "  << crt->link_id << endl;
         top->add_failed_link(crt->switch_type,crt->switch_id,crt->link_id);
     }
@@ -557,38 +620,16 @@ int main(int argc, char **argv) {
 
     vector<connection*>* all_conns = conns->getAllConnections();
     vector <NdpSrc*> ndp_srcs;
+    vector <NdpSink*> ndp_snks;
 
     for (size_t c = 0; c < all_conns->size(); c++){
         connection* crt = all_conns->at(c);
         int src = crt->src;
         int dest = crt->dst;
-        path_refcounts[src][dest]++;
-        path_refcounts[dest][src]++;
-                        
-        if (!net_paths[src][dest]
-            && route_strategy!=ECMP_FIB
-            && route_strategy!=ECMP_FIB_ECN
-            && route_strategy!=REACTIVE_ECN ) {
-            vector<const Route*>* paths = top->get_bidir_paths(src,dest,false);
-            net_paths[src][dest] = paths;
-            /*
-            for (unsigned int i = 0; i < paths->size(); i++) {
-              routes.push_back((*paths)[i]);
-            }
-            */
-        }
-        if (!net_paths[dest][src]
-            && route_strategy!=ECMP_FIB
-            && route_strategy!=ECMP_FIB_ECN
-            && route_strategy!=REACTIVE_ECN ) {
-            vector<const Route*>* paths = top->get_bidir_paths(dest,src,false);
-            net_paths[dest][src] = paths;
-            /*
-            for (unsigned int i = 0; i < paths->size(); i++) {
-              routes.push_back((*paths)[i]);
-            }
-            */
-        }
+        // paths are built as each connection is set up below, and
+        // freed once the last connection between the pair is done
+        net_paths->hold(src,dest);
+        net_paths->hold(dest,src);
     }
 
     map <flowid_t, TriggerTarget*> flowmap;
@@ -622,8 +663,12 @@ int main(int argc, char **argv) {
             Trigger* trig = conns->getTrigger(crt->send_done_trigger, eventlist);
             ndpSrc->set_end_trigger(*trig);
         }
+        if (fct_stats) {
+            ndpSrc->logFlowEvents(*fct_stats);
+        }
 
         ndpSnk = new NdpSink(pacers[dest]);
+        ndp_snks.push_back(ndpSnk);
                         
         ndpSrc->setName("ndp_" + ntoa(src) + "_" + ntoa(dest));
 
@@ -649,8 +694,12 @@ int main(int argc, char **argv) {
         case SCATTER_ECMP:
         case PULL_BASED:
             ndpSrc->connect(NULL, NULL, *ndpSnk, crt->start);
-            ndpSrc->set_paths(net_paths[src][dest]);
-            ndpSnk->set_paths(net_paths[dest][src]);
+            // the source and sink route over the shared paths for
+            // the rest of the run, so they must never be freed
+            net_paths->hold(src,dest);
+            net_paths->hold(dest,src);
+            ndpSrc->set_paths(net_paths->get_paths(src,dest));
+            ndpSnk->set_paths(net_paths->get_paths(dest,src));
             break;
         case ECMP_FIB:
         case ECMP_FIB_ECN:
@@ -681,8 +730,8 @@ int main(int argc, char **argv) {
         case SINGLE_PATH:
             {
                 assert(route_strategy==SINGLE_PATH);
-                int choice = rand()%net_paths[src][dest]->size();
-                routeout = new Route(*(net_paths[src][dest]->at(choice)));
+                int choice = rand()%net_paths->get_paths(src,dest)->size();
+                routeout = new Route(*(net_paths->get_paths(src,dest)->at(choice)));
                 routeout->add_endpoints(ndpSrc, ndpSnk);
                                 
                 routein = new Route(*top->get_bidir_paths(dest,src,false)->at(choice));
@@ -694,40 +743,27 @@ int main(int argc, char **argv) {
             abort();
         }
 
-        path_refcounts[src][dest]--;
-        path_refcounts[dest][src]--;
-
 
         // set up the triggers
         // xxx
 
         // free up the routes if no other connection needs them 
-        if (path_refcounts[src][dest] == 0 && net_paths[src][dest]) {
-            vector<const Route*>::iterator i;
-            for (i = net_paths[src][dest]->begin(); i != net_paths[src][dest]->end(); i++) {
-                if ((*i)->reverse())
-                    delete (*i)->reverse();
-                delete *i;
-            }
-            delete net_paths[src][dest];
-        }
-        if (path_refcounts[dest][src] == 0 && net_paths[dest][src]) {
-            vector<const Route*>::iterator i;
-            for (i = net_paths[dest][src]->begin(); i != net_paths[dest][src]->end(); i++) {
-                if ((*i)->reverse())
-                    delete (*i)->reverse();
-                delete *i;
-            }
-            delete net_paths[dest][src];
-        }
+        net_paths->release(src,dest);
+        net_paths->release(dest,src);
 
         if (log_sink) {
             sinkLogger.monitorSink(ndpSnk);
         }
     }
 
-    for (size_t ix = 0; ix < no_of_nodes; ix++) {
-        delete path_refcounts[ix];
+    if (runtime_failures) {
+        // flows stop sending on source routes across failed links
+        top->add_link_listener([&ndp_srcs, &ndp_snks](const Pipe* link, bool failed) {
+                for (size_t ix = 0; ix < ndp_srcs.size(); ix++) {
+                    ndp_srcs[ix]->link_state_changed(link, failed);
+                    ndp_snks[ix]->link_state_changed(link, failed);
+                }
+            });
     }
 
     Logged::dump_idmap();
@@ -753,6 +789,21 @@ int main(int argc, char **argv) {
         bounce_pkts += ndp_srcs[ix]->_bounces_received;
     }
     cout << "New: " << new_pkts << " Rtx: " << rtx_pkts << " Bounced: " << bounce_pkts << endl;
+    cout << "Events: " << EventList::eventsRun() << " Packet hops: " << Pipe::_packets_carried << endl;
+    cout << "Peak RSS: " << MemoryStats::peakRss()/1024 << " KB" << endl;
+    if (fct_stats) {
+        fct_stats->writeSummary(fct_file);
+    }
+    if (ar_sticky == FatTreeSwitch::PER_FLOWLET) {
+        FlowletTable::report(cout);
+    }
+    if (runtime_failures) {
+        cout << "Lost on failed links: " << Pipe::_failed_drops
+             << " No route: " << FatTreeSwitch::_no_route_drops << endl;
+    }
+    if (memstats_ticks >= 0) {
+        MemoryStats::report(cout);
+    }
     /*
     list <const Route*>::iterator rt_i;
     int counts[10]; int hop;
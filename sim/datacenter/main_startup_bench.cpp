@@ -0,0 +1,75 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+// Times building a FatTreeTopology, and reports the memory it takes.
+// Static topology parameters can only be set once per process, so each
+// run builds a single topology; "make bench_startup" runs it over a
+// range of sizes.
+#include <string.h>
+#include <sys/time.h>
+#include "network.h"
+#include "eventlist.h"
+#include "memstats.h"
+#include "fat_tree_topology.h"
+
+#include "main.h"
+
+EventList eventlist;
+
+void exit_error(char* progr) {
+    cout << "Usage " << progr << " [-nodes N]\n\t[-tiers 2|3]\n\t[-build_threads n] threads used to name links, default one per core\n\t[-queue_type composite|random]" << endl;
+    exit(1);
+}
+
+static double now_ms() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+int main(int argc, char **argv) {
+    uint32_t no_of_nodes = 1024;
+    uint32_t tiers = 3;
+    queue_type qt = COMPOSITE;
+    int i = 1;
+
+    while (i<argc) {
+        if (!strcmp(argv[i],"-nodes")) {
+            no_of_nodes = atoi(argv[i+1]);
+            i++;
+        } else if (!strcmp(argv[i],"-tiers")) {
+            tiers = atoi(argv[i+1]);
+            assert(tiers == 2 || tiers == 3);
+            i++;
+        } else if (!strcmp(argv[i],"-build_threads")) {
+            FatTreeTopology::set_build_threads(atoi(argv[i+1]));
+            i++;
+        } else if (!strcmp(argv[i],"-queue_type")) {
+            if (!strcmp(argv[i+1], "composite")) {
+                qt = COMPOSITE;
+            } else if (!strcmp(argv[i+1], "random")) {
+                qt = RANDOM;
+            } else {
+                exit_error(argv[0]);
+            }
+            i++;
+        } else {
+            exit_error(argv[0]);
+        }
+        i++;
+    }
+
+    int64_t rss_before = MemoryStats::rss();
+    double start = now_ms();
+
+    FatTreeTopology::set_tiers(tiers);
+    FatTreeTopology* top = new FatTreeTopology(no_of_nodes, speedFromGbps(100), memFromPkt(35), NULL,
+                                               &eventlist, NULL, qt, timeFromUs(1.0), 0);
+
+    double elapsed = now_ms() - start;
+    int64_t rss_after = MemoryStats::rss();
+
+    cout << "startup nodes " << top->no_of_nodes()
+         << " build_ms " << elapsed
+         << " rss_mb " << (rss_after - rss_before)/(1024*1024)
+         << " total_rss_mb " << rss_after/(1024*1024) << endl;
+    return 0;
+}
@@ -15,8 +15,10 @@
 #include "loggers.h"
 #include "clock.h"
 #include "swift.h"
+#include "fct_stats.h"
 #include "compositequeue.h"
 //#include "firstfit.h"
+#include "path_service.h"
 #include "topology.h"
 #include "connection_matrix.h"
 //#include "vl2_topology.h"
@@ -69,6 +71,7 @@ int main(int argc, char **argv) {
     simtime_picosec endtime = timeFromMs(1.2);
     char* tm_file = NULL;
     char* topo_file = NULL;
+    char* fct_file = NULL;
 
     int i = 1;
     filename << "logout.dat";
@@ -95,6 +98,9 @@ int main(int argc, char **argv) {
         } else if (!strcmp(argv[i],"-cwnd")){
             cwnd = atoi(argv[i+1]);
             i++;
+        } else if (!strcmp(argv[i],"-fct_stats")){
+            fct_file = argv[i+1];
+            i++;
         } else if (!strcmp(argv[i],"-flowsize")){
             flowsize = atoi(argv[i+1]);
             i++;
@@ -152,6 +158,12 @@ int main(int argc, char **argv) {
     //Logfile 
     Logfile logfile(filename.str(), eventlist);
 
+    FctStatsCollector* fct_stats = NULL;
+    if (fct_file) {
+        // RTT is per-link delay; the longest fat tree path has 12 links round trip
+        fct_stats = new FctStatsCollector(linkspeed, 12 * timeFromUs(RTT));
+    }
+
 #if PRINT_PATHS
     filename << ".paths";
     cout << "Logging path choices to " << filename.str() << endl;
@@ -217,16 +229,12 @@ int main(int argc, char **argv) {
     no_of_nodes = top->no_of_nodes();
     cout << "actual nodes " << no_of_nodes << endl;
 
-    vector<const Route*>*** net_paths;
-    net_paths = new vector<const Route*>**[no_of_nodes];
+    PathService* net_paths = new PathService(top);
 
     int* is_dest = new int[no_of_nodes];
     
     for (uint32_t i=0; i<no_of_nodes; i++){
 is_dest[i] = 0;
-        net_paths[i] = new vector<const Route*>*[no_of_nodes];
-        for (uint32_t j = 0; j<no_of_nodes; j++)
-            net_paths[i][j] = NULL;
     }
 
     // Permutation connections
@@ -265,17 +273,13 @@ is_dest[i] = 0;
         uint32_t dest = crt->dst;
         
         connID++;
-        if (!net_paths[src][dest]) {
-            vector<const Route*>* paths = top->get_paths(src,dest);
-            net_paths[src][dest] = paths;
+        if (!net_paths->has_paths(src,dest)) {
+            vector<const Route*>* paths = net_paths->get_paths(src,dest);
             for (uint32_t p = 0; p < paths->size(); p++) {
                 routes.push_back((*paths)[p]);
             }
         }
-        if (!net_paths[dest][src]) {
-            vector<const Route*>* paths = top->get_paths(dest,src);
-            net_paths[dest][src] = paths;
-        }
+        vector<const Route*>* pair_paths = net_paths->get_paths(src,dest);
 
         swiftSrc = new SwiftSrc(swiftRtxScanner, NULL, NULL, eventlist);
         swiftSrc->set_cwnd(cwnd*Packet::data_packet_size());
@@ -296,6 +300,9 @@ is_dest[i] = 0;
 
         swiftSrc->setName("swift_" + ntoa(src) + "_" + ntoa(dest));
         logfile.writeName(*swiftSrc);
+        if (fct_stats) {
+            swiftSrc->logFlowEvents(*fct_stats);
+        }
 
         if (no_of_subflows>1)
             swiftSnk->setName("mpswift_sink_" + ntoa(src) + "_" + ntoa(dest));
@@ -308,24 +315,24 @@ is_dest[i] = 0;
         uint32_t choice = 0;
           
 #ifdef FAT_TREE
-        choice = rand()%net_paths[src][dest]->size();
+        choice = rand()%pair_paths->size();
 #endif
           
 #ifdef OV_FAT_TREE
-        choice = rand()%net_paths[src][dest]->size();
+        choice = rand()%pair_paths->size();
 #endif
           
 #ifdef MH_FAT_TREE
-        int use_all = it_sub==net_paths[src][dest]->size();
+        int use_all = it_sub==pair_paths->size();
 
         if (use_all)
             choice = inter;
         else
-            choice = rand()%net_paths[src][dest]->size();
+            choice = rand()%pair_paths->size();
 #endif
           
 #ifdef VL2
-        choice = rand()%net_paths[src][dest]->size();
+        choice = rand()%pair_paths->size();
 #endif
           
 #ifdef STAR
@@ -338,34 +345,34 @@ is_dest[i] = 0;
         int min = -1, max = -1,minDist = 1000,maxDist = 0;
         if (subflow_count==1){
             //find shortest and longest path 
-            for (uint32_t dd=0;dd<net_paths[src][dest]->size();dd++){
-                if (net_paths[src][dest]->at(dd)->size()<minDist){
-                    minDist = net_paths[src][dest]->at(dd)->size();
+            for (uint32_t dd=0;dd<pair_paths->size();dd++){
+                if (pair_paths->at(dd)->size()<minDist){
+                    minDist = pair_paths->at(dd)->size();
                     min = dd;
                 }
-                if (net_paths[src][dest]->at(dd)->size()>maxDist){
-                    maxDist = net_paths[src][dest]->at(dd)->size();
+                if (pair_paths->at(dd)->size()>maxDist){
+                    maxDist = pair_paths->at(dd)->size();
                     max = dd;
                 }
             }
             choice = min;
         } 
         else
-            choice = rand()%net_paths[src][dest]->size();
+            choice = rand()%pair_paths->size();
 #endif
-        if (choice>=net_paths[src][dest]->size()){
-            printf("Weird path choice %d out of %lu\n",choice,net_paths[src][dest]->size());
+        if (choice>=pair_paths->size()){
+            printf("Weird path choice %d out of %lu\n",choice,pair_paths->size());
             exit(1);
         }
           
 #if PRINT_PATHS
-        for (uint32_t ll=0;ll<net_paths[src][dest]->size();ll++){
+        for (uint32_t ll=0;ll<pair_paths->size();ll++){
             paths << "Route from "<< ntoa(src) << " to " << ntoa(dest) << "  (" << ll << ") -> " ;
-            print_path(paths,net_paths[src][dest]->at(ll));
+            print_path(paths,pair_paths->at(ll));
         }
 #endif
           
-        routeout = new Route(*(net_paths[src][dest]->at(choice)));
+        routeout = new Route(*(pair_paths->at(choice)));
         //routeout->push_back(swiftSnk);
           
         routein = new Route(*top->get_paths(dest,src)->at(choice));
@@ -374,7 +381,7 @@ is_dest[i] = 0;
         if (no_of_subflows == 1) {
             swiftSrc->connect(*routeout, *routein, *swiftSnk, timeFromUs((uint32_t)crt->start));
         }
-        swiftSrc->set_paths(net_paths[src][dest]);
+        swiftSrc->set_paths(pair_paths);
         if (no_of_subflows > 1) {
             // could probably use this for single-path case too, but historic reasons
             cout << "will start subflow " << c << " at " << crt->start << endl;
@@ -405,6 +412,9 @@ is_dest[i] = 0;
     }
 
     cout << "Done" << endl;
+    if (fct_stats) {
+        fct_stats->writeSummary(fct_file);
+    }
 
 #if PRINT_PATHS
     list <const Route*>::iterator rt_i;
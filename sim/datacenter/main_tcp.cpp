@@ -11,12 +11,14 @@
 #include "shortflows.h"
 #include "pipe.h"
 #include "eventlist.h"
+#include "memstats.h"
 #include "logfile.h"
 #include "loggers.h"
 #include "clock.h"
 #include "mtcp.h"
 #include "tcp.h"
 #include "tcp_transfer.h"
+#include "fct_stats.h"
 #include "cbr.h"
 #include "firstfit.h"
 #include "topology.h"
@@ -50,7 +52,7 @@ size_t subflow_count = 1;
 EventList eventlist;
 
 void exit_error(char* progr) {
-    cout << "Usage " << progr << " [UNCOUPLED(DEFAULT)|COUPLED_INC|FULLY_COUPLED|COUPLED_EPSILON] [epsilon][COUPLED_SCALABLE_TCP" << endl;
+    cout << "Usage " << progr << " [-nodes N] [-conns C] [-seed random_seed] [-end end_time_in_usec] [-shortflows flows_per_sec] [-flowsize_cdf file] [UNCOUPLED(DEFAULT)|COUPLED_INC|FULLY_COUPLED|COUPLED_EPSILON] [epsilon][COUPLED_SCALABLE_TCP" << endl;
     exit(1);
 }
 
@@ -74,6 +76,10 @@ int main(int argc, char **argv) {
     double epsilon = 1;
     uint32_t no_of_conns = 0, no_of_nodes = DEFAULT_NODES;
     stringstream filename(ios_base::out);
+    char* fct_file = NULL;
+    double shortflow_rate = 0;
+    FlowSizeCdf* flow_sizes = NULL;
+    int seed = time(NULL);
 
     int i = 1;
     filename << "logout.dat";
@@ -84,6 +90,22 @@ int main(int argc, char **argv) {
             filename << argv[i+1];
             i++;
         }
+        else if (!strcmp(argv[i],"-fct_stats")){
+            fct_file = argv[i+1];
+            i++;
+        }
+        else if (!strcmp(argv[i],"-shortflows")){
+            shortflow_rate = atof(argv[i+1]);
+            cout << "short flow arrivals/sec " << shortflow_rate << endl;
+            i++;
+        }
+        else if (!strcmp(argv[i],"-flowsize_cdf")){
+            flow_sizes = new FlowSizeCdf();
+            if (!flow_sizes->load(argv[i+1]))
+                exit(1);
+            cout << "short flow sizes from " << argv[i+1] << " mean " << flow_sizes->mean() << endl;
+            i++;
+        }
         else if (!strcmp(argv[i],"-sub")){
             subflow_count = atoi(argv[i+1]);
             i++;
@@ -95,6 +117,13 @@ int main(int argc, char **argv) {
             no_of_nodes = atoi(argv[i+1]);
             cout << "no_of_nodes "<<no_of_nodes << endl;
             i++;
+        } else if (!strcmp(argv[i],"-seed")){
+            seed = atoi(argv[i+1]);
+            cout << "random seed "<< seed << endl;
+            i++;
+        } else if (!strcmp(argv[i],"-end")){
+            eventlist.setEndtime(timeFromUs((uint32_t)atoi(argv[i+1])));
+            i++;
         } else if (!strcmp(argv[i], "UNCOUPLED"))
             algo = UNCOUPLED;
         else if (!strcmp(argv[i], "COUPLED_INC"))
@@ -117,7 +146,7 @@ int main(int argc, char **argv) {
 
         i++;
     }
-    srand(time(NULL));
+    srand(seed);
       
     cout << "Using subflow count " << subflow_count <<endl;
     cout << "conns " << no_of_conns << endl;
@@ -131,6 +160,12 @@ int main(int argc, char **argv) {
     //Logfile 
     Logfile logfile(filename.str(), eventlist);
 
+    FctStatsCollector* fct_stats = NULL;
+    if (fct_file) {
+        // RTT is per-link delay; the longest fat tree path has 12 links round trip
+        fct_stats = new FctStatsCollector(linkspeed, 12 * timeFromUs(RTT));
+    }
+
 #if PRINT_PATHS
     filename << ".paths";
     cout << "Logging path choices to " << filename.str() << endl;
@@ -204,16 +239,12 @@ int main(int argc, char **argv) {
     no_of_nodes = top->no_of_nodes();
     cout << "actual nodes " << no_of_nodes << endl;
 
-    vector<const Route*>*** net_paths;
-    net_paths = new vector<const Route*>**[no_of_nodes];
+    PathService* net_paths = new PathService(top);
 
     int* is_dest = new int[no_of_nodes];
     
     for (uint32_t i=0;i<no_of_nodes;i++){
         is_dest[i] = 0;
-        net_paths[i] = new vector<const Route*>*[no_of_nodes];
-        for (uint32_t j = 0;j<no_of_nodes;j++)
-            net_paths[i][j] = NULL;
     }
     
     if (ff)
@@ -250,8 +281,7 @@ int main(int argc, char **argv) {
         for (uint32_t dst_id = 0;dst_id<destinations->size();dst_id++){
             connID++;
             dest = destinations->at(dst_id);
-            if (!net_paths[src][dest])
-                net_paths[src][dest] = top->get_paths(src,dest);
+            vector<const Route*>* pair_paths = net_paths->get_paths(src,dest);
 
             /*bool cbr = 1;
               if (cbr){
@@ -265,14 +295,14 @@ int main(int argc, char **argv) {
               logfile.writeName(*cbrSnk);
               
               // tell it the route
-              if (net_paths[src][dest]->size()==1){
+              if (pair_paths->size()==1){
               choice = 0;
               }
               else {
-              choice = rand()%net_paths[src][dest]->size();
+              choice = rand()%pair_paths->size();
               }
               
-              routeout = new Route(*(net_paths[src][dest]->at(choice)));
+              routeout = new Route(*(pair_paths->at(choice)));
               routeout->push_back(cbrSnk);
           
               cbrSrc->connect(*routeout, *cbrSnk, timeFromMs(0));
@@ -301,10 +331,10 @@ int main(int argc, char **argv) {
                     tot_subs += crt_subflow_count;
                     cnt_con ++;
 
-                    it_sub = crt_subflow_count > net_paths[src][dest]->size()?net_paths[src][dest]->size():crt_subflow_count;
+                    it_sub = crt_subflow_count > pair_paths->size()?pair_paths->size():crt_subflow_count;
 
 #ifdef MH_FAT_TREE
-                    int use_all = it_sub==net_paths[src][dest]->size();
+                    int use_all = it_sub==pair_paths->size();
 #endif
                     //if (connID%10!=0)
                     //it_sub = 1;
@@ -315,7 +345,7 @@ int main(int argc, char **argv) {
                         tcpSnk = new TcpSink();
                         /*}
                           else {
-                          tcpSrc = new TcpSrcTransfer(NULL,NULL,eventlist,bb,net_paths[src][dest]);
+                          tcpSrc = new TcpSrcTransfer(NULL,NULL,eventlist,bb,pair_paths);
                           tcpSnk = new TcpSinkTransfer();
                           }*/
 
@@ -324,6 +354,9 @@ int main(int argc, char **argv) {
               
                         tcpSrc->setName("mtcp_" + ntoa(src) + "_" + ntoa(inter) + "_" + ntoa(dest)+"("+ntoa(connection)+")");
                         logfile.writeName(*tcpSrc);
+                        if (fct_stats) {
+                            tcpSrc->logFlowEvents(*fct_stats);
+                        }
               
                         tcpSnk->setName("mtcp_sink_" + ntoa(src) + "_" + ntoa(inter) + "_" + ntoa(dest)+ "("+ntoa(connection)+")");
                         logfile.writeName(*tcpSnk);
@@ -334,10 +367,10 @@ int main(int argc, char **argv) {
                           do {
                           found = 0;
                 
-                          //if (net_paths[src][dest]->size()==K*K/4 && it_sub <= K/2)
+                          //if (pair_paths->size()==K*K/4 && it_sub <= K/2)
                           //choice = rand()%(K/2);
                           //else 
-                          choice = rand()%net_paths[src][dest]->size();
+                          choice = rand()%pair_paths->size();
                 
                           for (uint32_t cnt = 0;cnt<subflows_chosen.size();cnt++){
                           if (subflows_chosen.at(cnt)==choice){
@@ -350,22 +383,22 @@ int main(int argc, char **argv) {
                         size_t choice = 0;
 
 #ifdef FAT_TREE
-                        choice = rand()%net_paths[src][dest]->size();
+                        choice = rand()%pair_paths->size();
 #endif
 
 #ifdef OV_FAT_TREE
-                        choice = rand()%net_paths[src][dest]->size();
+                        choice = rand()%pair_paths->size();
 #endif
 
 #ifdef MH_FAT_TREE
                         if (use_all)
                             choice = inter;
                         else
-                            choice = rand()%net_paths[src][dest]->size();
+                            choice = rand()%pair_paths->size();
 #endif
 
 #ifdef VL2
-                        choice = rand()%net_paths[src][dest]->size();
+                        choice = rand()%pair_paths->size();
 #endif
 
 #ifdef STAR
@@ -378,37 +411,37 @@ int main(int argc, char **argv) {
                         int min = -1, max = -1,minDist = 1000,maxDist = 0;
                         if (subflow_count==1){
                             //find shortest and longest path 
-                            for (uint32_t dd=0;dd<net_paths[src][dest]->size();dd++){
-                                if (net_paths[src][dest]->at(dd)->size()<minDist){
-                                    minDist = net_paths[src][dest]->at(dd)->size();
+                            for (uint32_t dd=0;dd<pair_paths->size();dd++){
+                                if (pair_paths->at(dd)->size()<minDist){
+                                    minDist = pair_paths->at(dd)->size();
                                     min = dd;
                                 }
-                                if (net_paths[src][dest]->at(dd)->size()>maxDist){
-                                    maxDist = net_paths[src][dest]->at(dd)->size();
+                                if (pair_paths->at(dd)->size()>maxDist){
+                                    maxDist = pair_paths->at(dd)->size();
                                     max = dd;
                                 }
                             }
                             choice = min;
                         } else
-                            choice = rand()%net_paths[src][dest]->size();
+                            choice = rand()%pair_paths->size();
 #endif
-                        //cout << "Choice "<<choice<<" out of "<<net_paths[src][dest]->size();
+                        //cout << "Choice "<<choice<<" out of "<<pair_paths->size();
                         subflows_chosen.push_back(choice);
 
-                        /*if (net_paths[src][dest]->size()==K*K/4 && it_sub<=K/2){
+                        /*if (pair_paths->size()==K*K/4 && it_sub<=K/2){
                           uint32_t choice2 = rand()%(K/2);*/
 
-                        if (choice>=net_paths[src][dest]->size()){
-                            printf("Weird path choice %lu out of %lu\n",choice,net_paths[src][dest]->size());
+                        if (choice>=pair_paths->size()){
+                            printf("Weird path choice %lu out of %lu\n",choice,pair_paths->size());
                             exit(1);
                         }
                 
 #if PRINT_PATHS
                         paths << "Route from "<< ntoa(src) << " to " << ntoa(dest) << "  (" << choice << ") -> " ;
-                        print_path(paths,net_paths[src][dest]->at(choice));
+                        print_path(paths,pair_paths->at(choice));
 #endif
 
-                        routeout = new Route(*(net_paths[src][dest]->at(choice)));
+                        routeout = new Route(*(pair_paths->at(choice)));
                         routeout->push_back(tcpSnk);
               
                         routein = new Route();
@@ -427,7 +460,7 @@ int main(int argc, char **argv) {
                         tcpSrc->connect(*routeout, *routein, *tcpSnk, timeFromMs(extrastarttime));
             
 #ifdef PACKET_SCATTER
-                        tcpSrc->set_paths(net_paths[src][dest]);
+                        tcpSrc->set_paths(pair_paths);
                         cout << "Using PACKET SCATTER!!!!"<<endl;
 #endif
               
@@ -440,7 +473,14 @@ int main(int argc, char **argv) {
             }
         }
     }
-    //    ShortFlows* sf = new ShortFlows(2560, eventlist, net_paths,conns,lg, &tcpRtxScanner);
+    ShortFlows* sf = NULL;
+    if (shortflow_rate > 0) {
+        sf = new ShortFlows(shortflow_rate, eventlist, net_paths, conns, &logfile, &tcpRtxScanner);
+        if (flow_sizes)
+            sf->setFlowSizes(flow_sizes);
+        if (fct_stats)
+            sf->logFlowEvents(*fct_stats);
+    }
 
     cout << "Mean number of subflows " << ntoa((double)tot_subs/cnt_con)<<endl;
 
@@ -457,4 +497,13 @@ int main(int argc, char **argv) {
     // GO!
     while (eventlist.doNextEvent()) {
     }
+    cout << endl << "Events: " << EventList::eventsRun() << " Packet hops: " << Pipe::_packets_carried << endl;
+    cout << "Peak RSS: " << MemoryStats::peakRss()/1024 << " KB" << endl;
+
+    if (sf) {
+        sf->report(cout);
+    }
+    if (fct_stats) {
+        fct_stats->writeSummary(fct_file);
+    }
 }
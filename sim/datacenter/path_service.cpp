@@ -0,0 +1,41 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#include "path_service.h"
+
+PathService::PathService(Topology* top, bool reverse) : _top(top), _reverse(reverse) {
+}
+
+vector<const Route*>* PathService::get_paths(uint32_t src, uint32_t dest) {
+    PairPaths& pair = _pairs[pairKey(src, dest)];
+    if (!pair.paths) {
+        pair.paths = _reverse ? _top->get_paths(src, dest) : _top->get_bidir_paths(src, dest, false);
+        assert(pair.paths && !pair.paths->empty());
+    }
+    return pair.paths;
+}
+
+bool PathService::has_paths(uint32_t src, uint32_t dest) const {
+    unordered_map<uint64_t, PairPaths>::const_iterator i = _pairs.find(pairKey(src, dest));
+    return i != _pairs.end() && i->second.paths;
+}
+
+void PathService::hold(uint32_t src, uint32_t dest) {
+    _pairs[pairKey(src, dest)].holders++;
+}
+
+void PathService::release(uint32_t src, uint32_t dest) {
+    unordered_map<uint64_t, PairPaths>::iterator i = _pairs.find(pairKey(src, dest));
+    assert(i != _pairs.end() && i->second.holders > 0);
+    if (--i->second.holders > 0)
+        return;
+
+    vector<const Route*>* paths = i->second.paths;
+    if (paths) {
+        for (vector<const Route*>::iterator r = paths->begin(); r != paths->end(); r++) {
+            if ((*r)->reverse())
+                delete (*r)->reverse();
+            delete *r;
+        }
+        delete paths;
+    }
+    _pairs.erase(i);
+}
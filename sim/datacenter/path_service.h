@@ -0,0 +1,48 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef PATH_SERVICE_H
+#define PATH_SERVICE_H
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include "network.h"
+#include "topology.h"
+
+// Paths between pairs of hosts, built from the topology the first time
+// a pair is asked for and then shared by every user of that pair.  Only
+// pairs that carry traffic ever have an entry, so memory grows with the
+// number of active pairs rather than with the square of the number of
+// hosts.
+class PathService {
+public:
+    // reverse: also build the reverse route of every path, as
+    // Topology::get_paths() does.  Otherwise forward routes only.
+    PathService(Topology* top, bool reverse = true);
+
+    // never NULL; the vector is owned by the service
+    vector<const Route*>* get_paths(uint32_t src, uint32_t dest);
+    bool has_paths(uint32_t src, uint32_t dest) const;
+
+    // Drivers that build all their connections up front can hold a
+    // pair once per connection that uses it, and release it once that
+    // connection is set up.  The routes are freed with the last release.
+    // Pairs that are never held keep their paths for the whole run.
+    void hold(uint32_t src, uint32_t dest);
+    void release(uint32_t src, uint32_t dest);
+
+    size_t active_pairs() const {return _pairs.size();}
+
+private:
+    struct PairPaths {
+        PairPaths() : paths(NULL), holders(0) {}
+        vector<const Route*>* paths;
+        uint32_t holders;
+    };
+    static uint64_t pairKey(uint32_t src, uint32_t dest) {return ((uint64_t)src << 32) | dest;}
+
+    Topology* _top;
+    bool _reverse;
+    unordered_map<uint64_t, PairPaths> _pairs;
+};
+
+#endif
@@ -4,72 +4,108 @@
 string ntoa(double n);
 string itoa(uint64_t n);
 
-ShortFlows::ShortFlows(double lambda, EventList& eventlist, vector<const Route*>*** n,
+////////////////////////////////////////////////////////////////
+//  Short flows
+////////////////////////////////////////////////////////////////
+
+ShortFlow::ShortFlow(ShortFlows& owner, int src_host, int dst_host)
+    : EventSource(owner.eventlist(), "ShortFlow"), _owner(owner)
+{
+    _src_host = src_host;
+    _dst_host = dst_host;
+    src = NULL;
+    snk = NULL;
+}
+
+void ShortFlow::doNextEvent() {
+    _owner.flowFinished(this);
+}
+
+ShortFlows::ShortFlows(double lambda, EventList& eventlist, PathService* n,
                        ConnectionMatrix* conns,Logfile* logfile,TcpRtxTimerScanner * rtx)
-  : EventSource(eventlist,"ShortFlows")
+    : EventSource(eventlist,"ShortFlows")
 {
-  eventlist.sourceIsPendingRel(*this, timeFromMs(1000));
-  net_paths = n;
-  _traffic_matrix = conns->getAllConnections();
-  this->logfile = logfile;
-  this->_lambda = lambda;
+    net_paths = n;
+    _traffic_matrix = conns->getAllConnections();
+    this->logfile = logfile;
+    this->_lambda = lambda;
+    _flow_size = 70000;
+    _sizes = NULL;
+    _flow_logger = NULL;
+    _arrivals = 0;
+    _created = 0;
+    _finished = 0;
+
+    tcpRtxScanner = rtx;
 
-  tcpRtxScanner = rtx;
+    eventlist.sourceIsPendingRel(*this, (simtime_picosec)(exponential(_lambda)*timeFromSec(1)));
 }
 
-ShortFlow* ShortFlows::createConnection(int src, int dst, simtime_picosec starttime){
-    ShortFlow* f = new ShortFlow();
-    f->src = new TcpSrcTransfer(NULL,NULL,eventlist(),70000,net_paths[src][dst]);
+ShortFlow* ShortFlows::createConnection(int src, int dst, simtime_picosec starttime, uint64_t bytes){
+    ShortFlow* f = new ShortFlow(*this, src, dst);
+    vector<const Route*>* paths = net_paths->get_paths(src,dst);
+    f->src = new TcpSrcTransfer(NULL,NULL,eventlist(),bytes,paths,f);
     f->snk = new TcpSinkTransfer();
 
-    int pos = connections[src][dst].size();
-
-    f->src->setName("sf_" + ntoa(src) + "_" + ntoa(dst)+"("+ntoa(pos)+")");
+    f->src->setName("sf_" + ntoa(src) + "_" + ntoa(dst)+"("+ntoa(_created)+")");
     logfile->writeName(*(f->src));
-              
-    f->snk->setName("sf_sink_" + ntoa(src) + "_" + ntoa(dst)+ "("+ntoa(pos)+")");
+
+    f->snk->setName("sf_sink_" + ntoa(src) + "_" + ntoa(dst)+ "("+ntoa(_created)+")");
     logfile->writeName(*(f->snk));
-    
+
     tcpRtxScanner->registerTcp(*(f->src));
+    if (_flow_logger)
+        f->src->logFlowEvents(*_flow_logger);
 
-    int choice = rand()%net_paths[src][dst]->size();
+    int choice = rand()%paths->size();
 
-    Route* routeout = new Route(*(net_paths[src][dst]->at(choice)));
+    Route* routeout = new Route(*(paths->at(choice)));
     routeout->push_back(f->snk);
-    
+
     Route* routein = new Route();
     routein->push_back(f->src);
-    
+
     f->src->connect(*routeout, *routein, *(f->snk), starttime);
+    _created++;
     return f;
 }
 
+void ShortFlows::flowFinished(ShortFlow* f) {
+    _finished++;
+    _idle[pairKey(f->_src_host, f->_dst_host)].push_back(f);
+}
+
 void ShortFlows::doNextEvent() {
-  run();
-  
-  simtime_picosec nextArrival = (simtime_picosec)(exponential(_lambda)*timeFromSec(1));
-  eventlist().sourceIsPendingRel(*this, nextArrival);
+    run();
+
+    simtime_picosec nextArrival = (simtime_picosec)(exponential(_lambda)*timeFromSec(1));
+    eventlist().sourceIsPendingRel(*this, nextArrival);
 }
 
 void ShortFlows::run(){
-  //randomly choose connection to activate.
-  int pos = rand()%_traffic_matrix->size();
-
-  //look for inactive connection
-  connection* c = _traffic_matrix->at(pos);
-  
-  ShortFlow* f = NULL;
-  for (unsigned int i=0;i<connections[c->src][c->dst].size();i++){
-    f = connections[c->src][c->dst][i];
-    if (!f->src->_is_active)
-      break;
-  }
-
-  if (!f||f->src->_is_active){
-    f = createConnection(c->src,c->dst,eventlist().now());
-    connections[c->src][c->dst].push_back(f);
-  }
-  else {
-    f->src->reset(70000, true);
-  }
+    //randomly choose connection to activate.
+    int pos = rand()%_traffic_matrix->size();
+    connection* c = _traffic_matrix->at(pos);
+    uint64_t bytes = _sizes ? _sizes->sample() : _flow_size;
+    _arrivals++;
+
+    //reuse a finished flow between the same hosts if there is one
+    unordered_map<uint64_t, vector<ShortFlow*> >::iterator i = _idle.find(pairKey(c->src, c->dst));
+    if (i == _idle.end()) {
+        createConnection(c->src, c->dst, eventlist().now(), bytes);
+        return;
+    }
+    ShortFlow* f = i->second.back();
+    i->second.pop_back();
+    if (i->second.empty())
+        _idle.erase(i);
+    f->src->restart(bytes, eventlist().now());
+}
+
+void ShortFlows::report(ostream& out) {
+    out << "# short flows arrivals " << _arrivals
+        << " finished " << _finished
+        << " active " << active()
+        << " created " << _created
+        << " reused " << _arrivals - _created << endl;
 }
@@ -10,36 +10,73 @@
 #include "tcp_transfer.h"
 #include <list>
 #include <map>
+#include <unordered_map>
 #include "connection_matrix.h"
+#include "path_service.h"
+#include "workload.h"
+
+class ShortFlows;
+
+// A short flow's TCP source and sink.  The source tells us when it has
+// finished, and the flow is kept for the next arrival between the same
+// pair of hosts rather than being thrown away.
+class ShortFlow : public EventSource {
+public:
+    ShortFlow(ShortFlows& owner, int src_host, int dst_host);
+    // called by the source when its transfer completes
+    virtual void doNextEvent();
 
-struct ShortFlow{
     TcpSrcTransfer* src;
-    TcpSinkTransfer* snk; 
+    TcpSinkTransfer* snk;
+    int _src_host;
+    int _dst_host;
+private:
+    ShortFlows& _owner;
 };
 
+// Open-loop short flow arrivals: flows arrive as a Poisson process of
+// rate l per second, between a random pair from the connection matrix,
+// whether or not earlier flows have finished.  Finished flows are
+// pooled per pair and reused, so memory is bounded by the number of
+// flows in flight, not by the length of the run.
 class ShortFlows: public EventSource{
 public:
-    ShortFlows(double l, EventList& eventlist, vector<const Route*>*** np, ConnectionMatrix* c,
+    ShortFlows(double l, EventList& eventlist, PathService* np, ConnectionMatrix* c,
                Logfile* logfile,TcpRtxTimerScanner* r);
     void doNextEvent();
 
     void run();
 
+    // flow sizes are drawn from sizes if set, else all are flow_size bytes
+    void setFlowSize(uint64_t flow_size) {_flow_size = flow_size;}
+    void setFlowSizes(FlowSizeCdf* sizes) {_sizes = sizes;}
+    void logFlowEvents(FlowEventLogger& flow_logger) {_flow_logger = &flow_logger;}
 
-    ShortFlow* createConnection(int src, int dst, simtime_picosec starttime);
-    vector<const Route*>*** net_paths;
+    ShortFlow* createConnection(int src, int dst, simtime_picosec starttime, uint64_t bytes = 70000);
+    void flowFinished(ShortFlow* f);
+
+    uint64_t active() const {return _arrivals - _finished;}
+    void report(ostream& out);
+
+    PathService* net_paths;
 private:
-    vector<ShortFlow*> connections[1024][1024];
+    static uint64_t pairKey(int src, int dst) {return ((uint64_t)src << 32) | (uint32_t)dst;}
+
+    // finished flows, by (src, dst).  Only pairs with idle flows have
+    // an entry.
+    unordered_map<uint64_t, vector<ShortFlow*> > _idle;
     vector<connection*>* _traffic_matrix;
     Logfile* logfile;
 
-    //create connections periodically
-    //change path
-    //start
-    //log finish time when it's done
-  
-    double _lambda;  
+    double _lambda;
+    uint64_t _flow_size;
+    FlowSizeCdf* _sizes;
+    FlowEventLogger* _flow_logger;
     TcpRtxTimerScanner* tcpRtxScanner;
+
+    uint64_t _arrivals;
+    uint64_t _created;
+    uint64_t _finished;
 };
 
 #endif
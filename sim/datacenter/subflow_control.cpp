@@ -4,7 +4,7 @@
 
 SubflowControl::SubflowControl(simtime_picosec scanPeriod, Logfile* lg, SinkLoggerSampling* sl,
                                EventList& eventlist, TcpRtxTimerScanner* rtx,  
-                               vector<const Route*>*** n, std::ofstream* p, int ms) 
+                               PathService* n, std::ofstream* p, int ms) 
   : EventSource(eventlist,"SubflowControl"), _scanPeriod(scanPeriod)
 {
   eventlist.sourceIsPendingRel(*this, _scanPeriod);
@@ -57,11 +57,12 @@ void SubflowControl::run(){
     delta = crt_counter-f->byte_counter;
 
     int counts = f->byte_counter!=0;
+    vector<const Route*>* pair_paths = net_paths->get_paths(f->src,f->dest);
 
     f->byte_counter = crt_counter;
 
     //    cout << "Delta " << delta << "subs " <<f->subflows->size() << "max " << _max_subflows << "counts " << counts << endl ;
-    if (counts && delta<threshold && f->subflows->size()<_max_subflows && f->subflows->size()<net_paths[f->src][f->dest]->size()){
+    if (counts && delta<threshold && f->subflows->size()<_max_subflows && f->subflows->size()<pair_paths->size()){
       //add new subflow!
       TcpSrc* tcpSrc = new TcpSrc(NULL, NULL, eventlist());
       TcpSink* tcpSnk = new TcpSink();
@@ -79,7 +80,7 @@ void SubflowControl::run(){
       do {
         found = 0;
                 
-        if (net_paths[f->src][f->dest]->size()==K*K/4 && f->subflows->size() < K/2){
+        if (pair_paths->size()==K*K/4 && f->subflows->size() < K/2){
           assert(f->structure->size()==f->subflows->size());
           choice = rand()%(K/2);
 
@@ -91,7 +92,7 @@ void SubflowControl::run(){
           }
         }
         else {
-          choice = rand()%net_paths[f->src][f->dest]->size();
+          choice = rand()%pair_paths->size();
         
           for (unsigned int cnt = 0;cnt<f->subflows->size();cnt++){
             if (f->subflows->at(cnt)==choice){
@@ -102,7 +103,7 @@ void SubflowControl::run(){
         }
       }while(found);
 
-      if (net_paths[f->src][f->dest]->size()==K*K/4 && f->subflows->size() < K/2){
+      if (pair_paths->size()==K*K/4 && f->subflows->size() < K/2){
         f->structure->push_back(choice);
         choice = choice * K/2 + rand()%2;
       }
@@ -111,7 +112,7 @@ void SubflowControl::run(){
 
       //cout << endl << ntoa(f->subflows->size()) << " subflows between " << ntoa(f->src) << " and " << ntoa(f->dest) << " at " << timeAsMs(eventlist().now()) << endl ;
 
-      Route* routeout = new Route(*(net_paths[f->src][f->dest]->at(choice)));
+      Route* routeout = new Route(*(pair_paths->at(choice)));
       routeout->push_back(tcpSnk);
               
       Route* routein = new Route();
@@ -6,6 +6,7 @@
 #include "randomqueue.h"
 #include "eventlist.h"
 #include "loggers.h"
+#include "path_service.h"
 #include <list>
 #include <iostream>
 #include <map>
@@ -32,7 +33,7 @@ struct multipath_flow_entry {
 class SubflowControl: public EventSource{
  public:
   SubflowControl(simtime_picosec scanPeriod, Logfile* lg, SinkLoggerSampling* sl,
-                 EventList& eventlist, TcpRtxTimerScanner* rtx, vector<const Route*>*** np, 
+                 EventList& eventlist, TcpRtxTimerScanner* rtx, PathService* np, 
                  std::ofstream* p,int max_subflows);
   void doNextEvent();
 
@@ -41,7 +42,7 @@ class SubflowControl: public EventSource{
   void add_flow(int src,int dest,MultipathTcpSrc* flow);
   void add_subflow(MultipathTcpSrc* m, int subflow, int structure = -1);
 
-  vector<const Route*>*** net_paths;
+  PathService* net_paths;
   std::ofstream* paths;
 
   void print_stats();
@@ -19,6 +19,11 @@ public:
     virtual void add_switch_loggers(Logfile& log, simtime_picosec sample_period) {
         abort();
     }
+
+    // add a single logger that summarises queue depth and utilization per port, switch, tier and pod
+    virtual void add_aggregate_switch_logger(Logfile& log, simtime_picosec sample_period, uint32_t levels) {
+        abort();
+    }
 };
 
 #endif
@@ -0,0 +1,230 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#include "workload.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+////////////////////////////////////////////////////////////////
+//  Flow size distribution
+////////////////////////////////////////////////////////////////
+
+bool FlowSizeCdf::load(const string& filename) {
+    ifstream in(filename.c_str());
+    if (!in) {
+        cerr << "Failed to open flow size CDF " << filename << endl;
+        return false;
+    }
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        stringstream ss(line);
+        uint64_t size;
+        double cdf;
+        if (!(ss >> size >> cdf)) {
+            cerr << "Bad line in flow size CDF " << filename << ": " << line << endl;
+            return false;
+        }
+        add(size, cdf);
+    }
+    if (_cdf.empty() || _cdf.back() != 1.0) {
+        cerr << "Flow size CDF " << filename << " must end with cdf 1" << endl;
+        return false;
+    }
+    return true;
+}
+
+void FlowSizeCdf::add(uint64_t size, double cdf) {
+    assert(cdf >= 0 && cdf <= 1);
+    assert(_sizes.empty() || (size >= _sizes.back() && cdf >= _cdf.back()));
+    _sizes.push_back(size);
+    _cdf.push_back(cdf);
+}
+
+uint64_t FlowSizeCdf::sample(double u) const {
+    assert(!_sizes.empty());
+    size_t i = lower_bound(_cdf.begin(), _cdf.end(), u) - _cdf.begin();
+    if (i == 0)
+        return _sizes[0];
+    if (i >= _sizes.size())
+        return _sizes.back();
+    double frac = (u - _cdf[i-1]) / (_cdf[i] - _cdf[i-1]);
+    return _sizes[i-1] + (uint64_t)(frac * (_sizes[i] - _sizes[i-1]));
+}
+
+double FlowSizeCdf::mean() const {
+    // sizes are uniform between points
+    double m = _sizes.empty() ? 0 : _sizes[0] * _cdf[0];
+    for (size_t i = 1; i < _sizes.size(); i++)
+        m += (_cdf[i] - _cdf[i-1]) * (_sizes[i] + _sizes[i-1]) / 2.0;
+    return m;
+}
+
+////////////////////////////////////////////////////////////////
+//  Workload generator
+////////////////////////////////////////////////////////////////
+
+void WorkloadGenerator::Stream::seed(uint64_t seed) {
+    // splitmix64 of the seed, so nearby seeds give unrelated streams
+    // and the state is never zero
+    uint64_t z = seed + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    s = (z ^ (z >> 31)) | 1;
+}
+
+uint64_t WorkloadGenerator::Stream::next() {
+    s ^= s >> 12;
+    s ^= s << 25;
+    s ^= s >> 27;
+    return s * 0x2545f4914f6cdd1dULL;
+}
+
+WorkloadGenerator::WorkloadGenerator(EventList& eventlist, uint32_t nodes, linkspeed_bps linkspeed,
+                                     double load, const FlowSizeCdf& sizes, uint64_t seed)
+    : EventSource(eventlist, "workload"), _sizes(sizes)
+{
+    assert(nodes > 1);
+    assert(load > 0);
+    assert(!sizes.empty() && sizes.mean() > 0);
+    _nodes = nodes;
+    _rate = load * nodes * linkspeed / (8.0 * sizes.mean());
+    _seed = seed;
+    _rack_size = 0;
+    _rack_fraction = 0;
+    _pod_size = 0;
+    _pod_fraction = 0;
+    _rng.seed(seed);
+    _target = NULL;
+    _stop = 0;
+    _flows = 0;
+    _bytes = 0;
+    _local_flows[0] = _local_flows[1] = 0;
+
+    _flow.flowid = 0;
+    _flow.send_done_trigger = 0;
+    _flow.recv_done_trigger = 0;
+    _flow.trigger = 0;
+    _flow.priority = 2000000;
+}
+
+void WorkloadGenerator::setLocality(uint32_t rack_size, double rack_fraction,
+                                    uint32_t pod_size, double pod_fraction) {
+    if (rack_fraction < 0 || pod_fraction < 0 || rack_fraction + pod_fraction > 1) {
+        cerr << "Workload locality fractions must be between 0 and 1, found rack "
+             << rack_fraction << " pod " << pod_fraction << endl;
+        exit(1);
+    }
+    if ((rack_fraction > 0 && rack_size < 2) || (pod_fraction > 0 && pod_size <= rack_size)
+        || (pod_size && pod_size % rack_size) || (rack_size && _nodes % rack_size)
+        || (pod_size && _nodes % pod_size)) {
+        cerr << "Workload racks of " << rack_size << " and pods of " << pod_size
+             << " hosts do not fit " << _nodes << " hosts" << endl;
+        exit(1);
+    }
+    uint32_t inner = pod_fraction > 0 ? pod_size : (rack_fraction > 0 ? rack_size : 1);
+    if (rack_fraction + pod_fraction < 1 && inner == _nodes) {
+        cerr << "Workload locality leaves no hosts for remote flows" << endl;
+        exit(1);
+    }
+    _rack_size = rack_size;
+    _rack_fraction = rack_fraction;
+    _pod_size = pod_size;
+    _pod_fraction = pod_fraction;
+}
+
+void WorkloadGenerator::start(WorkloadTarget& target, simtime_picosec start, simtime_picosec stop) {
+    _target = &target;
+    _stop = stop;
+    simtime_picosec first = start + interarrival(_rng);
+    if (_stop == 0 || first < _stop)
+        eventlist().sourceIsPending(*this, first);
+}
+
+simtime_picosec WorkloadGenerator::interarrival(Stream& rng) const {
+    return (simtime_picosec)(-log(1.0 - rng.uniform()) / _rate * timeFromSec(1));
+}
+
+// uniform in [lo,hi) but not in [skip_lo,skip_hi)
+uint32_t WorkloadGenerator::pickOutside(Stream& rng, uint32_t lo, uint32_t hi,
+                                        uint32_t skip_lo, uint32_t skip_hi) const {
+    uint32_t n = rng.below(hi - lo - (skip_hi - skip_lo));
+    if (lo + n >= skip_lo)
+        n += skip_hi - skip_lo;
+    return lo + n;
+}
+
+void WorkloadGenerator::makeFlow(Stream& rng, connection& c) const {
+    uint32_t src = rng.below(_nodes);
+    double u = rng.uniform();
+    uint32_t rack = _rack_size ? src - src % _rack_size : src;
+    uint32_t pod = _pod_size ? src - src % _pod_size : src;
+    uint32_t dst;
+    if (u < _rack_fraction) {
+        dst = pickOutside(rng, rack, rack + _rack_size, src, src + 1);
+    } else if (u < _rack_fraction + _pod_fraction) {
+        dst = pickOutside(rng, pod, pod + _pod_size, rack, rack + _rack_size);
+    } else if (_pod_fraction > 0) {
+        dst = pickOutside(rng, 0, _nodes, pod, pod + _pod_size);
+    } else if (_rack_fraction > 0) {
+        dst = pickOutside(rng, 0, _nodes, rack, rack + _rack_size);
+    } else {
+        dst = pickOutside(rng, 0, _nodes, src, src + 1);
+    }
+    c.src = src;
+    c.dst = dst;
+    c.size = _sizes.sample(rng.uniform());
+    if (c.size == 0)
+        c.size = 1;
+}
+
+void WorkloadGenerator::doNextEvent() {
+    _flow.start = eventlist().now();
+    makeFlow(_rng, _flow);
+    _flows++;
+    _bytes += _flow.size;
+    if (_rack_size && _flow.src / _rack_size == _flow.dst / _rack_size)
+        _local_flows[0]++;
+    else if (_pod_size && _flow.src / _pod_size == _flow.dst / _pod_size)
+        _local_flows[1]++;
+    _target->newFlow(_flow, NULL);
+
+    simtime_picosec next = eventlist().now() + interarrival(_rng);
+    if (_stop == 0 || next < _stop)
+        eventlist().sourceIsPending(*this, next);
+}
+
+bool WorkloadGenerator::dump(const char* filename, simtime_picosec start, simtime_picosec until) const {
+    Stream rng;
+    rng.seed(_seed);
+    connection c;
+    vector<connection> flows;
+    for (simtime_picosec t = start + interarrival(rng); t < until; t += interarrival(rng)) {
+        c.start = t;
+        makeFlow(rng, c);
+        flows.push_back(c);
+    }
+
+    FILE* f = fopen(filename, "w");
+    if (!f)
+        return false;
+    // start times are in picoseconds, as ConnectionMatrix::load expects
+    fprintf(f, "Nodes %u\nConnections %zu\n", _nodes, flows.size());
+    for (size_t i = 0; i < flows.size(); i++) {
+        fprintf(f, "%d->%d start %" PRIu64 " size %d\n", flows[i].src, flows[i].dst,
+                (uint64_t)flows[i].start, flows[i].size);
+    }
+    return fclose(f) == 0;
+}
+
+void WorkloadGenerator::report(ostream& out) {
+    out << "# workload flows " << _flows
+        << " bytes " << _bytes
+        << " in_rack " << _local_flows[0]
+        << " in_pod " << _local_flows[1]
+        << " rate " << _rate << "/s" << endl;
+}
@@ -0,0 +1,105 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "eventlist.h"
+#include "connection_matrix.h"
+
+// An empirical flow size distribution, given as points of its CDF.
+// Sizes between points are interpolated linearly, as the usual
+// published workloads (web search, data mining) are specified.
+class FlowSizeCdf {
+public:
+    // one "size cdf" pair per line, in increasing order, with the last
+    // cdf value 1.  Lines starting with # are ignored.
+    bool load(const string& filename);
+    void add(uint64_t size, double cdf);
+    uint64_t sample() const {return sample(drand());}
+    // the size at which the CDF reaches u, for u in [0,1]
+    uint64_t sample(double u) const;
+    double mean() const;
+    bool empty() const {return _sizes.empty();}
+private:
+    vector<uint64_t> _sizes;
+    vector<double> _cdf;
+};
+
+// Told about each flow a generator creates.  The connection is only
+// valid during the call.  If done is set, it is to be activated when
+// the flow finishes.
+class WorkloadTarget {
+public:
+    virtual ~WorkloadTarget() {}
+    virtual void newFlow(connection& c, Trigger* done) = 0;
+};
+
+// Open-loop flow arrivals from an empirical size distribution, generated
+// during the run rather than read from a connection matrix.
+//
+// Flows arrive as a Poisson process whose rate gives each host an
+// average offered load of load * linkspeed.  Sources are uniform; the
+// destination is in the source's rack with probability rack_fraction,
+// elsewhere in its pod with probability pod_fraction, and otherwise
+// outside the innermost of those that is in use.
+//
+// The generator has its own random number stream, so the flows depend
+// only on the seed and parameters, not on what else in the simulation
+// draws random numbers.  dump() replays the same stream into a .cm file.
+class WorkloadGenerator : public EventSource {
+public:
+    WorkloadGenerator(EventList& eventlist, uint32_t nodes, linkspeed_bps linkspeed,
+                      double load, const FlowSizeCdf& sizes, uint64_t seed);
+
+    // racks and pods are blocks of consecutive hosts of these sizes
+    void setLocality(uint32_t rack_size, double rack_fraction,
+                     uint32_t pod_size = 0, double pod_fraction = 0);
+    // generate flows starting between start and stop; stop 0 means forever.
+    void start(WorkloadTarget& target, simtime_picosec start, simtime_picosec stop = 0);
+
+    virtual void doNextEvent();
+
+    // write the flows that start between start and until as a connection
+    // matrix, without disturbing the running generator.
+    bool dump(const char* filename, simtime_picosec start, simtime_picosec until) const;
+
+    double arrivalRate() const {return _rate;}   // flows per second
+    void report(ostream& out);
+private:
+    // xorshift64*: small, fast, and the same sequence on every platform
+    struct Stream {
+        uint64_t s;
+        void seed(uint64_t seed);
+        uint64_t next();
+        double uniform() {return (next() >> 11) * (1.0 / 9007199254740992.0);}
+        uint32_t below(uint32_t n) {return (uint32_t)(uniform() * n);}
+    };
+
+    simtime_picosec interarrival(Stream& rng) const;
+    void makeFlow(Stream& rng, connection& c) const;
+    uint32_t pickOutside(Stream& rng, uint32_t lo, uint32_t hi, uint32_t skip_lo, uint32_t skip_hi) const;
+
+    uint32_t _nodes;
+    double _rate;
+    const FlowSizeCdf& _sizes;
+    uint64_t _seed;
+
+    uint32_t _rack_size;
+    double _rack_fraction;
+    uint32_t _pod_size;
+    double _pod_fraction;
+
+    Stream _rng;
+    WorkloadTarget* _target;
+    simtime_picosec _stop;
+    connection _flow;
+
+    uint64_t _flows;
+    uint64_t _bytes;
+    uint64_t _local_flows[2];  // in rack, in pod
+};
+
+#endif
@@ -68,6 +68,7 @@ ECNQueue::receivePacket(Packet & pkt)
     _enqueued.push(pkt_p);
     _queuesize += pkt.size();
     if (_logger) _logger->logQueue(*this, QueueLogger::PKT_ENQUEUE, pkt);
+    levelChanged();
 
     if (queueWasEmpty && _state_send==LosslessQueue::READY) {
         /* schedule the dequeue event */
@@ -94,6 +95,7 @@ ECNQueue::completeService()
     _queuesize -= pkt->size();
     pkt->flow().logTraffic(*pkt, *this, TrafficLogger::PKT_DEPART);
     if (_logger) _logger->logQueue(*this, QueueLogger::PKT_SERVICE, *pkt);
+    levelChanged();
 
     /* tell the packet to move on to the next pipe */
     pkt->sendOn();
@@ -247,6 +247,7 @@ EqdsSrc::EqdsSrc(TrafficLogger *trafficLogger, EventList &eventList, EqdsNIC &ni
 {
     _node_num = _global_node_count++;
     _nodename = "eqdsSrc " + to_string(_node_num);
+    MemoryStats::addReporter(MemoryStats::EQDS_SRC, this);
     _rtx_timeout_pending = false;
     _rtx_timeout = timeInf;
     _rto_timer_handle = eventlist().nullHandle();
@@ -272,10 +273,10 @@ EqdsSrc::EqdsSrc(TrafficLogger *trafficLogger, EventList &eventList, EqdsNIC &ni
     _highest_sent = 0;
     _send_blocked_on_nic = false;
     _no_of_paths = _path_entropy_size;
-    _path_random = rand() % 0xffff; // random upper bits of EV
-    _path_xor = rand() % _no_of_paths;
-    _current_ev_index = 0;
+    _rng.setId(get_id());
+    _path_random = _rng.rand() % 0xffff; // random upper bits of EV
     _max_penalty = 1;
+    _evs.init(_no_of_paths, _max_penalty, &_rng);
     _last_rts = 0;
 
     // stats for debugging
@@ -283,12 +284,6 @@ EqdsSrc::EqdsSrc(TrafficLogger *trafficLogger, EventList &eventList, EqdsNIC &ni
     _rtx_packets_sent = 0;
     _rts_packets_sent = 0;
     _bounces_received = 0;
-
-    // reset path penalties
-    _ev_skip_bitmap.resize(_no_of_paths);
-    for (uint32_t i = 0; i < _no_of_paths; i++) {
-        _ev_skip_bitmap[i] = 0;
-    }
     
     // by default, end silently
     _end_trigger = 0;
@@ -302,6 +297,10 @@ EqdsSrc::EqdsSrc(TrafficLogger *trafficLogger, EventList &eventList, EqdsNIC &ni
     //if (_node_num == 490) _debug_src = true; // use this to enable debugging on one flow at a time
 }
 
+EqdsSrc::~EqdsSrc() {
+    MemoryStats::removeReporter(MemoryStats::EQDS_SRC, this);
+}
+
 void EqdsSrc::connect(Route &routeout, Route &routeback, EqdsSink &sink, simtime_picosec start_time) {
     _route = &routeout;
     _sink = &sink;
@@ -340,7 +339,7 @@ simtime_picosec EqdsSrc::computeDynamicRTO(simtime_picosec send_time) {
         _rto = _rtt + 4*_mdev;
     }
     if (_rto < _min_rto)
-        _rto = _min_rto * ((drand() * 0.5) + 0.75);
+        _rto = _min_rto * ((_rng.drand() * 0.5) + 0.75);
 
 
     if (_rto < _min_rto)
@@ -649,7 +648,9 @@ void EqdsSrc::stopSpeculating() {
     // we just got an ack, nack or pull.  We need to stop speculating
 
     _speculating = false;
-    if (_backlog > 0 && _state == SPECULATING) {
+    // even with no backlog we may still have retransmissions to send,
+    // and those now need pull credit.
+    if (_state == SPECULATING) {
         _state = COMMITTED;
     } 
 }
@@ -809,35 +810,131 @@ void EqdsSrc::penalizePath(uint16_t path_id, uint8_t penalty) {
     // _no_of_paths must be a power of 2
     uint16_t mask = _no_of_paths - 1;
     path_id &= mask;  // only take the relevant bits for an index
-    _ev_skip_bitmap[path_id] += penalty;
-    if (_ev_skip_bitmap[path_id] > _max_penalty) {
-        _ev_skip_bitmap[path_id] = _max_penalty;
-    }
+    _evs.penalize(path_id, penalty);
 }
 
 uint16_t EqdsSrc::nextEntropy() {
     // _no_of_paths must be a power of 2
     uint16_t mask = _no_of_paths - 1;  
-    uint16_t entropy = (_current_ev_index ^ _path_xor) & mask;
-    while (_ev_skip_bitmap[entropy] > 0) {
-        _ev_skip_bitmap[entropy]--;
-        _current_ev_index++;
-        if (_current_ev_index == _no_of_paths) {
-            _current_ev_index = 0;
-            _path_xor = rand() & mask;
+    uint16_t entropy = _evs.next();
+    entropy |= _path_random ^ (_path_random & mask); // set upper bits
+    return entropy;
+}
+
+void EqdsEntropySelector::init(uint16_t size, uint8_t max_penalty, RngStream* rng) {
+    _rng = rng;
+    _size = size;
+    _xor = rng->rand() % size;
+    _index = 0;
+    _max_penalty = max_penalty;
+    _words = (size + 63) / 64;
+    _planes_used = 1;
+    while (_planes_used < 8 && (max_penalty >> _planes_used))
+        _planes_used++;
+    _planes.assign(_planes_used * _words, 0);
+}
+
+uint8_t EqdsEntropySelector::penalty(uint16_t ev) const {
+    uint16_t pos = ev ^ _xor;
+    uint8_t penalty = 0;
+    for (uint32_t p = 0; p < _planes_used; p++)
+        penalty |= ((_planes[p * _words + pos / 64] >> (pos % 64)) & 1) << p;
+    return penalty;
+}
+
+void EqdsEntropySelector::penalize(uint16_t ev, uint8_t penalty) {
+    uint16_t pos = ev ^ _xor;
+    uint8_t value = this->penalty(ev) + penalty;
+    if (value > _max_penalty)
+        value = _max_penalty;
+    uint64_t bit = (uint64_t)1 << (pos % 64);
+    for (uint32_t p = 0; p < _planes_used; p++) {
+        uint64_t& plane = _planes[p * _words + pos / 64];
+        plane = (value >> p) & 1 ? plane | bit : plane & ~bit;
+    }
+}
+
+// take one off the penalty of each position in mask, which must all
+// have a penalty
+void EqdsEntropySelector::decay(uint32_t w, uint64_t mask) {
+    uint64_t borrow = mask;
+    for (uint32_t p = w; borrow && p < _planes.size(); p += _words) {
+        uint64_t plane = _planes[p];
+        _planes[p] = plane ^ borrow;
+        borrow &= ~plane;
+    }
+}
+
+// move the penalties to where their EVs are in a pass with new_xor
+void EqdsEntropySelector::reorder(uint16_t new_xor) {
+    // masks of the bits whose position has bit k clear
+    static const uint64_t low[6] = {0x5555555555555555ULL, 0x3333333333333333ULL,
+                                    0x0f0f0f0f0f0f0f0fULL, 0x00ff00ff00ff00ffULL,
+                                    0x0000ffff0000ffffULL, 0x00000000ffffffffULL};
+    uint16_t diff = _xor ^ new_xor;
+    _xor = new_xor;
+    if (diff == 0)
+        return;
+    uint32_t word_diff = diff / 64;
+    for (uint32_t p = 0; p < _planes.size(); p += _words) {
+        for (uint32_t w = 0; w < _words; w++) {
+            if (word_diff && (w ^ word_diff) < w)
+                continue;  // already swapped with its partner
+            uint64_t a = _planes[p + w];
+            uint64_t b = _planes[p + (w ^ word_diff)];
+            for (int k = 0; k < 6; k++) {
+                if (diff & (1 << k)) {
+                    a = ((a & low[k]) << (1 << k)) | ((a >> (1 << k)) & low[k]);
+                    b = ((b & low[k]) << (1 << k)) | ((b >> (1 << k)) & low[k]);
+                }
+            }
+            _planes[p + w] = b;
+            _planes[p + (w ^ word_diff)] = a;
         }
-        entropy = (_current_ev_index ^ _path_xor) & mask;
     }
+}
 
-    // set things for next time
-    _current_ev_index++;
-    if (_current_ev_index == _no_of_paths) {
-        _current_ev_index = 0;
-        _path_xor = rand() & mask; 
+uint16_t EqdsEntropySelector::next() {
+    uint16_t mask = _size - 1;
+    if (!((penalized(_index / 64) >> (_index % 64)) & 1)) {
+        // usual case: nothing to skip
+        uint16_t ev = _index ^ _xor;
+        _index++;
+        if (_index == _size) {
+            _index = 0;
+            reorder(_rng->rand() & mask);
+        }
+        return ev;
+    }
+    while (true) {
+        // find the next position without a penalty, decaying the
+        // penalties we skip over
+        while (_index < _size) {
+            uint32_t w = _index / 64;
+            uint64_t valid = _size - w * 64 >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << (_size - w * 64)) - 1;
+            uint64_t from = valid & (~(uint64_t)0 << (_index % 64));
+            uint64_t penalized = this->penalized(w);
+            uint64_t free = from & ~penalized;
+            if (free) {
+                uint32_t bit = __builtin_ctzll(free);
+                decay(w, penalized & from & (((uint64_t)1 << bit) - 1));
+                _index = w * 64 + bit;
+                uint16_t ev = _index ^ _xor;
+                // set things for next time
+                _index++;
+                if (_index == _size) {
+                    _index = 0;
+                    reorder(_rng->rand() & mask);
+                }
+                return ev;
+            }
+            decay(w, penalized & from);
+            _index = w * 64 + 64;
+        }
+        // every remaining EV in this pass was skipped
+        _index = 0;
+        reorder(_rng->rand() & mask);
     }
-    
-    entropy |= _path_random ^ (_path_random & mask); // set upper bits
-    return entropy;
 }
 
 mem_b EqdsSrc::sendNewPacket() {
@@ -894,7 +991,8 @@ mem_b EqdsSrc::sendRtxPacket() {
     mem_b full_pkt_size = _rtx_queue.begin()->second;
     bool speculative = false;
     bool can_send = spendCredit(full_pkt_size, speculative);
-    assert(!speculative); // I don't think this can happen, but remove this assert if we decide it can
+    // this can be speculative: an RTO can fire before we hear anything
+    // back from the receiver.
     if (!can_send) {
         // we can't sent because we've only got speculative credit and we're not in speculating mode
         return 0;
@@ -1134,6 +1232,15 @@ void EqdsSrc::setEndTrigger(Trigger& end_trigger) {
     _end_trigger = &end_trigger;
 };
 
+void EqdsSrc::memoryUsage(int64_t& bytes, int64_t& count) {
+    bytes += sizeof(EqdsSrc);
+    bytes += MemoryStats::mapBytes(_tx_bitmap);
+    bytes += MemoryStats::mapBytes(_send_times);
+    bytes += MemoryStats::mapBytes(_rtx_queue);
+    bytes += _evs.bytes();
+    count++;
+}
+
 ////////////////////////////////////////////////////////////////                                                                   
 //  EQDS SINK                                                                                                                       
 ////////////////////////////////////////////////////////////////   
@@ -1151,7 +1258,6 @@ EqdsSink::EqdsSink(TrafficLogger *trafficLogger, EqdsPullPacer* pullPacer, EqdsN
     _received_bytes(0),
     _accepted_bytes(0),
     _end_trigger(NULL),
-    _epsn_rx_bitmap(0),
     _out_of_order_count(0),
     _ack_request(false)
 {
@@ -1173,7 +1279,6 @@ EqdsSink::EqdsSink(TrafficLogger* trafficLogger, linkspeed_bps linkSpeed, double
     _received_bytes(0),
     _accepted_bytes(0),
     _end_trigger(NULL),
-    _epsn_rx_bitmap(0),
     _out_of_order_count(0),
     _ack_request(false)
 {
@@ -1225,7 +1330,7 @@ void EqdsSink::processData(const EqdsDataPacket& pkt){
     //otherwise ack will be delayed until we have cumulated enough bytes / packets. 
     bool ecn = (bool)(pkt.flags() & ECN_CE);
 
-    if (pkt.epsn() < _expected_epsn || _epsn_rx_bitmap[pkt.epsn()]) {
+    if (pkt.epsn() < _expected_epsn || _epsn_rx_bitmap.received(pkt.epsn())) {
         if (EqdsSrc::_debug) cout << _nodename << " src " << _src->nodename() << " duplicate psn " << pkt.epsn() << endl;
 
         _stats.duplicates++;
@@ -1262,9 +1367,9 @@ void EqdsSink::processData(const EqdsDataPacket& pkt){
     if (_src->debug()) cout << _nodename << " src " << _src->nodename() << " >>    cumulative ack was: " << _expected_epsn << " flow " << _src->flow()->str() << endl;
 
     if (pkt.epsn() == _expected_epsn) {
-        while (_epsn_rx_bitmap[++_expected_epsn]){
+        while (_epsn_rx_bitmap.received(++_expected_epsn)){
             //clean OOO state, this will wrap at some point.
-            _epsn_rx_bitmap[_expected_epsn] = 0;
+            _epsn_rx_bitmap.clear(_expected_epsn);
             _out_of_order_count--;
         }
         if (_src->debug()) cout << " EqdsSink "<< _nodename << " src " << _src->nodename() << " >>    cumulative ack now: " << _expected_epsn << " ooo count " << _out_of_order_count << " flow " << _src->flow()->str()  << endl;
@@ -1275,7 +1380,7 @@ void EqdsSink::processData(const EqdsDataPacket& pkt){
         }
     }
     else {
-        _epsn_rx_bitmap[pkt.epsn()] = 1;
+        _epsn_rx_bitmap.setReceived(pkt.epsn());
         _out_of_order_count ++;
         _stats.out_of_order++;
     }
@@ -1295,7 +1400,7 @@ void EqdsSink::processData(const EqdsDataPacket& pkt){
 void EqdsSink::processTrimmed(const EqdsDataPacket& pkt){
     _stats.trimmed++;
 
-    if (pkt.epsn() < _expected_epsn || _epsn_rx_bitmap[pkt.epsn()]){
+    if (pkt.epsn() < _expected_epsn || _epsn_rx_bitmap.received(pkt.epsn())){
         if (_src->debug())
             cout << " EqdsSink processTrimmed got a packet we already have: " << pkt.epsn() << " time " << timeAsNs(getSrc()->eventlist().now()) << " flow" << _src->flow()->str() << endl;
 
@@ -1359,7 +1464,7 @@ void EqdsSink::processRts(const EqdsRtsPacket& pkt){
 
     bool ecn = (bool)(pkt.flags() & ECN_CE);
 
-    if (pkt.epsn() < _expected_epsn || _epsn_rx_bitmap[pkt.epsn()]) {
+    if (pkt.epsn() < _expected_epsn || _epsn_rx_bitmap.received(pkt.epsn())) {
         if (_src->debug()) cout << _nodename << " src " << _src->nodename() << " duplicate psn " << pkt.epsn() << endl;
 
         _stats.duplicates++;
@@ -1379,9 +1484,9 @@ void EqdsSink::processRts(const EqdsRtsPacket& pkt){
     _received_bytes += pkt.size() - EqdsAckPacket::ACKSIZE;
 
     if (pkt.epsn() == _expected_epsn) {
-        while (_epsn_rx_bitmap[++_expected_epsn]){
+        while (_epsn_rx_bitmap.received(++_expected_epsn)){
             //clean OOO state, this will wrap at some point.
-            _epsn_rx_bitmap[_expected_epsn] = 0;
+            _epsn_rx_bitmap.clear(_expected_epsn);
             _out_of_order_count--;
         }
         if (_src->debug())
@@ -1392,7 +1497,7 @@ void EqdsSink::processRts(const EqdsRtsPacket& pkt){
         }
     }
     else {
-        _epsn_rx_bitmap[pkt.epsn()] = 1;
+        _epsn_rx_bitmap.setReceived(pkt.epsn());
         _out_of_order_count ++;
         _stats.out_of_order++;
     }
@@ -1472,16 +1577,11 @@ EqdsBasePacket::seq_t EqdsSink::sackBitmapBase(EqdsBasePacket::seq_t epsn){
 }
 
 EqdsBasePacket::seq_t EqdsSink::sackBitmapBaseIdeal(){
-    uint8_t lowest_value = UINT8_MAX;
-    EqdsBasePacket::seq_t lowest_position;
+    EqdsBasePacket::seq_t lowest_position = _expected_epsn;
 
     //find the lowest non-zero value in the sack bitmap; that is the candidate for the base, since it is the oldest packet that we are yet to sack.
     //on sack bitmap construction that covers a given seqno, the value is incremented. 
-    for (EqdsBasePacket::seq_t crt = _expected_epsn; crt <= _high_epsn; crt++)
-        if (_epsn_rx_bitmap[crt] && _epsn_rx_bitmap[crt]<lowest_value){
-            lowest_value = _epsn_rx_bitmap[crt];
-            lowest_position = crt;
-        }
+    _epsn_rx_bitmap.leastSacked(_expected_epsn, _high_epsn, lowest_position);
     
     if (lowest_position + 64 > _high_epsn)
         lowest_position = _high_epsn - 64;
@@ -1496,19 +1596,15 @@ uint64_t EqdsSink::buildSackBitmap(EqdsBasePacket::seq_t ref_epsn){
     //take the next 64 entries from ref_epsn and create a SACK bitmap with them
     if (_src->debug())
         cout << " EqdsSink: building sack for ref_epsn " << ref_epsn << endl;
-    uint64_t bitmap = (uint64_t)(_epsn_rx_bitmap[ref_epsn]!=0) << 63;
+    uint64_t bitmap = _epsn_rx_bitmap.bits(ref_epsn);
 
-    for (int i=1;i<64;i++){
-        bitmap = bitmap >> 1 | (uint64_t)(_epsn_rx_bitmap[ref_epsn+i]!=0) << 63;
-        if (_src->debug() && (_epsn_rx_bitmap[ref_epsn+i]!=0))
-            cout << "     Sack: " <<  ref_epsn+i << endl;
-
-        if (_epsn_rx_bitmap[ref_epsn+i]){
-            //remember that we sacked this packet
-            if (_epsn_rx_bitmap[ref_epsn+i]<UINT8_MAX)
-                _epsn_rx_bitmap[ref_epsn+i]++;
-        }
+    //remember that we sacked these packets; ref_epsn itself doesn't count
+    uint64_t sacked = bitmap & ~(uint64_t)1;
+    if (_src->debug()) {
+        for (uint64_t b = sacked; b; b &= b - 1)
+            cout << "     Sack: " <<  ref_epsn + __builtin_ctzll(b) << endl;
     }
+    _epsn_rx_bitmap.countSacks(ref_epsn, sacked);
     if (_src->debug())
         cout << "       bitmap is: " << bitmap << endl;
     return bitmap;
@@ -1536,13 +1632,7 @@ static unsigned pktByteTimes(unsigned size) {
 }
 
 uint32_t EqdsSink::reorder_buffer_size() {
-    uint32_t count = 0;
-    // it's not very efficient to count each time, but if we only do
-    // this occasionally when the sink logger runs, it should be OK.
-    for (uint32_t i = 0; i < eqdsMaxInFlightPkts; i++) {
-        if (_epsn_rx_bitmap[i]) count++;
-    }
-    return count;
+    return _epsn_rx_bitmap.count();
 }
 
 ////////////////////////////////////////////////////////////////                                                                   
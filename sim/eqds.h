@@ -5,11 +5,14 @@
 #include <memory>
 #include <tuple>
 #include <list>
+#include <string.h>
 
 #include "eventlist.h"
 #include "trigger.h"
+#include "memstats.h"
 #include "eqdspacket.h"
 #include "circular_buffer.h"
+#include "rng.h"
 
 
 #define timeInf 0
@@ -17,19 +20,155 @@
 // *** don't change this default - override it by calling EqdsSrc::setMinRTO()
 #define DEFAULT_EQDS_RTO_MIN 100
 
-template <typename T, unsigned Size>
-class ModularVector {
-    // Size is a power of 2 (because of seqno wrap-around)                                                                                                  
-    //static_assert(!(Size & (Size - 1)));
-    T buf[Size];
+// Receive scoreboard for EqdsSink, indexed by epsn modulo Size.  One
+// bit per packet records that it was received out of order; the bits
+// are packed so SACK bitmaps are built and searched a word at a time.
+// A separate byte per packet counts how often it has been SACKed,
+// saturating at UINT8_MAX; it is 1 when the packet arrives.
+template <unsigned Size>
+class EqdsScoreboard {
+    // Size is a power of 2 (because of seqno wrap-around), and at least 64
+    static const unsigned WORDS = Size / 64;
+    uint64_t _received[WORDS];
+    uint8_t _sacked[Size];
 
  public:
-    ModularVector(T default_value) {
-        for (uint i = 0; i < Size; i++) {
-            buf[i] = default_value;
+    EqdsScoreboard() {
+        memset(_received, 0, sizeof(_received));
+        memset(_sacked, 0, sizeof(_sacked));
+    }
+    inline bool received(uint64_t epsn) const {
+        return (_received[(epsn / 64) & (WORDS - 1)] >> (epsn % 64)) & 1;
+    }
+    inline void setReceived(uint64_t epsn) {
+        _received[(epsn / 64) & (WORDS - 1)] |= (uint64_t)1 << (epsn % 64);
+        _sacked[epsn & (Size - 1)] = 1;
+    }
+    inline void clear(uint64_t epsn) {
+        _received[(epsn / 64) & (WORDS - 1)] &= ~((uint64_t)1 << (epsn % 64));
+        _sacked[epsn & (Size - 1)] = 0;
+    }
+    inline uint8_t sackCount(uint64_t epsn) const {return _sacked[epsn & (Size - 1)];}
+
+    // the received bits for epsn to epsn+63, epsn in the lowest bit
+    inline uint64_t bits(uint64_t epsn) const {
+        unsigned w = (epsn / 64) & (WORDS - 1);
+        unsigned offset = epsn % 64;
+        uint64_t b = _received[w] >> offset;
+        if (offset)
+            b |= _received[(w + 1) & (WORDS - 1)] << (64 - offset);
+        return b;
+    }
+
+    // count a SACK of each packet whose bit is set in mask, where
+    // mask is laid out as bits(epsn) is.  Eight counts are updated
+    // at a time: each byte of the mask is spread to a 0 or 1 per
+    // count, and counts at UINT8_MAX are masked out so they saturate.
+    void countSacks(uint64_t epsn, uint64_t mask) {
+        unsigned idx = epsn & (Size - 1);
+        if (idx + 64 > Size) {
+            // the counts wrap around the end of the buffer
+            for (; mask; mask &= mask - 1) {
+                uint8_t& count = _sacked[(epsn + __builtin_ctzll(mask)) & (Size - 1)];
+                if (count < UINT8_MAX)
+                    count++;
+            }
+            return;
         }
+        for (unsigned i = idx; mask; i += 8, mask >>= 8) {
+            uint64_t bits = mask & 0xff;
+            if (!bits)
+                continue;
+            uint64_t inc = ((((bits * 0x0101010101010101ULL) & 0x8040201008040201ULL)
+                             + 0x7f7f7f7f7f7f7f7fULL) & 0x8080808080808080ULL) >> 7;
+            uint64_t counts = loadCounts(&_sacked[i]);
+            uint64_t full = counts & ((counts & 0x7f7f7f7f7f7f7f7fULL) + 0x0101010101010101ULL)
+                & 0x8080808080808080ULL;
+            counts += inc & ~(full >> 7);
+            storeCounts(&_sacked[i], counts);
+        }
+    }
+
+    // Finds the received packet in [from, to] with the lowest SACK
+    // count below UINT8_MAX, the earliest if there's a tie.  Returns
+    // false if there is none.
+    bool leastSacked(uint64_t from, uint64_t to, uint64_t& epsn) const {
+        uint8_t lowest = UINT8_MAX;
+        for (uint64_t base = from; base <= to; base += 64) {
+            uint64_t b = bits(base);
+            if (to - base < 63)
+                b &= ((uint64_t)2 << (to - base)) - 1;
+            for (; b; b &= b - 1) {
+                uint64_t crt = base + __builtin_ctzll(b);
+                if (_sacked[crt & (Size - 1)] < lowest) {
+                    lowest = _sacked[crt & (Size - 1)];
+                    epsn = crt;
+                }
+            }
+        }
+        return lowest < UINT8_MAX;
+    }
+
+    // number of packets received out of order
+    uint32_t count() const {
+        uint32_t n = 0;
+        for (unsigned w = 0; w < WORDS; w++)
+            n += __builtin_popcountll(_received[w]);
+        return n;
+    }
+
+ private:
+    // eight SACK counts as a word, with the count for the lowest epsn
+    // in the lowest byte whatever the host byte order
+    static inline uint64_t loadCounts(const uint8_t* p) {
+        uint64_t counts;
+        memcpy(&counts, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        counts = __builtin_bswap64(counts);
+#endif
+        return counts;
+    }
+    static inline void storeCounts(uint8_t* p, uint64_t counts) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        counts = __builtin_bswap64(counts);
+#endif
+        memcpy(p, &counts, 8);
     }
-    T &operator [](unsigned idx) { return buf[idx & (Size - 1)]; }
+};
+
+// Entropy value (EV) selection for EqdsSrc.  EVs are handed out in
+// passes over 0..size-1, each pass in a new random XOR order, skipping
+// EVs that have a penalty; each skip takes one off that EV's penalty.
+// Penalties are stored as bit planes indexed by position in the current
+// pass, so finding the next unpenalized EV, and decaying the penalties
+// of the EVs skipped on the way, take a few operations per 64 EVs.
+class EqdsEntropySelector {
+ public:
+    EqdsEntropySelector() : _size(0), _xor(0), _index(0), _max_penalty(0), _planes_used(0), _words(0), _rng(NULL) {}
+    // size must be a power of 2; each pass's XOR order is drawn from rng
+    void init(uint16_t size, uint8_t max_penalty, RngStream* rng);
+    void penalize(uint16_t ev, uint8_t penalty);
+    uint8_t penalty(uint16_t ev) const;
+    uint16_t next();
+    int64_t bytes() const {return _planes.capacity() * sizeof(uint64_t);}
+ private:
+    uint64_t penalized(uint32_t w) const {
+        uint64_t bits = _planes[w];
+        for (uint32_t p = 1; p < _planes_used; p++)
+            bits |= _planes[p * _words + w];
+        return bits;
+    }
+    void decay(uint32_t w, uint64_t mask);
+    void reorder(uint16_t new_xor);
+    uint16_t _size;
+    uint16_t _xor; // XOR with a position in the pass to get the EV
+    uint16_t _index; // position in the current pass
+    uint8_t _max_penalty;
+    uint8_t _planes_used;
+    uint32_t _words;
+    // bit p of each penalty; word w of plane p is _planes[p * _words + w]
+    vector<uint64_t> _planes;
+    RngStream* _rng;
 };
 
 static const unsigned eqdsMaxInFlightPkts = 1 << 12;
@@ -68,7 +207,7 @@ private:
     int _ratio_data, _ratio_control, _crt;
 };
 
-class EqdsSrc : public EventSource, public PacketSink, public TriggerTarget {
+class EqdsSrc : public EventSource, public PacketSink, public TriggerTarget, public MemoryReporter {
  public:
     struct Stats {
         uint64_t sent;
@@ -78,6 +217,7 @@ class EqdsSrc : public EventSource, public PacketSink, public TriggerTarget {
         uint64_t rts_nacks;
     };
     EqdsSrc(TrafficLogger *trafficLogger, EventList &eventList, EqdsNIC &nic, bool rts = false);
+    ~EqdsSrc();
     void logFlowEvents(FlowEventLogger& flow_logger) {_flow_logger = &flow_logger;}
     virtual void connect(Route &routeout, Route &routeback, EqdsSink &sink, simtime_picosec start);
     void timeToSend();
@@ -97,6 +237,8 @@ class EqdsSrc : public EventSource, public PacketSink, public TriggerTarget {
     // called from a trigger to start the flow.
     virtual void activate();
 
+    virtual void memoryUsage(int64_t& bytes, int64_t& count);
+
     static uint32_t _path_entropy_size; // now many paths do we include in our path set
     static int _global_node_count;
     static simtime_picosec _min_rto;
@@ -111,6 +253,8 @@ class EqdsSrc : public EventSource, public PacketSink, public TriggerTarget {
     inline PacketFlow* flow(){return &_flow;}
 
     inline flowid_t flowId() const { return _flow.flow_id();}
+    bool flowActive() const {return _state != INITIALIZE_CREDIT && !_done_sending;} // started, not finished
+    bool flowFinished() const {return _done_sending;}
 
 
     // status for debugging
@@ -204,10 +348,9 @@ class EqdsSrc : public EventSource, public PacketSink, public TriggerTarget {
     // entropy value calculation
     uint16_t _no_of_paths; // must be a power of 2
     uint16_t _path_random; // random upper bits of EV, set at startup and never changed
-    uint16_t _path_xor; // random value set each time we wrap the entropy values - XOR with _current_ev_index
-    uint16_t _current_ev_index; // count through _no_of_paths and then wrap.  XOR with _path_xor to get EV
-    vector <uint8_t> _ev_skip_bitmap;  // paths scores for load balancing
-    uint8_t _max_penalty; // max value we allow in _path_penalties (typically 1 or 2).
+    RngStream _rng;
+    EqdsEntropySelector _evs; // path penalties for load balancing
+    uint8_t _max_penalty; // max value we allow in path penalties (typically 1 or 2).
 
     // RTT estimate data for RTO
     simtime_picosec _rtt, _mdev, _rto;
@@ -328,7 +471,7 @@ private:
     uint16_t _accepted_bytes;
 
     Trigger* _end_trigger;
-    ModularVector<uint8_t, eqdsMaxInFlightPkts> _epsn_rx_bitmap; // list of packets above a hole, that we've received
+    EqdsScoreboard<eqdsMaxInFlightPkts> _epsn_rx_bitmap; // packets above a hole that we've received
     
     uint32_t _out_of_order_count;
     bool _ack_request;
@@ -75,7 +75,7 @@ public:
         //only change the IP packet size, not the approximate one in the EQDS header. 
         Packet::_size = ACKSIZE;
         _trim_hop = _nexthop;
-        _trim_direction = _direction;
+        _trim_direction = (packet_direction)_direction;
     };
 
     virtual inline void set_route(const Route &route) {
@@ -224,16 +224,18 @@ public:
     virtual ~EqdsAckPacket(){}
 
 protected:
+    // the small fields first, so they pack into EqdsBasePacket's tail padding
+    uint16_t _ev; //path id for the packet that triggered the SACK 
+
+    bool _rnr;
+    bool _ecn_echo;
+
     seq_t _ref_ack;  // corresponds to the base of the bitmap
     seq_t _cumulative_ack;  // highest in-order packet received.
     //pull_quanta _pullno; we don't need this field
 
     //SACK bitmap here 
     uint64_t _sack_bitmap;
-    uint16_t _ev; //path id for the packet that triggered the SACK 
-
-    bool _rnr;
-    bool _ecn_echo;
     simtime_picosec _residency_time;
 
     static PacketDB<EqdsAckPacket> _packetdb;
@@ -324,4 +326,10 @@ protected:
     static PacketDB<EqdsRtsPacket> _packetdb;
 };
 
+PACKET_SIZE_BUDGET(EqdsDataPacket, 120);
+PACKET_SIZE_BUDGET(EqdsPullPacket, 104);
+PACKET_SIZE_BUDGET(EqdsAckPacket, 120);
+PACKET_SIZE_BUDGET(EqdsNackPacket, 104);
+PACKET_SIZE_BUDGET(EqdsRtsPacket, 136);
+
 #endif
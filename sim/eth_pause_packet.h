@@ -39,4 +39,6 @@ class EthPausePacket : public Packet {
     static PacketDB<EthPausePacket> _packetdb;
 };
 
+PACKET_SIZE_BUDGET(EthPausePacket, 88);
+
 #endif
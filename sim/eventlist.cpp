@@ -2,10 +2,15 @@
 
 #include "eventlist.h"
 #include "trigger.h"
+#include "memstats.h"
 
 simtime_picosec EventList::_endtime = 0;
 simtime_picosec EventList::_lasteventtime = 0;
+uint64_t EventList::_events_run = 0;
 EventList::pendingsources_t EventList::_pendingsources;
+bool EventList::_elide_idle = false;
+EventList::pendingsources_t EventList::_periodicsources;
+vector <pair<simtime_picosec, EventSource*> > EventList::_heldsources;
 vector <TriggerTarget*> EventList::_pending_triggers;
 int EventList::_instanceCount = 0;
 EventList* EventList::_theEventList = nullptr;
@@ -38,6 +43,29 @@ EventList::setEndtime(simtime_picosec endtime)
     EventList::_endtime = endtime;
 }
 
+void
+EventList::setElideIdle(bool elide)
+{
+    EventList::_elide_idle = elide;
+    // move any periodic events that are already scheduled
+    pendingsources_t pending;
+    pending.swap(_pendingsources);
+    pending.insert(_periodicsources.begin(), _periodicsources.end());
+    _periodicsources.clear();
+    for (auto& i : pending)
+        queueFor(*i.second).insert(i);
+}
+
+void
+EventList::memoryUsage(int64_t& bytes, int64_t& count)
+{
+    count += _pendingsources.size() + _periodicsources.size() + _heldsources.size();
+    bytes += MemoryStats::mapBytes(_pendingsources);
+    bytes += MemoryStats::mapBytes(_periodicsources);
+    bytes += _heldsources.capacity() * sizeof(_heldsources[0]);
+    bytes += _pending_triggers.capacity() * sizeof(TriggerTarget*);
+}
+
 bool
 EventList::doNextEvent() 
 {
@@ -46,10 +74,15 @@ EventList::doNextEvent()
     if (!_pending_triggers.empty()) {
         TriggerTarget *target = _pending_triggers.back();
         _pending_triggers.pop_back();
+        _events_run++;
         target->activate();
         return true;
     }
-    
+
+    if (!_periodicsources.empty() &&
+        (_pendingsources.empty() || _periodicsources.begin()->first < _pendingsources.begin()->first))
+        return doNextPeriodicEvent();
+
     if (_pendingsources.empty())
         return false;
     
@@ -58,17 +91,73 @@ EventList::doNextEvent()
     _pendingsources.erase(_pendingsources.begin());
     assert(nexteventtime >= _lasteventtime);
     _lasteventtime = nexteventtime; // set this before calling doNextEvent, so that this::now() is accurate
+    _events_run++;
     nextsource->doNextEvent();
     return true;
 }
 
+// Only periodic events are due before the next one of src: if src is
+// idle, move it on to its last event before anything else happens, or
+// hold it if nothing else is pending at all.
+bool
+EventList::doNextPeriodicEvent()
+{
+    const simtime_picosec never = ~(simtime_picosec)0;
+    simtime_picosec when = _periodicsources.begin()->first;
+    EventSource* src = _periodicsources.begin()->second;
+    _periodicsources.erase(_periodicsources.begin());
+
+    simtime_picosec period = src->periodic();
+    simtime_picosec busy = _pendingsources.empty() ? never : _pendingsources.begin()->first;
+    if (busy - when >= period && src->idle()) {
+        if (busy == never)
+            _heldsources.push_back(make_pair(when, src));
+        else
+            _periodicsources.insert(make_pair(when + (busy - when) / period * period, src));
+        return true;
+    }
+
+    assert(when >= _lasteventtime);
+    _lasteventtime = when;
+    _events_run++;
+    src->doNextEvent();
+
+    // if it started something (eg a retransmit timer fired), the
+    // sources we moved on may have skipped past it
+    if (!_pendingsources.empty() && _pendingsources.begin()->first < busy)
+        realignPeriodic();
+    return true;
+}
+
+// bring every periodic source back to its first event after now
+void
+EventList::realignPeriodic()
+{
+    pendingsources_t periodic;
+    periodic.swap(_periodicsources);
+    periodic.insert(_heldsources.begin(), _heldsources.end());
+    _heldsources.clear();
+    for (auto& i : periodic) {
+        simtime_picosec period = i.second->periodic();
+        simtime_picosec when = i.first;
+        if (when <= now())
+            when += (now() - when + period - 1) / period * period; // held
+        else
+            when -= (when - now() - 1) / period * period;
+        if (_endtime==0 || when<_endtime)
+            _periodicsources.insert(make_pair(when, i.second));
+    }
+}
 
 void 
 EventList::sourceIsPending(EventSource &src, simtime_picosec when) 
 {
     assert(when>=now());
-    if (_endtime==0 || when<_endtime)
-        _pendingsources.insert(make_pair(when,&src));
+    if (_endtime==0 || when<_endtime) {
+        queueFor(src).insert(make_pair(when,&src));
+        if (!_heldsources.empty() && !src.periodic())
+            realignPeriodic();
+    }
 }
 
 EventList::Handle
@@ -76,7 +165,9 @@ EventList::sourceIsPendingGetHandle(EventSource &src, simtime_picosec when)
 {
     assert(when>=now());
     if (_endtime==0 || when<_endtime) {
-        EventList::Handle handle =_pendingsources.insert(make_pair(when,&src));
+        EventList::Handle handle = queueFor(src).insert(make_pair(when,&src));
+        if (!_heldsources.empty() && !src.periodic())
+            realignPeriodic();
         return handle;
     }
     return _pendingsources.end();
@@ -89,14 +180,21 @@ EventList::triggerIsPending(TriggerTarget &target) {
 
 void 
 EventList::cancelPendingSource(EventSource &src) {
-    pendingsources_t::iterator i = _pendingsources.begin();
-    while (i != _pendingsources.end()) {
+    pendingsources_t& queue = queueFor(src);
+    pendingsources_t::iterator i = queue.begin();
+    while (i != queue.end()) {
         if (i->second == &src) {
-            _pendingsources.erase(i);
+            queue.erase(i);
             return;
         }
         i++;
     }
+    for (auto j = _heldsources.begin(); j != _heldsources.end(); j++) {
+        if (j->second == &src) {
+            _heldsources.erase(j);
+            return;
+        }
+    }
 }
 
 void 
@@ -104,11 +202,12 @@ EventList::cancelPendingSourceByTime(EventSource &src, simtime_picosec when) {
     // fast cancellation of a timer - the timer MUST exist
     // this should normally be fast, except if we have a lot of events with exactly the same time value
 
-    auto range = _pendingsources.equal_range(when);
+    pendingsources_t& queue = queueFor(src);
+    auto range = queue.equal_range(when);
 
     for (auto i = range.first; i != range.second; ++i) {
         if (i->second == &src) {
-            _pendingsources.erase(i);
+            queue.erase(i);
             return;
         }
     }
@@ -124,7 +223,7 @@ void EventList::cancelPendingSourceByHandle(EventSource &src, EventList::Handle
     assert(handle != _pendingsources.end());
     assert(handle->first >= now());
     
-    _pendingsources.erase(handle);
+    queueFor(src).erase(handle);
 }
 
 void 
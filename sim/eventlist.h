@@ -12,13 +12,24 @@ class TriggerTarget;
 
 class EventSource : public Logged {
 public:
-    EventSource(EventList& eventlist, const string& name) : Logged(name), _eventlist(eventlist) {};
+    EventSource(EventList& eventlist, const string& name) : Logged(name), _eventlist(eventlist), _periodic(0) {};
     EventSource(const string& name);
     virtual ~EventSource() {};
     virtual void doNextEvent() = 0;
     inline EventList& eventlist() const {return _eventlist;}
+    // Sources that reschedule themselves every period, and only have
+    // work to do while something else is going on (clocks, samplers,
+    // timer scanners), call this before scheduling their first event.
+    // See EventList::setElideIdle().
+    void setPeriodic(simtime_picosec period) {_periodic = period;}
+    simtime_picosec periodic() const {return _periodic;}
+    // A periodic source whose events can't be skipped right now, such
+    // as a timer scanner with a timer running, returns false.
+    virtual bool idle() const {return true;}
 protected:
     EventList& _eventlist;
+private:
+    simtime_picosec _periodic; // period, or 0 if not a periodic source
 };
 
 class EventList {
@@ -26,6 +37,10 @@ public:
     typedef multimap <simtime_picosec, EventSource*>::iterator Handle;
     EventList();
     static void setEndtime(simtime_picosec endtime); // end simulation at endtime (rather than forever)
+    // Skip the events of idle periodic sources when nothing else
+    // happens before their next one, and end the simulation once only
+    // those are left.  Call before starting the simulation.
+    static void setElideIdle(bool elide);
     static bool doNextEvent(); // returns true if it did anything, false if there's nothing to do
     static void sourceIsPending(EventSource &src, simtime_picosec when);
     static Handle sourceIsPendingGetHandle(EventSource &src, simtime_picosec when);
@@ -40,6 +55,29 @@ public:
     static void triggerIsPending(TriggerTarget &target);
     static inline simtime_picosec now() {return EventList::_lasteventtime;}
     static Handle nullHandle() {return _pendingsources.end();}
+    // If an event at time when would be the very next thing to run,
+    // advance the clock to when and return true, so the caller can
+    // handle it directly instead of scheduling it.  Returns false
+    // (and does nothing) if anything else, including a trigger or
+    // another event at the same time, would run first.
+    static bool advanceIfNext(simtime_picosec when) {
+        if (!_pending_triggers.empty())
+            return false;
+        if (_endtime != 0 && when >= _endtime)
+            return false;
+        if (!_pendingsources.empty() && _pendingsources.begin()->first <= when)
+            return false;
+        if (!_periodicsources.empty() && _periodicsources.begin()->first <= when)
+            return false;
+        assert(when >= _lasteventtime);
+        _lasteventtime = when;
+        _events_run++;
+        return true;
+    }
+    // events run so far, including those handled directly after advanceIfNext()
+    static uint64_t eventsRun() {return _events_run;}
+    // estimate of the memory used by pending events, for MemoryStats
+    static void memoryUsage(int64_t& bytes, int64_t& count);
 
 
     static EventList& getTheEventList();
@@ -49,8 +87,19 @@ public:
 private:
     static simtime_picosec _endtime;
     static simtime_picosec _lasteventtime;
+    static uint64_t _events_run;
     typedef multimap <simtime_picosec, EventSource*> pendingsources_t;
     static pendingsources_t _pendingsources;
+    // with setElideIdle(), the events of periodic sources are kept
+    // apart, and those of sources held until something else is scheduled
+    static bool _elide_idle;
+    static pendingsources_t _periodicsources;
+    static vector <pair<simtime_picosec, EventSource*> > _heldsources;
+    static pendingsources_t& queueFor(EventSource& src) {
+        return _elide_idle && src.periodic() ? _periodicsources : _pendingsources;
+    }
+    static bool doNextPeriodicEvent();
+    static void realignPeriodic();
     static vector <TriggerTarget*> _pending_triggers;
 
     static int _instanceCount;
@@ -0,0 +1,235 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#include <math.h>
+#include <fstream>
+#include <iomanip>
+#include "fct_stats.h"
+#include "network.h"
+#include "eventlist.h"
+
+////////////////////////////////////////////////////////////////
+//  Quantile sketch
+////////////////////////////////////////////////////////////////
+
+QuantileSketch::QuantileSketch(double alpha)
+    : _alpha(alpha), _offset(0), _zero_count(0), _count(0), _sum(0), _min(0), _max(0)
+{
+    assert(alpha > 0 && alpha < 1);
+    _gamma = (1 + alpha) / (1 - alpha);
+    _log_gamma = log(_gamma);
+}
+
+int QuantileSketch::bucketIndex(double value) const {
+    return (int)ceil(log(value) / _log_gamma);
+}
+
+double QuantileSketch::bucketValue(int index) const {
+    // midpoint (in relative terms) of (gamma^(i-1), gamma^i]
+    return 2 * pow(_gamma, index) / (_gamma + 1);
+}
+
+void QuantileSketch::add(double value) {
+    if (_count == 0) {
+        _min = value;
+        _max = value;
+    } else {
+        if (value < _min) _min = value;
+        if (value > _max) _max = value;
+    }
+    _count++;
+    _sum += value;
+
+    if (value <= 0) {
+        _zero_count++;
+        return;
+    }
+    int ix = bucketIndex(value);
+    if (_bins.empty()) {
+        _offset = ix;
+        _bins.push_back(0);
+    } else if (ix < _offset) {
+        _bins.insert(_bins.begin(), _offset - ix, 0);
+        _offset = ix;
+    } else if (ix >= _offset + (int)_bins.size()) {
+        _bins.resize(ix - _offset + 1, 0);
+    }
+    _bins[ix - _offset]++;
+}
+
+void QuantileSketch::merge(const QuantileSketch& other) {
+    assert(_alpha == other._alpha);
+    if (other._count == 0)
+        return;
+    if (_count == 0) {
+        _min = other._min;
+        _max = other._max;
+    } else {
+        if (other._min < _min) _min = other._min;
+        if (other._max > _max) _max = other._max;
+    }
+    _count += other._count;
+    _sum += other._sum;
+    _zero_count += other._zero_count;
+    if (other._bins.empty())
+        return;
+    if (_bins.empty()) {
+        _bins = other._bins;
+        _offset = other._offset;
+        return;
+    }
+    int lo = other._offset < _offset ? other._offset : _offset;
+    int hi_this = _offset + (int)_bins.size();
+    int hi_other = other._offset + (int)other._bins.size();
+    int hi = hi_other > hi_this ? hi_other : hi_this;
+    if (lo < _offset) {
+        _bins.insert(_bins.begin(), _offset - lo, 0);
+        _offset = lo;
+    }
+    _bins.resize(hi - _offset, 0);
+    for (size_t i = 0; i < other._bins.size(); i++) {
+        _bins[other._offset + i - _offset] += other._bins[i];
+    }
+}
+
+double QuantileSketch::quantile(double q) const {
+    if (_count == 0)
+        return 0;
+    if (q <= 0)
+        return _min;
+    if (q >= 1)
+        return _max;
+    uint64_t rank = (uint64_t)(q * (_count - 1));
+    if (rank < _zero_count)
+        return _min;
+    uint64_t seen = _zero_count;
+    for (size_t i = 0; i < _bins.size(); i++) {
+        seen += _bins[i];
+        if (seen > rank) {
+            double v = bucketValue(_offset + i);
+            // the bucket estimate can fall just outside the observed range
+            if (v < _min) v = _min;
+            if (v > _max) v = _max;
+            return v;
+        }
+    }
+    return _max;
+}
+
+////////////////////////////////////////////////////////////////
+//  FCT statistics collector
+////////////////////////////////////////////////////////////////
+
+FctStatsCollector::FctStatsCollector(linkspeed_bps linkspeed, simtime_picosec base_delay)
+    : _linkspeed(linkspeed), _base_delay(base_delay), _started(0), _finished(0)
+{
+    // default buckets: mice, 100KB, 1MB, 10MB, elephants
+    vector<mem_b> bounds;
+    bounds.push_back(10000);
+    bounds.push_back(100000);
+    bounds.push_back(1000000);
+    bounds.push_back(10000000);
+    setSizeBuckets(bounds);
+}
+
+void FctStatsCollector::setSizeBuckets(const vector<mem_b>& upper_bounds) {
+    // changing buckets once flows have finished would mix up the stats
+    assert(_finished == 0);
+    for (size_t i = 1; i < upper_bounds.size(); i++) {
+        assert(upper_bounds[i] > upper_bounds[i-1]);
+    }
+    _bounds = upper_bounds;
+    _buckets.clear();
+    _buckets.resize(_bounds.size() + 1);
+}
+
+size_t FctStatsCollector::bucketFor(mem_b bytes) const {
+    // few buckets, so a linear scan is fine
+    size_t i = 0;
+    while (i < _bounds.size() && bytes > _bounds[i])
+        i++;
+    return i;
+}
+
+simtime_picosec FctStatsCollector::idealFct(mem_b bytes) const {
+    // in floating point: bytes * 8 * 10^12 overflows 64 bits above ~2.3MB
+    return _base_delay + timeFromSec(bytes * 8.0 / _linkspeed);
+}
+
+void FctStatsCollector::logEvent(PacketFlow& flow, Logged& location, FlowEvent ev, mem_b bytes, uint64_t pkts) {
+    simtime_picosec now = EventList::now();
+    switch (ev) {
+    case START:
+        _start_times[&flow] = now;
+        _started++;
+        break;
+    case FINISH:
+    {
+        auto i = _start_times.find(&flow);
+        if (i == _start_times.end()) {
+            // we didn't see the start - probably attached to the src after it started.
+            return;
+        }
+        simtime_picosec fct = now - i->second;
+        _start_times.erase(i);
+        _finished++;
+
+        double slowdown = (double)fct / idealFct(bytes);
+        Bucket& b = _buckets[bucketFor(bytes)];
+        b.fct.add(timeAsUs(fct));
+        b.slowdown.add(slowdown);
+        b.bytes += bytes;
+        break;
+    }
+    }
+}
+
+void FctStatsCollector::writeBucket(ostream& out, const string& label, const Bucket& b) const {
+    out << label
+        << " flows " << b.fct.count()
+        << " bytes " << b.bytes
+        << " fct_mean_us " << b.fct.mean()
+        << " fct_p50_us " << b.fct.quantile(0.5)
+        << " fct_p99_us " << b.fct.quantile(0.99)
+        << " fct_p999_us " << b.fct.quantile(0.999)
+        << " fct_max_us " << b.fct.max()
+        << " slowdown_p50 " << b.slowdown.quantile(0.5)
+        << " slowdown_p99 " << b.slowdown.quantile(0.99)
+        << " slowdown_p999 " << b.slowdown.quantile(0.999)
+        << endl;
+}
+
+void FctStatsCollector::writeSummary(ostream& out) const {
+    Bucket all;
+    for (size_t i = 0; i < _buckets.size(); i++) {
+        all.fct.merge(_buckets[i].fct);
+        all.slowdown.merge(_buckets[i].slowdown);
+        all.bytes += _buckets[i].bytes;
+    }
+
+    out << "# FCT summary: started " << _started << " finished " << _finished
+        << " unfinished " << unfinished()
+        << " ideal_base_us " << timeAsUs(_base_delay)
+        << " linkspeed_gbps " << speedAsGbps(_linkspeed) << endl;
+    out << fixed << setprecision(3);
+    mem_b lo = 0;
+    for (size_t i = 0; i < _buckets.size(); i++) {
+        stringstream label;
+        if (i < _bounds.size()) {
+            label << "size " << lo << "-" << _bounds[i];
+            lo = _bounds[i] + 1;
+        } else {
+            label << "size " << lo << "-inf";
+        }
+        writeBucket(out, label.str(), _buckets[i]);
+    }
+    writeBucket(out, "all", all);
+}
+
+bool FctStatsCollector::writeSummary(const string& filename) const {
+    ofstream out(filename.c_str());
+    if (!out) {
+        cerr << "Failed to open FCT summary file " << filename << endl;
+        return false;
+    }
+    writeSummary(out);
+    return true;
+}
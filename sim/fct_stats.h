@@ -0,0 +1,96 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef FCT_STATS_H
+#define FCT_STATS_H
+
+/*
+ * In-simulator flow completion time statistics.
+ *
+ * FctStatsCollector is a FlowEventLogger, so it can be handed to any
+ * source that already reports START/FINISH flow events (EqdsSrc,
+ * NdpSrc, TcpSrc, SwiftSrc).  Rather than writing a record per flow
+ * to the logfile, it folds each completed flow into a set of online
+ * quantile sketches, bucketed by flow size, and only writes a short
+ * summary when asked to at the end of the run.
+ */
+
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+#include "config.h"
+#include "loggertypes.h"
+
+// QuantileSketch is a log-bucketed histogram with bounded relative
+// error (in the style of DDSketch).  Values are mapped to bucket
+// ceil(log_gamma(v)) where gamma = (1+alpha)/(1-alpha), so any
+// quantile estimate is within a factor alpha of a true sample value.
+// Two sketches with the same alpha can be merged exactly, which lets
+// us combine per-bucket sketches into an overall one.
+class QuantileSketch {
+public:
+    QuantileSketch(double alpha = 0.01);
+    void add(double value);
+    void merge(const QuantileSketch& other);
+    double quantile(double q) const;
+    uint64_t count() const {return _count;}
+    double mean() const {return _count ? _sum / _count : 0;}
+    double min() const {return _min;}
+    double max() const {return _max;}
+private:
+    int bucketIndex(double value) const;
+    double bucketValue(int index) const;
+
+    double _alpha;
+    double _gamma;
+    double _log_gamma;
+    vector<uint64_t> _bins;  // _bins[i] counts values in bucket _offset+i
+    int _offset;
+    uint64_t _zero_count;    // values <= 0 don't have a log bucket
+    uint64_t _count;
+    double _sum;
+    double _min;
+    double _max;
+};
+
+class FctStatsCollector : public FlowEventLogger {
+public:
+    // ideal FCT for a flow of B bytes is taken to be base_delay +
+    // B*8/linkspeed, ie one unloaded RTT plus serialization at the
+    // host NIC rate.
+    FctStatsCollector(linkspeed_bps linkspeed, simtime_picosec base_delay);
+    // flows are placed in the first size bucket whose upper bound
+    // they don't exceed; flows larger than all bounds go in a final
+    // open-ended bucket.
+    void setSizeBuckets(const vector<mem_b>& upper_bounds);
+    virtual void logEvent(PacketFlow& flow, Logged& location, FlowEvent ev, mem_b bytes, uint64_t pkts);
+    simtime_picosec idealFct(mem_b bytes) const;
+
+    uint64_t started() const {return _started;}
+    uint64_t finished() const {return _finished;}
+    uint64_t unfinished() const {return _start_times.size();}
+
+    // write a compact text summary: one line per size bucket plus an
+    // overall line.  FCTs are reported in microseconds.
+    void writeSummary(ostream& out) const;
+    bool writeSummary(const string& filename) const;
+private:
+    struct Bucket {
+        Bucket() : bytes(0) {}
+        QuantileSketch fct;      // in microseconds
+        QuantileSketch slowdown; // fct / ideal fct
+        uint64_t bytes;
+    };
+    size_t bucketFor(mem_b bytes) const;
+    void writeBucket(ostream& out, const string& label, const Bucket& b) const;
+
+    linkspeed_bps _linkspeed;
+    simtime_picosec _base_delay;
+    vector<mem_b> _bounds;
+    vector<Bucket> _buckets;   // _bounds.size() + 1 entries
+    // only flows that are currently in flight are kept here, so
+    // memory is proportional to active flows, not total flows.
+    unordered_map<const PacketFlow*, simtime_picosec> _start_times;
+    uint64_t _started;
+    uint64_t _finished;
+};
+
+#endif
@@ -62,7 +62,6 @@ HPCCSrc::HPCCSrc(HPCCLogger* logger, TrafficLogger* pktlogger, EventList &eventl
     _node_num = _global_node_count++;
     _nodename = "HPCCsrc " + to_string(_node_num);
 
-    srand(time(NULL));
     _pathid = random()%256;
 
     _Wai = _mss;
@@ -202,7 +201,7 @@ void HPCCSrc::processAck(const HPCCAck& ack) {
     _pacing_rate = _cwnd * 8 * pow(10,12) / _T;
     update_spacing();
 
-    //cout << "INT Entries " << ack._int_hop << " qs " << ack._int_info[0]._queuesize << " TS " << timeAsUs(ack._int_info[0]._ts) << " TX " << ack._int_info[0]._txbytes << endl; 
+    //cout << "INT Entries " << ack.int_hops() << " qs " << ack.int_info(0)._queuesize << " TS " << timeAsUs(ack.int_info(0)._ts) << " TX " << ack.int_info(0)._txbytes << endl; 
 
 
     if (_logger) _logger->logHPCC(*this, HPCCLogger::HPCC_RCV);
@@ -357,14 +356,14 @@ double HPCCSrc::measureInFlight(const HPCCAck& ack){
     double txRate;
     simtime_picosec tau = _T;
 
-    if (ack._int_hop == _link_count){
+    if (ack.int_hops() == _link_count){
         for (i = 0;i<_link_count;i++){
-            txRate = (ack._int_info[i]._txbytes - _link_info[i]._txbytes) * 8 * pow(10,12) / (ack._int_info[i]._ts - _link_info[i]._ts);
+            txRate = (ack.int_info(i)._txbytes - _link_info[i]._txbytes) * 8 * pow(10,12) / (ack.int_info(i)._ts - _link_info[i]._ts);
 
-            uprime = min(ack._int_info[i]._queuesize, _link_info[i]._queuesize)*8 * pow (10,12) / ( (double)ack._int_info[i]._linkrate * _T ) + txRate / ack._int_info[i]._linkrate; 
+            uprime = min(ack.int_info(i)._queuesize, _link_info[i]._queuesize)*8 * pow (10,12) / ( (double)ack.int_info(i)._linkrate * _T ) + txRate / ack.int_info(i)._linkrate; 
             if (uprime > u) {
                 u = uprime;
-                tau = ack._int_info[i]._ts - _link_info[i]._ts;
+                tau = ack.int_info(i)._ts - _link_info[i]._ts;
             }
         }
 
@@ -373,9 +372,9 @@ double HPCCSrc::measureInFlight(const HPCCAck& ack){
         _U = (1 - tau/_T)*_U + tau/_T*u;
     }
     else {    //reset path state
-        _link_count = ack._int_hop;
+        _link_count = ack.int_hops();
         for (i = 0;i<_link_count;i++)
-            _link_info[i] = ack._int_info[i];
+            _link_info[i] = ack.int_info(i);
     }
 
     return _U;
@@ -495,19 +494,17 @@ void HPCCSink::receivePacket(Packet& pkt) {
     } else if (seqno < _cumulative_ack+1) {
         //must have been a bad retransmit
     }
-    send_ack(ts,p->_int_info, p->_int_hop);
+    send_ack(ts,p->take_int());
     // have we seen everything yet?
     pkt.flow().logTraffic(pkt,*this,TrafficLogger::PKT_RCVDESTROY);
     pkt.free();
 }
 
-void HPCCSink::send_ack(simtime_picosec ts, IntEntry* intinfo, uint32_t hops) {
+void HPCCSink::send_ack(simtime_picosec ts, IntRecord* intinfo) {
     HPCCAck *ack = 0;
     ack = HPCCAck::newpkt(_src->_flow, *_route, _cumulative_ack,_srcaddr);
     ack->set_pathid(0);
-
-    if (hops>0)
-        ack->copy_int_info(intinfo,hops);
+    ack->set_int(intinfo);
 
     ack->sendOn();
 }
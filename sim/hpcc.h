@@ -193,7 +193,7 @@ private:
     HPCCPacket::seq_t _highest_seqno;
  
     // Mechanism
-    void send_ack(simtime_picosec ts, IntEntry* intinfo, uint32_t hops);
+    void send_ack(simtime_picosec ts, IntRecord* intinfo);
     void send_nack(simtime_picosec ts, HPCCPacket::seq_t ackno);
 };
 
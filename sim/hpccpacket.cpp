@@ -4,10 +4,4 @@
 PacketDB<HPCCPacket> HPCCPacket::_packetdb;
 PacketDB<HPCCAck> HPCCAck::_packetdb;
 PacketDB<HPCCNack> HPCCNack::_packetdb;
-
-void HPCCAck::copy_int_info(IntEntry* info, int cnt){
-    for (int i = 0;i<cnt;i++)
-        _int_info[i] = info[i];
-        
-    _int_hop = cnt;
-};
+vector<IntRecord*> IntRecord::_freelist;
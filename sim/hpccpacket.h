@@ -25,6 +25,43 @@ public:
     linkspeed_bps _linkrate;
 };
 
+// The INT entries a data packet collects along its path.  Records
+// live in a pool next to the packets, and a packet only holds a
+// pointer to one: the first queue that stamps a packet allocates the
+// record, and HPCCSink hands it on to the ACK rather than copying it.
+// Whichever packet holds the record when it is freed returns it.
+class IntRecord {
+public:
+    const static uint32_t MAX_HOPS = 5;
+
+    static IntRecord* alloc() {
+        IntRecord* r;
+        if (_freelist.empty()) {
+            r = new IntRecord();
+            MemoryStats::account(MemoryStats::PACKETS, sizeof(IntRecord), 1);
+        } else {
+            r = _freelist.back();
+            _freelist.pop_back();
+        }
+        r->_hops = 0;
+        return r;
+    }
+    void free() {_freelist.push_back(this);}
+
+    // the entry for the next hop, reset to defaults
+    IntEntry& append() {
+        assert(_hops < MAX_HOPS);
+        _entries[_hops] = IntEntry();
+        return _entries[_hops++];
+    }
+    uint32_t hops() const {return _hops;}
+    const IntEntry& operator[](uint32_t i) const {return _entries[i];}
+private:
+    IntEntry _entries[MAX_HOPS];
+    uint32_t _hops;
+    static vector<IntRecord*> _freelist;
+};
+
 class HPCCPacket : public Packet {
 public:
     typedef uint64_t seq_t;
@@ -46,7 +83,7 @@ public:
         p->_path_len = 0;
         p->_direction = NONE;
         p->set_dst(destination);
-        p->_int_hop = 0;
+        p->_int = NULL;
         return p;
     }
   
@@ -64,13 +101,26 @@ public:
         p->_retransmitted = retransmitted;
         p->_last_packet = last_packet;
         p->_path_len = route.size();
-        p->_int_hop = 0;
+        p->_int = NULL;
         p->set_dst(destination);
         return p;
     }
   
-    void free() {_packetdb.freePacket(this);}
+    void free() {
+        if (ref_count() == 1)
+            release_int();
+        _packetdb.freePacket(this);
+    }
     virtual ~HPCCPacket(){}
+
+    // the INT entry for the hop this packet is leaving
+    IntEntry& append_int() {
+        if (!_int)
+            _int = IntRecord::alloc();
+        return _int->append();
+    }
+    // hand this packet's INT record to someone else, eg the ACK
+    IntRecord* take_int() {IntRecord* r = _int; _int = NULL; return r;}
     
     inline seq_t seqno() const {return _seqno;}
     inline bool retransmitted() const {return _retransmitted;}
@@ -79,16 +129,15 @@ public:
     inline void set_ts(simtime_picosec ts) {_ts = ts;}
     inline uint32_t path_id() const {if (_pathid!=UINT32_MAX) return _pathid; else return _route->path_id();}
     virtual PktPriority priority() const {return Packet::PRIO_LO;}
-    IntEntry _int_info[5];
-    uint32_t _int_hop;
     const static int ACKSIZE=64;
 protected:
     seq_t _seqno;
     simtime_picosec _ts;
     bool _retransmitted;
     bool _last_packet;  // set to true in the last packet in a flow.
+    IntRecord* _int; // switch INT information gathered so far, if any
 
-    //area to aggregate switch INT information
+    void release_int() {if (_int) {_int->free(); _int = NULL;}}
     static PacketDB<HPCCPacket> _packetdb;
 };
 
@@ -106,13 +155,22 @@ public:
         p->_path_len = 0;
         p->_direction = NONE;
         p->set_dst(destination);
-        p->_int_hop = 0;
+        p->_int = NULL;
         return p;
     }
 
-    void copy_int_info(IntEntry* info, int cnt);
+    // takes ownership of the record, which may be NULL
+    void set_int(IntRecord* r) {assert(!_int); _int = r;}
+    uint32_t int_hops() const {return _int ? _int->hops() : 0;}
+    const IntEntry& int_info(uint32_t i) const {return (*_int)[i];}
   
-    void free() {_packetdb.freePacket(this);}
+    void free() {
+        if (ref_count() == 1 && _int) {
+            _int->free();
+            _int = NULL;
+        }
+        _packetdb.freePacket(this);
+    }
     inline seq_t ackno() const {return _ackno;}
     inline simtime_picosec ts() const {return _ts;}
     inline void set_ts(simtime_picosec ts) {_ts = ts;}
@@ -120,11 +178,10 @@ public:
   
     virtual ~HPCCAck(){}
 
-    IntEntry _int_info[5];
-    uint32_t _int_hop;
 protected:
     seq_t _ackno;
     simtime_picosec _ts;
+    IntRecord* _int;
     static PacketDB<HPCCAck> _packetdb;
 };
 
@@ -160,6 +217,8 @@ protected:
     static PacketDB<HPCCNack> _packetdb;
 };
 
-
+PACKET_SIZE_BUDGET(HPCCPacket, 112);
+PACKET_SIZE_BUDGET(HPCCAck, 104);
+PACKET_SIZE_BUDGET(HPCCNack, 96);
 
 #endif
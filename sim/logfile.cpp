@@ -25,7 +25,9 @@ string RawLogEvent::str() {
 Logfile::Logfile(const string& filename, EventList& eventlist) 
 : _starttime(0), _eventlist(eventlist), 
   _preamble(ios_base::out | ios_base::in), 
-  _logfilename(filename), _numRecords(0)
+  _logfilename(filename), _numRecords(0),
+  _indexfile(NULL), _index_bucket_width(0), _index_bucket(0),
+  _index_bucket_first_rec(0), _index_bucket_open(false)
 {
     _logfile = fopen(_logfilename.c_str(), "wbS");
     if (_logfile==NULL) {
@@ -39,6 +41,28 @@ Logfile::~Logfile() {
         fclose(_logfile);
         transposeLog();
     }
+    if (_indexfile != NULL) {
+        finishIndex();
+    }
+}
+
+void
+Logfile::enableIndex(simtime_picosec bucket_width) {
+    assert(bucket_width > 0);
+    assert(_numRecords == 0);
+    string indexname = _logfilename + ".idx";
+    _indexfile = fopen(indexname.c_str(), "wbS");
+    if (_indexfile == NULL) {
+        cerr << "Failed to open log index " << indexname << endl;
+        exit(1);
+    }
+    _index_bucket_width = bucket_width;
+    uint32_t version = LOG_INDEX_VERSION;
+    uint32_t recsize = LOG_RECORD_SIZE;
+    fwrite(LOG_INDEX_MAGIC, 1, 8, _indexfile);
+    fwrite(&version, sizeof(uint32_t), 1, _indexfile);
+    fwrite(&recsize, sizeof(uint32_t), 1, _indexfile);
+    fwrite(&_index_bucket_width, sizeof(uint64_t), 1, _indexfile);
 }
 
 void
@@ -76,9 +100,79 @@ Logfile::writeRecord(uint32_t type, uint32_t id, uint32_t ev,
     fwrite(&val1, sizeof(double), 1, _logfile);
     fwrite(&val2, sizeof(double), 1, _logfile);
     fwrite(&val3, sizeof(double), 1, _logfile);
+    if (_indexfile)
+        indexRecord(time, type, id);
     _numRecords++;
 }
 
+void
+Logfile::indexRecord(simtime_picosec time, uint32_t type, uint32_t id) {
+    uint64_t bucket = time / _index_bucket_width;
+    if (!_index_bucket_open || bucket != _index_bucket) {
+        // records arrive in time order, so once we move on a bucket is done
+        flushIndexBucket();
+        _index_bucket = bucket;
+        _index_bucket_first_rec = _numRecords;
+        _index_bucket_open = true;
+    }
+    uint64_t key = ((uint64_t)type << 32) | id;
+    auto i = _index_entries.find(key);
+    if (i == _index_entries.end()) {
+        LogIndexEntry& e = _index_entries[key];
+        e.type = type;
+        e.id = id;
+        e.first_rec = _numRecords;
+        e.last_rec = _numRecords;
+        e.count = 1;
+    } else {
+        i->second.last_rec = _numRecords;
+        i->second.count++;
+    }
+}
+
+void
+Logfile::flushIndexBucket() {
+    if (!_index_bucket_open)
+        return;
+    LogIndexBucket b;
+    b.bucket = _index_bucket;
+    b.block_offset = ftell(_indexfile);
+    b.first_rec = _index_bucket_first_rec;
+    b.nentries = _index_entries.size();
+    _index_dir.push_back(b);
+
+    fwrite(&b.nentries, sizeof(uint32_t), 1, _indexfile);
+    for (auto i = _index_entries.begin(); i != _index_entries.end(); i++) {
+        LogIndexEntry& e = i->second;
+        fwrite(&e.type, sizeof(uint32_t), 1, _indexfile);
+        fwrite(&e.id, sizeof(uint32_t), 1, _indexfile);
+        fwrite(&e.first_rec, sizeof(uint64_t), 1, _indexfile);
+        fwrite(&e.last_rec, sizeof(uint64_t), 1, _indexfile);
+        fwrite(&e.count, sizeof(uint32_t), 1, _indexfile);
+    }
+    _index_entries.clear();
+    _index_bucket_open = false;
+}
+
+void
+Logfile::finishIndex() {
+    flushIndexBucket();
+    uint64_t dir_offset = ftell(_indexfile);
+    uint64_t nbuckets = _index_dir.size();
+    for (size_t i = 0; i < _index_dir.size(); i++) {
+        LogIndexBucket& b = _index_dir[i];
+        fwrite(&b.bucket, sizeof(uint64_t), 1, _indexfile);
+        fwrite(&b.block_offset, sizeof(uint64_t), 1, _indexfile);
+        fwrite(&b.first_rec, sizeof(uint64_t), 1, _indexfile);
+        fwrite(&b.nentries, sizeof(uint32_t), 1, _indexfile);
+    }
+    fwrite(&dir_offset, sizeof(uint64_t), 1, _indexfile);
+    fwrite(&nbuckets, sizeof(uint64_t), 1, _indexfile);
+    fwrite(LOG_INDEX_MAGIC, 1, 8, _indexfile);
+    fclose(_indexfile);
+    _indexfile = NULL;
+}
+
 void
 Logfile::transposeLog() {
     double* timeRec = new double[_numRecords];
@@ -13,6 +13,7 @@
 #include <sstream>
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include "config.h"
 #include "network.h"
 #include "eventlist.h"
@@ -35,11 +36,51 @@ class RawLogEvent {
     string _name;
 };
 
+/*
+ * Optional time index, written to <logfile>.idx alongside the trace.
+ *
+ * Time is divided into fixed-width buckets.  For each non-empty
+ * bucket we write a block listing, for every (type,id) that logged in
+ * that bucket, the first and last record number it used.  Record
+ * numbers count from the start of the binary trace (after "# TRACE"),
+ * each record being LOG_RECORD_SIZE bytes.  A directory of blocks and
+ * a fixed-size footer go at the end of the file, so a reader can seek
+ * straight to the buckets covering a time range without reading the
+ * rest of the index or the trace.
+ *
+ * File layout:
+ *   header:    magic[8] version:u32 record_size:u32 bucket_width_ps:u64
+ *   blocks:    nentries:u32 {type:u32 id:u32 first:u64 last:u64 count:u32}*
+ *   directory: {bucket:u64 block_offset:u64 first_rec:u64 nentries:u32}*
+ *   footer:    dir_offset:u64 nbuckets:u64 magic[8]
+ */
+#define LOG_INDEX_MAGIC "HTSIMIDX"
+#define LOG_INDEX_VERSION 1
+#define LOG_RECORD_SIZE (3*sizeof(uint32_t) + 4*sizeof(double))
+#define LOG_INDEX_FOOTER_SIZE (2*sizeof(uint64_t) + 8)
+
+struct LogIndexEntry {
+    uint32_t type;
+    uint32_t id;
+    uint64_t first_rec;
+    uint64_t last_rec;
+    uint32_t count;
+};
+
+struct LogIndexBucket {
+    uint64_t bucket;       // bucket number, ie time / bucket width
+    uint64_t block_offset; // offset of this bucket's block in the index file
+    uint64_t first_rec;    // first record in this bucket
+    uint32_t nentries;
+};
+
 class Logfile {
  public:
     Logfile(const string& filename, EventList& eventlist);
     ~Logfile();
     void setStartTime(simtime_picosec starttime);
+    // write a time index to <filename>.idx; must be called before any records are written
+    void enableIndex(simtime_picosec bucket_width);
     void write(const string& msg);
     void writeName(Logged& logged);
     void writeRecord(uint32_t type, uint32_t id, uint32_t ev, 
@@ -56,6 +97,18 @@ class Logfile {
     FILE* _logfile;
     //bool _startedTrace;
     long int _numRecords;
+
+    // time index
+    void indexRecord(simtime_picosec time, uint32_t type, uint32_t id);
+    void flushIndexBucket();
+    void finishIndex();
+    FILE* _indexfile;
+    simtime_picosec _index_bucket_width;
+    uint64_t _index_bucket;  // bucket currently being accumulated
+    uint64_t _index_bucket_first_rec;
+    bool _index_bucket_open;
+    unordered_map<uint64_t, LogIndexEntry> _index_entries; // keyed by type<<32 | id
+    vector<LogIndexBucket> _index_dir;
 };
 
 #endif
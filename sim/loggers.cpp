@@ -1,6 +1,8 @@
 // -*- c-basic-offset: 4; indent-tabs-mode: nil -*-        
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <math.h>
 #include "loggers.h"
 
 
@@ -183,6 +185,7 @@ QueueLoggerSampling::QueueLoggerSampling(simtime_picosec period,
       _queue(NULL), _lastlook(0), _period(period), _lastq(0), 
       _seenQueueInD(false), _cumidle(0), _cumarr(0), _cumdrop(0)
 {        
+    setPeriodic(period);
     eventlist.sourceIsPendingRel(*this,0);
 }
 
@@ -319,6 +322,7 @@ MultiQueueLoggerSampling::MultiQueueLoggerSampling(id_t id, simtime_picosec peri
       _id(id), _period(period),
       _seenQueueInD(false), _currentQueueSizeBytes(0), _currentQueueSizePkts(0)
 {        
+    setPeriodic(period);
     eventlist.sourceIsPendingRel(*this,0);
 }
 
@@ -405,6 +409,178 @@ string MultiQueueLoggerSampling::event_to_str(RawLogEvent& event) {
     return ss.str();
 }
 
+AggregateQueueLoggerSampling::PortLogger::PortLogger(BaseQueue& queue)
+    : _queue(&queue), _last_change(EventList::now()), _last_depth(queue.queuesize()),
+      _depth_integral(0), _busy(0),
+      _min_depth(_last_depth), _max_depth(_last_depth), _mean_depth(0), _util(0)
+{
+}
+
+void
+AggregateQueueLoggerSampling::PortLogger::logQueue(BaseQueue& queue, QueueEvent ev, Packet& pkt) {
+    simtime_picosec now = EventList::now();
+    _depth_integral += (double)_last_depth * (now - _last_change);
+    _last_change = now;
+    _last_depth = queue.queuesize();
+    _min_depth = min(_min_depth, _last_depth);
+    _max_depth = max(_max_depth, _last_depth);
+    if (ev == PKT_SERVICE)
+        _busy += queue.drainTime(&pkt);
+}
+
+void
+AggregateQueueLoggerSampling::PortLogger::sample(simtime_picosec now, simtime_picosec period) {
+    // min and max were tracked as events arrived; finish off the
+    // mean, then start the next period from the current depth.
+    _depth_integral += (double)_last_depth * (now - _last_change);
+    _mean_depth = _depth_integral / period;
+    _util = (double)_busy / period;
+    // a packet's service time is credited when it completes, so may
+    // straddle the period boundary
+    if (_util > 1.0)
+        _util = 1.0;
+    _last_change = now;
+    _last_depth = _queue->queuesize();
+    _depth_integral = 0;
+    _busy = 0;
+}
+
+AggregateQueueLoggerSampling::AggregateQueueLoggerSampling(simtime_picosec period, EventList& eventlist,
+                                                           uint32_t levels)
+    : EventSource(eventlist, "AggregateQueuelogSampling"),
+      _period(period), _levels(levels)
+{
+    setPeriodic(period);
+    eventlist.sourceIsPendingRel(*this, period);
+}
+
+AggregateQueueLoggerSampling::Group*
+AggregateQueueLoggerSampling::findGroup(vector<Group>& groups, uint32_t index, const string& name) {
+    while (groups.size() <= index) {
+        Group g;
+        g.logged = new Logged(name + ntoa(groups.size()));
+        _logfile->writeName(*g.logged);
+        groups.push_back(g);
+    }
+    return &groups[index];
+}
+
+void
+AggregateQueueLoggerSampling::addSwitch(Switch& sw, uint32_t tier, int pod) {
+    assert(_logfile);
+    Group sw_group;
+    sw_group.logged = &sw;
+    for (uint32_t i = 0; i < sw.portCount(); i++) {
+        BaseQueue* queue = sw.getPort(i);
+        PortLogger* port = new PortLogger(*queue);
+        queue->setLogger(port);
+        _ports.push_back(port);
+        sw_group.ports.push_back(port);
+        if (_levels & TIER)
+            findGroup(_tiers, tier, "tier")->ports.push_back(port);
+        if ((_levels & POD) && pod >= 0)
+            findGroup(_pods, pod, "pod")->ports.push_back(port);
+    }
+    if (_levels & SWITCH) {
+        _logfile->writeName(sw);
+        _switches.push_back(sw_group);
+    }
+}
+
+void
+AggregateQueueLoggerSampling::writeGroup(Group& group) {
+    size_t n = group.ports.size();
+    if (n == 0)
+        return;
+    mem_b min_depth = group.ports[0]->_min_depth, max_depth = group.ports[0]->_max_depth;
+    double min_util = group.ports[0]->_util, max_util = min_util;
+    double sum_depth = 0, sum_util = 0;
+    for (size_t i = 0; i < n; i++) {
+        PortLogger* p = group.ports[i];
+        min_depth = min(min_depth, p->_min_depth);
+        max_depth = max(max_depth, p->_max_depth);
+        min_util = min(min_util, p->_util);
+        max_util = max(max_util, p->_util);
+        sum_depth += p->_mean_depth;
+        sum_util += p->_util;
+    }
+
+    // p99 across ports: index of the 99th percentile in sorted order
+    size_t rank = (size_t)ceil(0.99 * n) - 1;
+    _scratch.resize(n);
+    for (size_t i = 0; i < n; i++)
+        _scratch[i] = group.ports[i]->_max_depth;
+    nth_element(_scratch.begin(), _scratch.begin() + rank, _scratch.end());
+    double p99_depth = _scratch[rank];
+    for (size_t i = 0; i < n; i++)
+        _scratch[i] = group.ports[i]->_util;
+    nth_element(_scratch.begin(), _scratch.begin() + rank, _scratch.end());
+    double p99_util = _scratch[rank];
+
+    uint32_t id = group.logged->get_id();
+    _logfile->writeRecord(QUEUE_AGGREGATE, id, QueueLogger::AGG_DEPTH,
+                          (double)min_depth, sum_depth / n, (double)max_depth);
+    _logfile->writeRecord(QUEUE_AGGREGATE, id, QueueLogger::AGG_UTIL,
+                          min_util, sum_util / n, max_util);
+    _logfile->writeRecord(QUEUE_AGGREGATE, id, QueueLogger::AGG_TAIL,
+                          p99_depth, p99_util, (double)n);
+}
+
+void
+AggregateQueueLoggerSampling::doNextEvent() {
+    eventlist().sourceIsPendingRel(*this, _period);
+    simtime_picosec now = eventlist().now();
+    for (size_t i = 0; i < _ports.size(); i++) {
+        PortLogger* p = _ports[i];
+        p->sample(now, _period);
+        if (_levels & PORT) {
+            uint32_t id = p->_queue->get_id();
+            _logfile->writeRecord(QUEUE_AGGREGATE, id, QueueLogger::AGG_DEPTH,
+                                  (double)p->_min_depth, p->_mean_depth, (double)p->_max_depth);
+            _logfile->writeRecord(QUEUE_AGGREGATE, id, QueueLogger::AGG_UTIL,
+                                  p->_util, p->_util, p->_util);
+            _logfile->writeRecord(QUEUE_AGGREGATE, id, QueueLogger::AGG_TAIL,
+                                  (double)p->_max_depth, p->_util, 1);
+        }
+    }
+    for (size_t i = 0; i < _switches.size(); i++)
+        writeGroup(_switches[i]);
+    for (size_t i = 0; i < _tiers.size(); i++)
+        writeGroup(_tiers[i]);
+    for (size_t i = 0; i < _pods.size(); i++)
+        writeGroup(_pods[i]);
+    // the next period's min and max start from the current depth
+    for (size_t i = 0; i < _ports.size(); i++) {
+        PortLogger* p = _ports[i];
+        p->_min_depth = p->_last_depth;
+        p->_max_depth = p->_last_depth;
+    }
+}
+
+string AggregateQueueLoggerSampling::event_to_str(RawLogEvent& event) {
+    stringstream ss;
+    ss << fixed << setprecision(9) << event._time;
+    ss << " Type QUEUE_AGGREGATE ID " << event._id;
+    switch(event._ev) {
+    case QueueLogger::AGG_DEPTH:
+        ss << " Ev DEPTH Min " << (int)event._val1 << " Mean " << setprecision(1) << event._val2
+           << " Max " << (int)event._val3;
+        break;
+    case QueueLogger::AGG_UTIL:
+        ss << " Ev UTIL Min " << setprecision(3) << event._val1 << " Mean " << event._val2
+           << " Max " << event._val3;
+        break;
+    case QueueLogger::AGG_TAIL:
+        ss << " Ev TAIL P99Depth " << (int)event._val1 << " P99Util " << setprecision(3) << event._val2
+           << " Ports " << (int)event._val3;
+        break;
+    default:
+        ss << " Unknown Event " << event._ev;
+    }
+    if (event._name!="") ss << " Name " << event._name;
+    return ss.str();
+}
+
 void FlowEventLoggerSimple::logEvent(PacketFlow& flow, Logged& location, FlowEvent ev, mem_b bytes, uint64_t pkts) {
     _logfile->writeRecord(Logger::FLOW_EVENT,
                           location.get_id(),
@@ -1114,6 +1290,7 @@ MemoryLoggerSampling::MemoryLoggerSampling(simtime_picosec period,
                                            EventList& eventlist):
     EventSource(eventlist,"MemorySampling"), _period(period)
 {
+    setPeriodic(period);
     eventlist.sourceIsPendingRel(*this,0);
 }
 
@@ -1198,6 +1375,7 @@ SinkLoggerSampling::SinkLoggerSampling(simtime_picosec period,
     EventSource(eventlist,"SinkSampling"), _last_time(0), _period(period), 
     _sink_type(sink_type), _event_type(event_type)
 {
+    setPeriodic(period);
     eventlist.sourceIsPendingRel(*this,0);
 }
 
@@ -1682,6 +1860,7 @@ ReorderBufferLoggerSampling::ReorderBufferLoggerSampling(simtime_picosec period,
     : EventSource(eventlist,"ReorderBufferLoggerSampling"),
       _period(period), _queue_len(0), _min_queue(0), _max_queue(0)
 {
+    setPeriodic(period);
     eventlist.sourceIsPendingRel(*this,0);    
 }
 
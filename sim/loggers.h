@@ -176,6 +176,61 @@ class MultiQueueLoggerSampling : public QueueLogger, public EventSource {
     int _currentQueueSizePkts;
 };
 
+// AggregateQueueLoggerSampling keeps per-port queue statistics for a
+// set of switches and, once per period, writes summary records for
+// each port, switch, tier and pod (as selected by levels), rather
+// than raw records for every port.  For each group it writes:
+//   AGG_DEPTH min/mean/max queue depth in bytes
+//   AGG_UTIL  min/mean/max link utilization
+//   AGG_TAIL  p99 depth, p99 utilization, number of ports
+// For a single port, min and max are over the period and mean is
+// time-weighted.  For a group they are taken across its ports (min of
+// the per-port minimums, mean of the means, max of the maximums) and
+// the p99 is over the per-port maximum depth and utilization.
+// It replaces any queue logger already set on the ports.
+class AggregateQueueLoggerSampling : public Logger, public EventSource {
+ public:
+    enum Level { PORT = 1, SWITCH = 2, TIER = 4, POD = 8 };
+    AggregateQueueLoggerSampling(simtime_picosec period, EventList& eventlist,
+                                 uint32_t levels = SWITCH | TIER | POD);
+    // pod < 0 if the switch isn't in a pod (eg core switches).  Must
+    // be added to the logfile first, as this writes the group names.
+    void addSwitch(Switch& sw, uint32_t tier, int pod);
+    void doNextEvent();
+    static string event_to_str(RawLogEvent& event);
+ private:
+    class PortLogger : public QueueLogger {
+    public:
+        PortLogger(BaseQueue& queue);
+        void logQueue(BaseQueue& queue, QueueEvent ev, Packet& pkt);
+        void sample(simtime_picosec now, simtime_picosec period);
+        BaseQueue* _queue;
+        simtime_picosec _last_change;
+        mem_b _last_depth;
+        double _depth_integral; // byte-picoseconds this period
+        simtime_picosec _busy;
+        // results of the last sample
+        mem_b _min_depth;
+        mem_b _max_depth;
+        double _mean_depth;
+        double _util;
+    };
+    struct Group {
+        Logged* logged;
+        vector<PortLogger*> ports;
+    };
+    Group* findGroup(vector<Group>& groups, uint32_t index, const string& name);
+    void writeGroup(Group& group);
+
+    simtime_picosec _period;
+    uint32_t _levels;
+    vector<PortLogger*> _ports;
+    vector<Group> _switches;
+    vector<Group> _tiers;
+    vector<Group> _pods;
+    vector<double> _scratch;
+};
+
 class SinkLoggerSampling : public Logger, public EventSource {
  public:
     SinkLoggerSampling(simtime_picosec period, EventList& eventlist,
@@ -68,7 +68,7 @@ class Logger {
                      STRACK_SINK=32, STRACK_MEMORY=33,
                      EQDS_EVENT=38, EQDS_STATE=39, EQDS_RECORD=40,
                      EQDS_SINK = 41, EQDS_MEMORY = 42, EQDS_TRAFFIC = 43,
-                     FLOW_EVENT = 44 };
+                     FLOW_EVENT = 44, QUEUE_AGGREGATE = 45 };
     static string event_to_str(RawLogEvent& event);
     Logger() {};
     virtual ~Logger(){};
@@ -96,6 +96,7 @@ class QueueLogger : public Logger  {
     enum QueueEvent { PKT_ENQUEUE=0, PKT_DROP=1, PKT_SERVICE=2, PKT_TRIM=3, PKT_BOUNCE=4, PKT_UNQUEUE=5, PKT_ARRIVE=6 };
     enum QueueRecord { CUM_TRAFFIC=0 };
     enum QueueApprox { QUEUE_RANGE=0, QUEUE_OVERFLOW=1 };
+    enum QueueAggregate { AGG_DEPTH=0, AGG_UTIL=1, AGG_TAIL=2 };
     virtual void logQueue(BaseQueue& queue, QueueEvent ev, Packet& pkt) = 0;
     virtual ~QueueLogger(){};
 };
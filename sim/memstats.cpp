@@ -0,0 +1,79 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#include <stdio.h>
+#include <unistd.h>
+#include <iomanip>
+#include <algorithm>
+#include "memstats.h"
+#include "eventlist.h"
+
+const char* MemoryStats::_names[NUM_SUBSYSTEMS] = {"packets", "routes", "eventlist", "eqds_src", "ndp_src"};
+int64_t MemoryStats::_bytes[NUM_SUBSYSTEMS];
+int64_t MemoryStats::_count[NUM_SUBSYSTEMS];
+vector<MemoryReporter*> MemoryStats::_reporters[NUM_SUBSYSTEMS];
+
+void MemoryStats::addReporter(Subsystem s, MemoryReporter* reporter) {
+    _reporters[s].push_back(reporter);
+}
+
+void MemoryStats::removeReporter(Subsystem s, MemoryReporter* reporter) {
+    vector<MemoryReporter*>& r = _reporters[s];
+    vector<MemoryReporter*>::iterator i = find(r.begin(), r.end(), reporter);
+    if (i != r.end())
+        r.erase(i);
+}
+
+int64_t MemoryStats::rss() {
+    // second field of statm is resident pages
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f == NULL)
+        return 0;
+    long size, resident;
+    int n = fscanf(f, "%ld %ld", &size, &resident);
+    fclose(f);
+    if (n != 2)
+        return 0;
+    return (int64_t)resident * sysconf(_SC_PAGESIZE);
+}
+
+int64_t MemoryStats::peakRss() {
+    FILE* f = fopen("/proc/self/status", "r");
+    if (f == NULL)
+        return 0;
+    char line[256];
+    long kb = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "VmHWM: %ld kB", &kb) == 1)
+            break;
+    }
+    fclose(f);
+    return (int64_t)kb * 1024;
+}
+
+void MemoryStats::usage(int64_t bytes[NUM_SUBSYSTEMS], int64_t count[NUM_SUBSYSTEMS]) {
+    for (int s = 0; s < NUM_SUBSYSTEMS; s++) {
+        bytes[s] = _bytes[s];
+        count[s] = _count[s];
+        for (size_t i = 0; i < _reporters[s].size(); i++) {
+            _reporters[s][i]->memoryUsage(bytes[s], count[s]);
+        }
+    }
+    // the event list is static, so it doesn't need to register
+    EventList::memoryUsage(bytes[EVENTLIST], count[EVENTLIST]);
+}
+
+void MemoryStats::report(ostream& out) {
+    int64_t bytes[NUM_SUBSYSTEMS];
+    int64_t count[NUM_SUBSYSTEMS];
+    usage(bytes, count);
+
+    int64_t total = 0;
+    for (int s = 0; s < NUM_SUBSYSTEMS; s++)
+        total += bytes[s];
+    out << "# memory at " << timeAsMs(EventList::now()) << "ms: accounted "
+        << total/(1024*1024) << "MB rss " << rss()/(1024*1024) << "MB" << endl;
+    for (int s = 0; s < NUM_SUBSYSTEMS; s++) {
+        out << "#   " << setw(10) << left << _names[s] << right
+            << " count " << setw(10) << count[s]
+            << " KB " << setw(10) << bytes[s]/1024 << endl;
+    }
+}
@@ -0,0 +1,77 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+/*
+ * Per-subsystem memory accounting, so we can tell where the memory
+ * goes on large runs.
+ *
+ * There are two ways for a subsystem to report.  Things that are
+ * allocated in large numbers on the hot path (packets, routes) bump a
+ * per-subsystem counter when they are created and destroyed, which
+ * costs a couple of additions.  Long-lived objects whose containers
+ * grow and shrink (transport state) implement MemoryReporter and are
+ * only asked how much they are using when a report is printed.
+ *
+ * Container sizes are estimates from element counts and capacities,
+ * not exact heap usage, but they are good enough to tell which
+ * subsystem is to blame.
+ */
+
+#include <vector>
+#include <iostream>
+#include "config.h"
+
+class MemoryReporter {
+public:
+    virtual ~MemoryReporter() {}
+    // add this object's current usage to bytes and count
+    virtual void memoryUsage(int64_t& bytes, int64_t& count) = 0;
+};
+
+class MemoryStats {
+public:
+    enum Subsystem { PACKETS = 0, ROUTES = 1, EVENTLIST = 2, EQDS_SRC = 3, NDP_SRC = 4,
+                     NUM_SUBSYSTEMS = 5 };
+
+    static inline void account(Subsystem s, int64_t bytes, int64_t count) {
+        _bytes[s] += bytes;
+        _count[s] += count;
+    }
+    static void addReporter(Subsystem s, MemoryReporter* reporter);
+    static void removeReporter(Subsystem s, MemoryReporter* reporter);
+
+    // one line per subsystem, plus the process RSS for comparison
+    static void report(ostream& out);
+    // current bytes and count for each subsystem, as report() prints them
+    static void usage(int64_t bytes[NUM_SUBSYSTEMS], int64_t count[NUM_SUBSYSTEMS]);
+    static const char* name(Subsystem s) {return _names[s];}
+    // resident set size in bytes, or 0 if we can't tell on this platform
+    static int64_t rss();
+    // peak resident set size of this process image in bytes, or 0 if we
+    // can't tell.  Unlike getrusage()'s ru_maxrss this is not inherited
+    // across exec, so it doesn't include whatever forked us.
+    static int64_t peakRss();
+
+    // estimates of container heap usage
+    template <class M>
+    static int64_t mapBytes(const M& m) {
+        // red-black tree node: colour, parent, left, right, then the value
+        return m.size() * (sizeof(typename M::value_type) + 4 * sizeof(void*));
+    }
+    template <class V>
+    static int64_t vectorBytes(const V& v) {
+        return v.capacity() * sizeof(typename V::value_type);
+    }
+    template <class L>
+    static int64_t listBytes(const L& l) {
+        return l.size() * (sizeof(typename L::value_type) + 2 * sizeof(void*));
+    }
+private:
+    static const char* _names[NUM_SUBSYSTEMS];
+    static int64_t _bytes[NUM_SUBSYSTEMS];
+    static int64_t _count[NUM_SUBSYSTEMS];
+    static vector<MemoryReporter*> _reporters[NUM_SUBSYSTEMS];
+};
+
+#endif
@@ -0,0 +1,208 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sstream>
+#include <iomanip>
+#include "metrics.h"
+#include "memstats.h"
+#include "queue.h"
+#include "switch.h"
+#include "pipe.h"
+
+using namespace std::chrono;
+
+MetricsServer::MetricsServer(EventList& eventlist, simtime_picosec period, const string& address)
+    : EventSource(eventlist, "metrics"), _period(period), _address(address), _listen_fd(-1),
+      _last_events(0)
+{
+    bool tcp = !address.empty() && address.find_first_not_of("0123456789") == string::npos;
+    if (tcp) {
+        _listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(_listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(atoi(address.c_str()));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (_listen_fd < 0 || ::bind(_listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            cerr << "Metrics: can't bind to 127.0.0.1:" << address << ": " << strerror(errno) << endl;
+            exit(1);
+        }
+    } else {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (address.empty() || address.size() >= sizeof(addr.sun_path)) {
+            cerr << "Metrics: bad socket path \"" << address << "\"" << endl;
+            exit(1);
+        }
+        strcpy(addr.sun_path, address.c_str());
+        // a socket left behind by an earlier run
+        unlink(address.c_str());
+        _listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (_listen_fd < 0 || ::bind(_listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            cerr << "Metrics: can't bind to " << address << ": " << strerror(errno) << endl;
+            exit(1);
+        }
+        _unix_path = address;
+    }
+    if (listen(_listen_fd, 8) < 0) {
+        cerr << "Metrics: can't listen on " << address << ": " << strerror(errno) << endl;
+        exit(1);
+    }
+
+    if (pipe(_wake_fd) < 0) {
+        cerr << "Metrics: can't create pipe: " << strerror(errno) << endl;
+        exit(1);
+    }
+
+    _start = _last_sample = steady_clock::now();
+    sample();
+    _thread = std::thread(&MetricsServer::serve, this);
+
+    setPeriodic(period);
+    eventlist.sourceIsPendingRel(*this, period);
+}
+
+MetricsServer::~MetricsServer() {
+    char c = 0;
+    if (write(_wake_fd[1], &c, 1) == 1)
+        _thread.join();
+    else
+        _thread.detach();
+    close(_wake_fd[0]);
+    close(_wake_fd[1]);
+    close(_listen_fd);
+    if (!_unix_path.empty())
+        unlink(_unix_path.c_str());
+}
+
+void MetricsServer::addGauge(const string& name, const string& help, Gauge gauge) {
+    NamedGauge g = {name, help, gauge};
+    _gauges.push_back(g);
+}
+
+void MetricsServer::addSwitch(Switch& sw) {
+    for (uint32_t i = 0; i < sw.portCount(); i++)
+        addQueue(sw.getPort(i));
+}
+
+void MetricsServer::doNextEvent() {
+    eventlist().sourceIsPendingRel(*this, _period);
+    if (steady_clock::now() - _last_sample >= milliseconds(MIN_WALL_INTERVAL_MS))
+        sample();
+}
+
+template <class T>
+static void metric(ostream& out, const char* name, const char* help, const char* type, T value) {
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " " << type << "\n"
+        << name << " " << value << "\n";
+}
+
+// Runs on the simulation thread.
+void MetricsServer::sample() {
+    steady_clock::time_point now = steady_clock::now();
+    double wall = duration<double>(now - _start).count();
+    double interval = duration<double>(now - _last_sample).count();
+    double simulated = timeAsSec(EventList::now());
+    uint64_t events = EventList::eventsRun();
+
+    ostringstream out;
+    out << setprecision(12);
+    metric(out, "htsim_simulated_seconds", "Simulated time so far.", "gauge", simulated);
+    metric(out, "htsim_wall_seconds", "Wall clock time since the metrics server started.", "gauge", wall);
+    metric(out, "htsim_sim_wall_ratio", "Simulated seconds per wall clock second.", "gauge",
+           wall > 0 ? simulated / wall : 0);
+    metric(out, "htsim_events_total", "Events run.", "counter", events);
+    metric(out, "htsim_events_per_second", "Events run per wall clock second since the last snapshot.", "gauge",
+           interval > 0 ? (events - _last_events) / interval : 0);
+    metric(out, "htsim_packet_hops_total", "Packets carried by pipes.", "counter", Pipe::_packets_carried);
+
+    int64_t bytes[MemoryStats::NUM_SUBSYSTEMS];
+    int64_t count[MemoryStats::NUM_SUBSYSTEMS];
+    MemoryStats::usage(bytes, count);
+    out << "# HELP htsim_memory_bytes Estimated memory use by subsystem.\n"
+        << "# TYPE htsim_memory_bytes gauge\n";
+    for (int s = 0; s < MemoryStats::NUM_SUBSYSTEMS; s++)
+        out << "htsim_memory_bytes{subsystem=\"" << MemoryStats::name((MemoryStats::Subsystem)s) << "\"} "
+            << bytes[s] << "\n";
+    out << "# HELP htsim_memory_objects Objects allocated by subsystem.\n"
+        << "# TYPE htsim_memory_objects gauge\n";
+    for (int s = 0; s < MemoryStats::NUM_SUBSYSTEMS; s++)
+        out << "htsim_memory_objects{subsystem=\"" << MemoryStats::name((MemoryStats::Subsystem)s) << "\"} "
+            << count[s] << "\n";
+    metric(out, "htsim_rss_bytes", "Resident set size of the process.", "gauge", MemoryStats::rss());
+
+    if (!_queues.empty()) {
+        mem_b queued = 0, max_queued = 0;
+        uint32_t nonempty = 0;
+        for (size_t i = 0; i < _queues.size(); i++) {
+            mem_b q = _queues[i]->queuesize();
+            queued += q;
+            max_queued = max(max_queued, q);
+            if (q > 0)
+                nonempty++;
+        }
+        metric(out, "htsim_queues", "Queues watched.", "gauge", _queues.size());
+        metric(out, "htsim_queues_nonempty", "Watched queues holding packets.", "gauge", nonempty);
+        metric(out, "htsim_queued_bytes", "Bytes held in all watched queues.", "gauge", queued);
+        metric(out, "htsim_queue_max_bytes", "Bytes held in the fullest watched queue.", "gauge", max_queued);
+    }
+
+    for (size_t i = 0; i < _gauges.size(); i++)
+        metric(out, _gauges[i].name.c_str(), _gauges[i].help.c_str(), "gauge", _gauges[i].gauge());
+
+    _last_sample = now;
+    _last_events = events;
+
+    std::lock_guard<std::mutex> guard(_lock);
+    _snapshot = out.str();
+}
+
+// Runs on the server thread, until the destructor writes to _wake_fd.
+void MetricsServer::serve() {
+    while (true) {
+        struct pollfd p[2] = {{_listen_fd, POLLIN, 0}, {_wake_fd[0], POLLIN, 0}};
+        if (poll(p, 2, -1) <= 0)
+            continue;
+        if (p[1].revents)
+            return;
+        int fd = accept(_listen_fd, NULL, NULL);
+        if (fd < 0)
+            continue;
+        reply(fd);
+        close(fd);
+    }
+}
+
+void MetricsServer::reply(int fd) {
+    // Plain clients (socat, nc) send nothing and get the text as is;
+    // HTTP clients (curl, Prometheus) get it wrapped in a response.
+    char request[1024];
+    ssize_t n = 0;
+    struct pollfd p = {fd, POLLIN, 0};
+    if (poll(&p, 1, 100) > 0)
+        n = recv(fd, request, sizeof(request), MSG_DONTWAIT);
+    string text;
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        text = _snapshot;
+    }
+    if (n >= 4 && !strncmp(request, "GET ", 4))
+        text = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n\r\n" + text;
+    size_t sent = 0;
+    while (sent < text.size()) {
+        ssize_t w = send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+        if (w <= 0)
+            return;
+        sent += w;
+    }
+}
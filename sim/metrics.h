@@ -0,0 +1,82 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef METRICS_H
+#define METRICS_H
+
+/*
+ * A live view of a long-running simulation, served in the Prometheus
+ * text format on a Unix-domain socket or a TCP port on 127.0.0.1:
+ *
+ *    socat - UNIX-CONNECT:/tmp/htsim.sock
+ *    curl http://127.0.0.1:9100/metrics
+ *
+ * The simulation thread takes a snapshot every period of simulated
+ * time (at most every MIN_WALL_INTERVAL_MS of wall time), and a
+ * separate thread answers connections with the latest snapshot.  The
+ * hot path is never touched: counters are only read when a snapshot is
+ * taken, and the server thread never looks at simulator state.
+ *
+ * Besides the built-in progress, event, memory and queue metrics,
+ * callers can add gauges of their own, e.g. the number of live flows.
+ * Gauges are evaluated on the simulation thread when a snapshot is
+ * taken, so they may look at anything.
+ */
+
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <string>
+#include "config.h"
+#include "eventlist.h"
+
+class BaseQueue;
+class Switch;
+
+class MetricsServer : public EventSource {
+public:
+    typedef std::function<double()> Gauge;
+    const static int MIN_WALL_INTERVAL_MS = 100;
+
+    // address is a port number, for a TCP socket on 127.0.0.1, or
+    // else the path of a Unix-domain socket to create.  Exits if the
+    // socket can't be set up.
+    MetricsServer(EventList& eventlist, simtime_picosec period, const string& address);
+    ~MetricsServer();
+
+    void addGauge(const string& name, const string& help, Gauge gauge);
+    // queues whose backlog is summed into htsim_queued_bytes etc.
+    void addQueue(BaseQueue* queue) {_queues.push_back(queue);}
+    void addSwitch(Switch& sw); // all of the switch's ports
+
+    void doNextEvent();
+private:
+    void sample();
+    void serve();
+    void reply(int fd);
+
+    struct NamedGauge {
+        string name;
+        string help;
+        Gauge gauge;
+    };
+
+    simtime_picosec _period;
+    string _address;
+    string _unix_path; // empty for TCP
+    int _listen_fd;
+    int _wake_fd[2]; // a pipe, written to tell the server thread to stop
+    vector<NamedGauge> _gauges;
+    vector<BaseQueue*> _queues;
+
+    std::chrono::steady_clock::time_point _start;
+    std::chrono::steady_clock::time_point _last_sample;
+    uint64_t _last_events;
+
+    // shared with the server thread
+    std::mutex _lock;
+    string _snapshot;
+    std::thread _thread;
+};
+
+#endif
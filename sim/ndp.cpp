@@ -6,6 +6,7 @@
 #include "queue.h"
 #include <stdio.h>
 #include "switch.h"
+#include "pipe.h"
 using namespace std;
 
 ////////////////////////////////////////////////////////////////
@@ -58,6 +59,7 @@ NdpSrc::NdpSrc(NdpLogger* logger, TrafficLogger* pktlogger, EventList &eventlist
     : EventSource(eventlist,"ndp"), _logger(logger), _flow(pktlogger)
 {
     _mss = Packet::data_packet_size();
+    MemoryStats::addReporter(MemoryStats::NDP_SRC, this);
 
     _rts = rts;
     _rts_pacer = rts_pacer;
@@ -93,6 +95,7 @@ NdpSrc::NdpSrc(NdpLogger* logger, TrafficLogger* pktlogger, EventList &eventlist
   
     _crt_path = 0; // used for SCATTER_PERMUTE route strategy
     _same_path_burst = 1;
+    _shared_paths = false;
 
     _feedback_count = 0;
     for(int i = 0; i < HIST_LEN; i++) {
@@ -106,11 +109,17 @@ NdpSrc::NdpSrc(NdpLogger* logger, TrafficLogger* pktlogger, EventList &eventlist
 
     // by default, end silently
     _end_trigger = 0;
+    _flow_logger = 0;
+    _finished = false;
 
     // debugging hack
     _log_me = false;
 }
 
+NdpSrc::~NdpSrc() {
+    MemoryStats::removeReporter(MemoryStats::NDP_SRC, this);
+}
+
 void NdpSrc::set_traffic_logger(TrafficLogger* pktlogger) {
     _flow.set_logger(pktlogger);
 }
@@ -129,15 +138,29 @@ void NdpSrc::set_end_trigger(Trigger& end_trigger) {
     _end_trigger = &end_trigger;
 }
 
+void NdpSrc::memoryUsage(int64_t& bytes, int64_t& count) {
+    bytes += sizeof(NdpSrc);
+    bytes += MemoryStats::mapBytes(_sent_times);
+    bytes += MemoryStats::mapBytes(_first_sent_times);
+    bytes += MemoryStats::vectorBytes(_path_ids);
+    bytes += MemoryStats::vectorBytes(_down_path_ids);
+    bytes += MemoryStats::vectorBytes(_paths);
+    bytes += _scores.bytes();
+    count++;
+}
+
+void NdpPathScores::reset(uint32_t no_of_paths) {
+    delete[] _scores;
+    _size = no_of_paths;
+    _scores = new int16_t[words(no_of_paths)]();
+}
+
 void NdpSrc::permute_paths() {
-    int len = _paths.size();
+    // only the path IDs are permuted; path(i) looks up the route
+    int len = _path_ids.size();
     for (int i = 0; i < len; i++) {
         int ix = random() % (len - i);
-        const Route* tmppath = _paths[ix];
-        _paths[ix] = _paths[len-1-i];
-        _paths[len-1-i] = tmppath;
-
-        int tmpid = _path_ids[ix];
+        uint16_t tmpid = _path_ids[ix];
         _path_ids[ix] = _path_ids[len-1-i];
         _path_ids[len-1-i] = tmpid;
     }
@@ -152,14 +175,15 @@ void randomize_sequence(vector<int>& seq) {
 }
 
 // generate a new randomized permutation of the integers from 0 to len
-void permute_sequence(vector<int>& seq) {
+template<class T>
+void permute_sequence(vector<T>& seq) {
     size_t len = seq.size();
     for (uint32_t i = 0; i < len; i++) {
         seq[i] = i;
     }
     for (uint32_t i = 0; i < len; i++) {
         int ix = random() % (len - i);
-        int tmpval = seq[ix];
+        T tmpval = seq[ix];
         seq[ix] = seq[len-1-i];
         seq[len-1-i] = tmpval;
     }
@@ -175,26 +199,7 @@ void NdpSrc::set_paths(uint32_t no_of_paths){
 
     _path_ids.resize(no_of_paths);
     permute_sequence(_path_ids);
-
-    _paths.resize(no_of_paths);
-    _original_paths.resize(no_of_paths);
-    _path_acks.resize(no_of_paths);
-    _path_ecns.resize(no_of_paths);
-    _path_nacks.resize(no_of_paths);
-    _bad_path.resize(no_of_paths);
-    _avoid_ratio.resize(no_of_paths);
-    _avoid_score.resize(no_of_paths);
-
-    for (size_t i=0; i < no_of_paths; i++){
-        _paths[i] = NULL;
-        _original_paths[i] = NULL;
-        _path_acks[i] = 0;
-        _path_ecns[i] = 0;
-        _path_nacks[i] = 0;
-        _avoid_ratio[i] = 0;
-        _avoid_score[i] = 0;
-        _bad_path[i] = false;
-    }
+    _scores.reset(no_of_paths);
 }
 
 
@@ -215,13 +220,7 @@ void NdpSrc::set_paths(vector<const Route*>* rt_list){
         no_of_paths = min(_path_entropy_size, no_of_paths);
         _path_ids.resize(no_of_paths);
         _paths.resize(no_of_paths);
-        _original_paths.resize(no_of_paths);
-        _path_acks.resize(no_of_paths);
-        _path_ecns.resize(no_of_paths);
-        _path_nacks.resize(no_of_paths);
-        _bad_path.resize(no_of_paths);
-        _avoid_ratio.resize(no_of_paths);
-        _avoid_score.resize(no_of_paths);
+        _scores.reset(no_of_paths);
 #ifdef DEBUG_PATH_STATS        
         _path_counts_new.resize(no_of_paths);
         _path_counts_rtx.resize(no_of_paths);
@@ -238,28 +237,29 @@ void NdpSrc::set_paths(vector<const Route*>* rt_list){
             permute_sequence(randseq);
         }
 
+        // Routes without a reverse can't be used for return-to-sender,
+        // so we can use them as they are, shared with every other
+        // flow between the same hosts, and have our packets carry
+        // the sink as the final hop.
+        _shared_paths = rt_list->at(0)->reverse() == NULL;
         for (size_t i=0; i < no_of_paths; i++){
-            // we need to copy the route before adding endpoints, as
-            // it may be used in the reverse direction too.
             // Pick a random route from the available ones
-            Route* tmp = new Route(*(rt_list->at(randseq[i])), *_sink);
-            //Route* tmp = new Route(*(rt_list->at(i)));
-            tmp->add_endpoints(this, _sink);
-            tmp->set_path_id(i, rt_list->size());
-            _paths[i] = tmp;
+            const Route* rt = rt_list->at(randseq[i]);
+            if (!_shared_paths) {
+                // we need to copy the route before adding endpoints, as
+                // it may be used in the reverse direction too.
+                Route* tmp = new Route(*rt, *_sink);
+                tmp->add_endpoints(this, _sink);
+                tmp->set_path_id(i, rt_list->size());
+                rt = tmp;
+            }
+            _paths[i] = rt;
             _path_ids[i] = i;
-            _original_paths[i] = tmp;
 #ifdef DEBUG_PATH_STATS        
             _path_counts_new[i] = 0;
             _path_counts_rtx[i] = 0;
             _path_counts_rto[i] = 0;
 #endif            
-            _path_acks[i] = 0;
-            _path_ecns[i] = 0;
-            _path_nacks[i] = 0;
-            _avoid_ratio[i] = 0;
-            _avoid_score[i] = 0;
-            _bad_path[i] = false;
         }
         _crt_path = 0;
         permute_paths();
@@ -267,8 +267,68 @@ void NdpSrc::set_paths(vector<const Route*>* rt_list){
     }
 }
 
+static bool crosses(const Route* route, const PacketSink* link) {
+    for (size_t i = 0; i < route->size(); i++) {
+        if (route->at(i) == link)
+            return true;
+    }
+    return false;
+}
+
+static bool crosses_failed_link(const Route* route) {
+    for (size_t i = 0; i < route->size(); i++) {
+        const Pipe* pipe = dynamic_cast<const Pipe*>(route->at(i));
+        if (pipe && pipe->failed())
+            return true;
+    }
+    return false;
+}
+
+// Moves the IDs of the paths that cross link between ids, the paths in
+// use, and down.  A path comes back once no link on it has failed.  At
+// least one path stays in use, even if it crosses a failed link.
+// Returns whether anything moved.
+static bool update_path_ids(const vector<const Route*>& paths, vector<uint16_t>& ids,
+                            vector<uint16_t>& down, const PacketSink* link, bool failed) {
+    bool changed = false;
+    if (failed) {
+        for (size_t i = 0; i < ids.size() && ids.size() > 1;) {
+            if (crosses(paths[ids[i]], link)) {
+                down.push_back(ids[i]);
+                ids.erase(ids.begin() + i);
+                changed = true;
+            } else {
+                i++;
+            }
+        }
+    } else {
+        for (size_t i = 0; i < down.size();) {
+            const Route* route = paths[down[i]];
+            if (crosses(route, link) && !crosses_failed_link(route)) {
+                ids.push_back(down[i]);
+                down.erase(down.begin() + i);
+                changed = true;
+            } else {
+                i++;
+            }
+        }
+    }
+    return changed;
+}
+
+void NdpSrc::link_state_changed(const PacketSink* link, bool failed) {
+    // nothing to do with ECMP_FIB and SINGLE_PATH, which don't pick paths
+    if (_paths.empty())
+        return;
+    if (update_path_ids(_paths, _path_ids, _down_path_ids, link, failed))
+        _crt_path = 0;
+}
+
 void NdpSrc::startflow(){
     cout << "startflow " <<  _flow._name <<  " CWND " << _cwnd << " rts " << _rts << " at " << timeAsUs(eventlist().now()) << endl;
+    if (_flow_logger) {
+        _flow_logger->logEvent(_flow, *this, FlowEventLogger::START, _flow_size, 0);
+    }
     _highest_sent = 0;
     _last_acked = 0;
     
@@ -305,8 +365,10 @@ void NdpSrc::startflow(){
                 p->set_route(*_route);
                 p->set_pathid(0);
             } else {
-                const Route *rt = _paths.at(choose_route());
-                p->set_route(*rt);        
+                int crt = choose_route();
+                p->set_route(*path(crt));
+                if (_shared_paths)
+                    p->set_next_hop(_sink);
 #ifdef DEBUG_PATH_STATS        
                 _path_counts_rtx[p->path_id()]++;
 #endif
@@ -352,7 +414,7 @@ void NdpSrc::connect(Route* routeout, Route* routeback, NdpSink& sink, simtime_p
 #define ABS(X) ((X)>0?(X):-(X))
 
 void NdpSrc::count_ecn(int32_t path_id) {
-    _path_ecns[path_id]++;
+    _scores.ecns(path_id)++;
 }
 
 void NdpSrc::count_feedback(int32_t path_id, FeedbackType fb) {
@@ -361,19 +423,19 @@ void NdpSrc::count_feedback(int32_t path_id, FeedbackType fb) {
 
     /*ECMP_FIB setup needed*/
 
-    int32_t sz = _paths.size();
+    int32_t sz = _path_ids.size();
     // keep feedback history in a circular buffer
     _feedback_history[_feedback_count] = fb;
     _feedback_count = (_feedback_count + 1) % HIST_LEN;
     switch (fb) {
     case ACK:
-        _path_acks[path_id]++;
+        _scores.acks(path_id)++;
         break;
     case NACK:
-        _path_nacks[path_id]++;
+        _scores.nacks(path_id)++;
         break;
     case BOUNCE:
-        _path_nacks[path_id]+=3;  //a bounce is kind of a more severe Nack for this purpose
+        _scores.nacks(path_id)+=3;  //a bounce is kind of a more severe Nack for this purpose
         break;
     case UNKNOWN:
     case ECN:
@@ -383,15 +445,15 @@ void NdpSrc::count_feedback(int32_t path_id, FeedbackType fb) {
     int path_acks_total = 0;
     int path_nacks_total = 0;
     for (int i = 0; i < sz; i++) {
-        path_acks_total += _path_acks[i];
-        path_nacks_total += _path_nacks[i];
+        path_acks_total += _scores.acks(i);
+        path_nacks_total += _scores.nacks(i);
     }
     int path_acks_mean = path_acks_total / sz;
     int path_nacks_mean = path_nacks_total / sz;
 
     int nack_ratio = 0; 
-    if (_path_acks[path_id] > 10)
-        nack_ratio = (_path_nacks[path_id]*100)/_path_acks[path_id];
+    if (_scores.acks(path_id) > 10)
+        nack_ratio = (_scores.nacks(path_id)*100)/_scores.acks(path_id);
     int mean_nack_ratio = 100;
     if (path_acks_mean > 0) 
         mean_nack_ratio = (path_nacks_mean*100)/path_acks_mean;
@@ -399,15 +461,15 @@ void NdpSrc::count_feedback(int32_t path_id, FeedbackType fb) {
     // 1.  nack count > 125% of the mean nack count
     // 2.  nack ratio > 30%
     // 3.  total acks+nacks > 100, so we don't react to noisy startup data
-    if ((_path_acks[path_id] + _path_nacks[path_id] > 100) &&
+    if ((_scores.acks(path_id) + _scores.nacks(path_id) > 100) &&
         (nack_ratio > mean_nack_ratio*1.25) &&
         (nack_ratio > 30)) {
-        _bad_path[path_id] = true;
-        _avoid_ratio[path_id]++;
+        _scores.set_bad(path_id, true);
+        _scores.avoid_ratio(path_id)++;
     } else {
-        if (_avoid_ratio[path_id] > 0)
-            _avoid_ratio[path_id]--;
-        _bad_path[path_id] = false;
+        if (_scores.avoid_ratio(path_id) > 0)
+            _scores.avoid_ratio(path_id)--;
+        _scores.set_bad(path_id, false);
     }
 }
 
@@ -462,7 +524,7 @@ void NdpSrc::processRTS(NdpPacket& pkt){
     //_rtx_queue.push_front(&pkt);
     _rtx_queue[pkt.seqno()] = &pkt;
 
-    count_bounce(pkt.route()->path_id());
+    count_bounce(pkt.path_id());
 
     /* When we get a return-to-sender packet, we could immediately
        resend it, but this leads to a larger-than-necessary second
@@ -531,27 +593,29 @@ void NdpSrc::processNack(const NdpNack& nack){
     switch (_route_strategy) {
     case SINGLE_PATH:
         p = NdpPacket::newpkt(_flow, *_route, seqno, 0, _mss, true,
-                              _paths.size()>0?_paths.size():1, last_packet,_dstaddr);
+                              path_count()>0?path_count():1, last_packet,_dstaddr);
         break;
     case ECMP_FIB:
     case ECMP_FIB_ECN:
         p = NdpPacket::newpkt(_flow, *_route, seqno, 0, _mss, true,
-                    _path_ids.size(), last_packet,_dstaddr);
+                    path_count(), last_packet,_dstaddr);
         p->set_pathid(_path_ids[choose_route()]);
         break;
     case SCATTER_PERMUTE:
     case SCATTER_RANDOM:
     case PULL_BASED:
     case SCATTER_ECMP: {
-        const Route *rt = _paths.at(choose_route());
-        p = NdpPacket::newpkt(_flow, *rt, seqno, 0, _mss, true,
-                    _paths.size()>0?_paths.size():1, last_packet,_dstaddr);
+        int crt = choose_route();
+        p = NdpPacket::newpkt(_flow, *path(crt), seqno, 0, _mss, true,
+                    path_count()>0?path_count():1, last_packet,_dstaddr,
+                    _shared_paths ? _sink : NULL);
+        p->set_pathid(_path_ids[crt]);
         break;
     }
     case REACTIVE_ECN: {
         // we got a NACK - assume path was bad and switch to next one
         p = NdpPacket::newpkt(_flow, *_route, seqno, 0, _mss, true,
-                    _path_ids.size(), last_packet,_dstaddr);
+                    path_count(), last_packet,_dstaddr);
         p->set_pathid(_path_ids[next_route()]);
         break;
     }        
@@ -662,6 +726,10 @@ void NdpSrc::processAck(const NdpAck& ack) {
         if (_end_trigger) {
             _end_trigger->activate();
         }
+        if (_flow_logger && !_finished) {
+            _flow_logger->logEvent(_flow, *this, FlowEventLogger::FINISH, _flow_size, _packets_sent);
+        }
+        _finished = true;
         return;
     }
 
@@ -753,49 +821,48 @@ int NdpSrc::choose_route() {
     {
         /* this case is basically SCATTER_PERMUTE, but avoiding bad paths. */
 
-        assert(_paths.size() > 0);
-        if (_paths.size() == 1) {
+        assert(_path_ids.size() > 0);
+        if (_path_ids.size() == 1) {
             // special case - no choice
             return 0;
         }
         // otherwise we've got a choice
         _crt_path++;
-        if (_crt_path == _paths.size()) {
+        if (_crt_path == _path_ids.size()) {
             permute_paths();
             _crt_path = 0;
         }
         uint32_t path_id = _path_ids[_crt_path];
-        _avoid_score[path_id] = _avoid_ratio[path_id];
+        int16_t avoid_score = _scores.avoid_ratio(path_id);
         int ctr = 0;
-        while (_avoid_score[path_id] > 0 /* && ctr < 2*/) {
-            printf("as[%d]: %d\n", path_id, _avoid_score[path_id]);
-            _avoid_score[path_id]--;
+        while (avoid_score > 0 /* && ctr < 2*/) {
+            printf("as[%d]: %d\n", path_id, avoid_score);
+            avoid_score--;
             ctr++;
             //re-choosing path
             cout << "re-choosing path " << path_id << endl;
             _crt_path++;
-            if (_crt_path == _paths.size()) {
+            if (_crt_path == _path_ids.size()) {
                 permute_paths();
                 _crt_path = 0;
             }
             path_id = _path_ids[_crt_path];
-            _avoid_score[path_id] = _avoid_ratio[path_id];
+            avoid_score = _scores.avoid_ratio(path_id);
         }
-        //cout << "AS: " << _avoid_score[path_id] << " AR: " << _avoid_ratio[path_id] << endl;
-        assert(_avoid_score[path_id] == 0);
+        //cout << "AS: " << avoid_score << " AR: " << _scores.avoid_ratio(path_id) << endl;
         break;
     }
     case SCATTER_RANDOM:
         //ECMP
-        assert(_paths.size() > 0);
-        _crt_path = random()%_paths.size();
+        assert(_path_ids.size() > 0);
+        _crt_path = random()%_path_ids.size();
         break;
     case SCATTER_PERMUTE:
     case SCATTER_ECMP:
         //Cycle through a permutation.  Generally gets better load balancing than SCATTER_RANDOM.
         _crt_path++;
-        assert(_paths.size() > 0);
-        if (_crt_path/_same_path_burst == _paths.size()) {
+        assert(_path_ids.size() > 0);
+        if (_crt_path/_same_path_burst == _path_ids.size()) {
             permute_paths();
             _crt_path = 0;
         }
@@ -803,7 +870,7 @@ int NdpSrc::choose_route() {
     case ECMP_FIB:
         //Cycle through a permutation.  Generally gets better load balancing than SCATTER_RANDOM.
         _crt_path++;
-        if (_crt_path == _paths.size()) {
+        if (_crt_path == _path_ids.size()) {
             permute_paths();
             _crt_path = 0;
         }
@@ -813,15 +880,15 @@ int NdpSrc::choose_route() {
         //Cycle through a permutation, but use ECN to skip paths
         while(1) {
             _crt_path++;
-            if (_crt_path == _paths.size()) {
+            if (_crt_path == _path_ids.size()) {
                 permute_paths();
                 _crt_path = 0;
             }
-            if (_path_ecns[_path_ids[_crt_path]] > 0) {
-                _path_ecns[_path_ids[_crt_path]]--;
+            if (_scores.ecns(_path_ids[_crt_path]) > 0) {
+                _scores.ecns(_path_ids[_crt_path])--;
                 /*
                 if (_log_me) {
-                    cout << eventlist().now() << " skipped " << _path_ids[_crt_path] << " " << _path_ecns[_path_ids[_crt_path]] << endl;
+                    cout << eventlist().now() << " skipped " << _path_ids[_crt_path] << " " << _scores.ecns(_path_ids[_crt_path]) << endl;
                 }
                 */
             } else {
@@ -847,8 +914,8 @@ int NdpSrc::next_route() {
     // Just move on to the next path blindly
     assert(_route_strategy == REACTIVE_ECN);
     _crt_path++;
-    assert(_paths.size() > 0);
-    if (_crt_path == _paths.size()) {
+    assert(_path_ids.size() > 0);
+    if (_crt_path == _path_ids.size()) {
         permute_paths();
         _crt_path = 0;
     }
@@ -904,8 +971,11 @@ int NdpSrc::send_packet(NdpPull::seq_t pacer_no) {
                 break;
             }
         default:
-            const Route *rt = _paths.at(choose_route());
-            p->set_route(*rt);
+            // the packet still carries the sink as its endpoint if
+            // the paths are shared
+            int crt = choose_route();
+            p->set_route(*path(crt));
+            p->set_pathid(_path_ids[crt]);
 #ifdef DEBUG_PATH_STATS
             _path_counts_rtx[p->path_id()]++;
 #endif
@@ -948,10 +1018,12 @@ int NdpSrc::send_packet(NdpPull::seq_t pacer_no) {
         case PULL_BASED:
         case SCATTER_ECMP:
         {
-            assert(_paths.size() > 0);
-            const Route *rt = _paths.at(choose_route());
-            p = NdpPacket::newpkt(_flow, *rt, _highest_sent+1, pacer_no, _mss, false,
-                                  _paths.size()>0?_paths.size():1, last_packet,_dstaddr);
+            assert(_path_ids.size() > 0);
+            int crt = choose_route();
+            p = NdpPacket::newpkt(_flow, *path(crt), _highest_sent+1, pacer_no, _mss, false,
+                                  path_count()>0?path_count():1, last_packet,_dstaddr,
+                                  _shared_paths ? _sink : NULL);
+            p->set_pathid(_path_ids[crt]);
             
 #ifdef DEBUG_PATH_STATS
             _path_counts_new[p->path_id()]++;
@@ -963,7 +1035,7 @@ int NdpSrc::send_packet(NdpPull::seq_t pacer_no) {
         case REACTIVE_ECN:
             {
                 p = NdpPacket::newpkt(_flow, *_route, _highest_sent+1, pacer_no,
-                                      _mss, false, _path_ids.size(),
+                                      _mss, false, path_count(),
                                       last_packet,_dstaddr);
                 int crt = choose_route();
                 p->set_pathid(_path_ids[crt]);
@@ -1087,15 +1159,16 @@ NdpSrc::retransmit_packet() {
         case PULL_BASED:
         case SCATTER_ECMP:
         {
-            assert(_paths.size() > 0);
-            const Route* rt = _paths.at(_crt_path);
-            p = NdpPacket::newpkt(_flow, *rt, seqno, 0, _mss, true,
-                                  _paths.size(), last_packet,_dstaddr);
+            assert(_path_ids.size() > 0);
+            p = NdpPacket::newpkt(_flow, *path(_crt_path), seqno, 0, _mss, true,
+                                  path_count(), last_packet,_dstaddr,
+                                  _shared_paths ? _sink : NULL);
+            p->set_pathid(_path_ids[_crt_path]);
             if (_route_strategy == SCATTER_RANDOM) {
-                _crt_path = random() % _paths.size();
+                _crt_path = random() % _path_ids.size();
             } else {
                 _crt_path++;
-                if (_crt_path==_paths.size()){ 
+                if (_crt_path==_path_ids.size()){ 
                     permute_paths();
                     _crt_path = 0;
                 }
@@ -1106,13 +1179,13 @@ NdpSrc::retransmit_packet() {
         case ECMP_FIB_ECN:
         case REACTIVE_ECN:
             p = NdpPacket::newpkt(_flow, *_route, seqno, 0, _mss, true,
-                                  _path_ids.size(), last_packet,_dstaddr);
+                                  path_count(), last_packet,_dstaddr);
                 p->set_pathid(_path_ids[choose_route()]);
             break;
 
         case SINGLE_PATH:
             p = NdpPacket::newpkt(_flow, *_route, seqno, 0, _mss, true,
-                                  _paths.size(), last_packet,_dstaddr);
+                                  path_count(), last_packet,_dstaddr);
             break;
         case NOT_SET:
             abort();
@@ -1194,7 +1267,7 @@ void NdpSrc::print_stats() {
 #ifdef DEBUG_PATH_STATS
     cout << _nodename << "\n";
     int total_new = 0, total_rtx = 0, total_rto = 0;
-    for (uint32_t i = 0; i < _paths.size(); i++) {
+    for (uint32_t i = 0; i < path_count(); i++) {
         cout << _path_counts_new[i] << "/" << _path_counts_rtx[i] << "/" << _path_counts_rto[i] << " ";
         total_new += _path_counts_new[i];
         total_rtx += _path_counts_rtx[i];
@@ -1227,6 +1300,7 @@ NdpSink::NdpSink(EventList& event, linkspeed_bps linkspeed, double pull_rate_mod
     _total_received = 0;
     _path_hist_index = -1;
     _path_hist_first = -1;
+    _shared_paths = false;
 
     _parked_cwnd = 0;
     _parked_increase = 0;
@@ -1264,6 +1338,7 @@ NdpSink::NdpSink(NdpPullPacer* pacer) : DataReceiver("ndp_sink"),_cumulative_ack
     _highest_seqno = 0;
     _path_hist_index = -1;
     _path_hist_first = -1;
+    _shared_paths = false;
 
     _parked_cwnd = 0;
     _parked_increase = 0;
@@ -1333,14 +1408,19 @@ void NdpSink::set_paths(vector<const Route*>* rt_list){
     case SCATTER_RANDOM:
     case PULL_BASED:
     case SCATTER_ECMP:
-        assert(_paths.size() == 0);
+        assert(_path_ids.size() == 0);
         _paths.resize(rt_list->size());
         _path_ids.resize(rt_list->size());
+        // as for NdpSrc, routes without a reverse are shared
+        _shared_paths = rt_list->at(0)->reverse() == NULL;
         for (unsigned int i=0;i<rt_list->size();i++){
-            Route* t = new Route(*(rt_list->at(i)), *_src);
-            //Route* t = new Route(*(rt_list->at(i)));
-            t->add_endpoints(this, _src);
-            _paths[i]=t;
+            if (_shared_paths) {
+                _paths[i] = rt_list->at(i);
+            } else {
+                Route* t = new Route(*(rt_list->at(i)), *_src);
+                t->add_endpoints(this, _src);
+                _paths[i]=t;
+            }
             _path_ids[i] = i;
         }
         _crt_path = 0;
@@ -1355,6 +1435,13 @@ void NdpSink::set_paths(vector<const Route*>* rt_list){
     }
 }
 
+void NdpSink::link_state_changed(const PacketSink* link, bool failed) {
+    if (_paths.empty())
+        return;
+    if (update_path_ids(_paths, _path_ids, _down_path_ids, link, failed))
+        _crt_path = 0;
+}
+
 void NdpSink::set_paths(uint32_t no_of_paths){
     switch (_route_strategy) {
     case SCATTER_PERMUTE:
@@ -1368,12 +1455,10 @@ void NdpSink::set_paths(uint32_t no_of_paths){
     case ECMP_FIB:
     case ECMP_FIB_ECN:
     case REACTIVE_ECN:
-        assert(_paths.size() == 0);
-        _paths.resize(no_of_paths);
+        assert(_path_ids.size() == 0);
         _path_ids.resize(no_of_paths);
         for (unsigned int i=0;i<no_of_paths;i++){
-            _paths[i]=NULL;
-                _path_ids[i] = i;
+            _path_ids[i] = i;
         }
         _crt_path = 0;
         permute_paths();
@@ -1426,8 +1511,11 @@ void NdpSink::receiver_increase(NdpPacket* p){
         
         if (_route)
             pull_pkt = NdpPull::newpkt(p->flow(),*_route,_cumulative_ack,++_pull_no,_srcaddr);
-        else 
-            pull_pkt = NdpPull::newpkt(p->flow(),*(_paths[random()%_paths.size()]),_cumulative_ack,++_pull_no,_srcaddr);
+        else {
+            pull_pkt = NdpPull::newpkt(p->flow(),*path(random()%_path_ids.size()),_cumulative_ack,++_pull_no,_srcaddr);
+            if (_shared_paths)
+                pull_pkt->set_next_hop(_src);
+        }
     
         _pacer->enqueue_pull(pull_pkt, this);
         _parked_increase = _pacer->pacer_no();
@@ -1613,18 +1701,20 @@ void NdpSink::process_request_to_send(NdpRTS* pkt){
             r = _route;
         } else {
             if (_route_strategy == SCATTER_RANDOM) {
-                _crt_path = random()%_paths.size();
+                _crt_path = random()%_path_ids.size();
             } else {
                 _crt_path++;
-                if (_crt_path == _paths.size()) {
+                if (_crt_path == _path_ids.size()) {
                     permute_paths();
                     _crt_path = 0;
                 }
             }
-            r = _paths.at(_crt_path);
+            r = path(_crt_path);
         }
         
         NdpPull* pull_pkt = NdpPull::newpkt(pkt,*r,_cumulative_ack,_pull_no,_srcaddr);
+        if (_shared_paths)
+            pull_pkt->set_next_hop(_src);
         _pacer->enqueue_pull(pull_pkt, this);
     }
 
@@ -1668,15 +1758,17 @@ void NdpSink::send_ack(simtime_picosec ts, NdpPacket::seq_t ackno,
     case SCATTER_RANDOM:
     case PULL_BASED:
     case SCATTER_ECMP:
-        assert(_paths.size() > 0);
-        ack = NdpAck::newpkt(_src->_flow, *(_paths.at(_crt_path)), 0, ackno, 
+        assert(_path_ids.size() > 0);
+        ack = NdpAck::newpkt(_src->_flow, *path(_crt_path), 0, ackno, 
                     _cumulative_ack, _pull_no, 
                     _path_history[_path_hist_index].path_id(), _srcaddr);
+        if (_shared_paths)
+            ack->set_next_hop(_src);
         if (_route_strategy == SCATTER_RANDOM) {
-            _crt_path = random()%_paths.size();
+            _crt_path = random()%_path_ids.size();
         } else {
             _crt_path++;
-            if (_crt_path == _paths.size()) {
+            if (_crt_path == _path_ids.size()) {
             permute_paths();
             _crt_path = 0;
             }
@@ -1693,7 +1785,7 @@ void NdpSink::send_ack(simtime_picosec ts, NdpPacket::seq_t ackno,
 
         ack->set_pathid(_path_ids[_crt_path]);
         _crt_path++;
-        if (_crt_path == _paths.size()) {
+        if (_crt_path == _path_ids.size()) {
             permute_paths();
             _crt_path = 0;
         }
@@ -1738,15 +1830,17 @@ void NdpSink::send_nack(simtime_picosec ts, NdpPacket::seq_t ackno, NdpPacket::s
     case SCATTER_RANDOM:
     case PULL_BASED:
     case SCATTER_ECMP:
-        assert(_paths.size() > 0);
-        nack = NdpNack::newpkt(_src->_flow, *(_paths.at(_crt_path)), 0, ackno, 
+        assert(_path_ids.size() > 0);
+        nack = NdpNack::newpkt(_src->_flow, *path(_crt_path), 0, ackno, 
                     _cumulative_ack, _pull_no,
                     _path_history[_path_hist_index].path_id(),_srcaddr);
+        if (_shared_paths)
+            nack->set_next_hop(_src);
         if (_route_strategy == SCATTER_RANDOM) {
-            _crt_path = random()%_paths.size();
+            _crt_path = random()%_path_ids.size();
         } else {
             _crt_path++;
-            if (_crt_path == _paths.size()) {
+            if (_crt_path == _path_ids.size()) {
                 permute_paths();
                 _crt_path = 0;
             }
@@ -1761,7 +1855,7 @@ void NdpSink::send_nack(simtime_picosec ts, NdpPacket::seq_t ackno, NdpPacket::s
 
         nack->set_pathid(_path_ids[_crt_path]);
         _crt_path++;
-        if (_crt_path == _paths.size()) {
+        if (_crt_path == _path_ids.size()) {
             permute_paths();
             _crt_path = 0;
         }
@@ -1790,14 +1884,10 @@ void NdpSink::send_nack(simtime_picosec ts, NdpPacket::seq_t ackno, NdpPacket::s
 
 
 void NdpSink::permute_paths() {
-    int len = _paths.size();
+    int len = _path_ids.size();
     for (int i = 0; i < len; i++) {
         int ix = random() % (len - i);
-        const Route* tmppath = _paths[ix];
-        _paths[ix] = _paths[len-1-i];
-        _paths[len-1-i] = tmppath;
-
-        int tmpid = _path_ids[ix];
+        uint16_t tmpid = _path_ids[ix];
         _path_ids[ix] = _path_ids[len-1-i];
         _path_ids[len-1-i] = tmpid;        
     }
@@ -2127,6 +2217,7 @@ NdpRtxTimerScanner::NdpRtxTimerScanner(simtime_picosec scanPeriod, EventList& ev
   : EventSource(eventlist,"RtxScanner"), 
     _scanPeriod(scanPeriod)
 {
+    setPeriodic(scanPeriod);
     eventlist.sourceIsPendingRel(*this, 0);
 }
 
@@ -2146,3 +2237,17 @@ NdpRtxTimerScanner::doNextEvent()
     }
     eventlist().sourceIsPendingRel(*this, _scanPeriod);
 }
+
+// only needed while one of our sources has a retransmit timer running
+bool
+NdpRtxTimerScanner::idle() const {
+#ifndef RESEND_ON_TIMEOUT
+    return true;  // the timer hooks do nothing
+#else
+    for (auto i = _tcps.begin(); i != _tcps.end(); i++) {
+        if ((*i)->_highest_sent != 0 && (*i)->_rtx_timeout != timeInf)
+            return false;
+    }
+    return true;
+#endif
+}
@@ -15,6 +15,7 @@
 #include "priopullqueue.h"
 #include "trigger.h"
 #include "eventlist.h"
+#include "memstats.h"
 
 #define timeInf 0
 #define NDP_PACKET_SCATTER
@@ -47,10 +48,48 @@ class ReceiptEvent {
     bool _is_header;
 };
 
-class NdpSrc : public PacketSink, public EventSource, public TriggerTarget {
+// Per-path feedback scores for the multipath route strategies.  A
+// flow's counters live in one allocation, one array per counter, with
+// the bad path flags packed as bits after them: count_feedback() sums
+// counters over every path, and a source with the default path entropy
+// has one entry for every path in the topology.
+class NdpPathScores {
+ public:
+    NdpPathScores() : _size(0), _scores(NULL) {}
+    ~NdpPathScores() {delete[] _scores;}
+
+    void reset(uint32_t no_of_paths);
+    uint32_t size() const {return _size;}
+    int64_t bytes() const {return _scores ? words(_size) * sizeof(int16_t) : 0;}
+
+    int16_t& acks(uint32_t path_id) {return _scores[path_id];}
+    int16_t& nacks(uint32_t path_id) {return _scores[_size + path_id];}
+    int16_t& ecns(uint32_t path_id) {return _scores[2 * _size + path_id];}
+    int16_t& avoid_ratio(uint32_t path_id) {return _scores[3 * _size + path_id];}
+
+    bool bad(uint32_t path_id) const {
+        return _scores[4 * _size + path_id / 16] & (1 << (path_id % 16));
+    }
+    void set_bad(uint32_t path_id, bool bad) {
+        int16_t& w = _scores[4 * _size + path_id / 16];
+        if (bad)
+            w |= 1 << (path_id % 16);
+        else
+            w &= ~(1 << (path_id % 16));
+    }
+ private:
+    NdpPathScores(const NdpPathScores&);
+    NdpPathScores& operator=(const NdpPathScores&);
+    static uint32_t words(uint32_t no_of_paths) {return 4 * no_of_paths + (no_of_paths + 15) / 16;}
+    uint32_t _size;
+    int16_t* _scores;
+};
+
+class NdpSrc : public PacketSink, public EventSource, public TriggerTarget, public MemoryReporter {
     friend class NdpSink;
  public:
     NdpSrc(NdpLogger* logger, TrafficLogger* pktlogger, EventList &eventlist, bool rts = false, NdpRTSPacer* pacer = NULL);
+    ~NdpSrc();
     virtual void connect(Route* routeout, Route* routeback, NdpSink& sink, simtime_picosec startTime);
 
     void set_dst(uint32_t dst) {_dstaddr = dst;}
@@ -75,6 +114,8 @@ class NdpSrc : public PacketSink, public EventSource, public TriggerTarget {
     }
 
     void set_end_trigger(Trigger& trigger);
+    void logFlowEvents(FlowEventLogger& flow_logger) {_flow_logger = &flow_logger;}
+    virtual void memoryUsage(int64_t& bytes, int64_t& count);
 
     virtual void doNextEvent();
     virtual void receivePacket(Packet& pkt);
@@ -93,6 +134,10 @@ class NdpSrc : public PacketSink, public EventSource, public TriggerTarget {
     //used by ECMP_FIB strategy
     void set_paths(uint32_t path_count);
 
+    // Take the paths that cross a failed link out of use, and put them
+    // back once it recovers (see FatTreeTopology::add_link_listener).
+    void link_state_changed(const PacketSink* link, bool failed);
+
 
     // should really be private, but loggers want to see:
     uint64_t _highest_sent;  //seqno is in bytes
@@ -115,23 +160,24 @@ class NdpSrc : public PacketSink, public EventSource, public TriggerTarget {
     uint16_t _crt_direction;
     uint16_t _same_path_burst; // how many packets in a row to use same ECMP value (default is 1)
     void set_path_burst(uint16_t path_burst) {_same_path_burst = path_burst;}
-    
-    vector<int> _path_ids;
+
+    // current permutation of path IDs.  With routes, a path ID is an
+    // index into _paths; with ECMP_FIB it is the ECMP hash value.
+    vector<uint16_t> _path_ids;
 
     uint32_t _dstaddr;
-    vector<const Route*> _paths;
-    vector<const Route*> _original_paths; //paths in original permutation order
+    vector<const Route*> _paths; //paths in original order, indexed by path ID
+    bool _shared_paths; // _paths are shared with other flows and stop short of the sink
 #ifdef DEBUG_PATH_STATS
     vector<int> _path_counts_new; // only used for debugging, can remove later.
     vector<int> _path_counts_rtx; // only used for debugging, can remove later.
     vector<int> _path_counts_rto; // only used for debugging, can remove later.
 #endif
-    vector <int16_t> _path_acks; //keeps path scores
-    vector <int16_t> _path_ecns; //keeps path scores
-    vector <int16_t> _path_nacks; //keeps path scores
-    vector <int16_t> _avoid_ratio; //keeps path scores
-    vector <int16_t> _avoid_score; //keeps path scores
-    vector <bool> _bad_path; //keeps path scores
+    vector<uint16_t> _down_path_ids; // paths out of use because they cross a failed link
+    NdpPathScores _scores;
+    inline const Route* path(int crt) const {return _paths[_path_ids[crt]];}
+    // the number of path IDs, whether in use or not
+    inline uint32_t path_count() const {return _path_ids.size() + _down_path_ids.size();}
 
     map<NdpPacket::seq_t, simtime_picosec> _sent_times;
     map<NdpPacket::seq_t, simtime_picosec> _first_sent_times;
@@ -187,7 +233,9 @@ class NdpSrc : public PacketSink, public EventSource, public TriggerTarget {
     // Housekeeping
     NdpLogger* _logger;
     TrafficLogger* _pktlogger;
+    FlowEventLogger* _flow_logger;
     Trigger* _end_trigger;
+    bool _finished; // so we only report completion once
 
     // Connectivity
     PacketFlow _flow;
@@ -266,6 +314,7 @@ class NdpSink : public PacketSink, public DataReceiver {
     //needed by all strategies except SINGLE and ECMP_FIB
     void set_paths(vector<const Route*>* rt);
     void set_paths(uint32_t no_of_paths);
+    void link_state_changed(const PacketSink* link, bool failed); // as for NdpSrc
 
 #ifdef RECORD_PATH_LENS
 #define MAX_PATH_LEN 20u
@@ -294,9 +343,11 @@ class NdpSink : public PacketSink, public DataReceiver {
     // and PULL_BASED route strategies
     uint16_t _crt_path; // index into paths
     uint16_t _crt_direction;
-    vector<int> _path_ids; // path IDs to be used for ECMP FIB. 
-    vector<const Route*> _paths; //paths in current permutation order
-    vector<const Route*> _original_paths; //paths in original permutation order
+    vector<uint16_t> _path_ids; // current permutation of path IDs, as for NdpSrc
+    vector<uint16_t> _down_path_ids;
+    vector<const Route*> _paths; //paths in original order, indexed by path ID
+    bool _shared_paths; // _paths are shared with other flows and stop short of the source
+    inline const Route* path(int crt) const {return _paths[_path_ids[crt]];}
     const Route* _route;
     Trigger* _end_trigger;
 
@@ -419,6 +470,7 @@ class NdpRtxTimerScanner : public EventSource {
  public:
     NdpRtxTimerScanner(simtime_picosec scanPeriod, EventList& eventlist);
     void doNextEvent();
+    bool idle() const;
     void registerNdp(NdpSrc &tcpsrc);
  private:
     simtime_picosec _scanPeriod;
@@ -50,7 +50,8 @@ public:
                                     seq_t seqno, seq_t pacerno, int size, 
                                     bool retransmitted, int32_t no_of_paths,
                                     bool last_packet,
-                                    uint32_t destination = UINT32_MAX) {
+                                    uint32_t destination = UINT32_MAX,
+                                    PacketSink* endpoint = NULL) {
         NdpPacket* p = _packetdb.allocPacket();
         p->set_route(flow,route,size+ACKSIZE,seqno+size-1); // The NDP sequence number is the first byte of the packet; I will ID the packet by its last byte.
         p->_type = NDP;
@@ -62,7 +63,9 @@ public:
         p->_retransmitted = retransmitted;
         p->_no_of_paths = no_of_paths;
         p->_last_packet = last_packet;
-        p->_path_len = route.size();
+        // a route shared between flows doesn't include the destination
+        p->set_next_hop(endpoint);
+        p->_path_len = endpoint ? route.size() + 1 : route.size();
         p->_trim_hop = UINT32_MAX;
         p->_trim_direction = NONE;
         p->set_dst(destination);
@@ -71,12 +74,12 @@ public:
   
     virtual inline void  strip_payload() {
         Packet::strip_payload(); _size = ACKSIZE;_trim_hop = _nexthop;
-        _trim_direction = _direction;
+        _trim_direction = (packet_direction)_direction;
     };
 
     virtual inline void set_route(const Route &route) {
         if (_trim_hop!=INT32_MAX)
-            _trim_hop -= route.size();
+            _trim_hop -= _next_routed_hop ? route.size() + 1 : route.size();
 
         Packet::set_route(route);
     }
@@ -292,6 +295,7 @@ public:
         NdpPull* p = _packetdb.allocPacket();
         assert(ack->route());
         p->set_route(ack->flow(), *(ack->route()), NdpPacket::ACKSIZE, ack->ackno());
+        p->set_next_hop(ack->next_routed_hop());
 
         assert(p->route());
         p->_type = NDPPULL;
@@ -310,6 +314,7 @@ public:
         NdpPull* p = _packetdb.allocPacket();
         assert(nack->route());
         p->set_route(nack->flow(), *(nack->route()), NdpPacket::ACKSIZE, nack->ackno());
+        p->set_next_hop(nack->next_routed_hop());
 
         assert(p->route());
 
@@ -403,4 +408,10 @@ protected:
     static PacketDB<NdpPull> _packetdb;
 };
 
+PACKET_SIZE_BUDGET(NdpPacket, 128);
+PACKET_SIZE_BUDGET(NdpAck, 128);
+PACKET_SIZE_BUDGET(NdpNack, 128);
+PACKET_SIZE_BUDGET(NdpRTS, 104);
+PACKET_SIZE_BUDGET(NdpPull, 120);
+
 #endif
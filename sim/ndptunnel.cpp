@@ -1200,6 +1200,7 @@ NdpTunnelRtxTimerScanner::NdpTunnelRtxTimerScanner(simtime_picosec scanPeriod, E
   : EventSource(eventlist,"RtxScanner"), 
     _scanPeriod(scanPeriod)
 {
+    setPeriodic(scanPeriod);
     eventlist.sourceIsPendingRel(*this, 0);
 }
 
@@ -1219,3 +1220,17 @@ NdpTunnelRtxTimerScanner::doNextEvent()
     }
     eventlist().sourceIsPendingRel(*this, _scanPeriod);
 }
+
+// only needed while one of our sources has a retransmit timer running
+bool
+NdpTunnelRtxTimerScanner::idle() const {
+#ifndef RESEND_ON_TIMEOUT
+    return true;  // the timer hooks do nothing
+#else
+    for (auto i = _tcps.begin(); i != _tcps.end(); i++) {
+        if ((*i)->_highest_sent != 0 && (*i)->_rtx_timeout != timeInf)
+            return false;
+    }
+    return true;
+#endif
+}
@@ -264,6 +264,7 @@ class NdpTunnelRtxTimerScanner : public EventSource {
  public:
     NdpTunnelRtxTimerScanner(simtime_picosec scanPeriod, EventList& eventlist);
     void doNextEvent();
+    bool idle() const;
     void registerNdp(NdpTunnelSrc &tcpsrc);
  private:
     simtime_picosec _scanPeriod;
@@ -118,4 +118,6 @@ protected:
     static PacketDB<NdpTunnelPacket> _packetdb;
 };
 
+PACKET_SIZE_BUDGET(NdpTunnelPacket, 128);
+
 #endif
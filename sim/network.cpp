@@ -36,6 +36,7 @@ Packet::set_route(PacketFlow& flow, const Route &route, int pkt_size,
     _route = &route;
     _is_header = 0;
     _flags = 0;
+    _next_routed_hop = 0;
 }
 
 void 
@@ -69,10 +70,14 @@ Packet::sendOn() {
             //assert(_route->size() == _route->reverse()->size());
             nextsink = _route->reverse()->at(_nexthop);
             _nexthop++;
-        } else {
-            assert(_nexthop<_route->size());
+        } else if (_nexthop < _route->size()) {
             nextsink = _route->at(_nexthop);
             _nexthop++;
+        } else {
+            // a shared route that doesn't include the destination
+            assert(_nexthop == _route->size() && _next_routed_hop);
+            nextsink = _next_routed_hop;
+            _nexthop++;
         }
     } else if (_next_routed_hop)
         nextsink = _next_routed_hop;
@@ -95,10 +100,13 @@ Packet::sendOn2(VirtualQueue* crtSink) {
             //assert(_route->size() == _route->reverse()->size());
             nextsink = _route->reverse()->at(_nexthop);
             _nexthop++;
-        } else {
-            assert(_nexthop<_route->size());
+        } else if (_nexthop < _route->size()) {
             nextsink = _route->at(_nexthop);
             _nexthop++;
+        } else {
+            assert(_nexthop == _route->size() && _next_routed_hop);
+            nextsink = _next_routed_hop;
+            _nexthop++;
         }
     } else if (_next_routed_hop)
         nextsink = _next_routed_hop;
@@ -7,6 +7,7 @@
 #include "config.h"
 #include "loggertypes.h"
 #include "route.h"
+#include "memstats.h"
 
 class Packet;
 class PacketFlow;
@@ -102,7 +103,7 @@ class Packet {
 
     uint16_t size() const {return _size;}
     void set_size(int i) {_size = i;}
-    packet_type type() const {return _type;};
+    packet_type type() const {return (packet_type)_type;};
     bool header_only() const {return _is_header;}
     bool bounced() const {return _bounced;}
     PacketFlow& flow() const {return *_flow;}
@@ -118,6 +119,7 @@ class Packet {
     const Route* reverse_route() const {return _route->reverse();}
 
     inline void set_next_hop(PacketSink* snk) { _next_routed_hop = snk;}
+    inline PacketSink* next_routed_hop() const {return _next_routed_hop;}
 
     virtual void strip_payload() { assert(!_is_header); _is_header = true;};
     virtual void bounce();
@@ -131,14 +133,14 @@ class Packet {
         if ((_direction == NONE) || (_direction == UP && d==DOWN)) 
             _direction = d; 
         else {
-            cout << "Current direction is " << _direction << " trying to change it to " << d << endl;
+            cout << "Current direction is " << (int)_direction << " trying to change it to " << d << endl;
             abort();
         }
     }
 
     virtual PktPriority priority() const = 0;
 
-    virtual packet_direction get_direction() {return _direction;}
+    virtual packet_direction get_direction() {return (packet_direction)_direction;}
 
     void inc_ref_count() { _refcount++;};
     void dec_ref_count() { _refcount--;};
@@ -166,39 +168,58 @@ class Packet {
                                   // measured in bytes
     static bool _packet_size_fixed; //prevent foot-shooting
     
-    packet_type _type;
-    
-    uint16_t _size,_oldsize;
-    
-    
-    bool _is_header;
-    bool _bounced; // packet has hit a full queue, and is being bounced back to the sender
-    uint32_t _flags; // used for ECN & friends
-
-    uint32_t _dst; //used for packets that do not have a route in switched networks.    
-    uint32_t _pathid;  //used for ECMP hashing.
-    packet_direction _direction; //used to avoid loop in FatTrees.   
+    // Fields are ordered by how often forwarding touches them, not by
+    // meaning.  Everything a Queue, Pipe or Switch reads or writes on
+    // every hop sits in the first 64 bytes (with the vtable pointer);
+    // fields only used on bounce, lossless ingress or for logging come
+    // after.  _type and _direction are stored in a byte each to make
+    // this fit; use type() and get_direction() to read them.
 
     // A packet can contain a route or a routegraph, but not both.
     // Eventually switch over entirely to RouteGraph?
     const Route* _route;
 
-    //PacketSink* _detour;
-    uint32_t _nexthop,_oldnexthop;
+    //used when using routing tables in switches, i.e. the packet has no route,
+    //and for the endpoint of routes that are shared by several flows and so
+    //stop short of the destination.
+    PacketSink* _next_routed_hop;
+
+    PacketFlow* _flow{nullptr};
+
+    uint32_t _nexthop;
+    uint32_t _flags; // used for ECN & friends
+    uint32_t _dst; //used for packets that do not have a route in switched networks.    
+    uint32_t _pathid;  //used for ECMP hashing.
+
+    uint16_t _size;
+    uint8_t _type; // a packet_type
+    uint8_t _direction; // a packet_direction, used to avoid loop in FatTrees.   
+    bool _is_header;
+    bool _bounced; // packet has hit a full queue, and is being bounced back to the sender
 
     //used for tunneling purposes when one packet can be referenced by multiple classes
     uint8_t _refcount;
 
-    //used when using routing tables in switches, i.e. the packet has no route.
-    PacketSink* _next_routed_hop;
+    uint16_t _oldsize;
+    uint32_t _path_len; // length of the path in hops - used in BCube priority routing with NDP
 
+    // end of the forwarding-hot part
     packetid_t _id;
-    PacketFlow* _flow{nullptr};
-    static PacketFlow _defaultFlow;
+    uint32_t _oldnexthop;
+    //PacketSink* _detour;
     LosslessInputQueue* _ingressqueue;
-    uint32_t _path_len; // length of the path in hops - used in BCube priority routing with NDP
+    static PacketFlow _defaultFlow;
 };
 
+// Size budgets for Packet and its subclasses, in bytes on a 64-bit
+// build.  Every packet is touched on every hop, so a field that pushes
+// a packet type over a cache line boundary costs for the whole run.  If
+// one of these fires, look at the field order before raising the budget.
+#define PACKET_SIZE_BUDGET(P, bytes) \
+    static_assert(sizeof(P) <= (bytes), #P " has grown past its size budget")
+
+PACKET_SIZE_BUDGET(Packet, 80);
+
 class PacketSink {
  public:
     PacketSink() { _remoteEndpoint = NULL; }
@@ -235,6 +256,8 @@ class PacketDB {
         if (_freelist.empty()) {
             P* p = new P();
             p->inc_ref_count();
+            // pooled packets are never freed, so this is the pool's high watermark
+            MemoryStats::account(MemoryStats::PACKETS, sizeof(P), 1);
             /*
             if (_alloc_count == 0) {
                 cout << "Packet size: " << sizeof(P) << endl;
@@ -22,6 +22,7 @@ using namespace std;
 
 #include "loggers.h"
 #include "eqds_logger.h"
+#include "logfile.h"
 
 struct eqint
 {
@@ -31,9 +32,162 @@ struct eqint
     }
 };
 
+struct LogRecord {
+    double time;
+    uint32_t type, id, ev;
+    double val1, val2, val3;
+};
+
+struct RecordRange {
+    uint64_t first, last; // inclusive
+    bool operator<(const RecordRange& other) const {return first < other.first;}
+};
+
+static bool read_record(FILE* f, LogRecord& r) {
+    if (fread(&r.time, sizeof(double), 1, f) < 1) return false;
+    if (fread(&r.type, sizeof(uint32_t), 1, f) < 1) return false;
+    if (fread(&r.id, sizeof(uint32_t), 1, f) < 1) return false;
+    if (fread(&r.ev, sizeof(uint32_t), 1, f) < 1) return false;
+    if (fread(&r.val1, sizeof(double), 1, f) < 1) return false;
+    if (fread(&r.val2, sizeof(double), 1, f) < 1) return false;
+    if (fread(&r.val3, sizeof(double), 1, f) < 1) return false;
+    return true;
+}
+
+static bool wanted(const vector<uint32_t>& want, uint32_t v) {
+    return want.empty() || std::find(want.begin(), want.end(), v) != want.end();
+}
+
+/*
+ * Use the time index written by Logfile::enableIndex to read only the
+ * records between from and to (in seconds), optionally restricted to
+ * some types and ids.  The index directory is binary searched for the
+ * first bucket in range, and each bucket's block tells us which span
+ * of records holds the (type,id) pairs we want, so we only seek to and
+ * read those spans of the trace.
+ */
+static void query_index(const string& indexname, FILE* logfile, long trace_start, int numRecords,
+                        double from, double to,
+                        const vector<uint32_t>& types, const vector<uint32_t>& ids,
+                        vector<LogRecord>& result) {
+    FILE* indexfile = fopen(indexname.c_str(), "rbS");
+    if (indexfile==NULL) {
+        cerr << "Failed to open log index " << indexname << endl;
+        exit(1);
+    }
+    char magic[9];
+    magic[8] = 0;
+    uint32_t version, recsize;
+    uint64_t bucket_width;
+    if (fread(magic, 1, 8, indexfile) < 8 || strcmp(magic, LOG_INDEX_MAGIC)
+        || fread(&version, sizeof(uint32_t), 1, indexfile) < 1
+        || fread(&recsize, sizeof(uint32_t), 1, indexfile) < 1
+        || fread(&bucket_width, sizeof(uint64_t), 1, indexfile) < 1) {
+        cerr << indexname << " is not a log index" << endl;
+        exit(1);
+    }
+    if (version != LOG_INDEX_VERSION || recsize != LOG_RECORD_SIZE) {
+        cerr << "Unsupported log index version " << version << " record size " << recsize << endl;
+        exit(1);
+    }
+
+    uint64_t dir_offset, nbuckets;
+    fseek(indexfile, -(long)LOG_INDEX_FOOTER_SIZE, SEEK_END);
+    if (fread(&dir_offset, sizeof(uint64_t), 1, indexfile) < 1
+        || fread(&nbuckets, sizeof(uint64_t), 1, indexfile) < 1
+        || fread(magic, 1, 8, indexfile) < 8 || strcmp(magic, LOG_INDEX_MAGIC)) {
+        cerr << "Log index " << indexname << " is truncated - did the simulation finish?" << endl;
+        exit(1);
+    }
+    vector<LogIndexBucket> dir(nbuckets);
+    fseek(indexfile, dir_offset, SEEK_SET);
+    for (uint64_t b = 0; b < nbuckets; b++) {
+        std::ignore = fread(&dir[b].bucket, sizeof(uint64_t), 1, indexfile);
+        std::ignore = fread(&dir[b].block_offset, sizeof(uint64_t), 1, indexfile);
+        std::ignore = fread(&dir[b].first_rec, sizeof(uint64_t), 1, indexfile);
+        std::ignore = fread(&dir[b].nentries, sizeof(uint32_t), 1, indexfile);
+    }
+
+    // picoseconds, to match the bucketing done when the log was written
+    uint64_t from_bucket = (uint64_t)llround(from * 1e12) / bucket_width;
+    uint64_t to_bucket = (uint64_t)llround(to * 1e12) / bucket_width;
+    vector<LogIndexBucket>::iterator b = dir.begin();
+    // binary search for the first bucket that could hold records at or after from
+    size_t lo = 0, hi = dir.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (dir[mid].bucket < from_bucket)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    b += lo;
+
+    vector<RecordRange> ranges;
+    bool filtered = !types.empty() || !ids.empty();
+    for (; b != dir.end() && b->bucket <= to_bucket; b++) {
+        uint64_t end_rec = (b + 1 == dir.end()) ? numRecords : (b + 1)->first_rec;
+        if (end_rec <= b->first_rec)
+            continue;
+        RecordRange r;
+        if (!filtered) {
+            r.first = b->first_rec;
+            r.last = end_rec - 1;
+            ranges.push_back(r);
+            continue;
+        }
+        fseek(indexfile, b->block_offset, SEEK_SET);
+        uint32_t nentries;
+        std::ignore = fread(&nentries, sizeof(uint32_t), 1, indexfile);
+        for (uint32_t e = 0; e < nentries; e++) {
+            LogIndexEntry entry;
+            std::ignore = fread(&entry.type, sizeof(uint32_t), 1, indexfile);
+            std::ignore = fread(&entry.id, sizeof(uint32_t), 1, indexfile);
+            std::ignore = fread(&entry.first_rec, sizeof(uint64_t), 1, indexfile);
+            std::ignore = fread(&entry.last_rec, sizeof(uint64_t), 1, indexfile);
+            std::ignore = fread(&entry.count, sizeof(uint32_t), 1, indexfile);
+            if (!wanted(types, entry.type) || !wanted(ids, entry.id))
+                continue;
+            r.first = entry.first_rec;
+            r.last = entry.last_rec;
+            ranges.push_back(r);
+        }
+    }
+    fclose(indexfile);
+
+    // merge overlapping spans so each record is read at most once
+    std::sort(ranges.begin(), ranges.end());
+    size_t merged = 0;
+    for (size_t i = 1; i < ranges.size(); i++) {
+        if (ranges[i].first <= ranges[merged].last + 1) {
+            if (ranges[i].last > ranges[merged].last)
+                ranges[merged].last = ranges[i].last;
+        } else {
+            ranges[++merged] = ranges[i];
+        }
+    }
+    if (!ranges.empty())
+        ranges.resize(merged + 1);
+
+    for (size_t i = 0; i < ranges.size(); i++) {
+        fseek(logfile, trace_start + (long)(ranges[i].first * LOG_RECORD_SIZE), SEEK_SET);
+        for (uint64_t rec = ranges[i].first; rec <= ranges[i].last; rec++) {
+            LogRecord r;
+            if (!read_record(logfile, r))
+                break;
+            if (r.time < from || r.time > to)
+                continue;
+            if (!wanted(types, r.type) || !wanted(ids, r.id))
+                continue;
+            result.push_back(r);
+        }
+    }
+}
+
 int main(int argc, char** argv){
     if (argc < 2){
         printf("Usage %s filename [-show|-verbose|-ascii]\n", argv[0]);
+        printf("\t[-from t] [-to t] [-type T]... [-id N]... read only these records via filename.idx (t in seconds)\n");
         return 1;
     }
 
@@ -44,6 +198,10 @@ int main(int argc, char** argv){
     vector <string> filters;
     vector <string> splits;
     vector <int> fields;
+    bool use_index = false;
+    double from = 0, to = HUGE_VAL;
+    vector <uint32_t> query_types;
+    vector <uint32_t> query_ids;
 
     int i = 2;
     while (i<argc) {
@@ -68,6 +226,22 @@ int main(int argc, char** argv){
         } else if (!strcmp(argv[i],"-field")){
             fields.push_back(atoi(argv[i+1]));
             i++;
+        } else if (!strcmp(argv[i],"-from")){
+            from = atof(argv[i+1]);
+            use_index = true;
+            i++;
+        } else if (!strcmp(argv[i],"-to")){
+            to = atof(argv[i+1]);
+            use_index = true;
+            i++;
+        } else if (!strcmp(argv[i],"-type")){
+            query_types.push_back(atoi(argv[i+1]));
+            use_index = true;
+            i++;
+        } else if (!strcmp(argv[i],"-id")){
+            query_ids.push_back(atoi(argv[i+1]));
+            use_index = true;
+            i++;
         }
         i++;
     }
@@ -173,6 +347,17 @@ int main(int argc, char** argv){
 
     //must find the number of records here, and go to #TRACE
 
+    vector<LogRecord> selected;
+    if (use_index) {
+        if (transpose) {
+            cerr << "Indexed queries need a record-at-a-time (transpose=0) logfile" << endl;
+            exit(1);
+        }
+        query_index(string(argv[1]) + ".idx", logfile, ftell(logfile), numRecords,
+                    from, to, query_types, query_ids, selected);
+        numRecords = selected.size();
+    }
+
     int numread = numRecords;
 
     double* timeRec = new double[numRecords];
@@ -183,7 +368,17 @@ int main(int argc, char** argv){
     double* val2Rec = new double[numRecords];
     double *val3Rec = new double[numRecords];
 
-    if (transpose) {
+    if (use_index) {
+        for (int i = 0; i < numRecords; i++) {
+            timeRec[i] = selected[i].time;
+            typeRec[i] = selected[i].type;
+            idRec[i] = selected[i].id;
+            evRec[i] = selected[i].ev;
+            val1Rec[i] = selected[i].val1;
+            val2Rec[i] = selected[i].val2;
+            val3Rec[i] = selected[i].val3;
+        }
+    } else if (transpose) {
         /* old-style transposed data */
         std::ignore = fread(timeRec, sizeof(double), numread, logfile);
         std::ignore = fread(typeRec, sizeof(uint32_t), numread, logfile);
@@ -375,6 +570,9 @@ int main(int argc, char** argv){
             case Logger::FLOW_EVENT:
                 out = FlowEventLoggerSimple::event_to_str(event);
                 break;
+            case Logger::QUEUE_AGGREGATE:
+                out = AggregateQueueLoggerSampling::event_to_str(event);
+                break;
             }
             bool do_output = true;
             for (size_t f=0; f < filters.size(); f++) {
@@ -3,6 +3,10 @@
 #include <iostream>
 #include <sstream>
 
+uint64_t Pipe::_batched_deliveries = 0;
+uint64_t Pipe::_packets_carried = 0;
+uint64_t Pipe::_failed_drops = 0;
+
 Pipe::Pipe(simtime_picosec delay, EventList& eventlist)
 : EventSource(eventlist,"pipe"), _delay(delay)
 {
@@ -20,6 +24,12 @@ void
 Pipe::receivePacket(Packet& pkt)
 {
     //pkt.flow().logTraffic(pkt,*this,TrafficLogger::PKT_ARRIVE);
+    if (_failed) {
+        _failed_drops++;
+        pkt.free();
+        return;
+    }
+    _packets_carried++;
     //if (_inflight.empty()){
     if (_count == 0){
         /* no packets currently inflight; need to notify the eventlist
@@ -55,20 +65,32 @@ Pipe::doNextEvent() {
     if (_count == 0) 
             return;
 
-    //Packet *pkt = _inflight.back().second;
-    //_inflight.pop_back();
-    Packet *pkt = _inflight_v[_next_pop].pkt;
-    _next_pop = (_next_pop +1) % _size;
-    _count--;
-    pkt->flow().logTraffic(*pkt, *this,TrafficLogger::PKT_DEPART);
+    while (true) {
+        //Packet *pkt = _inflight.back().second;
+        //_inflight.pop_back();
+        Packet *pkt = _inflight_v[_next_pop].pkt;
+        _next_pop = (_next_pop +1) % _size;
+        _count--;
+        pkt->flow().logTraffic(*pkt, *this,TrafficLogger::PKT_DEPART);
+
+        // tell the packet to move itself on to the next hop
+        pkt->sendOn();
 
-    // tell the packet to move itself on to the next hop
-    pkt->sendOn();
+        //if (!_inflight.empty()) {
+        if (_count == 0)
+            return;
 
-    //if (!_inflight.empty()) {
-    if (_count > 0) {
-        // notify the eventlist we've another event pending
+        // A train of back-to-back packets would otherwise cost an
+        // eventlist insertion and removal per packet.  If our next
+        // packet is due before anything else in the simulation, just
+        // deliver it now; this runs events in exactly the same order
+        // as scheduling it would.
         simtime_picosec nexteventtime = _inflight_v[_next_pop].time;
-        _eventlist.sourceIsPending(*this, nexteventtime);
+        if (!EventList::advanceIfNext(nexteventtime)) {
+            // notify the eventlist we've another event pending
+            _eventlist.sourceIsPending(*this, nexteventtime);
+            return;
+        }
+        _batched_deliveries++;
     }
 }
@@ -34,6 +34,16 @@ class Pipe : public EventSource, public PacketSink, public Drawable {
     PacketSink* next() const {
             return _next_sink;
     }
+    // A failed pipe loses every packet sent into it until it recovers;
+    // packets already on the wire still arrive.
+    void setFailed(bool failed) {_failed = failed;}
+    bool failed() const {return _failed;}
+    // packets delivered without going through the eventlist
+    static uint64_t _batched_deliveries;
+    // packets that have entered any pipe, ie link traversals
+    static uint64_t _packets_carried;
+    // packets lost to failed pipes
+    static uint64_t _failed_drops;
 protected:
     string _nodename;
     //typedef pair<simtime_picosec,Packet*> pktrecord_t;
@@ -43,6 +53,7 @@ protected:
 private:
     simtime_picosec _delay;
     PacketSink* _next_sink{nullptr}; // used in generic topology for linkage
+    bool _failed{false};
 };
 
 
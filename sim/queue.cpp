@@ -9,7 +9,8 @@ simtime_picosec BaseQueue::_update_period = timeFromUs(0.1);
 
 // base queue is a generic queue that we can log, but doesn't actually store anything
 BaseQueue::BaseQueue(linkspeed_bps bitrate, EventList& eventlist, QueueLogger* logger)
-    : EventSource(eventlist, "Queue"), _logger(logger), _bitrate(bitrate), _switch(NULL) {
+    : EventSource(eventlist, "Queue"), _logger(logger), _bitrate(bitrate), _switch(NULL),
+      _level_listener(NULL), _level_index(0) {
     _ps_per_byte = (simtime_picosec)((pow(10.0, 12.0) * 8) / _bitrate);
     _window = timeFromUs(30.0);
     _busy = 0;
@@ -73,40 +74,35 @@ uint8_t
 BaseQueue::quantized_utilization(){
     if (eventlist().now()-_last_update_utilization > _update_period){
         _last_update_utilization = eventlist().now();
+        _last_utilization = utilization_level();
+    }
+    return _last_utilization;
+}
 
-        uint16_t avg = average_utilization();
+uint8_t
+BaseQueue::utilization_level(){
+    uint16_t avg = average_utilization();
 
-        //if (avg>=100) avg = 99;
+    //if (avg>=100) avg = 99;
 
-        //quantize utilization to four 25% bands of linerate. 
-        //_last_utilization = avg / 25;            
+    //quantize utilization to four 25% bands of linerate. 
+    //return avg / 25;            
 
-        if (avg == 0)
-            _last_utilization = 0;
-        else if (avg < 15)
-            _last_utilization = 1;
-        else if (avg < 50)
-            _last_utilization = 2;
-        else 
-            _last_utilization = 3;
-    }
-    return _last_utilization;
+    if (avg == 0)
+        return 0;
+    else if (avg < 15)
+        return 1;
+    else if (avg < 50)
+        return 2;
+    else 
+        return 3;
 }
 
 uint64_t
 BaseQueue::quantized_queuesize(){
     if (eventlist().now()-_last_update_qs > _update_period){
         _last_update_qs = eventlist().now();
-
-        uint64_t qs = queuesize();
-        if (qs < maxsize() * 0.05)
-            _last_qs = 0;
-        else if (qs < maxsize() * 0.1)
-            _last_qs = 1;
-        else if (qs < maxsize() * 0.2)
-            _last_qs = 2;
-        else 
-            _last_qs = 3;
+        _last_qs = queuesize_level();
         //_last_qs = queuesize();
 
         //cout << "QS " << (uint32_t)_last_qs << " queuesize " << queuesize() << " max " << maxsize() << endl;
@@ -114,6 +110,19 @@ BaseQueue::quantized_queuesize(){
     return _last_qs;
 }
 
+uint8_t
+BaseQueue::queuesize_level(){
+    uint64_t qs = queuesize();
+    if (qs < maxsize() * 0.05)
+        return 0;
+    else if (qs < maxsize() * 0.1)
+        return 1;
+    else if (qs < maxsize() * 0.2)
+        return 2;
+    else 
+        return 3;
+}
+
 
 Queue::Queue(linkspeed_bps bitrate, mem_b maxsize, EventList& eventlist, 
              QueueLogger* logger)
@@ -149,6 +158,7 @@ Queue::completeService()
 
     //used to compute queue utilization
     log_packet_send(drainTime(pkt));
+    levelChanged();
 
     /* tell the packet to move on to the next pipe */
     pkt->sendOn();
@@ -189,6 +199,7 @@ Queue::receivePacket(Packet& pkt)
     _enqueued.push(pkt_p);
     _queuesize += pkt.size();
     if (_logger) _logger->logQueue(*this, QueueLogger::PKT_ENQUEUE, pkt);
+    levelChanged();
 
     if (queueWasEmpty) {
         /* schedule the dequeue event */
@@ -22,6 +22,15 @@
 // disciplines. 
 class Switch;
 
+// Told when a queue's load may have changed (a packet was queued or
+// sent, or the queue was paused), so a switch doing adaptive routing
+// can keep its ports ranked instead of polling every candidate queue.
+class QueueLevelListener {
+public:
+    virtual ~QueueLevelListener() {}
+    virtual void queueLevelChanged(uint32_t index) = 0;
+};
+
 class BaseQueue  : public EventSource, public PacketSink, public Drawable {
  public:
     BaseQueue(linkspeed_bps bitrate, EventList &eventlist, QueueLogger* logger);
@@ -64,6 +73,19 @@ class BaseQueue  : public EventSource, public PacketSink, public Drawable {
     virtual uint64_t quantized_queuesize();
     virtual uint8_t quantized_utilization();
 
+    // the same quantization, applied to the current values rather
+    // than sampled every _update_period
+    uint8_t queuesize_level();
+    uint8_t utilization_level();
+
+    // only one listener per queue; index is passed back to it.  A
+    // NULL listener removes the current one.
+    void setLevelListener(QueueLevelListener* listener, uint32_t index) {
+        assert(!listener || !_level_listener || _level_listener == listener);
+        _level_listener = listener;
+        _level_index = index;
+    }
+
     static simtime_picosec _update_period;
 
 protected:
@@ -86,6 +108,14 @@ protected:
     uint8_t _last_qs, _last_utilization;
 
     Switch* _switch;//which switch is this queue part of?
+
+    // subclasses call this whenever the queue size or pause state changes
+    inline void levelChanged() {
+        if (_level_listener)
+            _level_listener->queueLevelChanged(_level_index);
+    }
+    QueueLevelListener* _level_listener;
+    uint32_t _level_index;
 };
 
 
@@ -66,6 +66,7 @@ LosslessOutputQueue::receivePacket(Packet& pkt,VirtualQueue* prev)
             if(_enqueued.size()>0&&!_sending)
                 beginService();
         }
+        levelChanged();
         
         pkt.free();
         return;
@@ -92,6 +93,7 @@ LosslessOutputQueue::receivePacket(Packet& pkt,VirtualQueue* prev)
 
     if (_logger) 
         _logger->logQueue(*this, QueueLogger::PKT_ENQUEUE, pkt);
+    levelChanged();
 
     if (queueWasEmpty && _state_send == READY) {
         /* schedule the dequeue event */
@@ -124,20 +126,18 @@ void LosslessOutputQueue::completeService(){
     if (pkt->type()==HPCC){
         //HPPC INT information adding to packet
         HPCCPacket* h = dynamic_cast<HPCCPacket*>(pkt);
-        assert(h->_int_hop<5);
+        IntEntry& e = h->append_int();
 
-        h->_int_info[h->_int_hop]._queuesize = _queuesize;
-        h->_int_info[h->_int_hop]._ts = eventlist().now();
+        e._queuesize = _queuesize;
+        e._ts = eventlist().now();
 
         if (_switch){
-            h->_int_info[h->_int_hop]._switchID = _switch->getID();
-            h->_int_info[h->_int_hop]._type = _switch->getType();
+            e._switchID = _switch->getID();
+            e._type = _switch->getType();
         }
 
-        h->_int_info[h->_int_hop]._txbytes = _txbytes;
-        h->_int_info[h->_int_hop]._linkrate = _bitrate;
-
-        h->_int_hop++;
+        e._txbytes = _txbytes;
+        e._linkrate = _bitrate;
     }   
 
     _queuesize -= pkt->size();
@@ -152,6 +152,7 @@ void LosslessOutputQueue::completeService(){
 
     //this is used for bandwidth utilization tracking. 
     log_packet_send(drainTime(pkt));
+    levelChanged();
 
     //if (((uint64_t)timeAsUs(eventlist().now()))%5==0)
     //    cout << "Queue bandwidth utilization " << average_utilization() << "%" << endl;
@@ -12,6 +12,7 @@ RandomQueue::RandomQueue(linkspeed_bps bitrate, mem_b maxsize,
     //cout << "RandomQueue::_maxsize " << _maxsize << endl;
     _drop_th = _maxsize - _drop;
     _plr = 0.0;
+    _rng.setId(get_id());
 }
 
 void RandomQueue::set_packet_loss_rate(double l){
@@ -24,7 +25,7 @@ RandomQueue::receivePacket(Packet& pkt)
     double drop_prob = 0;
     int crt = _queuesize + pkt.size();
 
-    if (_plr > 0.0 && drand() < _plr){
+    if (_plr > 0.0 && _rng.drand() < _plr){
         //if (_logger) _logger->logQueue(*this, QueueLogger::PKT_DROP, pkt);
         //pkt.flow().logTraffic(pkt,*this,TrafficLogger::PKT_DROP);
         cout << "Random Drop" << endl;
@@ -37,7 +38,7 @@ RandomQueue::receivePacket(Packet& pkt)
   
     //  cout << "Drop Prob "<<drop_prob<< " queue size "<< _queuesize/1000 << " queue id " << id << endl;
 
-    if (crt > _maxsize || drand() < drop_prob) {
+    if (crt > _maxsize || _rng.drand() < drop_prob) {
         /* drop the packet */
         if (_logger) _logger->logQueue(*this, QueueLogger::PKT_DROP, pkt);
         pkt.flow().logTraffic(pkt, *this, TrafficLogger::PKT_DROP);
@@ -61,6 +62,7 @@ RandomQueue::receivePacket(Packet& pkt)
 
     if (_logger) 
         _logger->logQueue(*this, QueueLogger::PKT_ENQUEUE, pkt);
+    levelChanged();
 
     if (queueWasEmpty) {
         /* schedule the dequeue event */
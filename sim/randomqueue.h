@@ -11,6 +11,7 @@
 #include "eventlist.h"
 #include "network.h"
 #include "loggertypes.h"
+#include "rng.h"
 
 class RandomQueue : public Queue {
 public:
@@ -22,6 +23,7 @@ private:
     mem_b _drop_th,_drop;
     int _buffer_drops;
     double _plr;
+    RngStream _rng; // for drop decisions
 };
 
 #endif
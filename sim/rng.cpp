@@ -1,6 +1,7 @@
 #include <cstdlib>
 #include <climits>
 #include <random>
+#include "rng.h"
 
 using namespace std;
 
@@ -9,6 +10,7 @@ static mt19937 random_engine;
 void srand(unsigned seed)
 {
     random_engine = mt19937(seed);
+    RngStream::setSeed(seed);
 }
 
 int rand()
@@ -25,3 +27,29 @@ long random()
 {
     return rand();
 }
+
+uint64_t RngStream::_seed = 0;
+
+void RngStream::refill()
+{
+    // the counter is the block number and the stream id, the key is the seed
+    uint32_t c0 = _counter, c1 = _counter >> 32, c2 = _id, c3 = 0;
+    uint32_t k0 = _seed, k1 = _seed >> 32;
+    for (int round = 0; round < 10; round++) {
+        uint64_t p0 = (uint64_t)0xD2511F53 * c0;
+        uint64_t p1 = (uint64_t)0xCD9E8D57 * c2;
+        c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        c1 = (uint32_t)p1;
+        c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c3 = (uint32_t)p0;
+        k0 += 0x9E3779B9;
+        k1 += 0xBB67AE85;
+    }
+    // handed out from _out[3] down
+    _out[0] = c3;
+    _out[1] = c2;
+    _out[2] = c1;
+    _out[3] = c0;
+    _avail = 4;
+    _counter++;
+}
@@ -0,0 +1,44 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+#include <climits>
+
+/*
+ * A random number stream for one component, from the Philox4x32-10
+ * counter-based generator (Salmon et al, "Parallel Random Numbers: As
+ * Easy as 1, 2, 3", SC'11).  The n'th number a stream returns depends
+ * only on the seed, the stream id and n, so a component's draws don't
+ * change when other components draw more or fewer numbers, or when
+ * events run in a different order.
+ *
+ * Components use their Logged id as the stream id.  The seed is the
+ * one given to srand()/srandom().
+ */
+
+class RngStream {
+ public:
+    RngStream(uint32_t id = 0) : _id(id), _counter(0), _avail(0) {}
+    void setId(uint32_t id) {_id = id; _counter = 0; _avail = 0;}
+
+    uint32_t next() {
+        if (_avail == 0)
+            refill();
+        return _out[--_avail];
+    }
+    // drop-in replacements for rand()/random() and drand()
+    int rand() {return next() & INT_MAX;}
+    double drand() {return (double)rand() / (double)INT_MAX;}
+
+    static void setSeed(uint64_t seed) {_seed = seed;}
+ private:
+    void refill();
+    uint32_t _id;
+    uint64_t _counter; // blocks of 4 numbers used so far
+    uint32_t _out[4];
+    uint8_t _avail;
+    static uint64_t _seed;
+};
+
+#endif
@@ -62,7 +62,6 @@ RoceSrc::RoceSrc(RoceLogger* logger, TrafficLogger* pktlogger, EventList &eventl
     _node_num = _global_node_count++;
     _nodename = "rocesrc " + to_string(_node_num);
 
-    srand(time(NULL));
     _pathid = random()%256;
 
     //cout << _nodename << " path id is " << _pathid << endl;
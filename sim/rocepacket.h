@@ -138,5 +138,8 @@ class RoceNack : public Packet {
     static PacketDB<RoceNack> _packetdb;
 };
 
+PACKET_SIZE_BUDGET(RocePacket, 104);
+PACKET_SIZE_BUDGET(RoceAck, 96);
+PACKET_SIZE_BUDGET(RoceNack, 96);
 
 #endif
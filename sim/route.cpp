@@ -7,12 +7,37 @@
 
 #define MAXQUEUES 10
 
-Route::Route() : _hop_count(0), _reverse(NULL) {};
+Route::Route() : _hop_count(0), _reverse(NULL) {
+    MemoryStats::account(MemoryStats::ROUTES, memory_used(), 1);
+};
 
 Route::Route(int size) : _hop_count(0), _reverse(NULL) {
     _sinklist.reserve(size);
+    MemoryStats::account(MemoryStats::ROUTES, memory_used(), 1);
 };
 
+Route::Route(const Route& orig)
+    : _sinklist(orig._sinklist), _hop_count(orig._hop_count), _reverse(orig._reverse),
+      _path_id(orig._path_id), _no_of_paths(orig._no_of_paths) {
+    MemoryStats::account(MemoryStats::ROUTES, memory_used(), 1);
+}
+
+Route::~Route() {
+    MemoryStats::account(MemoryStats::ROUTES, -memory_used(), -1);
+}
+
+Route& Route::operator=(const Route& orig) {
+    // the sink list may reallocate, so account for the size change
+    int64_t before = memory_used();
+    _sinklist = orig._sinklist;
+    _hop_count = orig._hop_count;
+    _reverse = orig._reverse;
+    _path_id = orig._path_id;
+    _no_of_paths = orig._no_of_paths;
+    MemoryStats::account(MemoryStats::ROUTES, memory_used() - before, 0);
+    return *this;
+}
+
 Route::Route(const Route& orig, PacketSink& dst) : _sinklist(orig.size()+1){
     //_sinklist.resize(orig.size()+1);
     _path_id = orig.path_id();
@@ -24,6 +49,7 @@ Route::Route(const Route& orig, PacketSink& dst) : _sinklist(orig.size()+1){
     }
     _sinklist[orig.size()] = &dst;
     _hop_count++;
+    MemoryStats::account(MemoryStats::ROUTES, memory_used(), 1);
 }
 
 
@@ -43,7 +69,9 @@ Route::clone() const {
       copy->push_back(*i);
       }
     */
+    size_t cap = copy->_sinklist.capacity();
     copy->_sinklist.resize(_sinklist.size());
+    copy->account_growth(cap);
     for (uint32_t i = 0; i < _sinklist.size(); i++) {
         copy->_sinklist[i] = _sinklist[i];
     }
@@ -7,6 +7,7 @@
  */
 
 #include "config.h"
+#include "memstats.h"
 #include <list>
 #include <vector>
 
@@ -16,19 +17,28 @@ class Route {
     Route();
     Route(int size);
     Route(const Route& orig, PacketSink& dst);
+    Route(const Route& orig);
+    ~Route();
+    Route& operator=(const Route& orig);
     Route* clone() const;
     inline PacketSink* at(size_t n) const {return _sinklist.at(n);}
     void push_back(PacketSink* sink) {
         assert(sink != NULL);
+        size_t cap = _sinklist.capacity();
         _sinklist.push_back(sink);
+        account_growth(cap);
         update_hopcount(sink);
     }
     void push_at(PacketSink* sink,int id) {
+        size_t cap = _sinklist.capacity();
         _sinklist.insert(_sinklist.begin()+id, sink);
+        account_growth(cap);
             update_hopcount(sink);
     }
     void push_front(PacketSink* sink) {
+        size_t cap = _sinklist.capacity();
         _sinklist.insert(_sinklist.begin(), sink);
+        account_growth(cap);
             update_hopcount(sink);
     }
     void add_endpoints(PacketSink *src, PacketSink* dst);
@@ -48,6 +58,13 @@ class Route {
     inline uint32_t hop_count() const {return _hop_count;}
  private:
     void update_hopcount(PacketSink* sink);
+    // tell MemoryStats if the sink list storage grew
+    inline void account_growth(size_t old_capacity) {
+        if (_sinklist.capacity() != old_capacity)
+            MemoryStats::account(MemoryStats::ROUTES,
+                                 (_sinklist.capacity() - old_capacity) * sizeof(PacketSink*), 0);
+    }
+    int64_t memory_used() const {return sizeof(Route) + _sinklist.capacity() * sizeof(PacketSink*);}
     vector<PacketSink*> _sinklist;
     uint32_t _hop_count;
     Route* _reverse;
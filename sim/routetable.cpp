@@ -1,5 +1,6 @@
 // -*- c-basic-offset: 4; indent-tabs-mode: nil -*-  
 #include <climits>
+#include <algorithm>
 #include "routetable.h"
 #include "network.h"
 #include "queue.h"
@@ -14,13 +15,30 @@ void RouteTable::addRoute(int destination, Route* port, int cost, packet_directi
     _fib[destination]->push_back(new FibEntry(port,cost,direction));
 }
 
-void RouteTable::addHostRoute(int destination, Route* port, int flowid){  
-    if (_hostfib.find(destination) == _hostfib.end())
-        _hostfib[destination] = new unordered_map<int, HostFibEntry*>(); 
-    
+void RouteTable::addGroupRoute(uint32_t key, Route* port, int cost, packet_direction direction){  
     assert(port!=NULL);
 
-    (*_hostfib[destination])[flowid] = new HostFibEntry(port,flowid);
+    addGroup(key)->push_back(new FibEntry(port,cost,direction));
+}
+
+vector<FibEntry*>* RouteTable::addGroup(uint32_t key){
+    if (key >= _groups.size())
+        _groups.resize(key+1, NULL);
+    if (_groups[key] == NULL)
+        _groups[key] = new vector<FibEntry*>();
+    return _groups[key];
+}
+
+HostFibEntry* RouteTable::addHostRoute(uint32_t port, Route* route, int addr){  
+    if (port >= _hostfib.size())
+        _hostfib.resize(port+1, NULL);
+    assert(_hostfib[port] == NULL);
+    assert(route!=NULL);
+
+    HostDemux* demux = new HostDemux(addr);
+    route->push_back(demux);
+    _hostfib[port] = new HostFibEntry(route,demux);
+    return _hostfib[port];
 }
 
 
@@ -31,15 +49,37 @@ vector<FibEntry*>* RouteTable::getRoutes(int destination){
         return _fib[destination];
 }
 
-HostFibEntry* RouteTable::getHostRoute(int destination,int flowid){
-    if (_hostfib.find(destination) == _hostfib.end() ||
-        _hostfib[destination]->find(flowid) == _hostfib[destination]->end())
+void RouteTable::setRoutes(int destination, vector<FibEntry*>* routes){
+    _fib[destination] = routes;
+}
+
+HostDemux::HostDemux(int addr) {
+    _nodename = "demux(" + ntoa(addr) + ")";
+}
+
+void HostDemux::addFlow(flowid_t flowid, PacketSink* transport) {
+    assert(transport != NULL);
+    vector<pair<flowid_t, PacketSink*> >::iterator i = 
+        lower_bound(_flows.begin(), _flows.end(), make_pair(flowid, (PacketSink*)NULL));
+    if (i != _flows.end() && i->first == flowid)
+        i->second = transport;
+    else
+        _flows.insert(i, make_pair(flowid, transport));
+}
+
+PacketSink* HostDemux::getFlow(flowid_t flowid) const {
+    vector<pair<flowid_t, PacketSink*> >::const_iterator i = 
+        lower_bound(_flows.begin(), _flows.end(), make_pair(flowid, (PacketSink*)NULL));
+    if (i == _flows.end() || i->first != flowid)
         return NULL;
-    else {
-        return (*_hostfib[destination])[flowid];
-    }
+    return i->second;
 }
 
-void RouteTable::setRoutes(int destination, vector<FibEntry*>* routes){
-    _fib[destination] = routes;
-}
\ No newline at end of file
+void HostDemux::receivePacket(Packet& pkt) {
+    PacketSink* transport = getFlow(pkt.flow_id());
+    if (!transport) {
+        cerr << nodename() << ": no transport for flow " << pkt.flow_id() << endl;
+        abort();
+    }
+    transport->receivePacket(pkt);
+}
@@ -26,31 +26,69 @@ protected:
     packet_direction _direction;
 };
 
+// Every flow to a directly attached host leaves the switch through the
+// same queue and pipe, so the switch keeps one Route per host port,
+// shared by all those flows, and ends it with a HostDemux that hands
+// each packet to its flow's transport.
+class HostDemux : public PacketSink {
+public:
+    HostDemux(int addr);
+    void addFlow(flowid_t flowid, PacketSink* transport);
+    PacketSink* getFlow(flowid_t flowid) const;
+    size_t flows() const {return _flows.size();}
+
+    virtual void receivePacket(Packet& pkt);
+    virtual const string& nodename() {return _nodename;}
+
+private:
+    // sorted by flowid for binary search.  Flows are normally set up
+    // in increasing flowid order, so adding one is an append.
+    vector<pair<flowid_t, PacketSink*> > _flows;
+    string _nodename;
+};
+
 class HostFibEntry{
 public:
-    HostFibEntry(Route* outport, int flowid){ _flowid = flowid; _out = outport;}
+    HostFibEntry(Route* outport, HostDemux* demux){ _out = outport; _demux = demux;}
 
     Route* getEgressPort(){return _out;}
-    int getFlowID(){return _flowid;}
+    HostDemux* getDemux(){return _demux;}
 
 protected:
     Route* _out;
-    uint32_t _flowid;
-
+    HostDemux* _demux;
 };
 
 class RouteTable {
 public:
     RouteTable() {};
     void addRoute(int destination, Route* port, int cost, packet_direction direction);  
-    void addHostRoute(int destination, Route* port, int flowid);  
     void setRoutes(int destination, vector<FibEntry*>* routes);  
     vector <FibEntry*>* getRoutes(int destination);
-    HostFibEntry* getHostRoute(int destination, int flowid);
+
+    // Host routes are indexed by the host's port number on this
+    // switch.  route is the path to the host (egress queue and pipe);
+    // a HostDemux is appended to it, and flows are added to that.
+    HostFibEntry* addHostRoute(uint32_t port, Route* route, int addr);
+    inline HostFibEntry* getHostRoute(uint32_t port) {
+        return port < _hostfib.size() ? _hostfib[port] : NULL;
+    }
+
+    // Switches in hierarchical topologies can map a destination to a
+    // small group key (eg the destination's ToR or pod), so every
+    // destination behind that key shares one ECMP group and lookup is
+    // an array index rather than a hash of the host address.
+    void addGroupRoute(uint32_t key, Route* port, int cost, packet_direction direction);
+    // the group for key, created empty if there isn't one yet
+    vector <FibEntry*>* addGroup(uint32_t key);
+    inline vector <FibEntry*>* getGroup(uint32_t key) {
+        return key < _groups.size() ? _groups[key] : NULL;
+    }
     
 private:
     unordered_map<int,vector<FibEntry*>* > _fib;
-    unordered_map<int,unordered_map<int,HostFibEntry*>*> _hostfib;
+    vector<vector<FibEntry*>*> _groups;
+    vector<HostFibEntry*> _hostfib;
 };
 
 #endif
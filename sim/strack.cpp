@@ -828,6 +828,7 @@ STrackSink::drops() {
 
 STrackRtxTimerScanner::STrackRtxTimerScanner(simtime_picosec scanPeriod, EventList& eventlist)
     : EventSource(eventlist,"RtxScanner"), _scanPeriod(scanPeriod) {
+    setPeriodic(scanPeriod);
     eventlist.sourceIsPendingRel(*this, _scanPeriod);
 }
 
@@ -844,3 +845,13 @@ void STrackRtxTimerScanner::doNextEvent() {
     }
     eventlist().sourceIsPendingRel(*this, _scanPeriod);
 }
+
+// only needed while one of our sources has a retransmit timer running
+bool
+STrackRtxTimerScanner::idle() const {
+    for (auto i = _srcs.begin(); i != _srcs.end(); i++) {
+        if ((*i)->_highest_sent != 0 && (*i)->_RFC2988_RTO_timeout != timeInf)
+            return false;
+    }
+    return true;
+}
@@ -236,6 +236,7 @@ class STrackRtxTimerScanner : public EventSource {
  public:
     STrackRtxTimerScanner(simtime_picosec scanPeriod, EventList& eventlist);
     void doNextEvent();
+    bool idle() const;
     void registerSrc(STrackSrc &src);
  private:
     simtime_picosec _scanPeriod;
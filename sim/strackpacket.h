@@ -78,4 +78,7 @@ protected:
     static PacketDB<STrackAck> _packetdb;
 };
 
+PACKET_SIZE_BUDGET(STrackPacket, 104);
+PACKET_SIZE_BUDGET(STrackAck, 104);
+
 #endif
@@ -600,6 +600,8 @@ SwiftSrc::SwiftSrc(SwiftRtxTimerScanner& rtx_scanner, SwiftLogger* logger, Traff
     _stopped = false;
     _app_limited = -1;
     _highest_dsn_sent = 0;
+    _flow_logger = NULL;
+    _finished = false;
 
     // swift cc init
     _ai = 1.0;  // increase constant.  Value is a guess
@@ -715,6 +717,9 @@ SwiftSrc::permute_paths() {
 
 void 
 SwiftSrc::startflow() {
+    if (_flow_logger && !_subs.empty() && !_subs[0]->_established) {
+        _flow_logger->logEvent(_subs[0]->flow(), *this, FlowEventLogger::START, _flow_size - mss(), 0);
+    }
     for (size_t i = 0; i < _subs.size(); i++) {
         if (_subs[i]->_established)
             continue; // don't start twice
@@ -797,6 +802,10 @@ void SwiftSrc::update_dsn_ack(SwiftAck::seq_t ds_ackno) {
     //cout << "Flow " << _name << " dsn ack " << ds_ackno << endl;
     if (ds_ackno >= _flow_size){
         cout << "Flow " << _name << " finished at " << timeAsUs(eventlist().now()) << " total bytes " << ds_ackno << endl;
+        if (_flow_logger && !_finished) {
+            _flow_logger->logEvent(_subs[0]->flow(), *this, FlowEventLogger::FINISH, _flow_size - mss(), (_flow_size - mss())/mss());
+        }
+        _finished = true;
     }
 }
 
@@ -1047,6 +1056,7 @@ SwiftSink::drops(){
 
 SwiftRtxTimerScanner::SwiftRtxTimerScanner(simtime_picosec scanPeriod, EventList& eventlist)
     : EventSource(eventlist,"RtxScanner"), _scanPeriod(scanPeriod) {
+    setPeriodic(scanPeriod);
     eventlist.sourceIsPendingRel(*this, _scanPeriod);
 }
 
@@ -1063,3 +1073,13 @@ void SwiftRtxTimerScanner::doNextEvent() {
     }
     eventlist().sourceIsPendingRel(*this, _scanPeriod);
 }
+
+// only needed while one of our sources has a retransmit timer running
+bool
+SwiftRtxTimerScanner::idle() const {
+    for (auto i = _subflows.begin(); i != _subflows.end(); i++) {
+        if ((*i)->_highest_sent != 0 && (*i)->_RFC2988_RTO_timeout != timeInf)
+            return false;
+    }
+    return true;
+}
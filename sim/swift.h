@@ -44,6 +44,7 @@ private:
 class SwiftSubflowSrc : public EventSource, public PacketSink, public ScheduledSrc {
     friend class SwiftSrc;
     friend class SwiftLoggerSimple;
+    friend class SwiftRtxTimerScanner;
 public:
     SwiftSubflowSrc(SwiftSrc& src, TrafficLogger* pktlogger, int subflow_id);
     virtual const string& nodename() { return _nodename; }
@@ -145,6 +146,9 @@ public:
         cout << "Setting stop time to " << timeAsSec(_stop_time) << endl;
     }
 
+    // flow events are reported against the first subflow's PacketFlow
+    void logFlowEvents(FlowEventLogger& flow_logger) {_flow_logger = &flow_logger;}
+
     bool more_data_available() const;
 
     SwiftPacket::seq_t get_next_dsn() {
@@ -215,6 +219,8 @@ private:
     // Housekeeping
     SwiftLogger* _logger;
     TrafficLogger* _traffic_logger;
+    FlowEventLogger* _flow_logger;
+    bool _finished; // so we only report completion once
     BaseScheduler* _scheduler;
     SwiftRtxTimerScanner* _rtx_timer_scanner;
 
@@ -297,6 +303,7 @@ class SwiftRtxTimerScanner : public EventSource {
 public:
     SwiftRtxTimerScanner(simtime_picosec scanPeriod, EventList& eventlist);
     void doNextEvent();
+    bool idle() const;
     void registerSubflow(SwiftSubflowSrc &subflow_src);
 private:
     simtime_picosec _scanPeriod;
@@ -84,4 +84,7 @@ protected:
     static PacketDB<SwiftAck> _packetdb;
 };
 
+PACKET_SIZE_BUDGET(SwiftPacket, 112);
+PACKET_SIZE_BUDGET(SwiftAck, 112);
+
 #endif
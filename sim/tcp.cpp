@@ -11,7 +11,7 @@
 
 TcpSrc::TcpSrc(TcpLogger* logger, TrafficLogger* pktlogger, 
                EventList &eventlist)
-    : EventSource(eventlist,"tcp"),  _logger(logger), _flow(pktlogger)
+    : EventSource(eventlist,"tcp"), _flow(pktlogger), _logger(logger)
 {
     _mss = Packet::data_packet_size();
     _maxcwnd = 0xffffffff;//200*_mss;
@@ -46,6 +46,8 @@ TcpSrc::TcpSrc(TcpLogger* logger, TrafficLogger* pktlogger,
     _in_fast_recovery = false;
     _mSrc = NULL;
     _drops = 0;
+    _flow_logger = NULL;
+    _finished = false;
 
 #ifdef PACKET_SCATTER
     _crt_path = 0;
@@ -91,6 +93,9 @@ void
 TcpSrc::startflow() {
     _unacked = _cwnd;
     _established = false;
+    if (_flow_logger) {
+        _flow_logger->logEvent(_flow, *this, FlowEventLogger::START, _flow_size - _mss, 0);
+    }
 
     send_packets();
 }
@@ -185,6 +190,10 @@ TcpSrc::receivePacket(Packet& pkt)
 
     if (seqno >= _flow_size){
         cout << "Flow " << nodename() << " finished at " << timeAsMs(eventlist().now()) << endl;        
+        if (_flow_logger && !_finished) {
+            _flow_logger->logEvent(_flow, *this, FlowEventLogger::FINISH, _flow_size - _mss, _packets_sent);
+        }
+        _finished = true;
     }
   
     if (seqno > _last_acked) { // a brand new ack
@@ -732,6 +741,7 @@ void TcpSink::set_paths(vector<const Route*>* rt) {
 
 TcpRtxTimerScanner::TcpRtxTimerScanner(simtime_picosec scanPeriod, EventList& eventlist)
     : EventSource(eventlist,"RtxScanner"), _scanPeriod(scanPeriod) {
+    setPeriodic(scanPeriod);
     eventlist.sourceIsPendingRel(*this, _scanPeriod);
 }
 
@@ -748,3 +758,13 @@ void TcpRtxTimerScanner::doNextEvent() {
     }
     eventlist().sourceIsPendingRel(*this, _scanPeriod);
 }
+
+// only needed while one of our sources has a retransmit timer running
+bool
+TcpRtxTimerScanner::idle() const {
+    for (auto i = _tcps.begin(); i != _tcps.end(); i++) {
+        if ((*i)->_highest_sent != 0 && (*i)->_RFC2988_RTO_timeout != timeInf)
+            return false;
+    }
+    return true;
+}
@@ -47,6 +47,7 @@ public:
         cout << "Setting flow size to " << _flow_size << endl;
     }
     flowid_t getFlowId() {return _flow.flow_id();}
+    void logFlowEvents(FlowEventLogger& flow_logger) {_flow_logger = &flow_logger;}
     
     void set_ssthresh(uint64_t s){_ssthresh = s;}
     void set_cwnd(uint64_t s){_cwnd = s;}
@@ -117,6 +118,13 @@ public:
     virtual void inflate_window();
     virtual void deflate_window();
 
+protected:
+    FlowEventLogger* _flow_logger;
+    bool _finished; // so we only report completion once
+
+    // Connectivity
+    PacketFlow _flow;
+
 private:
     const Route* _old_route;
     uint64_t _last_packet_with_old_route;
@@ -125,9 +133,6 @@ private:
     TcpLogger* _logger;
     //TrafficLogger* _pktlogger;
 
-    // Connectivity
-    PacketFlow _flow;
-
     // Mechanism
     void clear_timer(uint64_t start,uint64_t end);
 
@@ -186,6 +191,7 @@ class TcpRtxTimerScanner : public EventSource {
 public:
     TcpRtxTimerScanner(simtime_picosec scanPeriod, EventList& eventlist);
     void doNextEvent();
+    bool idle() const;
     void registerTcp(TcpSrc &tcpsrc);
 private:
     simtime_picosec _scanPeriod;
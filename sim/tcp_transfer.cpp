@@ -26,6 +26,9 @@ TcpSrcTransfer::TcpSrcTransfer(TcpLogger* logger, TrafficLogger* pktLogger, Even
     _bytes_to_send = bytes_to_send;
     set_flowsize(_bytes_to_send+_mss);
     _paths = p;
+    _initial_cwnd = _cwnd;
+    _started = 0;
+    _finished_at = 0;
 
     _flow_stopped = stopped;
 
@@ -58,11 +61,29 @@ void TcpSrcTransfer::reset(uint64_t bb, int shouldRestart){
         eventlist().sourceIsPendingRel(*this,timeFromMs(1));
 }
 
+void TcpSrcTransfer::restart(uint64_t bytes, simtime_picosec starttime){
+    assert(!_is_active);
+    reset(bytes,0);
+    _bytes_to_send = bytes;
+    _flow_size = bytes + 2*_mss; // as set_flowsize() in the constructor
+    _cwnd = _initial_cwnd;
+    _finished = false;
+    _in_fast_recovery = false;
+    _packets_sent = 0;
+    _drops = 0;
+    // the previous transfer sent its last packets up to _finished_at;
+    // start strictly later so none of them looks like one of ours.
+    if (starttime <= _finished_at)
+        starttime = _finished_at + 1;
+    eventlist().sourceIsPending(*this,starttime);
+}
+
 
 void 
 TcpSrcTransfer::connect(const Route& routeout, const Route& routeback, TcpSink& sink, simtime_picosec starttime)
 {
     _is_active = false;
+    _initial_cwnd = _cwnd;
 
     TcpSrc::connect(routeout,routeback,sink,starttime);
 }
@@ -72,18 +93,24 @@ TcpSrcTransfer::doNextEvent() {
     if (!_is_active){
         _is_active = true;
 
-        //delete _route;
+        // routes may still be in use by packets of the previous
+        // transfer, so keep one per path rather than a new one each time.
         if (_paths!=NULL){
-            Route* rt = new Route(*(_paths->at(rand()%_paths->size())));
-            rt->push_back(_sink);
-            _route = rt;
+            uint32_t choice = rand()%_paths->size();
+            if (_path_routes.size() < _paths->size())
+                _path_routes.resize(_paths->size(), NULL);
+            if (!_path_routes[choice]){
+                _path_routes[choice] = new Route(*(_paths->at(choice)));
+                _path_routes[choice]->push_back(_sink);
+            }
+            _route = _path_routes[choice];
         }
 
         //should reset route here!
         //how?
-        ((TcpSinkTransfer*)_sink)->reset();
-
         _started = eventlist().now();
+        ((TcpSinkTransfer*)_sink)->reset(_started);
+
         startflow();
     }
     else TcpSrc::doNextEvent();
@@ -91,12 +118,26 @@ TcpSrcTransfer::doNextEvent() {
 
 void 
 TcpSrcTransfer::receivePacket(Packet& pkt){
+    // an ACK for a packet sent by the previous transfer.  SYNs carry no
+    // timestamp, but the SYN/ACK is the same for every transfer.
+    TcpAck& ack = (TcpAck&)pkt;
+    if (_is_active && ack.ackno() > 1 && ack.ts() < _started){
+        pkt.flow().logTraffic(pkt,*this,TrafficLogger::PKT_RCVDESTROY);
+        pkt.free();
+        return;
+    }
+
     if (_is_active){
         TcpSrc::receivePacket(pkt);
 
         if (_bytes_to_send>0){
             if (!_mSrc && _last_acked>=_bytes_to_send){
                 _is_active = false;
+                if (_flow_logger && !_finished) {
+                    _flow_logger->logEvent(_flow, *this, FlowEventLogger::FINISH, _bytes_to_send, _packets_sent);
+                }
+                _finished = true;
+                _finished_at = eventlist().now();
               
                 cout << endl << "Flow " << _bytes_to_send << " finished after " << timeAsMs(eventlist().now()-_started) << endl;
               
@@ -153,11 +194,27 @@ void TcpSrcTransfer::rtx_timer_hook(simtime_picosec now, simtime_picosec period)
 
 TcpSinkTransfer::TcpSinkTransfer() : TcpSink() 
 {
+    _started = 0;
+}
+
+void TcpSinkTransfer::receivePacket(Packet& pkt){
+    // data sent by the previous transfer, which we've already forgotten
+    // (the SYN has no timestamp, and is the same for every transfer)
+    TcpPacket& p = (TcpPacket&)pkt;
+    if (p.seqno() > 1 && p.ts() < _started){
+        pkt.flow().logTraffic(pkt,*this,TrafficLogger::PKT_RCVDESTROY);
+        pkt.free();
+        return;
+    }
+    TcpSink::receivePacket(pkt);
 }
 
-void TcpSinkTransfer::reset(){
+void TcpSinkTransfer::reset(simtime_picosec started){
     _cumulative_ack = 0;
     _received.clear();
+    _packets = 0;
+    _drops = 0;
+    _started = started;
 
     //queue logger sampling?
 }
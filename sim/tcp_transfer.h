@@ -29,6 +29,11 @@ public:
     virtual void rtx_timer_hook(simtime_picosec now,simtime_picosec period);
     virtual void receivePacket(Packet& pkt);
     void reset(uint64_t bb, int rs);
+    // start a new transfer of bytes on a finished flow, with fresh
+    // congestion state, so sources can be pooled and reused.  Packets
+    // of the previous transfer still in flight are told apart by their
+    // timestamps, which are older than the new transfer's start.
+    void restart(uint64_t bytes, simtime_picosec starttime);
     virtual void doNextEvent();
  
     // should really be private, but loggers want to see:
@@ -38,6 +43,11 @@ public:
     simtime_picosec _started;
     vector<const Route*>* _paths;
     EventSource* _flow_stopped;
+private:
+    // _paths[i] extended to our sink, built the first time it's used
+    vector<Route*> _path_routes;
+    uint32_t _initial_cwnd;
+    simtime_picosec _finished_at;
 };
 
 class TcpSinkTransfer : public TcpSink {
@@ -45,7 +55,10 @@ class TcpSinkTransfer : public TcpSink {
 public:
     TcpSinkTransfer();
 
-    void reset();
+    virtual void receivePacket(Packet& pkt);
+    void reset(simtime_picosec started);
+private:
+    simtime_picosec _started;
 };
 
 #endif
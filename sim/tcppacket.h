@@ -24,6 +24,7 @@ public:
         p->_seqno = seqno;
         p->_data_seqno=dataseqno;
         p->_syn = false;
+        p->_direction = NONE;
         return p;
     }
 
@@ -65,6 +66,7 @@ public:
         p->_seqno = seqno;
         p->_ackno = ackno;
         p->_data_ackno = dackno;
+        p->_direction = NONE;
 
         return p;
     }
@@ -91,4 +93,7 @@ protected:
     static PacketDB<TcpAck> _packetdb;
 };
 
+PACKET_SIZE_BUDGET(TcpPacket, 112);
+PACKET_SIZE_BUDGET(TcpAck, 112);
+
 #endif
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+
+import json
+import subprocess
+import os
+import re
+import time
+import argparse
+
+
+BENCH_DIR = 'htsim-benchmarks'
+CONFIG = BENCH_DIR + '/benchmarks.json'
+BASELINE = BENCH_DIR + '/baseline.json'
+OUTPUT = BENCH_DIR + '/bench.out'
+
+STATS_RE = re.compile(rb'^Events: (\d+) Packet hops: (\d+)$', re.MULTILINE)
+# printed by the simulator itself: the rusage we'd get from wait4 carries
+# over the RSS of the python process it was forked from
+RSS_RE = re.compile(rb'^Peak RSS: (\d+) KB$', re.MULTILINE)
+
+# for each metric, whether a larger value is better
+HIGHER_IS_BETTER = {
+	'events_per_sec': True,
+	'packets_per_sec': True,
+	'wall_s': False,
+	'peak_rss_mb': False,
+}
+
+
+def run_once(cmd: list[str]):
+	start = time.monotonic()
+	proc = subprocess.Popen(cmd, stdout = subprocess.PIPE, stderr = subprocess.STDOUT)
+	stdout = proc.stdout.read()
+	proc.wait()
+	wall = time.monotonic() - start
+	if proc.returncode != 0:
+		raise RuntimeError(f'exit status {proc.returncode}')
+
+	match = STATS_RE.search(stdout)
+	if not match:
+		raise RuntimeError('no "Events: Packet hops:" line in output')
+	rss_match = RSS_RE.search(stdout)
+	if not rss_match:
+		raise RuntimeError('no "Peak RSS:" line in output')
+	return {
+		'events': int(match.group(1)),
+		'packets': int(match.group(2)),
+		'wall_s': wall,
+		'peak_rss_mb': int(rss_match.group(1)) / 1024,
+	}
+
+
+def run_benchmark(bench: dict, repeat: int):
+	cmd = [OUTPUT if arg == '{output}' else arg for arg in bench['cmd']]
+	runs = [run_once(cmd) for _ in range(repeat)]
+	try:
+		os.remove(OUTPUT)
+	except FileNotFoundError:
+		pass
+
+	# the event and packet counts depend only on the seed, so all
+	# runs should agree; the fastest run has the least noise.
+	for run in runs[1:]:
+		if run['events'] != runs[0]['events'] or run['packets'] != runs[0]['packets']:
+			raise RuntimeError('event counts differ between runs')
+	best = min(runs, key = lambda r: r['wall_s'])
+	return {
+		'name': bench['name'],
+		'events': best['events'],
+		'packets': best['packets'],
+		'wall_s': round(best['wall_s'], 4),
+		'events_per_sec': round(best['events'] / best['wall_s']),
+		'packets_per_sec': round(best['packets'] / best['wall_s']),
+		'peak_rss_mb': round(max(r['peak_rss_mb'] for r in runs), 1),
+	}
+
+
+def compare(result: dict, base: dict, thresholds: dict):
+	failures = []
+	if result['events'] != base['events'] or result['packets'] != base['packets']:
+		# not a regression as such, but the timings are no longer comparable
+		print(f'  note: event counts changed from {base["events"]}/{base["packets"]}'
+			f' to {result["events"]}/{result["packets"]}, simulation behaviour has changed')
+	for metric, higher_is_better in HIGHER_IS_BETTER.items():
+		limit = thresholds.get(metric)
+		if limit is None or not base.get(metric):
+			continue
+		change = (result[metric] - base[metric]) / base[metric]
+		worse = -change if higher_is_better else change
+		status = 'REGRESSION' if worse > limit else 'ok'
+		print(f'  {metric:16} {base[metric]:>14} -> {result[metric]:>14} ({change:+.1%}) {status}')
+		if worse > limit:
+			failures.append(metric)
+	return failures
+
+
+if __name__ == '__main__':
+	parser = argparse.ArgumentParser('benchmarks.py', description = 'Runs HTSim benchmarks and compares them against a stored baseline')
+	parser.add_argument('-u', '--update', action = 'store_true', help = 'store the results as the new baseline')
+	parser.add_argument('-o', '--output', help = 'write the results to this file as JSON')
+	parser.add_argument('-r', '--repeat', type = int, default = 3, help = 'runs per benchmark, the fastest is kept')
+	parser.add_argument('-b', '--bench', action = 'append', help = 'only run this benchmark (may be repeated)')
+	args = parser.parse_args()
+
+	with open(CONFIG) as config_file:
+		config = json.load(config_file)
+	thresholds = config.get('thresholds', {})
+
+	baseline = {}
+	if not args.update:
+		try:
+			with open(BASELINE) as baseline_file:
+				baseline = {b['name']: b for b in json.load(baseline_file)}
+		except FileNotFoundError:
+			print('No baseline found, run with -u to create one\n')
+
+	results = []
+	regressions = []
+	for bench in config['benchmarks']:
+		if args.bench and bench['name'] not in args.bench:
+			continue
+		print('Benchmark ' + bench['name'])
+		try:
+			result = run_benchmark(bench, args.repeat)
+		except Exception as e:
+			print(f'  failed: {e}\n')
+			regressions.append(bench['name'])
+			continue
+		results.append(result)
+		print(f'  {result["events"]} events, {result["packets"]} packet hops in {result["wall_s"]}s,'
+			f' peak rss {result["peak_rss_mb"]}MB')
+		if bench['name'] in baseline:
+			if compare(result, baseline[bench['name']], thresholds):
+				regressions.append(bench['name'])
+		print()
+
+	if args.output:
+		with open(args.output, 'w') as out_file:
+			json.dump(results, out_file, indent = 1)
+	if args.update:
+		with open(BASELINE, 'w') as baseline_file:
+			json.dump(results, baseline_file, indent = 1)
+		print('Updated baseline')
+
+	if regressions:
+		print('Regressions: ' + ' '.join(regressions))
+		exit(1)
@@ -74,7 +74,8 @@ def run_test(test_name: str, update: bool = False, verbose: bool = False):
 	print('Test ' + test_name)
 	print('Parameters: ' + str(params))
 	print('=' * 32)
-	executable = 'htsim_' + test_name
+	# tests of the datacenter binaries name them, relative to this directory
+	executable = test_opts.get('executable', 'htsim_' + test_name)
 	output = test_opts.get('output')
 	out_param = []
 	if output == None: